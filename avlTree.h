@@ -37,6 +37,7 @@ typedef struct buffer_info
 {
     unsigned long read_hit;                      /*这里的hit都表示sector的命中次数或是没命中的次数*/
     unsigned long read_miss_hit;  
+    unsigned long read_node_miss;                /*读请求的lpn在buffer中没有节点时没命中的sector数，不计入read_miss_hit*/
     unsigned long write_hit;   
     unsigned long write_miss_hit;
 
@@ -44,8 +45,28 @@ typedef struct buffer_info
     struct buffer_group *buffer_tail;            /*as LRU tail which is least recently used*/
     TREE_NODE	*pTreeHeader;     				 /*for search target lsn is LRU table*/
 
-    unsigned int max_buffer_sector;
-    unsigned int buffer_sector_count;
+    unsigned long long max_buffer_sector;
+    unsigned long long buffer_sector_count;
+    int policy;                                  /*替换策略，buffer_policies[]的下标*/
+    struct buffer_hash *hash;                    /*buffer index为1时的哈希索引，否则为NULL，使用平衡二叉树*/
+    unsigned long write_back_count;              /*写回的buffer node数*/
+    unsigned long evict_batch_count;             /*evict batch大于1时批量写回的次数*/
+    unsigned long clean_evict_count;             /*不需要写回就被替换的干净节点数*/
+    unsigned long padding_count;                 /*BPLRU补齐逻辑块时读出再写回的页数*/
+    unsigned long long dirty_sector_count;       /*脏的sector数*/
+    int flushing;                                /*后台写回是否在进行*/
+    unsigned long flush_count;                   /*后台写回的buffer node数*/
+    unsigned long sync_count;                    /*flush命令和FUA写强制写入flash的buffer node数*/
+    struct buffer_group *flush_cursor[2];        /*后台写回的扫描位置，队尾到这个节点之间都是干净的节点；NULL表示从队尾开始*/
+
+    struct buffer_group *frequent_head;          /*ARC的T2队列，buffer_head/buffer_tail为T1队列*/
+    struct buffer_group *frequent_tail;
+    unsigned int frequent_count;
+    unsigned int arc_capacity;                   /*ARC中buffer能放下的页数*/
+    unsigned int arc_target;                     /*ARC中T1的目标页数*/
+    struct buffer_info *ghost[2];                /*ARC中最近从T1和T2替换出去的lpn*/
+    struct buffer_info *blocks;                  /*BPLRU/FAB中按逻辑块组织的LRU队列，节点的group为逻辑块号*/
+    unsigned int block_pages;                    /*一个逻辑块的页数*/
 
 #ifdef ORDER_LIST_WANTED
     TREE_NODE	*pListHeader;
@@ -19,20 +19,138 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 #include "flash.h"
 #include "ssd.h"
 
+/*****************************************************************************************
+ *channel的读子请求队列是双向链表，另外按ppn建了哈希索引，查找相同ppn的子请求和从队列中取出
+ *子请求都不用遍历队列。读子请求都通过下面几个函数进出队列
+ *****************************************************************************************/
+static unsigned int subs_r_home(int64_t ppn)
+{
+    return (unsigned int)(((uint64_t)ppn*0x9E3779B97F4A7C15ULL)>>(64-SUBS_R_INDEX_BITS));
+}
+
+/*把sub插到队列中ahead的后面，ahead为NULL时插到队首*/
+static void subs_r_insert(struct channel_info *ch,struct sub_request *ahead,struct sub_request *sub)
+{
+    unsigned int home=subs_r_home(sub->ppn);
+
+    sub->prev_node=ahead;
+    sub->next_node=(ahead!=NULL)?ahead->next_node:ch->subs_r_head;
+    if (sub->next_node!=NULL)
+    {
+        sub->next_node->prev_node=sub;
+    }
+    else
+    {
+        ch->subs_r_tail=sub;
+    }
+    if (ahead!=NULL)
+    {
+        ahead->next_node=sub;
+    }
+    else
+    {
+        ch->subs_r_head=sub;
+    }
+    sub->hash_next=ch->subs_r_index[home];
+    ch->subs_r_index[home]=sub;
+    if (sub->prefetch!=0)
+    {
+        ch->subs_r_prefetch++;
+    }
+}
+
+static void subs_r_append(struct channel_info *ch,struct sub_request *sub)
+{
+    subs_r_insert(ch,ch->subs_r_tail,sub);
+}
+
+static void subs_r_remove(struct channel_info *ch,struct sub_request *sub)
+{
+    struct sub_request **slot=&ch->subs_r_index[subs_r_home(sub->ppn)];
+
+    if (sub->prev_node!=NULL)
+    {
+        sub->prev_node->next_node=sub->next_node;
+    }
+    else
+    {
+        ch->subs_r_head=sub->next_node;
+    }
+    if (sub->next_node!=NULL)
+    {
+        sub->next_node->prev_node=sub->prev_node;
+    }
+    else
+    {
+        ch->subs_r_tail=sub->prev_node;
+    }
+    while (*slot!=sub)
+    {
+        slot=&(*slot)->hash_next;
+    }
+    *slot=sub->hash_next;
+    for (slot=&ch->subs_r_issued;*slot!=NULL;slot=&(*slot)->issued_next)
+    {
+        if (*slot==sub)
+        {
+            *slot=sub->issued_next;
+            break;
+        }
+    }
+    if (sub->prefetch!=0)
+    {
+        ch->subs_r_prefetch--;
+    }
+    sub->next_node=NULL;
+    sub->prev_node=NULL;
+    sub->hash_next=NULL;
+    sub->issued_next=NULL;
+}
+
+/*队列中的读子请求离开SR_WAIT(发出读命令)之前调用，加入channel的已发出链表，这个链表只有每个plane一个子请求那么长*/
+static void subs_r_issue(struct ssd_info *ssd,struct sub_request *sub)
+{
+    struct channel_info *ch=&ssd->channel_head[sub->location->channel];
+
+    if ((sub->current_state!=SR_WAIT)||((sub->prev_node==NULL)&&(ch->subs_r_head!=sub)))
+    {
+        return;
+    }
+    sub->issued_next=ch->subs_r_issued;
+    ch->subs_r_issued=sub;
+}
+
+/*****************************************************************************************
+ *读队列中ppn相同的子请求。有几个时，issued为0(查重)优先返回不是预取的，issued为1(取数据)优先返回
+ *已经发出读命令的；条件相同时返回最早进入队列的(在哈希链的最后)
+ *****************************************************************************************/
+static struct sub_request *subs_r_find(struct channel_info *ch,int64_t ppn,int issued)
+{
+    struct sub_request *sub=NULL,*found=NULL,*preferred=NULL;
+
+    for (sub=ch->subs_r_index[subs_r_home(ppn)];sub!=NULL;sub=sub->hash_next)
+    {
+        if (sub->ppn!=ppn)
+        {
+            continue;
+        }
+        found=sub;
+        if ((issued!=0)?(sub->current_state!=SR_WAIT):(sub->prefetch==0))
+        {
+            preferred=sub;
+        }
+    }
+    return (preferred!=NULL)?preferred:found;
+}
+
 /**********************
  *这个函数只作用于写请求 | This function only works on write requests.
  ***********************/
 Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
 {
     struct sub_request * update=NULL;
-    unsigned int channel_num=0,chip_num=0,die_num=0,plane_num=0;
     struct local *location=NULL;
 
-    channel_num=ssd->parameter->channel_number;
-    chip_num=ssd->parameter->chip_channel[0];
-    die_num=ssd->parameter->die_chip;
-    plane_num=ssd->parameter->plane_die;
-
 
     if (ssd->parameter->allocation_scheme==0)                                          /*动态分配的情况*/
     {
@@ -40,9 +158,16 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
          *In dynamic allocation, because the update operation of the page cannot use the copyback operation,
          *A read request needs to be generated, and only after the read request is completed can the page be written
          *******************************************************************/
-        if (ssd->dram->map->map_entry[sub_req->lpn].state!=0)    
+        if ((get_entry(ssd,sub_req->lpn)->state!=0)&&(ssd->dram->map->submap!=NULL))
+        {                                                                              /*子页映射只写新的子页，旧的子页留在原来的物理页中*/
+            if ((sub_req->state&get_entry(ssd,sub_req->lpn)->state)!=get_entry(ssd,sub_req->lpn)->state)
+            {
+                ssd->dram->map->submap->avoided_update_read_count++;
+            }
+        }
+        else if (get_entry(ssd,sub_req->lpn)->state!=0)    
         {
-            if ((sub_req->state&ssd->dram->map->map_entry[sub_req->lpn].state)!=ssd->dram->map->map_entry[sub_req->lpn].state)
+            if ((sub_req->state&get_entry(ssd,sub_req->lpn)->state)!=get_entry(ssd,sub_req->lpn)->state)
             {
                 ssd->read_count++;
                 ssd->in_read_size+=ssd->parameter->subpage_page;
@@ -60,7 +185,7 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
                 update->next_node=NULL;
                 update->next_subs=NULL;
                 update->update=NULL;						
-                location = find_location(ssd,ssd->dram->map->map_entry[sub_req->lpn].pn);
+                location = find_location(ssd,get_entry(ssd,sub_req->lpn)->pn);
                 update->location=location;
                 update->begin_time = ssd->current_time;
                 update->current_state = SR_WAIT;
@@ -68,21 +193,12 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
                 update->next_state = SR_R_C_A_TRANSFER;
                 update->next_state_predict_time=MAX_INT64;
                 update->lpn = sub_req->lpn;
-                update->state=((ssd->dram->map->map_entry[sub_req->lpn].state^sub_req->state)&0x7fffffff);
+                update->state=((get_entry(ssd,sub_req->lpn)->state^sub_req->state)&SUBPAGE_BITS(ssd->parameter->subpage_page));
                 update->size=size(update->state);
-                update->ppn = ssd->dram->map->map_entry[sub_req->lpn].pn;
+                update->ppn = get_entry(ssd,sub_req->lpn)->pn;
                 update->operation = READ;
                 
-                if (ssd->channel_head[location->channel].subs_r_tail!=NULL)            /*Generate a new read request and hang it to the end of the subs_r_tail queue of the channel*/
-                {
-                    ssd->channel_head[location->channel].subs_r_tail->next_node=update;
-                    ssd->channel_head[location->channel].subs_r_tail=update;
-                } 
-                else
-                {
-                    ssd->channel_head[location->channel].subs_r_tail=update;
-                    ssd->channel_head[location->channel].subs_r_head=update;
-                }
+                subs_r_append(&ssd->channel_head[location->channel],update);             /*Generate a new read request and hang it to the end of the subs_r_tail queue of the channel*/
             }
         }
         /***************************************
@@ -152,67 +268,31 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
          *是静态分配方式，所以可以将这个子请求的最终channel，chip，die，plane全部得出
          *总共有0,1,2,3,4,5,这六种静态分配方式。
          *Is a static allocation method, so you can get the final channel, chip, die, plane of this subrequest
-         *There are a total of 0, 1, 2, 3, 4, 5, these six static allocation methods.
+         *There are a total of 0, 1, 2, 3, 4, 5, these six static allocation methods, 6 uses static allocation order.
+         *The location is looked up in the allocation table built by initialize_allocation_table().
          ****************************************************************************/
-        switch (ssd->parameter->static_allocation)
+        if (ssd->parameter->address_mapping==ZNS_MAPPING)                             /*ZNS中逻辑页的位置是固定的*/
         {
-            case 0:         //no striping static allocation
-                {
-                    sub_req->location->channel=(sub_req->lpn/(plane_num*die_num*chip_num))%channel_num;
-                    sub_req->location->chip=sub_req->lpn%chip_num;
-                    sub_req->location->die=(sub_req->lpn/chip_num)%die_num;
-                    sub_req->location->plane=(sub_req->lpn/(die_num*chip_num))%plane_num;
-                    break;
-                }
-            case 1:
-                {
-                    sub_req->location->channel=sub_req->lpn%channel_num;
-                    sub_req->location->chip=(sub_req->lpn/channel_num)%chip_num;
-                    sub_req->location->die=(sub_req->lpn/(chip_num*channel_num))%die_num;
-                    sub_req->location->plane=(sub_req->lpn/(die_num*chip_num*channel_num))%plane_num;
-
-                    break;
-                }
-            case 2:
-                {
-                    sub_req->location->channel=sub_req->lpn%channel_num;
-                    sub_req->location->chip=(sub_req->lpn/(plane_num*channel_num))%chip_num;
-                    sub_req->location->die=(sub_req->lpn/(plane_num*chip_num*channel_num))%die_num;
-                    sub_req->location->plane=(sub_req->lpn/channel_num)%plane_num;
-                    break;
-                }
-            case 3:
-                {
-                    sub_req->location->channel=sub_req->lpn%channel_num;
-                    sub_req->location->chip=(sub_req->lpn/(die_num*channel_num))%chip_num;
-                    sub_req->location->die=(sub_req->lpn/channel_num)%die_num;
-                    sub_req->location->plane=(sub_req->lpn/(die_num*chip_num*channel_num))%plane_num;
-                    break;
-                }
-            case 4:  
-                {
-                    sub_req->location->channel=sub_req->lpn%channel_num;
-                    sub_req->location->chip=(sub_req->lpn/(plane_num*die_num*channel_num))%chip_num;
-                    sub_req->location->die=(sub_req->lpn/(plane_num*channel_num))%die_num;
-                    sub_req->location->plane=(sub_req->lpn/channel_num)%plane_num;
-
-                    break;
-                }
-            case 5:   
-                {
-                    sub_req->location->channel=sub_req->lpn%channel_num;
-                    sub_req->location->chip=(sub_req->lpn/(plane_num*die_num*channel_num))%chip_num;
-                    sub_req->location->die=(sub_req->lpn/channel_num)%die_num;
-                    sub_req->location->plane=(sub_req->lpn/(die_num*channel_num))%plane_num;
-
-                    break;
-                }
-            default : return ERROR;
-
+            zns_location(ssd,sub_req->lpn,sub_req->location);
+        }
+        else if (ssd->parameter->address_mapping!=PAGE_MAPPING)                       /*块映射和FAST中逻辑块所在的plane是固定的*/
+        {
+            blockmap_plane(ssd,sub_req->lpn/ssd->parameter->page_block,sub_req->location);
+        }
+        else
+        {
+            static_location(ssd,sub_req->lpn,sub_req->location);
+        }
+        if ((get_entry(ssd,sub_req->lpn)->state!=0)&&(ssd->dram->map->submap!=NULL))
+        {
+            if ((sub_req->state&get_entry(ssd,sub_req->lpn)->state)!=get_entry(ssd,sub_req->lpn)->state)
+            {
+                ssd->dram->map->submap->avoided_update_read_count++;
+            }
         }
-        if (ssd->dram->map->map_entry[sub_req->lpn].state!=0)
+        else if ((get_entry(ssd,sub_req->lpn)->state!=0)&&(ssd->parameter->address_mapping!=ZNS_MAPPING))
         {                                                                              /*这个写回的子请求的逻辑页不可以覆盖之前被写回的数据 需要产生读请求*/ 
-            if ((sub_req->state&ssd->dram->map->map_entry[sub_req->lpn].state)!=ssd->dram->map->map_entry[sub_req->lpn].state)  
+            if ((sub_req->state&get_entry(ssd,sub_req->lpn)->state)!=get_entry(ssd,sub_req->lpn)->state)  
             {
                 ssd->read_count++;
                 ssd->in_read_size+=ssd->parameter->subpage_page;
@@ -229,7 +309,7 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
                 update->next_node=NULL;
                 update->next_subs=NULL;
                 update->update=NULL;						
-                location = find_location(ssd,ssd->dram->map->map_entry[sub_req->lpn].pn);
+                location = find_location(ssd,get_entry(ssd,sub_req->lpn)->pn);
                 update->location=location;
                 update->begin_time = ssd->current_time;
                 update->current_state = SR_WAIT;
@@ -237,21 +317,12 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
                 update->next_state = SR_R_C_A_TRANSFER;
                 update->next_state_predict_time=MAX_INT64;
                 update->lpn = sub_req->lpn;
-                update->state=((ssd->dram->map->map_entry[sub_req->lpn].state^sub_req->state)&0x7fffffff);
+                update->state=((get_entry(ssd,sub_req->lpn)->state^sub_req->state)&SUBPAGE_BITS(ssd->parameter->subpage_page));
                 update->size=size(update->state);
-                update->ppn = ssd->dram->map->map_entry[sub_req->lpn].pn;
+                update->ppn = get_entry(ssd,sub_req->lpn)->pn;
                 update->operation = READ;
 
-                if (ssd->channel_head[location->channel].subs_r_tail!=NULL)
-                {
-                    ssd->channel_head[location->channel].subs_r_tail->next_node=update;
-                    ssd->channel_head[location->channel].subs_r_tail=update;
-                } 
-                else
-                {
-                    ssd->channel_head[location->channel].subs_r_tail=update;
-                    ssd->channel_head[location->channel].subs_r_head=update;
-                }
+                subs_r_append(&ssd->channel_head[location->channel],update);
             }
 
             if (update!=NULL)
@@ -281,281 +352,1701 @@ Status allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req)
 }	
 
 
-/*******************************************************************************
-*insert2 buffer This function is called in buffer_management to assign sub-request services for write requests.
- ********************************************************************************/
-struct ssd_info * insert2buffer(struct ssd_info *ssd,unsigned int lpn,int state,struct sub_request *sub,struct request *req)      
+/*****************************************************************************************
+ *buffer node的查找、插入、删除和替换。buffer->hash为空时按lpn在平衡二叉树中查找，否则在哈希表中查找；
+ *buffer->policy是替换策略(写buffer由buffer management决定)：LRU时命中的节点移到队首，淘汰队尾的节点；CLOCK时命中只置
+ *访问位，淘汰时从队尾开始，访问位为1的节点清0后移到队首，相当于时钟指针扫过一次
+ *****************************************************************************************/
+static unsigned int buffer_hash_home(struct buffer_hash *hash,int64_t lpn)
 {
-    int write_back_count,flag=0;                                                             /*flag表示为写入新数据腾空间是否完成，0表示需要进一步腾，1表示已经腾空*/
-    unsigned int i,lsn,hit_flag,add_flag,sector_count,active_region_flag=0,free_sector=0;
-    struct buffer_group *buffer_node=NULL,*pt,*new_node=NULL,key;
-    struct sub_request *sub_req=NULL,*update=NULL;
-
-
-    unsigned int sub_req_state=0, sub_req_size=0,sub_req_lpn=0;
+    return (unsigned int)(((uint64_t)lpn*0x9E3779B97F4A7C15ULL)>>(64-hash->bits));
+}
 
-#ifdef DEBUG
-    printf("enter insert2buffer,  current time:%lld, lpn:%d, state:%d,\n",ssd->current_time,lpn,state);
-#endif
+static void buffer_hash_put(struct buffer_hash *hash,struct buffer_group *node)
+{
+    unsigned int i,mask=(1U<<hash->bits)-1;
 
-    sector_count=size(state);                                                                /*需要写到buffer的sector个数*/
-    key.group=lpn;
-    buffer_node= (struct buffer_group*)avlTreeFind(ssd->dram->buffer, (TREE_NODE *)&key);    /*在平衡二叉树中寻找buffer node*/ 
+    i=buffer_hash_home(hash,node->group);
+    while (hash->slot[i]!=NULL)
+    {
+        i=(i+1)&mask;
+    }
+    hash->slot[i]=node;
+}
 
-    /************************************************************************************************
-     *No hits.
-     *The first step is to delete the lsn that has been written back according to how many subpages of this lpn need to be written to the buffer, to make room for the lpn,
-     *First of all, it is necessary to calculate the free sector (indicating how many buffer nodes can be written directly).
-     *If free_sector>=sector_count, there is extra space enough for lpn sub-request to write, no need to generate a write-back request
-     *Otherwise, there is no extra space for the lpn sub-request to write. At this time, a part of the space needs to be released to generate a write-back request. Just creat_sub_request()
-     *************************************************************************************************/
-    if(buffer_node==NULL)
+/*装载率超过1/2时哈希表加倍，所有节点重新插入*/
+static void buffer_hash_resize(struct buffer_hash *hash)
+{
+    unsigned int i,old_size=1U<<hash->bits;
+    struct buffer_group **old_slot=hash->slot;
+
+    hash->bits++;
+    hash->slot=(struct buffer_group **)malloc(sizeof(struct buffer_group *)*(1U<<hash->bits));
+    alloc_assert(hash->slot,"buffer_hash->slot");
+    memset(hash->slot,0,sizeof(struct buffer_group *)*(1U<<hash->bits));
+    for (i=0;i<old_size;i++)
     {
-        free_sector=ssd->dram->buffer->max_buffer_sector-ssd->dram->buffer->buffer_sector_count;   
-        if(free_sector>=sector_count)
-        {
-            flag=1;    
-        }
-        if(flag==0)     
+        if (old_slot[i]!=NULL)
         {
-            write_back_count=sector_count-free_sector;
-            ssd->dram->buffer->write_miss_hit=ssd->dram->buffer->write_miss_hit+write_back_count;
-            while(write_back_count>0)
-            {
-                sub_req=NULL;
-                sub_req_state=ssd->dram->buffer->buffer_tail->stored; 
-                sub_req_size=size(ssd->dram->buffer->buffer_tail->stored);
-                sub_req_lpn=ssd->dram->buffer->buffer_tail->group;
-                sub_req=creat_sub_request(ssd,sub_req_lpn,sub_req_size,sub_req_state,req,WRITE);
-
-                /**********************************************************************************
-                 *req不为空，表示这个insert2buffer函数是在buffer_management中调用，传递了request进来
-                 *req为空，表示这个函数是在process函数中处理一对多映射关系的读的时候，需要将这个读出
-                 *的数据加到buffer中，这可能产生实时的写回操作，需要将这个实时的写回操作的子请求挂在
-                 *这个读请求的总请求上
-                 ***********************************************************************************/
-                if(req!=NULL)                                             
-                {
-                }
-                else    
-                {
-                    sub_req->next_subs=sub->next_subs;
-                    sub->next_subs=sub_req;
-                }
-
-                /*********************************************************************
-                 *写请求插入到了平衡二叉树，这时就要修改dram的buffer_sector_count；
-                 *维持平衡二叉树调用avlTreeDel()和AVL_TREENODE_FREE()函数；维持LRU算法；
-                 **********************************************************************/
-                ssd->dram->buffer->buffer_sector_count=ssd->dram->buffer->buffer_sector_count-sub_req->size;
-                pt = ssd->dram->buffer->buffer_tail;
-                avlTreeDel(ssd->dram->buffer, (TREE_NODE *) pt);
-                if(ssd->dram->buffer->buffer_head->LRU_link_next == NULL){
-                    ssd->dram->buffer->buffer_head = NULL;
-                    ssd->dram->buffer->buffer_tail = NULL;
-                }else{
-                    ssd->dram->buffer->buffer_tail=ssd->dram->buffer->buffer_tail->LRU_link_pre;
-                    ssd->dram->buffer->buffer_tail->LRU_link_next=NULL;
-                }
-                pt->LRU_link_next=NULL;
-                pt->LRU_link_pre=NULL;
-                AVL_TREENODE_FREE(ssd->dram->buffer, (TREE_NODE *) pt);
-                pt = NULL;
-
-                write_back_count=write_back_count-sub_req->size;                            /*因为产生了实时写回操作，需要将主动写回操作区域增加*/
-            }
+            buffer_hash_put(hash,old_slot[i]);
         }
+    }
+    free(old_slot);
+}
 
-        /******************************************************************************
-         *生成一个buffer node，根据这个页的情况分别赋值个各个成员，添加到队首和二叉树中
-         *******************************************************************************/
-        new_node=NULL;
-        new_node=(struct buffer_group *)malloc(sizeof(struct buffer_group));
-        alloc_assert(new_node,"buffer_group_node");
-        memset(new_node,0, sizeof(struct buffer_group));
+/*线性探测的删除：删除后把后面探测链上的节点前移，不使用删除标记*/
+static void buffer_hash_remove(struct buffer_hash *hash,struct buffer_group *node)
+{
+    unsigned int i,j,home,mask=(1U<<hash->bits)-1;
 
-        new_node->group=lpn;
-        new_node->stored=state;
-        new_node->dirty_clean=state;
-        new_node->LRU_link_pre = NULL;
-        new_node->LRU_link_next=ssd->dram->buffer->buffer_head;
-        if(ssd->dram->buffer->buffer_head != NULL){
-            ssd->dram->buffer->buffer_head->LRU_link_pre=new_node;
-        }else{
-            ssd->dram->buffer->buffer_tail = new_node;
-        }
-        ssd->dram->buffer->buffer_head=new_node;
-        new_node->LRU_link_pre=NULL;
-        avlTreeAdd(ssd->dram->buffer, (TREE_NODE *) new_node);
-        ssd->dram->buffer->buffer_sector_count += sector_count;
+    i=buffer_hash_home(hash,node->group);
+    while (hash->slot[i]!=node)
+    {
+        i=(i+1)&mask;
     }
-    /****************************************************************************************
-     *在buffer中命中的情况
-     *算然命中了，但是命中的只是lpn，有可能新来的写请求，只是需要写lpn这一page的某几个sub_page
-     *这时有需要进一步的判断
-     *****************************************************************************************/
-    else
+    hash->slot[i]=NULL;
+    j=i;
+    while (1)
     {
-        for(i=0;i<ssd->parameter->subpage_page;i++)
+        j=(j+1)&mask;
+        if (hash->slot[j]==NULL)
         {
-            /*************************************************************
-             *判断state第i位是不是1
-             *并且判断第i个sector是否存在buffer中，1表示存在，0表示不存在。
-             **************************************************************/
-            if((state>>i)%2!=0)                                                         
-            {
-                lsn=lpn*ssd->parameter->subpage_page+i;
-                hit_flag=0;
-                hit_flag=(buffer_node->stored)&(0x00000001<<i);
-
-                if(hit_flag!=0)				                                          /*命中了，需要将该节点移到buffer的队首，并且将命中的lsn进行标记*/
-                {	
-                    active_region_flag=1;                                             /*用来记录在这个buffer node中的lsn是否被命中，用于后面对阈值的判定*/
-
-                    if(req!=NULL)
-                    {
-                        if(ssd->dram->buffer->buffer_head!=buffer_node)     
-                        {				
-                            if(ssd->dram->buffer->buffer_tail==buffer_node)
-                            {				
-                                ssd->dram->buffer->buffer_tail=buffer_node->LRU_link_pre;
-                                buffer_node->LRU_link_pre->LRU_link_next=NULL;					
-                            }				
-                            else if(buffer_node != ssd->dram->buffer->buffer_head)
-                            {					
-                                buffer_node->LRU_link_pre->LRU_link_next=buffer_node->LRU_link_next;				
-                                buffer_node->LRU_link_next->LRU_link_pre=buffer_node->LRU_link_pre;
-                            }				
-                            buffer_node->LRU_link_next=ssd->dram->buffer->buffer_head;	
-                            ssd->dram->buffer->buffer_head->LRU_link_pre=buffer_node;
-                            buffer_node->LRU_link_pre=NULL;				
-                            ssd->dram->buffer->buffer_head=buffer_node;					
-                        }					
-                        ssd->dram->buffer->write_hit++;
-                        req->complete_lsn_count++;                                        /*关键 当在buffer中命中时 就用req->complete_lsn_count++表示往buffer中写了数据。*/					
-                    }
-                    else
-                    {
-                    }				
-                }			
-                else                 			
-                {
-                    /************************************************************************************************************
-                     *该lsn没有命中，但是节点在buffer中，需要将这个lsn加到buffer的对应节点中
-                     *从buffer的末端找一个节点，将一个已经写回的lsn从节点中删除(如果找到的话)，更改这个节点的状态，同时将这个新的
-                     *lsn加到相应的buffer节点中，该节点可能在buffer头，不在的话，将其移到头部。如果没有找到已经写回的lsn，在buffer
-                     *节点找一个group整体写回，将这个子请求挂在这个请求上。可以提前挂在一个channel上。
-                     *第一步:将buffer队尾的已经写回的节点删除一个，为新的lsn腾出空间，这里需要修改队尾某节点的stored状态这里还需要
-                     *       增加，当没有可以之间删除的lsn时，需要产生新的写子请求，写回LRU最后的节点。
-                     *第二步:将新的lsn加到所述的buffer节点中。
-                     *************************************************************************************************************/	
-                    ssd->dram->buffer->write_miss_hit++;
-
-                    if(ssd->dram->buffer->buffer_sector_count>=ssd->dram->buffer->max_buffer_sector)
-                    {
-                        if (buffer_node==ssd->dram->buffer->buffer_tail)                  /*如果命中的节点是buffer中最后一个节点，交换最后两个节点*/
-                        {
-                            pt = ssd->dram->buffer->buffer_tail->LRU_link_pre;
-                            ssd->dram->buffer->buffer_tail->LRU_link_pre=pt->LRU_link_pre;
-                            ssd->dram->buffer->buffer_tail->LRU_link_pre->LRU_link_next=ssd->dram->buffer->buffer_tail;
-                            ssd->dram->buffer->buffer_tail->LRU_link_next=pt;
-                            pt->LRU_link_next=NULL;
-                            pt->LRU_link_pre=ssd->dram->buffer->buffer_tail;
-                            ssd->dram->buffer->buffer_tail=pt;
+            break;
+        }
+        home=buffer_hash_home(hash,hash->slot[j]->group);
+        if (((j-home)&mask)>=((j-i)&mask))                                   /*home不在(i,j]之间，可以前移到i*/
+        {
+            hash->slot[i]=hash->slot[j];
+            hash->slot[j]=NULL;
+            i=j;
+        }
+    }
+    hash->count--;
+}
 
-                        }
-                        sub_req=NULL;
-                        sub_req_state=ssd->dram->buffer->buffer_tail->stored; 
-                        sub_req_size=size(ssd->dram->buffer->buffer_tail->stored);
-                        sub_req_lpn=ssd->dram->buffer->buffer_tail->group;
-                        sub_req=creat_sub_request(ssd,sub_req_lpn,sub_req_size,sub_req_state,req,WRITE);
+/*节点所在的LRU队列：ARC的T2节点在frequent队列中，其余在buffer_head/buffer_tail队列中*/
+static void buffer_unlink(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_group **head=(buffer_node->frequent!=0)?&buffer->frequent_head:&buffer->buffer_head;
+    struct buffer_group **tail=(buffer_node->frequent!=0)?&buffer->frequent_tail:&buffer->buffer_tail;
 
-                        if(req!=NULL)           
-                        {
+    if (buffer->flush_cursor[buffer_node->frequent]==buffer_node)
+        buffer->flush_cursor[buffer_node->frequent]=buffer_node->LRU_link_pre;
+    if (buffer_node->LRU_link_pre!=NULL)
+        buffer_node->LRU_link_pre->LRU_link_next=buffer_node->LRU_link_next;
+    else
+        *head=buffer_node->LRU_link_next;
+    if (buffer_node->LRU_link_next!=NULL)
+        buffer_node->LRU_link_next->LRU_link_pre=buffer_node->LRU_link_pre;
+    else
+        *tail=buffer_node->LRU_link_pre;
+    buffer_node->LRU_link_next=NULL;
+    buffer_node->LRU_link_pre=NULL;
+}
 
-                        }
-                        else if(req==NULL)   
-                        {
-                            sub_req->next_subs=sub->next_subs;
-                            sub->next_subs=sub_req;
-                        }
+static void buffer_link_head(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_group **head=(buffer_node->frequent!=0)?&buffer->frequent_head:&buffer->buffer_head;
+    struct buffer_group **tail=(buffer_node->frequent!=0)?&buffer->frequent_tail:&buffer->buffer_tail;
 
-                        ssd->dram->buffer->buffer_sector_count=ssd->dram->buffer->buffer_sector_count-sub_req->size;
-                        pt = ssd->dram->buffer->buffer_tail;	
-                        avlTreeDel(ssd->dram->buffer, (TREE_NODE *) pt);
+    buffer_node->LRU_link_pre=NULL;
+    buffer_node->LRU_link_next=*head;
+    if (*head!=NULL)
+        (*head)->LRU_link_pre=buffer_node;
+    else
+        *tail=buffer_node;
+    *head=buffer_node;
+}
 
-                        /************************************************************************/
-                        /* 改:  挂在了子请求，buffer的节点不应立即删除，						*/
-                        /*			需等到写回了之后才能删除									*/
-                        /************************************************************************/
-                        if(ssd->dram->buffer->buffer_head->LRU_link_next == NULL)
-                        {
-                            ssd->dram->buffer->buffer_head = NULL;
-                            ssd->dram->buffer->buffer_tail = NULL;
-                        }else{
-                            ssd->dram->buffer->buffer_tail=ssd->dram->buffer->buffer_tail->LRU_link_pre;
-                            ssd->dram->buffer->buffer_tail->LRU_link_next=NULL;
-                        }
-                        pt->LRU_link_next=NULL;
-                        pt->LRU_link_pre=NULL;
-                        AVL_TREENODE_FREE(ssd->dram->buffer, (TREE_NODE *) pt);
-                        pt = NULL;	
-                    }
+static void buffer_link_tail(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_group **head=(buffer_node->frequent!=0)?&buffer->frequent_head:&buffer->buffer_head;
+    struct buffer_group **tail=(buffer_node->frequent!=0)?&buffer->frequent_tail:&buffer->buffer_tail;
 
-                    /*第二步:将新的lsn加到所述的buffer节点中*/	
-                    add_flag=0x00000001<<(lsn%ssd->parameter->subpage_page);
-
-                    if(ssd->dram->buffer->buffer_head!=buffer_node)                      /*如果该buffer节点不在buffer的队首，需要将这个节点提到队首*/
-                    {				
-                        if(ssd->dram->buffer->buffer_tail==buffer_node)
-                        {					
-                            buffer_node->LRU_link_pre->LRU_link_next=NULL;					
-                            ssd->dram->buffer->buffer_tail=buffer_node->LRU_link_pre;
-                        }			
-                        else						
-                        {			
-                            buffer_node->LRU_link_pre->LRU_link_next=buffer_node->LRU_link_next;						
-                            buffer_node->LRU_link_next->LRU_link_pre=buffer_node->LRU_link_pre;								
-                        }								
-                        buffer_node->LRU_link_next=ssd->dram->buffer->buffer_head;			
-                        ssd->dram->buffer->buffer_head->LRU_link_pre=buffer_node;
-                        buffer_node->LRU_link_pre=NULL;	
-                        ssd->dram->buffer->buffer_head=buffer_node;							
-                    }					
-                    buffer_node->stored=buffer_node->stored|add_flag;		
-                    buffer_node->dirty_clean=buffer_node->dirty_clean|add_flag;	
-                    ssd->dram->buffer->buffer_sector_count++;
-                }			
+    buffer_node->LRU_link_next=NULL;
+    buffer_node->LRU_link_pre=*tail;
+    if (*tail!=NULL)
+        (*tail)->LRU_link_next=buffer_node;
+    else
+        *head=buffer_node;
+    *tail=buffer_node;
+}
 
-            }
-        }
+static void buffer_move_to_head(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    if (buffer_node->LRU_link_pre==NULL)
+    {
+        return;
     }
+    buffer_unlink(buffer,buffer_node);
+    buffer_link_head(buffer,buffer_node);
+}
 
-    return ssd;
+static unsigned int buffer_node_count(struct buffer_info *buffer)
+{
+    return (buffer->hash!=NULL)?buffer->hash->count:buffer->count;
 }
 
-/**************************************************************************************
- *函数的功能是寻找活跃快，应为每个plane中都只有一个活跃块，只有这个活跃块中才能进行操作
- *The function of the function is to find the active fast, there should be only one active block in each plane, and only this active block can be operated.
- ***************************************************************************************/
-Status  find_active_block(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane)
+struct buffer_group *buffer_find(struct buffer_info *buffer,int64_t lpn)
 {
-    unsigned int active_block;
-    unsigned int free_page_num=0;
-    unsigned int count=0;
+    struct buffer_hash *hash=buffer->hash;
+    struct buffer_group key;
+    unsigned int i,mask;
 
-    active_block=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block;
-    free_page_num=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].free_page_num;
-    //last_write_page=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].free_page_num;
-    while((free_page_num==0)&&(count<ssd->parameter->block_plane))
+    if (hash==NULL)
     {
-        active_block=(active_block+1)%ssd->parameter->block_plane;	
-        free_page_num=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].free_page_num;
-        count++;
+        key.group=lpn;
+        return (struct buffer_group*)avlTreeFind(buffer, (TREE_NODE *)&key);
     }
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block=active_block;
-    if(count<ssd->parameter->block_plane)
+    mask=(1U<<hash->bits)-1;
+    i=buffer_hash_home(hash,lpn);
+    while (hash->slot[i]!=NULL)
     {
+        if (hash->slot[i]->group==lpn)
+        {
+            return hash->slot[i];
+        }
+        i=(i+1)&mask;
+    }
+    return NULL;
+}
+
+/*生成一个buffer node，加到LRU队首和索引中*/
+struct buffer_group *buffer_add(struct buffer_info *buffer,int64_t lpn)
+{
+    struct buffer_hash *hash=buffer->hash;
+    struct buffer_group *new_node=NULL;
+
+    if (hash==NULL)
+    {
+        new_node=(struct buffer_group *)malloc(sizeof(struct buffer_group));
+        alloc_assert(new_node,"buffer_group_node");
+    }
+    else
+    {
+        if (hash->free_node==NULL)
+        {
+            buffer_hash_grow_pool(hash);
+        }
+        new_node=hash->free_node;
+        hash->free_node=new_node->LRU_link_next;
+    }
+    memset(new_node,0, sizeof(struct buffer_group));
+    new_node->group=lpn;
+    buffer_link_head(buffer,new_node);
+
+    if (hash==NULL)
+    {
+        avlTreeAdd(buffer, (TREE_NODE *) new_node);
+    }
+    else
+    {
+        if (2*(hash->count+1)>(1U<<hash->bits))
+        {
+            buffer_hash_resize(hash);
+        }
+        buffer_hash_put(hash,new_node);
+        hash->count++;
+    }
+    if (buffer_policies[buffer->policy].insert!=NULL)
+    {
+        buffer_policies[buffer->policy].insert(buffer,new_node);
+    }
+    return new_node;
+}
+
+/*把buffer node从LRU队列和索引中摘除并释放*/
+void buffer_remove(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_hash *hash=buffer->hash;
+
+    if (buffer_policies[buffer->policy].remove!=NULL)
+    {
+        buffer_policies[buffer->policy].remove(buffer,buffer_node);
+    }
+    buffer_unlink(buffer,buffer_node);
+
+    if (hash==NULL)
+    {
+        avlTreeDel(buffer, (TREE_NODE *)buffer_node);
+        AVL_TREENODE_FREE(buffer, (TREE_NODE *)buffer_node);
+    }
+    else
+    {
+        buffer_hash_remove(hash,buffer_node);
+        buffer_node->LRU_link_next=hash->free_node;
+        hash->free_node=buffer_node;
+    }
+}
+
+/*buffer node被访问*/
+void buffer_touch(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    buffer_policies[buffer->policy].touch(buffer,buffer_node);
+}
+
+/*选择一个要写回的buffer node，exclude是正在写入的节点，不能被替换*/
+struct buffer_group *buffer_victim(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    return buffer_policies[buffer->policy].victim(buffer,exclude);
+}
+
+/*节点被替换出buffer*/
+static void buffer_evicted(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    if (buffer_policies[buffer->policy].evict!=NULL)
+    {
+        buffer_policies[buffer->policy].evict(buffer,buffer_node);
+    }
+}
+
+/*****************************************************************************************
+ *LRU：命中的节点移到队首，淘汰队尾的节点
+ *****************************************************************************************/
+static struct buffer_group *lru_victim(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *victim=buffer->buffer_tail;
+
+    if ((victim==exclude)&&(victim->LRU_link_pre!=NULL))
+    {
+        victim=victim->LRU_link_pre;
+    }
+    return victim;
+}
+
+/*****************************************************************************************
+ *CLOCK：命中只置访问位，淘汰时从队尾开始，访问位为1的节点清0后移到队首，相当于时钟指针扫过一次
+ *****************************************************************************************/
+static void clock_touch(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    buffer_node->referenced=1;
+}
+
+static struct buffer_group *clock_victim(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *victim=buffer->buffer_tail;
+
+    while ((victim!=buffer->buffer_head)&&((victim->referenced!=0)||(victim==exclude)))
+    {
+        victim->referenced=0;
+        buffer_move_to_head(buffer,victim);
+        victim=buffer->buffer_tail;
+    }
+    return victim;
+}
+
+/*****************************************************************************************
+ *CFLRU：LRU端1/CFLRU_WINDOW的节点是clean first窗口，窗口中有干净的节点(没有脏的子页)时
+ *先替换它，不需要写flash；没有时替换LRU队尾的节点。CFLRU时读出的数据也放入写buffer
+ *****************************************************************************************/
+static struct buffer_group *cflru_victim(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *victim=buffer->buffer_tail;
+    unsigned int i,window;
+
+    window=buffer_node_count(buffer)/CFLRU_WINDOW;
+    for (i=0;(victim!=NULL)&&(i<=window);i++)
+    {
+        if ((victim!=exclude)&&(victim->dirty_clean==0))
+        {
+            return victim;
+        }
+        victim=victim->LRU_link_pre;
+    }
+    return lru_victim(buffer,exclude);
+}
+
+/*****************************************************************************************
+ *BPLRU和FAB：buffer->blocks中每个逻辑块一个节点，记录这个块在buffer中的页数，按块的最近访问
+ *时间排成LRU队列。BPLRU替换最久没有访问的块，块中的页都在buffer中时(顺序写满了一个块)移到
+ *队尾，尽快写回；FAB替换页数最多的块，页数相同时替换最久没有访问的
+ *****************************************************************************************/
+static void block_insert(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_group *block=buffer_find(buffer->blocks,buffer_node->group/buffer->block_pages);
+
+    if (block==NULL)
+    {
+        block=buffer_add(buffer->blocks,buffer_node->group/buffer->block_pages);
+    }
+    else
+    {
+        buffer_move_to_head(buffer->blocks,block);
+    }
+    block->page_count++;
+    if ((buffer->policy==BUFFER_BPLRU)&&(block->page_count==buffer->block_pages))
+    {
+        buffer_unlink(buffer->blocks,block);
+        buffer_link_tail(buffer->blocks,block);
+    }
+}
+
+static void block_touch(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    buffer_move_to_head(buffer,buffer_node);
+    buffer_move_to_head(buffer->blocks,buffer_find(buffer->blocks,buffer_node->group/buffer->block_pages));
+}
+
+static void block_remove(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_group *block=buffer_find(buffer->blocks,buffer_node->group/buffer->block_pages);
+
+    block->page_count--;
+    if (block->page_count==0)
+    {
+        buffer_remove(buffer->blocks,block);
+    }
+}
+
+/*选择要写回的逻辑块，只有exclude一个页的块不能被选择*/
+static struct buffer_group *block_victim_block(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *block,*victim=NULL;
+
+    for (block=buffer->blocks->buffer_tail;block!=NULL;block=block->LRU_link_pre)
+    {
+        if ((exclude!=NULL)&&(block->page_count==1)&&(block->group==exclude->group/buffer->block_pages))
+        {
+            continue;
+        }
+        if (buffer->policy==BUFFER_BPLRU)
+        {
+            return block;
+        }
+        if ((victim==NULL)||(block->page_count>victim->page_count))
+        {
+            victim=block;
+        }
+    }
+    return victim;
+}
+
+static struct buffer_group *block_victim(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *block,*victim;
+    int64_t lpn;
+
+    block=block_victim_block(buffer,exclude);
+    if (block==NULL)
+    {
+        return lru_victim(buffer,exclude);
+    }
+    for (lpn=block->group*buffer->block_pages;lpn<(block->group+1)*buffer->block_pages;lpn++)
+    {
+        victim=buffer_find(buffer,lpn);
+        if ((victim!=NULL)&&(victim!=exclude))
+        {
+            return victim;
+        }
+    }
+    return lru_victim(buffer,exclude);
+}
+
+/*****************************************************************************************
+ *ARC：第一次写入的节点在T1(buffer_head队列)，再次访问的节点移到T2(frequent队列)。被替换的
+ *lpn记在ghost[0](来自T1)或ghost[1](来自T2)中；在ghost中的lpn再次写入时直接进入T2，并按
+ *两个ghost的大小之比调整T1的目标大小arc_target。T1超过arc_target时从T1替换，否则从T2替换
+ *****************************************************************************************/
+static void arc_make_frequent(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    buffer_unlink(buffer,buffer_node);
+    buffer_node->frequent=1;
+    buffer->frequent_count++;
+    buffer_link_head(buffer,buffer_node);
+}
+
+static void arc_insert(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    struct buffer_group *ghost;
+    unsigned int recent=buffer_node_count(buffer->ghost[0]),frequent=buffer_node_count(buffer->ghost[1]),delta;
+
+    if ((ghost=buffer_find(buffer->ghost[0],buffer_node->group))!=NULL)
+    {
+        delta=(frequent>recent)?frequent/recent:1;
+        buffer->arc_target=(buffer->arc_target+delta<buffer->arc_capacity)?buffer->arc_target+delta:buffer->arc_capacity;
+        buffer_remove(buffer->ghost[0],ghost);
+        arc_make_frequent(buffer,buffer_node);
+    }
+    else if ((ghost=buffer_find(buffer->ghost[1],buffer_node->group))!=NULL)
+    {
+        delta=(recent>frequent)?recent/frequent:1;
+        buffer->arc_target=(buffer->arc_target>delta)?buffer->arc_target-delta:0;
+        buffer_remove(buffer->ghost[1],ghost);
+        arc_make_frequent(buffer,buffer_node);
+    }
+}
+
+static void arc_touch(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    if (buffer_node->frequent==0)
+    {
+        arc_make_frequent(buffer,buffer_node);
+    }
+    else
+    {
+        buffer_move_to_head(buffer,buffer_node);
+    }
+}
+
+static struct buffer_group *arc_victim(struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *victim;
+    unsigned int recent=buffer_node_count(buffer)-buffer->frequent_count;
+
+    if ((recent>0)&&((recent>buffer->arc_target)||(buffer->frequent_count==0)))
+    {
+        victim=buffer->buffer_tail;
+    }
+    else
+    {
+        victim=buffer->frequent_tail;
+    }
+    if (victim==exclude)
+    {
+        victim=victim->LRU_link_pre;
+    }
+    if (victim==NULL)                                                        /*这个队列里只有exclude，从另一个队列替换*/
+    {
+        victim=(exclude->frequent!=0)?buffer->buffer_tail:buffer->frequent_tail;
+    }
+    return victim;
+}
+
+/*被替换的lpn记入ghost，ghost[0]和T1合计不超过arc_capacity，全部合计不超过2*arc_capacity*/
+static void arc_evict(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    unsigned int recent=buffer_node_count(buffer)-buffer->frequent_count;
+
+    if (buffer_find(buffer->ghost[buffer_node->frequent],buffer_node->group)==NULL)
+    {
+        buffer_add(buffer->ghost[buffer_node->frequent],buffer_node->group);
+    }
+    while ((buffer->ghost[0]->buffer_tail!=NULL)&&(recent+buffer_node_count(buffer->ghost[0])>buffer->arc_capacity))
+    {
+        buffer_remove(buffer->ghost[0],buffer->ghost[0]->buffer_tail);
+    }
+    while ((buffer->ghost[1]->buffer_tail!=NULL)&&(buffer_node_count(buffer)+buffer_node_count(buffer->ghost[0])+buffer_node_count(buffer->ghost[1])>2*buffer->arc_capacity))
+    {
+        buffer_remove(buffer->ghost[1],buffer->ghost[1]->buffer_tail);
+    }
+}
+
+static void arc_remove(struct buffer_info *buffer,struct buffer_group *buffer_node)
+{
+    if (buffer_node->frequent!=0)
+    {
+        buffer->frequent_count--;
+    }
+}
+
+const struct buffer_policy buffer_policies[]={
+    {"LRU",  0,NULL,        buffer_move_to_head,lru_victim,  NULL,     NULL},
+    {"CLOCK",0,NULL,        clock_touch,        clock_victim,NULL,     NULL},
+    {"CFLRU",0,NULL,        buffer_move_to_head,cflru_victim,NULL,     NULL},
+    {"BPLRU",1,block_insert,block_touch,        block_victim,NULL,     block_remove},
+    {"FAB",  1,block_insert,block_touch,        block_victim,NULL,     block_remove},
+    {"ARC",  0,arc_insert,  arc_touch,          arc_victim,  arc_evict,arc_remove}
+};
+
+/*****************************************************************************************
+ *把buffer node写回flash：生成一个写子请求，从buffer中删除这个节点，返回写回的sector数。
+ *req为空时(process中处理一对多映射的读)子请求挂在读子请求sub后面；干净的节点直接删除
+ *****************************************************************************************/
+static unsigned int buffer_write_back(struct ssd_info *ssd,struct buffer_group *pt,struct sub_request *sub,struct request *req)
+{
+    struct sub_request *sub_req=NULL;
+    unsigned int sectors;
+    struct buffer_info *buffer=buffer_of(ssd,pt->group);
+
+    buffer_evicted(buffer,pt);
+    buffer_gc_release(ssd,pt);
+    if (pt->dirty_clean==0)
+    {
+        sectors=size(pt->stored);
+        buffer->buffer_sector_count-=sectors;
+        buffer->clean_evict_count++;
+        buffer_remove(buffer,pt);
+        return sectors;
+    }
+    sub_req=creat_sub_request(ssd,pt->group,size(pt->stored),pt->stored,req,WRITE);
+    sub_req->stream=pt->stream;
+    if(req==NULL)
+    {
+        sub_req->next_subs=sub->next_subs;
+        sub->next_subs=sub_req;
+        sub_req->req=sub->req;
+        if (sub_req->req!=NULL)
+        {
+            sub_req->req->outstanding++;
+        }
+    }
+    buffer->buffer_sector_count=buffer->buffer_sector_count-sub_req->size;
+    buffer->dirty_sector_count-=size(pt->dirty_clean);
+    buffer->write_back_count++;
+    buffer_remove(buffer,pt);
+    return sub_req->size;
+}
+
+/*写回时lpn的目标位置，只有静态分配能确定到plane，channel定的动态分配只能确定channel，其余为-1*/
+static void buffer_target(struct ssd_info *ssd,int64_t lpn,struct local *location)
+{
+    memset(location,0xff,sizeof(struct local));
+    if (ssd->parameter->allocation_scheme!=0)
+    {
+        if (ssd->parameter->address_mapping==ZNS_MAPPING)
+        {
+            zns_location(ssd,lpn,location);
+        }
+        else if (ssd->parameter->address_mapping!=PAGE_MAPPING)
+        {
+            blockmap_plane(ssd,lpn/ssd->parameter->page_block,location);
+        }
+        else
+        {
+            static_location(ssd,lpn,location);
+        }
+    }
+    else if (ssd->parameter->dynamic_allocation==1)
+    {
+        location->channel=lpn%ssd->parameter->channel_number;
+    }
+}
+
+/*****************************************************************************************
+ *lpn所在的写buffer分区。按channel分区时用写回的目标channel，目标channel不确定(全动态分配)时
+ *按lpn轮流分到各channel；按哈希分区时用和哈希索引不相关的乘法哈希，避免分区内哈希槽聚集
+ *****************************************************************************************/
+struct buffer_info *buffer_of(struct ssd_info *ssd,int64_t lpn)
+{
+    struct local location;
+
+    if (ssd->dram->partition_num<=1)
+    {
+        return ssd->dram->buffer;
+    }
+    if (ssd->parameter->buffer_partition==BUFFER_PARTITION_CHANNEL)
+    {
+        buffer_target(ssd,lpn,&location);
+        if (location.channel>=ssd->dram->partition_num)
+        {
+            location.channel=lpn%ssd->dram->partition_num;
+        }
+        return ssd->dram->partition[location.channel];
+    }
+    return ssd->dram->partition[(((uint64_t)lpn*0xC2B2AE3D27D4EB4FULL)>>32)%ssd->dram->partition_num];
+}
+
+/*把各分区的命中、写回等计数加起来放到total中，用于输出统计结果*/
+void buffer_summary(struct ssd_info *ssd,struct buffer_info *total)
+{
+    unsigned int i;
+    struct buffer_info *part;
+
+    memset(total,0,sizeof(struct buffer_info));
+    total->policy=ssd->dram->buffer->policy;
+    for (i=0;i<ssd->dram->partition_num;i++)
+    {
+        part=ssd->dram->partition[i];
+        total->read_hit+=part->read_hit;
+        total->read_miss_hit+=part->read_miss_hit;
+        total->read_node_miss+=part->read_node_miss;
+        total->write_hit+=part->write_hit;
+        total->write_miss_hit+=part->write_miss_hit;
+        total->max_buffer_sector+=part->max_buffer_sector;
+        total->buffer_sector_count+=part->buffer_sector_count;
+        total->dirty_sector_count+=part->dirty_sector_count;
+        total->write_back_count+=part->write_back_count;
+        total->evict_batch_count+=part->evict_batch_count;
+        total->clean_evict_count+=part->clean_evict_count;
+        total->padding_count+=part->padding_count;
+        total->flush_count+=part->flush_count;
+        total->sync_count+=part->sync_count;
+    }
+}
+
+/*****************************************************************************************
+ *gc buffer aware：buffer中脏的节点计入它在flash上的旧数据页所在块的buffered_pages_num，gc选块时
+ *这些页和失效页一样不需要迁移。节点变干净或离开buffer时减去；旧数据页被更新后节点再次被写时重新计入
+ *****************************************************************************************/
+void buffer_gc_account(struct ssd_info *ssd,struct buffer_group *node)
+{
+    struct entry *entry=NULL;
+    struct local *location=NULL;
+
+    if ((ssd->parameter->gc_buffer_aware==0)||(node->dirty_clean==0))
+    {
+        return;
+    }
+    entry=find_entry(ssd,node->group);
+    if ((entry!=NULL)&&(entry->state!=0)&&(node->gc_ppn==entry->pn+1))
+    {
+        return;
+    }
+    buffer_gc_release(ssd,node);
+    if ((entry==NULL)||(entry->state==0))
+    {
+        return;
+    }
+    location=find_location(ssd,entry->pn);
+    node->gc_plane=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane];
+    node->gc_blk=&node->gc_plane->blk_head[location->block];
+    node->gc_blk->buffered_pages_num++;
+    free(location);
+    node->gc_ppn=entry->pn+1;
+}
+
+void buffer_gc_release(struct ssd_info *ssd,struct buffer_group *node)
+{
+    if (node->gc_ppn==0)
+    {
+        return;
+    }
+    node->gc_blk->buffered_pages_num--;
+    node->gc_plane=NULL;
+    node->gc_blk=NULL;
+    node->gc_ppn=0;
+}
+
+/*节点的旧数据页所在的plane再写一个块就要触发gc(空闲页不到gc hard threshold加一个块的页数)时先不替换，等gc时这一页不用迁移*/
+static int buffer_gc_hold(struct ssd_info *ssd,struct buffer_group *node)
+{
+    struct parameter_value *p=ssd->parameter;
+
+    if (node->gc_ppn==0)
+    {
+        return 0;
+    }
+    return node->gc_plane->free_page<p->page_block*p->block_plane*p->gc_hard_threshold+p->page_block;
+}
+
+/*gc buffer aware时的替换对象：从替换策略选出的节点开始，往MRU端最多再看GC_HOLD_SCAN个节点，找第一个不需要留下的节点，都需要留下时还是替换原来的节点*/
+static struct buffer_group *buffer_gc_victim(struct ssd_info *ssd,struct buffer_info *buffer,struct buffer_group *exclude)
+{
+    struct buffer_group *victim=buffer_victim(buffer,exclude),*pt=NULL;
+    unsigned int scanned;
+
+    if ((ssd->parameter->gc_buffer_aware==0)||(victim==NULL)||(buffer_gc_hold(ssd,victim)==0))
+    {
+        return victim;
+    }
+    for (pt=victim->LRU_link_pre,scanned=0;(pt!=NULL)&&(scanned<GC_HOLD_SCAN);pt=pt->LRU_link_pre,scanned++)
+    {
+        if ((pt!=exclude)&&(buffer_gc_hold(ssd,pt)==0))
+        {
+            ssd->gc_hold_count++;
+            return pt;
+        }
+    }
+    return victim;
+}
+
+/*一次批量写回的节点数：channel都空闲时为evict batch，都忙时为evict batch/(channel数+1)，至少为1*/
+static unsigned int buffer_batch_size(struct ssd_info *ssd)
+{
+    unsigned int i,idle=0,batch;
+
+    for (i=0;i<ssd->parameter->channel_number;i++)
+    {
+        if((ssd->channel_head[i].current_state==CHANNEL_IDLE)||(ssd->channel_head[i].next_state==CHANNEL_IDLE&&ssd->channel_head[i].next_state_predict_time<=ssd->current_time))
+        {
+            idle++;
+        }
+    }
+    batch=ssd->parameter->evict_batch*(idle+1)/(ssd->parameter->channel_number+1);
+    return (batch<1)?1:batch;
+}
+
+/*****************************************************************************************
+ *BPLRU/FAB整块写回：按lpn顺序写回被选中的逻辑块在buffer中的所有页，返回写回的sector数。
+ *BPLRU在块映射和FAST映射时把块中不在buffer里的有效页读出来一起写回(page padding)，
+ *FTL就可以用整块替换代替合并操作
+ *****************************************************************************************/
+static unsigned int buffer_evict_block(struct ssd_info *ssd,struct buffer_info *buffer,struct buffer_group *exclude,struct sub_request *sub,struct request *req)
+{
+    struct buffer_group *block=NULL,*pt=NULL;
+    struct entry *entry=NULL;
+    struct sub_request *read=NULL,*write=NULL;
+    subpage_mask state;
+    int64_t lpn,first;
+    unsigned int freed=0,found=0,pages;
+    int padding;
+
+    block=block_victim_block(buffer,exclude);
+    if (block==NULL)
+    {
+        return buffer_write_back(ssd,buffer_victim(buffer,exclude),sub,req);
+    }
+    first=block->group*buffer->block_pages;
+    pages=block->page_count;                                                          /*块的最后一页写回后block节点就被删除了*/
+    padding=(buffer->policy==BUFFER_BPLRU)&&(req!=NULL)&&((ssd->parameter->address_mapping==BLOCK_MAPPING)||(ssd->parameter->address_mapping==FAST_MAPPING));
+    for (lpn=first;(lpn<first+buffer->block_pages)&&((found<pages)||(padding!=0));lpn++)
+    {
+        pt=buffer_find(buffer,lpn);
+        if (pt!=NULL)
+        {
+            found++;
+            if (pt!=exclude)
+            {
+                freed+=buffer_write_back(ssd,pt,sub,req);
+            }
+            continue;
+        }
+        entry=(padding!=0)?find_entry(ssd,lpn):NULL;
+        state=(entry!=NULL)?(entry->state&SUBPAGE_BITS(ssd->parameter->subpage_page)):0;
+        if (state!=0)
+        {
+            read=creat_sub_request(ssd,lpn,size(state),state,NULL,READ);              /*和更新读一样挂在写子请求的update上，读出来以后才能写，随写子请求释放*/
+            write=creat_sub_request(ssd,lpn,size(state),state,req,WRITE);
+            if ((write!=NULL)&&(write->update==NULL))
+            {
+                write->update=read;
+            }
+            buffer->padding_count++;
+        }
+    }
+    return freed;
+}
+
+/*****************************************************************************************
+ *为buffer腾出need个sector的空间，exclude是正在写入的节点，不能被替换。
+ *evict batch大于1时批量写回：先按替换策略选出第一个节点，再从它往队首方向的窗口中挑选节点
+ *凑成一批，优先选择和第一个节点在同一个die上、plane还没有被选中的节点(组成two plane写)，
+ *其次是同一个chip上其它die的节点(组成interleave写)，最后是其余节点。选出的节点按channel，
+ *chip，die，plane排序后依次写回，使一组写子请求在channel队列中相邻
+ *****************************************************************************************/
+void buffer_evict(struct ssd_info *ssd,struct buffer_info *buffer,unsigned int need,struct buffer_group *exclude,struct sub_request *sub,struct request *req)
+{
+    unsigned int batch,window=0,chosen=0,i,j,pri,freed=0;
+    unsigned long long planes=0;
+    struct buffer_group *pt,**cand,**pick;
+    struct local *loc,first,tmp_loc;
+
+    if (buffer_policies[buffer->policy].block_level!=0)                 /*BPLRU/FAB本身就是整块批量写回*/
+    {
+        while(need>0)
+        {
+            i=buffer_evict_block(ssd,buffer,exclude,sub,req);
+            need=(i>=need)?0:need-i;
+        }
+        return;
+    }
+    batch=(ssd->parameter->evict_batch>1)?buffer_batch_size(ssd):1;
+    if (batch<=1)
+    {
+        while(need>0)
+        {
+            pt=buffer_gc_victim(ssd,buffer,exclude);
+            i=buffer_write_back(ssd,pt,sub,req);
+            need=(i>=need)?0:need-i;
+        }
+        return;
+    }
+
+    cand=(struct buffer_group **)malloc(sizeof(struct buffer_group *)*(4*batch+1));
+    pick=(struct buffer_group **)malloc(sizeof(struct buffer_group *)*batch);
+    loc=(struct local *)malloc(sizeof(struct local)*(4*batch+1));
+    alloc_assert(cand,"buffer_evict cand");
+    alloc_assert(pick,"buffer_evict pick");
+    alloc_assert(loc,"buffer_evict loc");
+
+    pt=buffer_gc_victim(ssd,buffer,exclude);
+    pick[chosen++]=pt;
+    buffer_target(ssd,pt->group,&first);
+    if (first.plane<64)
+    {
+        planes|=1ULL<<first.plane;
+    }
+    for (pt=pt->LRU_link_pre;(pt!=NULL)&&(window<4*batch);pt=pt->LRU_link_pre)
+    {
+        if ((pt==exclude)||(pt->referenced!=0)||((ssd->parameter->gc_buffer_aware!=0)&&(buffer_gc_hold(ssd,pt)!=0)))    /*CLOCK时跳过最近被访问过的节点，gc buffer aware时跳过要留下的节点*/
+        {
+            continue;
+        }
+        buffer_target(ssd,pt->group,&loc[window]);
+        cand[window++]=pt;
+    }
+
+    for (pri=0;(pri<3)&&(chosen<batch);pri++)
+    {
+        for (i=0;(i<window)&&(chosen<batch);i++)
+        {
+            if (cand[i]==NULL)
+            {
+                continue;
+            }
+            if (pri==0)                                                             /*同一个die上还没有被选中的plane；只知道channel时是同一个channel*/
+            {
+                if (first.chip!=(unsigned int)-1)
+                {
+                    if ((loc[i].channel!=first.channel)||(loc[i].chip!=first.chip)||(loc[i].die!=first.die)||(loc[i].plane>=64)||((planes&(1ULL<<loc[i].plane))!=0))
+                    {
+                        continue;
+                    }
+                    planes|=1ULL<<loc[i].plane;
+                }
+                else if ((first.channel==(unsigned int)-1)||(loc[i].channel!=first.channel))
+                {
+                    continue;
+                }
+            }
+            else if (pri==1)
+            {
+                if ((first.chip==(unsigned int)-1)||(loc[i].channel!=first.channel)||(loc[i].chip!=first.chip))
+                {
+                    continue;
+                }
+            }
+            pick[chosen]=cand[i];
+            chosen++;
+            cand[i]=NULL;
+        }
+    }
+
+    /*按目标位置排序(插入排序，位置相同的保持替换顺序)*/
+    for (i=0;i<chosen;i++)
+    {
+        buffer_target(ssd,pick[i]->group,&loc[i]);
+    }
+    for (i=1;i<chosen;i++)
+    {
+        pt=pick[i];
+        tmp_loc=loc[i];
+        for (j=i;j>0;j--)
+        {
+            if ((loc[j-1].channel<tmp_loc.channel)||((loc[j-1].channel==tmp_loc.channel)&&((loc[j-1].chip<tmp_loc.chip)||((loc[j-1].chip==tmp_loc.chip)&&((loc[j-1].die<tmp_loc.die)||((loc[j-1].die==tmp_loc.die)&&(loc[j-1].plane<=tmp_loc.plane)))))))
+            {
+                break;
+            }
+            pick[j]=pick[j-1];
+            loc[j]=loc[j-1];
+        }
+        pick[j]=pt;
+        loc[j]=tmp_loc;
+    }
+
+    for (i=0;i<chosen;i++)
+    {
+        freed+=buffer_write_back(ssd,pick[i],sub,req);
+    }
+    while (freed<need)
+    {
+        freed+=buffer_write_back(ssd,buffer_gc_victim(ssd,buffer,exclude),sub,req);
+    }
+    buffer->evict_batch_count++;
+
+    free(cand);
+    free(pick);
+    free(loc);
+}
+
+/*把脏节点中的数据写入flash，写子请求挂在req上，节点留在buffer中变为干净的节点，返回写入的sector数*/
+static unsigned int buffer_destage(struct ssd_info *ssd,struct buffer_info *buffer,struct buffer_group *pt,struct request *req)
+{
+    struct sub_request *sub=NULL;
+
+    sub=creat_sub_request(ssd,pt->group,size(pt->stored),pt->stored,req,WRITE);
+    sub->stream=pt->stream;
+    buffer->dirty_sector_count-=size(pt->dirty_clean);
+    pt->dirty_clean=0;
+    buffer_gc_release(ssd,pt);
+    return sub->size;
+}
+
+/*****************************************************************************************
+ *后台写回：background flush为1时，buffer中的脏数据超过flush high watermark就开始写回，低于flush low
+ *watermark时停止，写buffer分区时每个分区各自按自己的水位判断。每次process之后，给空闲而且没有
+ *等待的写子请求的channel(目标chip已知时chip也要空闲)各写回一个节点。从LRU队尾开始找脏节点，
+ *写回以后节点留在buffer中变为干净的节点，需要空间时直接替换，不用再写flash。写子请求挂在一个
+ *内部的写请求上，由trace_output释放
+ *****************************************************************************************/
+static void buffer_flush_partition(struct ssd_info *ssd,struct buffer_info *buffer,unsigned long long eligible,unsigned long long *used,unsigned int *idle,struct request **flush)
+{
+    struct buffer_group *pt=NULL;
+    struct local location;
+    unsigned int i,list,scanned,contiguous;
+    struct chip_info *p_chip=NULL;
+
+    if (buffer->max_buffer_sector==0)
+    {
+        return;
+    }
+    if (buffer->flushing==0)
+    {
+        if (buffer->dirty_sector_count<ssd->parameter->flush_high*buffer->max_buffer_sector)
+        {
+            return;
+        }
+        buffer->flushing=1;
+    }
+
+    for (list=0;(list<2)&&(*idle>0);list++)
+    {
+        pt=(buffer->flush_cursor[list]!=NULL)?buffer->flush_cursor[list]:((list==0)?buffer->buffer_tail:buffer->frequent_tail);
+        contiguous=1;
+        for (scanned=0;(pt!=NULL)&&(*idle>0)&&(scanned<4*ssd->parameter->channel_number);pt=pt->LRU_link_pre)
+        {
+            if (buffer->dirty_sector_count<=ssd->parameter->flush_low*buffer->max_buffer_sector)
+            {
+                buffer->flushing=0;
+                return;
+            }
+            if (pt->dirty_clean==0)
+            {
+                if (contiguous!=0)
+                {
+                    buffer->flush_cursor[list]=pt->LRU_link_pre;                   /*队尾到这里都是干净的节点*/
+                }
+                continue;
+            }
+            contiguous=0;
+            scanned++;
+
+            buffer_target(ssd,pt->group,&location);
+            if (location.channel==(unsigned int)-1)                                 /*动态分配时写到哪个channel由分配决定，只控制写回的个数*/
+            {
+                for (i=0;(eligible&~*used&(1ULL<<i))==0;i++);
+            }
+            else
+            {
+                i=location.channel;
+                if ((i>=64)||((eligible&~*used&(1ULL<<i))==0))
+                {
+                    continue;
+                }
+                if (location.chip!=(unsigned int)-1)
+                {
+                    p_chip=&ssd->channel_head[i].chip_head[location.chip];
+                    if ((p_chip->current_state!=CHIP_IDLE)&&!((p_chip->next_state==CHIP_IDLE)&&(p_chip->next_state_predict_time<=ssd->current_time)))
+                    {
+                        continue;
+                    }
+                }
+            }
+            *used|=1ULL<<i;
+            (*idle)--;
+
+            if (*flush==NULL)
+            {
+                *flush=(struct request *)malloc(sizeof(struct request));
+                alloc_assert(*flush,"flush request");
+                memset(*flush,0,sizeof(struct request));
+                (*flush)->time=ssd->current_time;
+                (*flush)->begin_time=ssd->current_time;
+                (*flush)->lsn=pt->group*ssd->parameter->subpage_page;
+                (*flush)->operation=WRITE;
+                (*flush)->flush=1;
+            }
+            (*flush)->size+=buffer_destage(ssd,buffer,pt,*flush);
+            buffer->flush_count++;
+        }
+        if ((pt==NULL)&&(contiguous!=0))
+        {
+            buffer->flush_cursor[list]=NULL;                                        /*整个队列都是干净的，下次从队尾开始*/
+        }
+    }
+}
+
+Status buffer_flush(struct ssd_info *ssd)
+{
+    struct request *flush=NULL;
+    unsigned int i,idle=0,first;
+    unsigned long long used=0,eligible=0;
+
+    if ((ssd->parameter->background_flush==0)||(ssd->subs_w_head!=NULL))
+    {
+        return SUCCESS;
+    }
+
+    for (i=0;(i<ssd->parameter->channel_number)&&(i<64);i++)
+    {
+        if ((ssd->channel_head[i].subs_w_head!=NULL)||((ssd->channel_head[i].current_state!=CHANNEL_IDLE)&&!((ssd->channel_head[i].next_state==CHANNEL_IDLE)&&(ssd->channel_head[i].next_state_predict_time<=ssd->current_time))))
+        {
+            continue;
+        }
+        eligible|=1ULL<<i;
+        idle++;
+    }
+
+    first=ssd->dram->flush_partition;                                               /*分区轮流先挑空闲的channel*/
+    for (i=0;(i<ssd->dram->partition_num)&&(idle>0);i++)
+    {
+        buffer_flush_partition(ssd,ssd->dram->partition[(first+i)%ssd->dram->partition_num],eligible,&used,&idle,&flush);
+    }
+    ssd->dram->flush_partition=(first+1)%ssd->dram->partition_num;
+
+    if (flush!=NULL)
+    {
+        flush->next_node=ssd->request_queue;
+        if (ssd->request_queue!=NULL)
+        {
+            ssd->request_queue->prev_node=flush;
+        }
+        ssd->request_queue=flush;
+        if (ssd->request_tail==NULL)
+        {
+            ssd->request_tail=flush;
+        }
+        ssd->request_queue_length++;
+        request_complete(ssd,flush);
+    }
+    return SUCCESS;
+}
+
+/*****************************************************************************************
+ *flush命令：所有分区中的脏节点都写入flash，写子请求挂在flush命令上，全部写完命令才完成。
+ *节点留在buffer中变为干净的节点。返回写入的节点数
+ *****************************************************************************************/
+unsigned int buffer_sync(struct ssd_info *ssd,struct request *req)
+{
+    struct buffer_info *buffer=NULL;
+    struct buffer_group *pt=NULL;
+    unsigned int i,list,count=0;
+
+    for (i=0;i<ssd->dram->partition_num;i++)
+    {
+        buffer=ssd->dram->partition[i];
+        for (list=0;list<2;list++)
+        {
+            for (pt=(list==0)?buffer->buffer_head:buffer->frequent_head;pt!=NULL;pt=pt->LRU_link_next)
+            {
+                if (pt->dirty_clean!=0)
+                {
+                    req->size+=buffer_destage(ssd,buffer,pt,req);
+                    buffer->sync_count++;
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/*FUA写：lpn写入buffer以后，节点中的脏数据立即写入flash，写子请求挂在请求上*/
+void buffer_fua(struct ssd_info *ssd,int64_t lpn,struct request *req)
+{
+    struct buffer_info *buffer=buffer_of(ssd,lpn);
+    struct buffer_group *pt=buffer_find(buffer,lpn);
+
+    if ((pt!=NULL)&&(pt->dirty_clean!=0))
+    {
+        buffer_destage(ssd,buffer,pt,req);
+        buffer->sync_count++;
+    }
+}
+
+/*****************************************************************************************
+ *掉电时估算把写buffer中的脏数据全部写入flash需要的时间(hold-up时间)，不改变模拟的状态。
+ *每个channel先等正在进行的操作结束，再写入分到这个channel上的脏页：页依次在总线上传输，
+ *channel上的各个die轮流编程，时间取总线传输和编程中较慢的一个。已经替换出buffer、还在channel
+ *写队列中等待的写子请求也计入。写回的channel不确定时轮流分到各channel。pages返回要写的页数，energy返回这段时间的能耗(nJ)
+ *****************************************************************************************/
+int64_t buffer_holdup(struct ssd_info *ssd,unsigned long *pages,double *energy)
+{
+    struct buffer_info *buffer=NULL;
+    struct buffer_group *pt=NULL;
+    struct sub_request *sub=NULL;
+    struct local location;
+    struct parameter_value *p=ssd->parameter;
+    unsigned long *count=NULL;
+    unsigned long long *bytes=NULL,total_bytes=0;
+    unsigned int i,j,list,next=0,dies;
+    int64_t busy,wait,bus,prog,holdup=0,bus_total=0;
+
+    count=(unsigned long *)malloc(sizeof(unsigned long)*p->channel_number);
+    alloc_assert(count,"holdup count");
+    memset(count,0,sizeof(unsigned long)*p->channel_number);
+    bytes=(unsigned long long *)malloc(sizeof(unsigned long long)*p->channel_number);
+    alloc_assert(bytes,"holdup bytes");
+    memset(bytes,0,sizeof(unsigned long long)*p->channel_number);
+
+    *pages=0;
+    for (i=0;i<ssd->dram->partition_num;i++)
+    {
+        buffer=ssd->dram->partition[i];
+        for (list=0;list<2;list++)
+        {
+            for (pt=(list==0)?buffer->buffer_head:buffer->frequent_head;pt!=NULL;pt=pt->LRU_link_next)
+            {
+                if (pt->dirty_clean==0)
+                {
+                    continue;
+                }
+                buffer_target(ssd,pt->group,&location);
+                if (location.channel>=p->channel_number)
+                {
+                    location.channel=(next++)%p->channel_number;
+                }
+                count[location.channel]++;
+                bytes[location.channel]+=(unsigned long long)size(pt->stored)*p->subpage_capacity;
+                (*pages)++;
+            }
+        }
+    }
+
+    /*已经从buffer替换出去、还在写队列中没有开始的写子请求也要写完*/
+    for (i=0;i<p->channel_number;i++)
+    {
+        for (sub=ssd->channel_head[i].subs_w_head;sub!=NULL;sub=sub->next_node)
+        {
+            if (sub->current_state==SR_WAIT)
+            {
+                count[i]++;
+                bytes[i]+=(unsigned long long)sub->size*p->subpage_capacity;
+                (*pages)++;
+            }
+        }
+    }
+    for (sub=ssd->subs_w_head;sub!=NULL;sub=sub->next_node)
+    {
+        i=(next++)%p->channel_number;
+        count[i]++;
+        bytes[i]+=(unsigned long long)sub->size*p->subpage_capacity;
+        (*pages)++;
+    }
+
+    for (i=0;i<p->channel_number;i++)
+    {
+        if (count[i]==0)
+        {
+            continue;
+        }
+        busy=ssd->channel_head[i].next_state_predict_time;
+        for (j=0;j<ssd->channel_head[i].chip;j++)
+        {
+            if (ssd->channel_head[i].chip_head[j].next_state_predict_time>busy)
+            {
+                busy=ssd->channel_head[i].chip_head[j].next_state_predict_time;
+            }
+        }
+        wait=(busy>ssd->current_time)?busy-ssd->current_time:0;
+
+        dies=ssd->channel_head[i].chip*p->die_chip;
+        bus=(int64_t)count[i]*bus_ca_time(ssd,7)+bus_data_in_time(ssd,bytes[i]);
+        prog=(int64_t)((count[i]+dies-1)/dies)*(bus/count[i]+p->time_characteristics.tPROG);
+        if (prog<bus+p->time_characteristics.tPROG)
+        {
+            prog=bus+p->time_characteristics.tPROG;
+        }
+        if (wait+prog>holdup)
+        {
+            holdup=wait+prog;
+        }
+        bus_total+=bus;
+        total_bytes+=bytes[i];
+    }
+
+    *energy=(double)*pages*p->program_energy+(double)total_bytes*p->bus_energy/1000+(double)total_bytes/p->subpage_capacity*p->dram_energy
+           +((p->chip_num*p->chip_idle_power+p->channel_number*p->channel_idle_power)*(double)holdup
+           +p->chip_active_power*(double)*pages*p->time_characteristics.tPROG+p->channel_active_power*(double)bus_total)/1000;
+
+    free(count);
+    free(bytes);
+    return holdup;
+}
+
+/*******************************************************************************
+*insert2 buffer This function is called in buffer_management to assign sub-request services for write requests.
+ ********************************************************************************/
+struct ssd_info * insert2buffer(struct ssd_info *ssd,int64_t lpn,subpage_mask state,struct sub_request *sub,struct request *req)      
+{
+    int write_back_count,flag=0;                                                             /*flag表示为写入新数据腾空间是否完成，0表示需要进一步腾，1表示已经腾空*/
+    unsigned int i,sector_count,active_region_flag=0;
+    unsigned long long free_sector=0;
+    int64_t lsn;
+    subpage_mask hit_flag,add_flag;
+    struct buffer_group *buffer_node=NULL,*new_node=NULL;
+    struct sub_request *update=NULL;
+    struct buffer_info *buffer=buffer_of(ssd,lpn);
+
+#ifdef DEBUG
+    printf("enter insert2buffer,  current time:%lld, lpn:%lld, state:%llx,\n",ssd->current_time,lpn,state);
+#endif
+
+    if ((req!=NULL)&&(ssd->dram->read_cache!=NULL))                                         /*写请求使read cache中的旧数据失效*/
+    {
+        read_cache_invalidate(ssd,lpn,state);
+    }
+    sector_count=size(state);                                                                /*需要写到buffer的sector个数*/
+    buffer_node=buffer_find(buffer,lpn);                                                      /*在平衡二叉树或哈希表中寻找buffer node*/ 
+
+    /************************************************************************************************
+     *No hits.
+     *The first step is to delete the lsn that has been written back according to how many subpages of this lpn need to be written to the buffer, to make room for the lpn,
+     *First of all, it is necessary to calculate the free sector (indicating how many buffer nodes can be written directly).
+     *If free_sector>=sector_count, there is extra space enough for lpn sub-request to write, no need to generate a write-back request
+     *Otherwise, there is no extra space for the lpn sub-request to write. At this time, a part of the space needs to be released to generate a write-back request. Just creat_sub_request()
+     *************************************************************************************************/
+    if(buffer_node==NULL)
+    {
+        free_sector=buffer->max_buffer_sector-buffer->buffer_sector_count;   
+        if(free_sector>=sector_count)
+        {
+            flag=1;    
+        }
+        if(flag==0)     
+        {
+            write_back_count=sector_count-free_sector;
+            buffer->write_miss_hit=buffer->write_miss_hit+write_back_count;
+
+            /**********************************************************************************
+             *req不为空，表示这个insert2buffer函数是在buffer_management中调用，传递了request进来
+             *req为空，表示这个函数是在process函数中处理一对多映射关系的读的时候，需要将这个读出
+             *的数据加到buffer中，这可能产生实时的写回操作，需要将这个实时的写回操作的子请求挂在
+             *这个读请求的总请求上
+             ***********************************************************************************/
+            buffer_evict(ssd,buffer,write_back_count,NULL,sub,req);
+        }
+
+        /******************************************************************************
+         *生成一个buffer node，根据这个页的情况分别赋值个各个成员，添加到队首和二叉树中
+         *******************************************************************************/
+        new_node=buffer_add(buffer,lpn);
+        new_node->stored=state;
+        new_node->dirty_clean=state;
+        new_node->stream=(req!=NULL)?req->stream:0;
+        buffer->buffer_sector_count += sector_count;
+        buffer->dirty_sector_count += sector_count;
+        buffer_gc_account(ssd,new_node);
+    }
+    /****************************************************************************************
+     *在buffer中命中的情况
+     *算然命中了，但是命中的只是lpn，有可能新来的写请求，只是需要写lpn这一page的某几个sub_page
+     *这时有需要进一步的判断
+     *****************************************************************************************/
+    else
+    {
+        if(req!=NULL)
+        {
+            buffer_node->stream=req->stream;                               /*节点写回时使用最近一次写它的stream*/
+        }
+        for(i=0;i<ssd->parameter->subpage_page;i++)
+        {
+            /*************************************************************
+             *判断state第i位是不是1
+             *并且判断第i个sector是否存在buffer中，1表示存在，0表示不存在。
+             **************************************************************/
+            if((state>>i)%2!=0)                                                         
+            {
+                lsn=lpn*ssd->parameter->subpage_page+i;
+                hit_flag=0;
+                hit_flag=(buffer_node->stored)&SUBPAGE_BIT(i);
+
+                if(hit_flag!=0)				                                          /*命中了，需要将该节点移到buffer的队首，并且将命中的lsn进行标记*/
+                {	
+                    active_region_flag=1;                                             /*用来记录在这个buffer node中的lsn是否被命中，用于后面对阈值的判定*/
+
+                    if(req!=NULL)
+                    {
+                        buffer_touch(buffer,buffer_node);
+                        if ((buffer_node->dirty_clean&SUBPAGE_BIT(i))==0)             /*干净的页(CFLRU读进来的或者后台写回过的)又变脏*/
+                        {
+                            if (buffer_node->dirty_clean==0)                               /*CLOCK时节点不移动，可能在后台写回已扫过的干净区间里*/
+                            {
+                                buffer->flush_cursor[buffer_node->frequent]=NULL;
+                            }
+                            buffer_node->dirty_clean|=SUBPAGE_BIT(i);
+                            buffer->dirty_sector_count++;
+                        }
+                        buffer->write_hit++;
+                        req->complete_lsn_count++;                                        /*关键 当在buffer中命中时 就用req->complete_lsn_count++表示往buffer中写了数据。*/					
+                    }
+                    else
+                    {
+                    }				
+                }			
+                else                 			
+                {
+                    /************************************************************************************************************
+                     *该lsn没有命中，但是节点在buffer中，需要将这个lsn加到buffer的对应节点中
+                     *从buffer的末端找一个节点，将一个已经写回的lsn从节点中删除(如果找到的话)，更改这个节点的状态，同时将这个新的
+                     *lsn加到相应的buffer节点中，该节点可能在buffer头，不在的话，将其移到头部。如果没有找到已经写回的lsn，在buffer
+                     *节点找一个group整体写回，将这个子请求挂在这个请求上。可以提前挂在一个channel上。
+                     *第一步:将buffer队尾的已经写回的节点删除一个，为新的lsn腾出空间，这里需要修改队尾某节点的stored状态这里还需要
+                     *       增加，当没有可以之间删除的lsn时，需要产生新的写子请求，写回LRU最后的节点。
+                     *第二步:将新的lsn加到所述的buffer节点中。
+                     *************************************************************************************************************/	
+                    buffer->write_miss_hit++;
+
+                    if(buffer->buffer_sector_count>=buffer->max_buffer_sector)
+                    {
+                        /************************************************************************/
+                        /* 改:  挂在了子请求，buffer的节点不应立即删除，						*/
+                        /*			需等到写回了之后才能删除									*/
+                        /************************************************************************/
+                        buffer_evict(ssd,buffer,1,buffer_node,sub,req);                           /*命中的节点本身不能被替换，如果它在队尾就替换它前面的节点*/
+                    }
+
+                    /*第二步:将新的lsn加到所述的buffer节点中*/	
+                    add_flag=SUBPAGE_BIT(lsn%ssd->parameter->subpage_page);
+
+                    buffer_touch(buffer,buffer_node);                                      /*LRU时将这个节点提到队首，CLOCK时置访问位*/
+                    buffer_node->stored=buffer_node->stored|add_flag;		
+                    if (buffer_node->dirty_clean==0)
+                    {
+                        buffer->flush_cursor[buffer_node->frequent]=NULL;
+                    }
+                    buffer_node->dirty_clean=buffer_node->dirty_clean|add_flag;	
+                    buffer->buffer_sector_count++;
+                    buffer->dirty_sector_count++;
+                }			
+
+            }
+        }
+        buffer_gc_account(ssd,buffer_node);                                          /*节点又变脏或者旧数据页已经更新过*/
+    }
+
+    return ssd;
+}
+
+/**************************************************************************************
+ *trim时把lpn中state所表示的sector从buffer中删除，这些数据不再需要写回；
+ *buffer node中没有sector时从平衡二叉树和LRU队列中摘除
+ *Drop the trimmed sectors of lpn from the buffer so they are never written back.
+ ***************************************************************************************/
+struct ssd_info *trim2buffer(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    struct buffer_group *buffer_node=NULL;
+    struct buffer_info *buffer=buffer_of(ssd,lpn);
+
+    if (ssd->dram->read_cache!=NULL)
+    {
+        read_cache_invalidate(ssd,lpn,state);
+    }
+    buffer_node=buffer_find(buffer,lpn);
+    if ((buffer_node==NULL)||((buffer_node->stored&state)==0))
+    {
+        return ssd;
+    }
+
+    buffer->buffer_sector_count-=size(buffer_node->stored&state);
+    buffer->dirty_sector_count-=size(buffer_node->dirty_clean&state);
+    buffer_node->stored&=~state;
+    buffer_node->dirty_clean&=~state;
+    buffer_gc_release(ssd,buffer_node);
+    if (buffer_node->stored!=0)
+    {
+        buffer_gc_account(ssd,buffer_node);
+        return ssd;
+    }
+
+    buffer_remove(buffer,buffer_node);
+    buffer_node=NULL;
+
+    return ssd;
+}
+
+/*****************************************************************************************
+ *read cache：从dram中划出read cache size字节，缓存从flash读出的干净数据，按LRU替换，不需要写回。
+ *读请求先查写buffer，再查read cache；读请求(包括预取的内部请求)完成时把读出的页放入read cache；
+ *写和trim使read cache中对应的子页失效，保证read cache中不会有旧数据
+ *****************************************************************************************/
+
+/*从read cache中去掉buffer node中state对应的子页，节点空了就删除*/
+static void read_cache_drop(struct ssd_info *ssd,struct buffer_group *node,subpage_mask state)
+{
+    struct buffer_info *cache=ssd->dram->read_cache;
+
+    cache->buffer_sector_count-=size(node->stored&state);
+    node->stored&=~state;
+    if (node->stored!=0)
+    {
+        return;
+    }
+    if ((node->prefetched!=0)&&(ssd->dram->prefetch!=NULL))
+    {
+        ssd->dram->prefetch->wasted_count++;
+    }
+    buffer_remove(cache,node);
+}
+
+/*读请求req在lpn上还需要读的子页为need，返回read cache命中以后还需要从flash读的子页*/
+subpage_mask read_cache_lookup(struct ssd_info *ssd,struct request *req,int64_t lpn,subpage_mask need)
+{
+    struct buffer_info *cache=ssd->dram->read_cache;
+    struct buffer_group *node=NULL;
+    int64_t first_lsn,last_lsn;
+    subpage_mask want,hit=0;
+
+    first_lsn=(req->lsn>lpn*ssd->parameter->subpage_page)?req->lsn:lpn*ssd->parameter->subpage_page;
+    last_lsn=(req->lsn+req->size<(lpn+1)*ssd->parameter->subpage_page)?req->lsn+req->size:(lpn+1)*ssd->parameter->subpage_page;
+    want=need&SUBPAGE_BITS(last_lsn-lpn*ssd->parameter->subpage_page)&~SUBPAGE_BITS(first_lsn-lpn*ssd->parameter->subpage_page);
+    if (want==0)
+    {
+        return need;
+    }
+
+    node=buffer_find(cache,lpn);
+    if (node!=NULL)
+    {
+        hit=node->stored&want;
+    }
+    cache->read_hit+=size(hit);
+    cache->read_miss_hit+=size(want&~hit);
+    if (hit==0)
+    {
+        return need;
+    }
+
+    buffer_touch(cache,node);
+    req->complete_lsn_count+=size(hit);
+    if (node->prefetched!=0)
+    {
+        ssd->dram->prefetch->hit_count++;
+        node->prefetched=0;
+    }
+    return need&~hit;
+}
+
+/*把从flash读出的lpn的state子页放入read cache，写buffer中有的子页更新，不放入*/
+void read_cache_fill(struct ssd_info *ssd,int64_t lpn,subpage_mask state,int prefetched)
+{
+    struct buffer_info *cache=ssd->dram->read_cache;
+    struct buffer_group *node=NULL,*victim=NULL;
+    unsigned int add;
+
+    node=buffer_find(buffer_of(ssd,lpn),lpn);
+    if (node!=NULL)
+    {
+        state&=~node->stored;
+    }
+    node=buffer_find(cache,lpn);
+    if (node!=NULL)
+    {
+        state&=~node->stored;
+    }
+    add=size(state);
+    if ((add==0)||(add>cache->max_buffer_sector))
+    {
+        if ((prefetched!=0)&&(node==NULL))
+        {
+            ssd->dram->prefetch->wasted_count++;
+        }
+        return;
+    }
+
+    while (cache->max_buffer_sector-cache->buffer_sector_count<add)
+    {
+        victim=buffer_victim(cache,node);
+        if ((victim==NULL)||(victim==node))
+        {
+            return;
+        }
+        read_cache_drop(ssd,victim,victim->stored);
+    }
+    if (node==NULL)
+    {
+        node=buffer_add(cache,lpn);
+        node->prefetched=prefetched;
+    }
+    else if (prefetched==0)
+    {
+        buffer_touch(cache,node);
+    }
+    node->stored|=state;
+    cache->buffer_sector_count+=add;
+}
+
+/*写或者trim了lpn的state子页，read cache中这些子页失效*/
+void read_cache_invalidate(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    struct buffer_group *node=NULL;
+
+    node=buffer_find(ssd->dram->read_cache,lpn);
+    if ((node!=NULL)&&((node->stored&state)!=0))
+    {
+        read_cache_drop(ssd,node,state);
+    }
+}
+
+/*CFLRU没有read cache时，读出的数据作为干净的页放入写buffer，只使用空闲空间或者替换干净的页*/
+static void buffer_clean_fill(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    struct buffer_info *buffer=buffer_of(ssd,lpn);
+    struct buffer_group *node=NULL,*victim=NULL;
+    unsigned int add;
+
+    node=buffer_find(buffer,lpn);
+    if (node!=NULL)
+    {
+        state&=~node->stored;
+    }
+    add=size(state);
+    if (add==0)
+    {
+        return;
+    }
+    while (buffer->buffer_sector_count+add>buffer->max_buffer_sector)
+    {
+        victim=buffer_victim(buffer,node);
+        if ((victim==NULL)||(victim==node)||(victim->dirty_clean!=0))
+        {
+            return;
+        }
+        buffer_write_back(ssd,victim,NULL,NULL);
+    }
+    if (node==NULL)
+    {
+        node=buffer_add(buffer,lpn);
+    }
+    node->stored|=state;
+    buffer->buffer_sector_count+=add;
+}
+
+/*读请求完成时把它从flash读出的数据页放入read cache(CFLRU没有read cache时放入写buffer)，DFTL的translation page不放入*/
+void read_cache_complete(struct ssd_info *ssd,struct request *req)
+{
+    struct sub_request *sub=NULL;
+
+    if (req->operation!=READ)
+    {
+        return;
+    }
+    for (sub=req->subs;sub!=NULL;sub=sub->next_subs)
+    {
+        if ((sub->operation==READ)&&(sub->location!=NULL)&&(sub->location->block<data_block_plane(ssd)))
+        {
+            if (ssd->dram->read_cache!=NULL)
+            {
+                read_cache_fill(ssd,sub->lpn,sub->state&SUBPAGE_BITS(ssd->parameter->subpage_page),sub->prefetch);
+            }
+            else
+            {
+                buffer_clean_fill(ssd,sub->lpn,sub->state&SUBPAGE_BITS(ssd->parameter->subpage_page));
+            }
+        }
+    }
+}
+
+/*****************************************************************************************
+ *顺序读流检测和预取：读请求是某个流的继续时，流的预取深度从请求的页数开始每次加倍，最大为
+ *prefetch depth页；已经预取而还没有读到的页少于深度的一半时，把请求后面深度以内的页预取到
+ *read cache。已经缓存的、没有映射的页不预取。预取生成一个内部读请求放在请求队列的队首，
+ *它的子请求在channel的读队列中排在普通读子请求后面
+ *****************************************************************************************/
+void read_cache_prefetch(struct ssd_info *ssd,struct request *req)
+{
+    struct prefetch_info *prefetch=ssd->dram->prefetch;
+    struct prefetch_stream *stream=NULL,*oldest=NULL;
+    struct request *pre=NULL;
+    struct entry *entry=NULL;
+    int64_t lpn,first_lpn,last_lpn,end_lpn;
+    unsigned int i,pages;
+
+    first_lpn=req->lsn/ssd->parameter->subpage_page;
+    last_lpn=(req->lsn+req->size-1)/ssd->parameter->subpage_page;
+    pages=last_lpn-first_lpn+1;
+
+    oldest=&prefetch->stream[0];
+    for (i=0;i<prefetch->stream_count;i++)
+    {
+        if ((prefetch->stream[i].run!=0)&&(req->lsn+ssd->parameter->subpage_page>=prefetch->stream[i].next_lsn)&&(req->lsn<=prefetch->stream[i].next_lsn+ssd->parameter->subpage_page))
+        {
+            stream=&prefetch->stream[i];
+            break;
+        }
+        if (prefetch->stream[i].last_time<oldest->last_time)
+        {
+            oldest=&prefetch->stream[i];
+        }
+    }
+    if (stream==NULL)                                                                 /*新的流，等下一个顺序请求再预取*/
+    {
+        memset(oldest,0,sizeof(struct prefetch_stream));
+        oldest->run=1;
+        oldest->next_lsn=req->lsn+req->size;
+        oldest->prefetched_lpn=last_lpn+1;
+        oldest->last_time=ssd->current_time;
+        return;
+    }
+
+    stream->run++;
+    stream->next_lsn=req->lsn+req->size;
+    stream->last_time=ssd->current_time;
+    stream->depth=(stream->depth==0)?pages:stream->depth*2;
+    if (stream->depth>ssd->parameter->prefetch_depth)
+    {
+        stream->depth=ssd->parameter->prefetch_depth;
+    }
+    if (stream->prefetched_lpn<=last_lpn)
+    {
+        stream->prefetched_lpn=last_lpn+1;
+    }
+    if (stream->prefetched_lpn-last_lpn-1>=stream->depth/2)
+    {
+        return;
+    }
+
+    end_lpn=last_lpn+stream->depth;
+    if (end_lpn>=ssd->page)
+    {
+        end_lpn=ssd->page-1;
+    }
+    for (lpn=stream->prefetched_lpn;lpn<=end_lpn;lpn++)
+    {
+        entry=find_entry(ssd,lpn);
+        if ((entry==NULL)||((entry->state&SUBPAGE_BITS(ssd->parameter->subpage_page))==0))
+        {
+            continue;
+        }
+        if ((buffer_find(ssd->dram->read_cache,lpn)!=NULL)||(buffer_find(buffer_of(ssd,lpn),lpn)!=NULL))
+        {
+            continue;
+        }
+        if (pre==NULL)
+        {
+            pre=(struct request *)malloc(sizeof(struct request));
+            alloc_assert(pre,"prefetch request");
+            memset(pre,0,sizeof(struct request));
+            pre->time=ssd->current_time;
+            pre->begin_time=ssd->current_time;
+            pre->lsn=lpn*ssd->parameter->subpage_page;
+            pre->operation=READ;
+            pre->prefetch=1;
+        }
+        pre->size=(lpn+1)*ssd->parameter->subpage_page-pre->lsn;
+        creat_sub_request(ssd,lpn,size(entry->state&SUBPAGE_BITS(ssd->parameter->subpage_page)),entry->state&SUBPAGE_BITS(ssd->parameter->subpage_page),pre,READ);
+        prefetch->prefetch_count++;
+    }
+    stream->prefetched_lpn=end_lpn+1;
+
+    if (pre!=NULL)
+    {
+        pre->next_node=ssd->request_queue;
+        if (ssd->request_queue!=NULL)
+        {
+            ssd->request_queue->prev_node=pre;
+        }
+        ssd->request_queue=pre;
+        if (ssd->request_tail==NULL)
+        {
+            ssd->request_tail=pre;
+        }
+        ssd->request_queue_length++;
+        request_complete(ssd,pre);
+    }
+}
+
+/**************************************************************************************
+ *函数的功能是寻找活跃快，应为每个plane中都只有一个活跃块，只有这个活跃块中才能进行操作
+ *活跃块写满以后从plane的空闲块池中取下一个块，取块的顺序由free block policy决定
+ *The function of the function is to find the active fast, there should be only one active block in each plane, and only this active block can be operated.
+ *Once the active block is full the next one is taken from the free block pool of the plane.
+ ***************************************************************************************/
+Status  find_active_block(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane)
+{
+    unsigned int active_block;
+    int block=0;
+
+    active_block=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block;
+    if(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].free_page_num>0)
+    {
+        return SUCCESS;
+    }
+
+    block=free_block_pop(ssd,channel,chip,die,plane,active_block);
+    if(block>=0)
+    {
+        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block=block;
         return SUCCESS;
     }
     else
@@ -570,7 +2061,7 @@ Status  find_active_block(struct ssd_info *ssd,unsigned int channel,unsigned int
  *The function of this function is to simulate a real write operation.
  *Is to change the relevant parameters of this page, as well as the statistical parameters of the entire ssd
  **************************************************/
-Status write_page(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int active_block,unsigned int *ppn)
+Status write_page(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int active_block,int64_t *ppn)
 {
     int last_write_page=0;
     last_write_page=++(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].last_write_page);	
@@ -583,23 +2074,53 @@ Status write_page(struct ssd_info *ssd,unsigned int channel,unsigned int chip,un
 
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].free_page_num--; 
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page--;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[last_write_page].written_count++;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],last_write_page)->written_count++;
     ssd->write_flash_count++;    
     *ppn=find_ppn(ssd,channel,chip,die,plane,active_block,last_write_page);
 
     return SUCCESS;
 }
 
+/*****************************************************************************************
+ *有buffer时把新的写子请求按产生的先后挂到dram->write_head链表上，完成时间确定时删除。
+ *buffer替换和后台写回的写子请求所属的请求可能已经响应，flush命令要等它之前的这些写子请求
+ *****************************************************************************************/
+static void write_track(struct ssd_info * ssd,struct sub_request * sub)
+{
+    struct dram_info *dram=ssd->dram;
+
+    if (ssd->parameter->dram_capacity==0)
+    {
+        return;
+    }
+    sub->write_seq=++dram->write_seq;
+    sub->write_prev=dram->write_tail;
+    sub->write_next=NULL;
+    if (dram->write_tail==NULL)
+    {
+        dram->write_head=sub;
+    }
+    else
+    {
+        dram->write_tail->write_next=sub;
+    }
+    dram->write_tail=sub;
+}
+
 /**********************************************
  *这个函数的功能是根据lpn，size，state创建子请求
  *The function of this function is to create sub-requests based on lpn, size, state.
  **********************************************/
-struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,int size,unsigned int state,struct request * req,unsigned int operation)
+struct sub_request * creat_sub_request(struct ssd_info * ssd,int64_t lpn,int size,subpage_mask state,struct request * req,unsigned int operation)
 {
     struct sub_request* sub=NULL,* sub_r=NULL;
     struct channel_info * p_ch=NULL;
     struct local * loc=NULL;
     unsigned int flag=0;
+    unsigned int i=0;
+    int64_t ppn=0;
+    subpage_mask mask=0;
+    struct sub_request *ahead=NULL;
 
     sub = (struct sub_request*)malloc(sizeof(struct sub_request));                        /*申请一个子请求的结构*/
     alloc_assert(sub,"sub_request");
@@ -618,6 +2139,10 @@ struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,in
     {
         sub->next_subs = req->subs;
         req->subs = sub;
+        sub->req = req;
+        req->outstanding++;
+        sub->stream = req->stream;
+        sub->prefetch = req->prefetch;
     }
 
     /*************************************************************************************
@@ -628,7 +2153,35 @@ struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,in
      **************************************************************************************/
     if (operation == READ)
     {
-        loc = find_location(ssd,ssd->dram->map->map_entry[lpn].pn);
+        ppn=get_entry(ssd,lpn)->pn;
+        mask=(get_entry(ssd,lpn)->state&SUBPAGE_BITS(ssd->parameter->subpage_page));
+        if (ssd->dram->map->submap!=NULL)
+        {
+            /*子页映射中一个逻辑页的子页可能在几个物理页中，每个物理页一个读子请求：
+             *这个子请求读state中第一个子页所在的物理页，其余的子页递归地创建子请求(参数size遮住了size()函数，这里直接计数)*/
+            mask&=((state!=0)?state:mask);
+            for (i=0;(i<ssd->parameter->subpage_page)&&((mask&SUBPAGE_BIT(i))==0);i++);
+            state=0;
+            size=0;
+            if (i<ssd->parameter->subpage_page)
+            {
+                ppn=ssd->dram->map->submap->psn[lpn*ssd->parameter->subpage_page+i]/ssd->parameter->subpage_page;
+                for (;i<ssd->parameter->subpage_page;i++)
+                {
+                    if (((mask&SUBPAGE_BIT(i))!=0)&&(ssd->dram->map->submap->psn[lpn*ssd->parameter->subpage_page+i]/ssd->parameter->subpage_page==ppn))
+                    {
+                        state|=SUBPAGE_BIT(i);
+                        size++;
+                    }
+                }
+                if ((mask&~state)!=0)
+                {
+                    creat_sub_request(ssd,lpn,0,mask&~state,req,READ);
+                }
+            }
+            mask=state;
+        }
+        loc = find_location(ssd,ppn);
         sub->location=loc;
         sub->begin_time = ssd->current_time;
         sub->current_state = SR_WAIT;
@@ -639,32 +2192,30 @@ struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,in
         sub->size=size;                                                               /*需要计算出该子请求的请求大小*/
 
         p_ch = &ssd->channel_head[loc->channel];	
-        sub->ppn = ssd->dram->map->map_entry[lpn].pn;
+        sub->ppn = ppn;
         sub->operation = READ;
-        sub->state=(ssd->dram->map->map_entry[lpn].state&0x7fffffff);
-        sub_r=p_ch->subs_r_head;                                                      /*一下几行包括flag用于判断该读子请求队列中是否有与这个子请求相同的，有的话，将新的子请求直接赋为完成*/
-        flag=0;
-        while (sub_r!=NULL)
+        sub->state=mask;
+        sub->map_sub=dftl_lookup(ssd,lpn,req,READ);                                  /*DFTL中映射项不在CMT时先读translation page*/
+        flag=((sub->state==0)&&((get_entry(ssd,lpn)->trimmed!=0)||(ssd->parameter->address_mapping==ZNS_MAPPING)))?1:0;   /*trim过的数据和ZNS中写指针之后的数据不需要读flash*/
+        sub_r=(flag==0)?subs_r_find(p_ch,sub->ppn,0):NULL;                           /*读子请求队列中有与这个子请求相同的，新的子请求直接赋为完成*/
+        if (sub_r!=NULL)
         {
-            if (sub_r->ppn==sub->ppn)
+            if ((sub_r->prefetch!=0)&&(sub->prefetch==0))                             /*正在预取的页被读到，算预取命中*/
             {
-                flag=1;
-                break;
+                sub_r->prefetch=0;
+                p_ch->subs_r_prefetch--;
+                ssd->dram->prefetch->hit_count++;
             }
-            sub_r=sub_r->next_node;
+            flag=1;
         }
-        if (flag==0)
+        if ((flag==0)&&(p_ch->subs_r_prefetch!=0)&&(sub->prefetch==0))              /*普通读子请求插到第一个预取的子请求前面*/
         {
-            if (p_ch->subs_r_tail!=NULL)
-            {
-                p_ch->subs_r_tail->next_node=sub;
-                p_ch->subs_r_tail=sub;
-            } 
-            else
-            {
-                p_ch->subs_r_head=sub;
-                p_ch->subs_r_tail=sub;
-            }
+            for (ahead=p_ch->subs_r_head;ahead->prefetch==0;ahead=ahead->next_node);
+            subs_r_insert(p_ch,ahead->prev_node,sub);
+        }
+        else if (flag==0)
+        {
+            subs_r_append(p_ch,sub);
         }
         else
         {
@@ -673,6 +2224,7 @@ struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,in
             sub->next_state = SR_COMPLETE;
             sub->next_state_predict_time=ssd->current_time+1000;
             sub->complete_time=ssd->current_time+1000;
+            sub_request_complete(ssd,sub);
         }
     }
     /*************************************************************************************
@@ -702,41 +2254,193 @@ struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,in
             sub=NULL;
             return NULL;
         }
+        dftl_lookup(ssd,lpn,req,WRITE);
+        write_track(ssd,sub);
+
+    }
+    else
+    {
+        free(sub->location);
+        sub->location=NULL;
+        free(sub);
+        sub=NULL;
+        printf("\nERROR ! Unexpected command.\n");
+        exit(100);
+        return NULL;
+    }
+
+    // Added by Fadhil to mark every IO that meets GC, and record GC remaining time in the IO
+    if (sub->location != NULL && 
+        ssd->channel_head[sub->location->channel].next_state_predict_time != MAX_INT64 &&
+        ssd->channel_head[sub->location->channel].next_state_predict_time != 0 &&
+        ssd->channel_head[sub->location->channel].current_state == CHANNEL_GC && 
+        ssd->channel_head[sub->location->channel].next_state == CHANNEL_IDLE && 
+        sub->begin_time >= ssd->channel_head[sub->location->channel].current_time &&
+        sub->begin_time <= ssd->channel_head[sub->location->channel].next_state_predict_time) {
+        req->meet_gc_flag = 1;
+        if (ssd->channel_head[sub->location->channel].next_state_predict_time - sub->begin_time > req->meet_gc_remaining_time) {
+            req->meet_gc_remaining_time = ssd->channel_head[sub->location->channel].next_state_predict_time - sub->begin_time;
+        }
+    }
+
+    if (operation==READ) {
+        ssd->read_subreq_count++;
+    }
+    if (operation==WRITE) {
+        ssd->write_subreq_count++;
+    }
+
+    return sub;
+}
+
+/*****************************************************************************************
+ *map子请求sub要读的translation page已经由读队列中的sub_r读出，sub的完成时间和sub_r相同
+ *****************************************************************************************/
+static void map_sub_follow(struct ssd_info * ssd,struct sub_request * sub,struct sub_request * sub_r)
+{
+    sub->current_state = SR_R_DATA_TRANSFER;
+    sub->current_time=ssd->current_time;
+    sub->next_state = SR_COMPLETE;
+    sub->complete_time=(sub_r->complete_time>ssd->current_time)?sub_r->complete_time:ssd->current_time;
+    sub->next_state_predict_time=sub->complete_time;
+    sub_request_complete(ssd,sub);
+}
+
+/*****************************************************************************************
+ *DFTL中映射项不在CMT时，为读请求req创建读取translation page(物理页号ppn)的子请求，
+ *和普通读子请求一样挂在channel的读队列上，完成时间计入req的响应时间；同一个translation page
+ *已经在读队列中时不再读，挂在队列中那个子请求的map_wait上，和它一起完成
+ *****************************************************************************************/
+struct sub_request * creat_map_sub_request(struct ssd_info * ssd,int64_t ppn,struct request * req)
+{
+    struct sub_request* sub=NULL,* sub_r=NULL;
+    struct channel_info * p_ch=NULL;
+
+    sub = (struct sub_request*)malloc(sizeof(struct sub_request));
+    alloc_assert(sub,"sub_request");
+    memset(sub,0, sizeof(struct sub_request));
+
+    sub->next_subs = req->subs;
+    req->subs = sub;
+    sub->req = req;
+    req->outstanding++;
+
+    sub->location=find_location(ssd,ppn);
+    sub->begin_time = ssd->current_time;
+    sub->current_state = SR_WAIT;
+    sub->current_time=MAX_INT64;
+    sub->next_state = SR_R_C_A_TRANSFER;
+    sub->next_state_predict_time=MAX_INT64;
+    sub->lpn = get_page(ssd,&ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].die_head[sub->location->die].plane_head[sub->location->plane].blk_head[sub->location->block],sub->location->page)->lpn;
+    sub->size=ssd->parameter->subpage_page;
+    sub->ppn = ppn;
+    sub->operation = READ;
+    sub->state=SUBPAGE_BITS(ssd->parameter->subpage_page);
+
+    p_ch = &ssd->channel_head[sub->location->channel];
+    sub_r=subs_r_find(p_ch,sub->ppn,0);                                                /*同一个translation page已经在读队列中时，不必再读*/
+    if (sub_r==NULL)
+    {
+        subs_r_append(p_ch,sub);
+        ssd->dram->map->dftl->trans_read_count++;
+    }
+    else if (sub_r->done!=0)                                                           /*已经读出的translation page，完成时间和它相同*/
+    {
+        map_sub_follow(ssd,sub,sub_r);
+    }
+    else                                                                               /*还没有读出的，等它读出后一起完成*/
+    {
+        sub->map_wait=sub_r->map_wait;
+        sub_r->map_wait=sub;
+    }
+
+    return sub;
+}
+
+/*****************************************************************************************
+ *子请求的完成时间(complete_time)确定或者推迟时调用：所属请求的outstanding减一并记录最晚的完成
+ *时间，所有子请求的完成时间都确定后把请求放入完成堆，由trace_output在完成时刻输出
+ *****************************************************************************************/
+void sub_request_complete(struct ssd_info * ssd,struct sub_request * sub)
+{
+    struct request *req=sub->req;
+    struct dram_info *dram=ssd->dram;
+    struct sub_request *wait=NULL;
+    int head;
+
+    while (sub->map_wait!=NULL)                                        /*等同一个translation page的map子请求一起完成*/
+    {
+        wait=sub->map_wait;
+        sub->map_wait=wait->map_wait;
+        wait->map_wait=NULL;
+        map_sub_follow(ssd,wait,sub);
+    }
+
+    if (sub->write_seq!=0)                                             /*写子请求的完成时间确定了，从write_head链表中删除*/
+    {
+        head=(sub==dram->write_head);
+        if (sub->write_prev==NULL)
+        {
+            dram->write_head=sub->write_next;
+        }
+        else
+        {
+            sub->write_prev->write_next=sub->write_next;
+        }
+        if (sub->write_next==NULL)
+        {
+            dram->write_tail=sub->write_prev;
+        }
+        else
+        {
+            sub->write_next->write_prev=sub->write_prev;
+        }
+        sub->write_prev=NULL;
+        sub->write_next=NULL;
+        sub->write_seq=0;
+        if (dram->write_done_time<sub->complete_time)
+        {
+            dram->write_done_time=sub->complete_time;
+        }
+        if ((head!=0)&&(ssd->flush_wait!=NULL))
+        {
+            flush_wakeup(ssd);
+        }
+    }
 
+    if (req==NULL)
+    {
+        return;
     }
-    else
+    if (sub->done==0)
     {
-        free(sub->location);
-        sub->location=NULL;
-        free(sub);
-        sub=NULL;
-        printf("\nERROR ! Unexpected command.\n");
-        exit(100);
-        return NULL;
+        sub->done=1;
+        req->outstanding--;
     }
-
-    // Added by Fadhil to mark every IO that meets GC, and record GC remaining time in the IO
-    if (sub->location != NULL && 
-        ssd->channel_head[sub->location->channel].next_state_predict_time != MAX_INT64 &&
-        ssd->channel_head[sub->location->channel].next_state_predict_time != 0 &&
-        ssd->channel_head[sub->location->channel].current_state == CHANNEL_GC && 
-        ssd->channel_head[sub->location->channel].next_state == CHANNEL_IDLE && 
-        sub->begin_time >= ssd->channel_head[sub->location->channel].current_time &&
-        sub->begin_time <= ssd->channel_head[sub->location->channel].next_state_predict_time) {
-        req->meet_gc_flag = 1;
-        if (ssd->channel_head[sub->location->channel].next_state_predict_time - sub->begin_time > req->meet_gc_remaining_time) {
-            req->meet_gc_remaining_time = ssd->channel_head[sub->location->channel].next_state_predict_time - sub->begin_time;
-        }
+    if (req->complete_time<sub->complete_time)
+    {
+        req->complete_time=sub->complete_time;
     }
+    if (req->outstanding==0)
+    {
+        request_complete(ssd,req);
+    }
+}
 
-    if (operation==READ) {
-        ssd->read_subreq_count++;
+/*****************************************************************
+ *读子请求的translation page已经读出(或者不需要读)时才能发给chip
+ ******************************************************************/
+int sub_map_ready(struct ssd_info * ssd,struct sub_request * sub)
+{
+    if (sub->map_sub==NULL)
+    {
+        return TRUE;
     }
-    if (operation==WRITE) {
-        ssd->write_subreq_count++;
+    if ((sub->map_sub->current_state==SR_COMPLETE)||((sub->map_sub->next_state==SR_COMPLETE)&&(sub->map_sub->next_state_predict_time<=ssd->current_time)))
+    {
+        return TRUE;
     }
-
-    return sub;
+    return FALSE;
 }
 
 /******************************************************
@@ -746,51 +2450,23 @@ struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,in
 struct sub_request * find_read_sub_request(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die)
 {
     unsigned int plane=0;
-    unsigned int address_ppn=0;
-    struct sub_request *sub=NULL,* p=NULL;
+    int64_t address_ppn=0;
+    struct sub_request *sub=NULL;
 
     for(plane=0;plane<ssd->parameter->plane_die;plane++)
     {
         address_ppn=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].add_reg_ppn;
         if(address_ppn!=-1)
         {
-            sub=ssd->channel_head[channel].subs_r_head;
-            if(sub->ppn==address_ppn)
-            {
-                if(sub->next_node==NULL)
-                {
-                    ssd->channel_head[channel].subs_r_head=NULL;
-                    ssd->channel_head[channel].subs_r_tail=NULL;
-                }
-                ssd->channel_head[channel].subs_r_head=sub->next_node;
-            }
-            while((sub->ppn!=address_ppn)&&(sub->next_node!=NULL))
-            {
-                if(sub->next_node->ppn==address_ppn)
-                {
-                    p=sub->next_node;
-                    if(p->next_node==NULL)
-                    {
-                        sub->next_node=NULL;
-                        ssd->channel_head[channel].subs_r_tail=sub;
-                    }
-                    else
-                    {
-                        sub->next_node=p->next_node;
-                    }
-                    sub=p;
-                    break;
-                }
-                sub=sub->next_node;
-            }
-            if(sub->ppn==address_ppn)
+            sub=subs_r_find(&ssd->channel_head[channel],address_ppn,1);
+            if(sub!=NULL)
             {
-                sub->next_node=NULL;
+                subs_r_remove(&ssd->channel_head[channel],sub);
                 return sub;
             }
             else 
             {
-                printf("Error! Can't find the sub request. {begin_time=%lld ope=%u}\n", sub->begin_time, sub->operation);
+                printf("Error! Can't find the sub request. {ppn=%lld}\n", address_ppn);
                 getchar();
             }
         }
@@ -921,9 +2597,10 @@ Status services_2_r_cmd_trans_and_complete(struct ssd_info * ssd)
     struct sub_request * sub=NULL, * p=NULL;
     for(i=0;i<ssd->parameter->channel_number;i++)                                       /*这个循环处理不需要channel的时间(读命令已经到达chip，chip由ready变为busy)，当读请求完成时，将其从channel的队列中取出*/
     {
-        sub=ssd->channel_head[i].subs_r_head;
+        sub=ssd->channel_head[i].subs_r_issued;                                        /*等待的子请求状态不会改变，只检查已经发出读命令的*/
         while(sub!=NULL)
         {
+            p=sub->issued_next;
             if(sub->current_state==SR_R_C_A_TRANSFER)                                  /*读命令发送完毕，将对应的die置为busy，同时修改sub的状态; 这个部分专门处理读请求由当前状态为传命令变为die开始busy，die开始busy不需要channel为空，所以单独列出*/
             {
                 if(sub->next_state_predict_time<=ssd->current_time)
@@ -934,25 +2611,9 @@ Status services_2_r_cmd_trans_and_complete(struct ssd_info * ssd)
             }
             else if((sub->current_state==SR_COMPLETE)||((sub->next_state==SR_COMPLETE)&&(sub->next_state_predict_time<=ssd->current_time)))
             {	
-                if(sub!=ssd->channel_head[i].subs_r_head)                             /*if the request is completed, we delete it from read queue */
-                {		
-                    p->next_node=sub->next_node;						
-                }			
-                else					
-                {	
-                    if (ssd->channel_head[i].subs_r_head!=ssd->channel_head[i].subs_r_tail)
-                    {
-                        ssd->channel_head[i].subs_r_head=sub->next_node;
-                    } 
-                    else
-                    {
-                        ssd->channel_head[i].subs_r_head=NULL;
-                        ssd->channel_head[i].subs_r_tail=NULL;
-                    }							
-                }			
+                subs_r_remove(&ssd->channel_head[i],sub);                              /*if the request is completed, we delete it from read queue */
             }
-            p=sub;
-            sub=sub->next_node;
+            sub=p;
         }
     }
 
@@ -966,7 +2627,8 @@ Status services_2_r_cmd_trans_and_complete(struct ssd_info * ssd)
 Status services_2_r_data_trans(struct ssd_info * ssd,unsigned int channel,unsigned int * channel_busy_flag, unsigned int * change_current_time_flag)
 {
     int chip=0;
-    unsigned int die=0,plane=0,address_ppn=0,die1=0,sub_plane;
+    unsigned int die=0,plane=0,die1=0,sub_plane;
+    int64_t address_ppn=0;
     struct sub_request * sub=NULL, * p=NULL,*sub1=NULL;
     struct sub_request * sub_twoplane_one=NULL, * sub_twoplane_two=NULL;
     struct sub_request * sub_interleave_one=NULL, * sub_interleave_two=NULL;
@@ -1084,11 +2746,25 @@ Status services_2_r_data_trans(struct ssd_info * ssd,unsigned int channel,unsign
  *******************************************************/
 int services_2_r_wait(struct ssd_info * ssd,unsigned int channel,unsigned int * channel_busy_flag, unsigned int * change_current_time_flag)
 {
-    unsigned int plane=0,address_ppn=0;
+    unsigned int plane=0,chip=0;
+    int64_t address_ppn=0;
     struct sub_request * sub=NULL, * p=NULL;
     struct sub_request * sub_twoplane_one=NULL, * sub_twoplane_two=NULL;
     struct sub_request * sub_interleave_one=NULL, * sub_interleave_two=NULL;
+    struct chip_info * p_chip=NULL;
 
+    for(chip=0;chip<ssd->channel_head[channel].chip;chip++)                           /*channel上没有空闲的chip时不可能发出读命令，不用扫描读队列*/
+    {
+        p_chip=&ssd->channel_head[channel].chip_head[chip];
+        if((p_chip->current_state==CHIP_IDLE)||((p_chip->next_state==CHIP_IDLE)&&(p_chip->next_state_predict_time<=ssd->current_time)))
+        {
+            break;
+        }
+    }
+    if(chip==ssd->channel_head[channel].chip)
+    {
+        return SUCCESS;
+    }
 
     sub=ssd->channel_head[channel].subs_r_head;
 
@@ -1111,7 +2787,7 @@ int services_2_r_wait(struct ssd_info * ssd,unsigned int channel,unsigned int *
         {
             while(sub!=NULL)                                                            /*if there are read requests in queue, send one of them to target die*/			
             {		
-                if(sub->current_state==SR_WAIT)									
+                if((sub->current_state==SR_WAIT)&&(sub_map_ready(ssd,sub)==TRUE))									
                 {	                                                                    /*注意下个这个判断条件与services_2_r_data_trans中判断条件的不同*/
                     if((ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].current_state==CHIP_IDLE)||((ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].next_state==CHIP_IDLE)&&
                                 (ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].next_state_predict_time<=ssd->current_time)))												
@@ -1148,7 +2824,7 @@ int services_2_r_wait(struct ssd_info * ssd,unsigned int channel,unsigned int *
         {
             while(sub!=NULL)                                                           /*if there are read requests in queue, send one of them to target die*/			
             {		
-                if(sub->current_state==SR_WAIT)									
+                if((sub->current_state==SR_WAIT)&&(sub_map_ready(ssd,sub)==TRUE))									
                 {	
                     if((ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].current_state==CHIP_IDLE)||((ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].next_state==CHIP_IDLE)&&
                                 (ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].next_state_predict_time<=ssd->current_time)))												
@@ -1176,7 +2852,7 @@ int services_2_r_wait(struct ssd_info * ssd,unsigned int channel,unsigned int *
     {
         while(sub!=NULL)                                                               /*if there are read requests in queue, send one of them to target chip*/			
         {		
-            if(sub->current_state==SR_WAIT)									
+            if((sub->current_state==SR_WAIT)&&(sub_map_ready(ssd,sub)==TRUE))									
             {	                                                                       
                 if((ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].current_state==CHIP_IDLE)||((ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].next_state==CHIP_IDLE)&&
                             (ssd->channel_head[sub->location->channel].chip_head[sub->location->chip].next_state_predict_time<=ssd->current_time)))												
@@ -1239,44 +2915,115 @@ int delete_w_sub_request(struct ssd_info * ssd, unsigned int channel, struct sub
     return SUCCESS;	
 }
 
+/*****************************************************************************************
+ *trim和zone reset时取消写队列(head,tail)中还没有发出的写子请求里lpn在first_lpn到last_lpn之间、
+ *state所表示的子页，免得它们在trim或擦除之后再写入flash。子页全部取消的写子请求从队列中删除，
+ *直接完成；更新读已经发出还没有完成的写子请求要等读完成，不取消
+ *****************************************************************************************/
+static void subs_w_cancel(struct ssd_info *ssd,struct sub_request **head,struct sub_request **tail,int64_t first_lpn,int64_t last_lpn,subpage_mask state)
+{
+    struct sub_request *sub=NULL,*p=NULL,*next=NULL,*update=NULL;
+
+    for (sub=*head;sub!=NULL;sub=next)
+    {
+        next=sub->next_node;
+        update=sub->update;
+        if ((sub->current_state!=SR_WAIT)||(sub->lpn<first_lpn)||(sub->lpn>last_lpn)||((sub->state&state)==0))
+        {
+            p=sub;
+            continue;
+        }
+        if ((sub->state&~state)!=0)
+        {
+            sub->state&=~state;
+            p=sub;
+            continue;
+        }
+        if ((update!=NULL)&&(update->current_state!=SR_WAIT)&&(update->current_state!=SR_COMPLETE)&&!((update->next_state==SR_COMPLETE)&&(update->next_state_predict_time<=ssd->current_time)))
+        {
+            p=sub;
+            continue;
+        }
+        if ((update!=NULL)&&(update->current_state==SR_WAIT))
+        {
+            subs_r_remove(&ssd->channel_head[update->location->channel],update);
+            update->current_state=SR_COMPLETE;
+        }
+
+        if (p==NULL)
+        {
+            *head=sub->next_node;
+        }
+        else
+        {
+            p->next_node=sub->next_node;
+        }
+        if (*tail==sub)
+        {
+            *tail=p;
+        }
+        sub->next_node=NULL;
+        sub->state=0;
+        sub->current_state=SR_COMPLETE;
+        sub->current_time=ssd->current_time;
+        sub->next_state=SR_COMPLETE;
+        sub->next_state_predict_time=ssd->current_time;
+        sub->complete_time=ssd->current_time;
+        sub_request_complete(ssd,sub);
+        ssd->write_cancel_count++;
+    }
+}
+
+void cancel_write_sub_request(struct ssd_info *ssd,int64_t first_lpn,int64_t last_lpn,subpage_mask state)
+{
+    unsigned int i=0;
+
+    subs_w_cancel(ssd,&ssd->subs_w_head,&ssd->subs_w_tail,first_lpn,last_lpn,state);
+    for (i=0;i<ssd->parameter->channel_number;i++)
+    {
+        subs_w_cancel(ssd,&ssd->channel_head[i].subs_w_head,&ssd->channel_head[i].subs_w_tail,first_lpn,last_lpn,state);
+    }
+}
+
 /*
  *函数的功能就是执行copyback命令的功能，
  */
 Status copy_back(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die,struct sub_request * sub)
 {
-    int old_ppn=-1, new_ppn=-1;
+    int64_t old_ppn=-1, new_ppn=-1;
     long long time=0;
     if (ssd->parameter->greed_CB_ad==1)                                               /*允许贪婪使用copyback高级命令*/
     {
         old_ppn=-1;
-        if (ssd->dram->map->map_entry[sub->lpn].state!=0)                             /*说明这个逻辑页之前有写过，需要使用copyback+random input命令，否则直接写下去即可*/
+        if (get_entry(ssd,sub->lpn)->state!=0)                             /*说明这个逻辑页之前有写过，需要使用copyback+random input命令，否则直接写下去即可*/
         {
-            if ((sub->state&ssd->dram->map->map_entry[sub->lpn].state)==ssd->dram->map->map_entry[sub->lpn].state)       
+            if ((sub->state&get_entry(ssd,sub->lpn)->state)==get_entry(ssd,sub->lpn)->state)       
             {
-                sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;	
+                sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);	
             } 
             else
             {
-                sub->next_state_predict_time=ssd->current_time+19*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,19)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
                 ssd->copy_back_count++;
                 ssd->read_count++;
                 ssd->in_read_size+=ssd->parameter->subpage_page;
                 ssd->update_read_count++;
-                old_ppn=ssd->dram->map->map_entry[sub->lpn].pn;                       /*记录原来的物理页，用于在copyback时，判断是否满足同为奇地址或者偶地址*/
+                old_ppn=get_entry(ssd,sub->lpn)->pn;                       /*记录原来的物理页，用于在copyback时，判断是否满足同为奇地址或者偶地址*/
             }															
         } 
         else
         {
-            sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+            sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
         }
         sub->complete_time=sub->next_state_predict_time;		
+        sub_request_complete(ssd,sub);
         time=sub->complete_time;
 
         get_ppn(ssd,sub->location->channel,sub->location->chip,sub->location->die,sub->location->plane,sub);
 
         if (old_ppn!=-1)                                                              /*采用了copyback操作，需要判断是否满足了奇偶地址的限制*/
         {
-            new_ppn=ssd->dram->map->map_entry[sub->lpn].pn;
+            new_ppn=get_entry(ssd,sub->lpn)->pn;
             while (old_ppn%2!=new_ppn%2)                                              /*没有满足奇偶地址限制，需要再往下找一页*/
             {
                 get_ppn(ssd,sub->location->channel,sub->location->chip,sub->location->die,sub->location->plane,sub);
@@ -1284,32 +3031,32 @@ Status copy_back(struct ssd_info * ssd, unsigned int channel, unsigned int chip,
                 ssd->in_program_size-=ssd->parameter->subpage_page;
                 ssd->write_flash_count--;
                 ssd->waste_page_count++;
-                new_ppn=ssd->dram->map->map_entry[sub->lpn].pn;
+                new_ppn=get_entry(ssd,sub->lpn)->pn;
             }
         }
     } 
     else                                                                              /*不能贪婪的使用copyback高级命令*/
     {
-        if (ssd->dram->map->map_entry[sub->lpn].state!=0)
+        if (get_entry(ssd,sub->lpn)->state!=0)
         {
-            if ((sub->state&ssd->dram->map->map_entry[sub->lpn].state)==ssd->dram->map->map_entry[sub->lpn].state)        
+            if ((sub->state&get_entry(ssd,sub->lpn)->state)==get_entry(ssd,sub->lpn)->state)        
             {
-                sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
                 get_ppn(ssd,sub->location->channel,sub->location->chip,sub->location->die,sub->location->plane,sub);
             } 
             else
             {
-                old_ppn=ssd->dram->map->map_entry[sub->lpn].pn;                       /*记录原来的物理页，用于在copyback时，判断是否满足同为奇地址或者偶地址*/
+                old_ppn=get_entry(ssd,sub->lpn)->pn;                       /*记录原来的物理页，用于在copyback时，判断是否满足同为奇地址或者偶地址*/
                 get_ppn(ssd,sub->location->channel,sub->location->chip,sub->location->die,sub->location->plane,sub);
-                new_ppn=ssd->dram->map->map_entry[sub->lpn].pn;
+                new_ppn=get_entry(ssd,sub->lpn)->pn;
                 if (old_ppn%2==new_ppn%2)
                 {
                     ssd->copy_back_count++;
-                    sub->next_state_predict_time=ssd->current_time+19*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                    sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,19)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
                 } 
                 else
                 {
-                    sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(size(ssd->dram->map->map_entry[sub->lpn].state))*ssd->parameter->time_characteristics.tRC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                    sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+ssd->parameter->time_characteristics.tR+bus_data_out_time(ssd,size(get_entry(ssd,sub->lpn)->state))+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
                 }
                 ssd->read_count++;
                 ssd->in_read_size+=ssd->parameter->subpage_page;
@@ -1318,10 +3065,11 @@ Status copy_back(struct ssd_info * ssd, unsigned int channel, unsigned int chip,
         } 
         else
         {
-            sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+            sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
             get_ppn(ssd,sub->location->channel,sub->location->chip,sub->location->die,sub->location->plane,sub);
         }
         sub->complete_time=sub->next_state_predict_time;		
+        sub_request_complete(ssd,sub);
         time=sub->complete_time;
     }
 
@@ -1333,10 +3081,7 @@ Status copy_back(struct ssd_info * ssd, unsigned int channel, unsigned int chip,
     ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
     ssd->channel_head[channel].next_state_predict_time=time;
 
-    ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-    ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-    ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-    ssd->channel_head[channel].chip_head[chip].next_state_predict_time=time+ssd->parameter->time_characteristics.tPROG;
+    chip_program_state(ssd,channel,chip,time);
 
     return SUCCESS;
 }
@@ -1347,15 +3092,15 @@ Status copy_back(struct ssd_info * ssd, unsigned int channel, unsigned int chip,
 Status static_write(struct ssd_info * ssd, unsigned int channel,unsigned int chip, unsigned int die,struct sub_request * sub)
 {
     long long time=0;
-    if (ssd->dram->map->map_entry[sub->lpn].state!=0)                                    /*说明这个逻辑页之前有写过，需要使用先读出来，再写下去，否则直接写下去即可 | Explain that this logical page has been written before, you need to use it to read it first, then write it down, otherwise you can write it down directly.*/
+    if (get_entry(ssd,sub->lpn)->state!=0)                                    /*说明这个逻辑页之前有写过，需要使用先读出来，再写下去，否则直接写下去即可 | Explain that this logical page has been written before, you need to use it to read it first, then write it down, otherwise you can write it down directly.*/
     {
-        if ((sub->state&ssd->dram->map->map_entry[sub->lpn].state)==ssd->dram->map->map_entry[sub->lpn].state)   /*可以覆盖*/
+        if ((sub->state&get_entry(ssd,sub->lpn)->state)==get_entry(ssd,sub->lpn)->state)   /*可以覆盖*/
         {
-            sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+            sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
         } 
         else
         {
-            sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(size((ssd->dram->map->map_entry[sub->lpn].state^sub->state)))*ssd->parameter->time_characteristics.tRC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+            sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+ssd->parameter->time_characteristics.tR+bus_data_out_time(ssd,size((get_entry(ssd,sub->lpn)->state^sub->state)))+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
             ssd->read_count++;
             ssd->in_read_size+=ssd->parameter->subpage_page;
             ssd->update_read_count++;
@@ -1363,9 +3108,10 @@ Status static_write(struct ssd_info * ssd, unsigned int channel,unsigned int chi
     } 
     else
     {
-        sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
     }
     sub->complete_time=sub->next_state_predict_time;		
+    sub_request_complete(ssd,sub);
     time=sub->complete_time;
 
     get_ppn(ssd,sub->location->channel,sub->location->chip,sub->location->die,sub->location->plane,sub);
@@ -1379,14 +3125,325 @@ Status static_write(struct ssd_info * ssd, unsigned int channel,unsigned int chi
     ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
     ssd->channel_head[channel].next_state_predict_time=time;
 
-    ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-    ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-    ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-    ssd->channel_head[channel].chip_head[chip].next_state_predict_time=time+ssd->parameter->time_characteristics.tPROG;
+    chip_program_state(ssd,channel,chip,time);
+
+    return SUCCESS;
+}
+
+/*****************************************************************************************************
+ *通道总线的时间模型。bus_speed为0时沿用原来的方式，每个周期(字节)按tWC/tRC计时；
+ *否则按ONFI接口的速率(MT/s)和位宽计算数据传输时间。命令/地址周期和bus_speed无关，按command_cycle计时(为0时用tWC)
+ *====================================================================================================
+ *Channel bus timing. bus_ca_time() is the cost of command/address cycles, bus_data_in_time() and
+ *bus_data_out_time() the cost of moving bytes to/from the flash register.
+ ******************************************************************************************************/
+int64_t bus_ca_time(struct ssd_info *ssd,unsigned int cycles)
+{
+    if(ssd->parameter->command_cycle==0)
+        return (int64_t)cycles*ssd->parameter->time_characteristics.tWC;
+    return (int64_t)cycles*ssd->parameter->command_cycle;
+}
+
+int64_t bus_transfer_time(struct ssd_info *ssd,unsigned long long bytes,int legacy_cycle)
+{
+    int64_t bits_per_us;
+
+    if(ssd->parameter->bus_speed==0)
+        return (int64_t)bytes*legacy_cycle;
+
+    bits_per_us=(int64_t)ssd->parameter->bus_speed*(ssd->parameter->bus_width>0?ssd->parameter->bus_width:8);
+    return ((int64_t)bytes*8*1000+bits_per_us-1)/bits_per_us;
+}
+
+int64_t bus_data_in_time(struct ssd_info *ssd,unsigned long long bytes)
+{
+    return bus_transfer_time(ssd,bytes,ssd->parameter->time_characteristics.tWC);
+}
+
+int64_t bus_data_out_time(struct ssd_info *ssd,unsigned long long bytes)
+{
+    return bus_transfer_time(ssd,bytes,ssd->parameter->time_characteristics.tRC);
+}
+
+/*****************************************************************************************************
+ *写数据传输结束(transfer_end)后修改chip的状态，计算编程完成的时间
+ *支持cache program(AD_CACHE)时，数据先进入cache register，上一页编程结束后才转入page register开始编程，
+ *cache register在开始编程时就空闲了，下一页的数据传输可以与这一页的编程重叠
+ *====================================================================================================
+ *Set the chip state once the write data transfer ends. With cache program the data waits in the cache
+ *register until the previous page leaves the array, so the next transfer overlaps the current tPROG.
+ ******************************************************************************************************/
+Status chip_program_state(struct ssd_info *ssd,unsigned int channel,unsigned int chip,int64_t transfer_end)
+{
+    int64_t array_start=transfer_end+ssd->channel_head[channel].chip_head[chip].merge_time;
+
+    ssd->channel_head[channel].chip_head[chip].merge_time=0;                          /*先完成写入触发的merge*/
+    if ((ssd->parameter->advanced_commands&AD_CACHE)==AD_CACHE)
+    {
+        if ((ssd->channel_head[channel].chip_head[chip].current_state==CHIP_CACHE_WRITE_BUSY)&&(ssd->channel_head[channel].chip_head[chip].next_state_predict_time>ssd->current_time))
+        {
+            ssd->cache_program_count++;                                                /*数据传输时上一页还在编程*/
+            if (ssd->channel_head[channel].chip_head[chip].next_state_predict_time>array_start)
+            {
+                array_start=ssd->channel_head[channel].chip_head[chip].next_state_predict_time;
+            }
+        }
+        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_CACHE_WRITE_BUSY;
+        ssd->channel_head[channel].chip_head[chip].cache_reg_free_time=array_start;
+    }
+    else
+    {
+        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;
+    }
+    ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;
+    ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;
+    ssd->channel_head[channel].chip_head[chip].next_state_predict_time=array_start+ssd->parameter->time_characteristics.tPROG;
+    power_budget_start(ssd);
+
+    return SUCCESS;
+}
+
+/*****************************************************************************************************
+ *功耗预算：统计当前正在编程/擦除的chip数目和功率，判断能否再开始一个op_state(CHIP_WRITE_BUSY或CHIP_ERASE_BUSY)
+ *的阵列操作。主机写和可中断的gc只能使用(1-power_cap_gc_reserve)的预算，不可中断的gc可以使用全部预算，
+ *避免空闲页耗尽时gc被主机写饿死。没有任何阵列操作时总是允许，防止功率上限小于单个操作功率时死锁。
+ *这里只做判断，推迟的次数由调用者按子请求或gc请求统计，操作真正开始时调用power_budget_start
+ *====================================================================================================
+ *Power budget: admit a new program/erase only if the concurrent operation count and power stay within
+ *the cap. Urgent (uninterruptible) GC may use the share reserved for it, host work and background GC may not.
+ ******************************************************************************************************/
+static unsigned int power_budget_load(struct ssd_info *ssd,double *power)
+{
+    unsigned int i,j,ops=0;
+    int state;
+    double program_power,erase_power;
+
+    program_power=ssd->parameter->program_energy*1000/ssd->parameter->time_characteristics.tPROG;    /*nJ/ns=W，换算成mW*/
+    erase_power=ssd->parameter->erase_energy*1000/ssd->parameter->time_characteristics.tBERS;
+
+    *power=0;
+    for(i=0;i<ssd->parameter->channel_number;i++)
+    {
+        for(j=0;j<ssd->parameter->chip_channel[i];j++)
+        {
+            if(ssd->channel_head[i].chip_head[j].next_state_predict_time<=ssd->current_time)
+                continue;
+            state=ssd->channel_head[i].chip_head[j].current_state;
+            if((state==CHIP_WRITE_BUSY)||(state==CHIP_CACHE_WRITE_BUSY)||(state==CHIP_COPYBACK_BUSY))
+            {
+                ops++;
+                *power+=program_power;
+            }
+            else if(state==CHIP_ERASE_BUSY)
+            {
+                ops++;
+                *power+=erase_power;
+            }
+        }
+    }
+    return ops;
+}
+
+int power_budget_admit(struct ssd_info *ssd,int op_state,int urgent)
+{
+    unsigned int ops=0;
+    double power=0,share;
+
+    if((ssd->parameter->power_cap_ops==0)&&(ssd->parameter->power_cap==0))
+        return TRUE;
+
+    ops=power_budget_load(ssd,&power);
+    if(ops==0)
+        return TRUE;
+
+    share=(urgent==TRUE)?1.0:(1.0-ssd->parameter->power_cap_gc_reserve);
+    if(op_state==CHIP_ERASE_BUSY)
+        power+=ssd->parameter->erase_energy*1000/ssd->parameter->time_characteristics.tBERS;
+    else
+        power+=ssd->parameter->program_energy*1000/ssd->parameter->time_characteristics.tPROG;
+    if(((ssd->parameter->power_cap_ops!=0)&&(ops+1>ssd->parameter->power_cap_ops*share))
+            ||((ssd->parameter->power_cap!=0)&&(power>ssd->parameter->power_cap*share)))
+        return FALSE;
+    return TRUE;
+}
+
+/*编程/擦除操作开始(chip的状态已经修改)后调用，记录同时进行的操作数目的最大值*/
+void power_budget_start(struct ssd_info *ssd)
+{
+    unsigned int ops=0;
+    double power=0;
+
+    if((ssd->parameter->power_cap_ops==0)&&(ssd->parameter->power_cap==0))
+        return;
+
+    ops=power_budget_load(ssd,&power);
+    if(ops>ssd->power_cap_peak_ops)
+        ssd->power_cap_peak_ops=ops;
+}
+
+/*****************************************************************************************************
+ *主机写因为功耗预算不能在channel的chip上开始：可能写到这个chip上的等待的写子请求记为推迟，
+ *每个写子请求只计一次
+ ******************************************************************************************************/
+static void power_budget_defer_write(struct ssd_info *ssd,unsigned int channel,unsigned int chip)
+{
+    struct sub_request *sub=NULL;
+
+    for(sub=ssd->subs_w_head;sub!=NULL;sub=sub->next_node)
+    {
+        if((sub->current_state==SR_WAIT)&&(sub->power_deferred==0))
+        {
+            sub->power_deferred=1;
+            ssd->power_cap_host_defer++;
+        }
+    }
+    for(sub=ssd->channel_head[channel].subs_w_head;sub!=NULL;sub=sub->next_node)
+    {
+        if((sub->current_state==SR_WAIT)&&(sub->power_deferred==0)&&((sub->location->chip==chip)||(sub->location->chip==(unsigned int)-1)))
+        {
+            sub->power_deferred=1;
+            ssd->power_cap_host_defer++;
+        }
+    }
+}
+
+/*************************************************************************************
+ *判断chip能否接收一个写子请求：chip空闲，或者支持cache program并且cache register已经空闲，两种情况都要经过功耗预算
+ **************************************************************************************/
+int chip_write_ready(struct ssd_info *ssd,unsigned int channel,unsigned int chip)
+{
+    if(!((ssd->channel_head[channel].chip_head[chip].current_state==CHIP_IDLE)||((ssd->channel_head[channel].chip_head[chip].next_state==CHIP_IDLE)&&(ssd->channel_head[channel].chip_head[chip].next_state_predict_time<=ssd->current_time)))
+            &&!(((ssd->parameter->advanced_commands&AD_CACHE)==AD_CACHE)&&(ssd->channel_head[channel].chip_head[chip].current_state==CHIP_CACHE_WRITE_BUSY)
+            &&(ssd->channel_head[channel].chip_head[chip].cache_reg_free_time<=ssd->current_time)))
+    {
+        return FALSE;
+    }
+    if(power_budget_admit(ssd,CHIP_WRITE_BUSY,FALSE)==FALSE)
+    {
+        power_budget_defer_write(ssd,channel,chip);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*****************************************************************************************************
+ *DFTL中translation page的写回、translation block gc的读写和擦除不属于任何请求，记在chip的pending计数上。
+ *每次process之后，在channel和chip都空闲时为每个channel执行一个这样的操作，像gc一样直接占用channel和chip，
+ *读优先，写和擦除要经过功耗预算
+ ******************************************************************************************************/
+Status dftl_flush(struct ssd_info *ssd)
+{
+    unsigned int i,j,page_size;
+    int64_t bus_time=0,array_time=0;
+    int state=0;
+    struct chip_info *p_chip=NULL;
+
+    if (ssd->dram->map->dftl==NULL)
+    {
+        return SUCCESS;
+    }
+
+    page_size=ssd->parameter->subpage_page*ssd->parameter->subpage_capacity;
+    for (i=0;i<ssd->parameter->channel_number;i++)
+    {
+        if ((ssd->channel_head[i].current_state!=CHANNEL_IDLE)&&!((ssd->channel_head[i].next_state==CHANNEL_IDLE)&&(ssd->channel_head[i].next_state_predict_time<=ssd->current_time)))
+        {
+            continue;
+        }
+        for (j=0;j<ssd->parameter->chip_channel[i];j++)
+        {
+            p_chip=&ssd->channel_head[i].chip_head[j];
+            if ((p_chip->map_read_pending==0)&&(p_chip->map_write_pending==0)&&(p_chip->map_erase_pending==0))
+            {
+                continue;
+            }
+            if ((p_chip->current_state!=CHIP_IDLE)&&!((p_chip->next_state==CHIP_IDLE)&&(p_chip->next_state_predict_time<=ssd->current_time)))
+            {
+                continue;
+            }
+
+            if (p_chip->map_read_pending>0)
+            {
+                p_chip->map_read_pending--;
+                state=CHIP_READ_BUSY;
+                bus_time=bus_ca_time(ssd,7)+bus_data_out_time(ssd,page_size);
+                array_time=ssd->parameter->time_characteristics.tR;
+                ssd->read_count++;
+                ssd->in_read_size+=ssd->parameter->subpage_page;
+                ssd->channel_head[i].read_count++;
+                p_chip->read_count++;
+            }
+            else if (p_chip->map_write_pending>0)
+            {
+                if (power_budget_admit(ssd,CHIP_WRITE_BUSY,FALSE)==FALSE)
+                {
+                    continue;
+                }
+                p_chip->map_write_pending--;
+                state=CHIP_WRITE_BUSY;
+                bus_time=bus_ca_time(ssd,7)+bus_data_in_time(ssd,page_size);
+                array_time=ssd->parameter->time_characteristics.tPROG;
+                ssd->program_count++;
+                ssd->in_program_size+=ssd->parameter->subpage_page;
+                ssd->channel_head[i].program_count++;
+                p_chip->program_count++;
+            }
+            else
+            {
+                if (power_budget_admit(ssd,CHIP_ERASE_BUSY,FALSE)==FALSE)
+                {
+                    continue;
+                }
+                p_chip->map_erase_pending--;                                           /*擦除次数在dftl_gc中已经统计*/
+                state=CHIP_ERASE_BUSY;
+                bus_time=bus_ca_time(ssd,5);
+                array_time=ssd->parameter->time_characteristics.tBERS;
+            }
+
+            ssd->channel_head[i].current_state=CHANNEL_TRANSFER;
+            ssd->channel_head[i].current_time=ssd->current_time;
+            ssd->channel_head[i].next_state=CHANNEL_IDLE;
+            ssd->channel_head[i].next_state_predict_time=ssd->current_time+bus_time;
+            p_chip->current_state=state;
+            p_chip->current_time=ssd->current_time;
+            p_chip->next_state=CHIP_IDLE;
+            p_chip->next_state_predict_time=ssd->current_time+bus_time+array_time;
+            if (state!=CHIP_READ_BUSY)
+            {
+                power_budget_start(ssd);
+            }
+            break;                                                                     /*channel已经被占用*/
+        }
+    }
 
     return SUCCESS;
 }
 
+/******************************************************************************************
+ *cache read时，在sub的数据从cache register传出之前，在同一个chip上寻找下一个等待的读子请求，
+ *它的阵列读可以与sub的数据传出重叠。只选择sub同一个die上，地址寄存器空闲的plane上的子请求
+ *******************************************************************************************/
+struct sub_request * find_cache_read_sub_request(struct ssd_info * ssd, unsigned int channel, struct sub_request * sub)
+{
+    struct sub_request * p=NULL;
+    struct local * location=NULL;
+
+    p=ssd->channel_head[channel].subs_r_head;
+    while(p!=NULL)
+    {
+        location=p->location;
+        if((p!=sub)&&(p->current_state==SR_WAIT)&&(sub_map_ready(ssd,p)==TRUE)&&(location->chip==sub->location->chip)&&(location->die==sub->location->die))
+        {
+            if((location->plane==sub->location->plane)||(ssd->channel_head[channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].add_reg_ppn==-1))
+            {
+                return p;
+            }
+        }
+        p=p->next_node;
+    }
+    return NULL;
+}
+
 /********************
   写子请求的处理函数 | Write handler for the subrequest
  *********************/
@@ -1394,8 +3451,8 @@ Status services_2_write(struct ssd_info * ssd,unsigned int channel,unsigned int
 {
     int j=0,chip=0;
     unsigned int k=0;
-    unsigned int  old_ppn=0,new_ppn=0;
-    unsigned int chip_token=0,die_token=0,plane_token=0,address_ppn=0;
+    int64_t old_ppn=0,new_ppn=0,address_ppn=0;
+    unsigned int chip_token=0,die_token=0,plane_token=0;
     unsigned int  die=0,plane=0;
     long long time=0;
     struct sub_request * sub=NULL, * p=NULL;
@@ -1422,7 +3479,7 @@ Status services_2_write(struct ssd_info * ssd,unsigned int channel,unsigned int
                 chip_token=ssd->channel_head[channel].token;                            /*令牌*/
                 if (*channel_busy_flag==0)
                 {
-                    if((ssd->channel_head[channel].chip_head[chip_token].current_state==CHIP_IDLE)||((ssd->channel_head[channel].chip_head[chip_token].next_state==CHIP_IDLE)&&(ssd->channel_head[channel].chip_head[chip_token].next_state_predict_time<=ssd->current_time)))				
+                    if(chip_write_ready(ssd,channel,chip_token)==TRUE)				
                     {
                         if((ssd->channel_head[channel].subs_w_head==NULL)&&(ssd->subs_w_head==NULL)) 
                         {
@@ -1491,7 +3548,7 @@ Status services_2_write(struct ssd_info * ssd,unsigned int channel,unsigned int
         {
             for(chip=0;chip<ssd->channel_head[channel].chip;chip++)					
             {	
-                if((ssd->channel_head[channel].chip_head[chip].current_state==CHIP_IDLE)||((ssd->channel_head[channel].chip_head[chip].next_state==CHIP_IDLE)&&(ssd->channel_head[channel].chip_head[chip].next_state_predict_time<=ssd->current_time)))				
+                if(chip_write_ready(ssd,channel,chip)==TRUE)				
                 {		
                     if(ssd->channel_head[channel].subs_w_head==NULL)
                     {
@@ -1587,7 +3644,8 @@ struct ssd_info *process(struct ssd_info *ssd)
      *Chg_cur_time_flag is used as a flag to adjust the current time. When the request is blocked because the channel is busy, the current time needs to be adjusted.
      *Initially think that adjustment is needed, set to 1. When any channel processes the transfer command or data, this value is set to 0, indicating that no adjustment is needed;
      **********************************************************************************************************/
-    int old_ppn=-1,flag_die=-1; 
+    int64_t old_ppn=-1;
+    int flag_die=-1; 
     unsigned int i,chan,random_num;     
     unsigned int flag=0,new_write=0,chg_cur_time_flag=1,flag2=0,flag_gc=0;       
     int64_t time, channel_time=MAX_INT64;
@@ -2638,7 +4696,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                  * That is, the corresponding horizontal position in palneA is available, and it is the corresponding page in planeB.
                  * Then let the pages in planeA and active_blockB move closer to pageB
                  ********************************************************************************/
-                if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[active_blockB].page_head[pageB].free_state==PG_SUB)    
+                if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[active_blockB],pageB)->free_state==PG_SUB)    
                 {
                     make_same_level(ssd,channel,chip,die,planeA,active_blockB,pageB);
                     flash_page_state_modify(ssd,subA,channel,chip,die,planeA,active_blockB,pageB);
@@ -2650,7 +4708,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                  *********************************************************************************/
                 else    
                 {
-                    for (i=0;i<ssd->parameter->block_plane;i++)
+                    for (i=0;i<data_block_plane(ssd);i++)
                     {
                         pageA=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[i].last_write_page+1;
                         pageB=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[i].last_write_page+1;
@@ -2658,7 +4716,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                         {
                             if (pageA<pageB)
                             {
-                                if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[i].page_head[pageB].free_state==PG_SUB)
+                                if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[i],pageB)->free_state==PG_SUB)
                                 {
                                     aim_page=pageB;
                                     make_same_level(ssd,channel,chip,die,planeA,i,aim_page);
@@ -2667,7 +4725,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                             } 
                             else
                             {
-                                if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[i].page_head[pageA].free_state==PG_SUB)
+                                if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[i],pageA)->free_state==PG_SUB)
                                 {
                                     aim_page=pageA;
                                     make_same_level(ssd,channel,chip,die,planeB,i,aim_page);
@@ -2675,8 +4733,8 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                                 }
                             }
                         }
-                    }//for (i=0;i<ssd->parameter->block_plane;i++)
-                    if (i<ssd->parameter->block_plane)
+                    }//for (i=0;i<data_block_plane(ssd);i++)
+                    if (i<data_block_plane(ssd))
                     {
                         flash_page_state_modify(ssd,subA,channel,chip,die,planeA,i,aim_page);
                         flash_page_state_modify(ssd,subB,channel,chip,die,planeB,i,aim_page);
@@ -2702,7 +4760,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
         {
             if (ssd->parameter->greed_MPW_ad==1)     
             {
-                if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[active_blockA].page_head[pageA].free_state==PG_SUB)
+                if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[active_blockA],pageA)->free_state==PG_SUB)
                 {
                     make_same_level(ssd,channel,chip,die,planeB,active_blockA,pageA);
                     flash_page_state_modify(ssd,subA,channel,chip,die,planeA,active_blockA,pageA);
@@ -2710,7 +4768,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                 }
                 else    
                 {
-                    for (i=0;i<ssd->parameter->block_plane;i++)
+                    for (i=0;i<data_block_plane(ssd);i++)
                     {
                         pageA=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[i].last_write_page+1;
                         pageB=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[i].last_write_page+1;
@@ -2718,7 +4776,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                         {
                             if (pageA<pageB)
                             {
-                                if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[i].page_head[pageB].free_state==PG_SUB)
+                                if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[i],pageB)->free_state==PG_SUB)
                                 {
                                     aim_page=pageB;
                                     make_same_level(ssd,channel,chip,die,planeA,i,aim_page);
@@ -2727,7 +4785,7 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                             } 
                             else
                             {
-                                if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[i].page_head[pageA].free_state==PG_SUB)
+                                if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[i],pageA)->free_state==PG_SUB)
                                 {
                                     aim_page=pageA;
                                     make_same_level(ssd,channel,chip,die,planeB,i,aim_page);
@@ -2735,8 +4793,8 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                                 }
                             }
                         }
-                    }//for (i=0;i<ssd->parameter->block_plane;i++)
-                    if (i<ssd->parameter->block_plane)
+                    }//for (i=0;i<data_block_plane(ssd);i++)
+                    if (i<data_block_plane(ssd))
                     {
                         flash_page_state_modify(ssd,subA,channel,chip,die,planeA,i,aim_page);
                         flash_page_state_modify(ssd,subB,channel,chip,die,planeB,i,aim_page);
@@ -2759,14 +4817,14 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
                      *1，planeA，planeB中的active_blockA，pageA位置都可用，那么不同plane 的相同位置，以blockA为准
                      *2，planeA，planeB中的active_blockB，pageA位置都可用，那么不同plane 的相同位置，以blockB为准
                      ********************************************************************************************/
-                    if ((ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[active_blockA].page_head[pageA].free_state==PG_SUB)
-                            &&(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[active_blockA].page_head[pageA].free_state==PG_SUB))
+                    if ((get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[active_blockA],pageA)->free_state==PG_SUB)
+                            &&(get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[active_blockA],pageA)->free_state==PG_SUB))
                     {
                         flash_page_state_modify(ssd,subA,channel,chip,die,planeA,active_blockA,pageA);
                         flash_page_state_modify(ssd,subB,channel,chip,die,planeB,active_blockA,pageA);
                     }
-                    else if ((ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[active_blockB].page_head[pageA].free_state==PG_SUB)
-                            &&(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[active_blockB].page_head[pageA].free_state==PG_SUB))
+                    else if ((get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeA].blk_head[active_blockB],pageA)->free_state==PG_SUB)
+                            &&(get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[planeB].blk_head[active_blockB],pageA)->free_state==PG_SUB))
                     {
                         flash_page_state_modify(ssd,subA,channel,chip,die,planeA,active_blockB,pageA);
                         flash_page_state_modify(ssd,subB,channel,chip,die,planeB,active_blockB,pageA);
@@ -2865,11 +4923,12 @@ Status find_level_page(struct ssd_info *ssd,unsigned int channel,unsigned int ch
  */
 struct ssd_info *flash_page_state_modify(struct ssd_info *ssd,struct sub_request *sub,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page)
 {
-    unsigned int ppn,full_page;
+    int64_t ppn;
+    subpage_mask full_page;
     struct local *location;
     struct direct_erase *new_direct_erase,*direct_erase_node;
 
-    full_page=~(0xffffffff<<ssd->parameter->subpage_page);
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].last_write_page=page;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].free_page_num--;
 
@@ -2879,22 +4938,23 @@ struct ssd_info *flash_page_state_modify(struct ssd_info *ssd,struct sub_request
         while(1){}
     }
 
-    if(ssd->dram->map->map_entry[sub->lpn].state==0)                                          /*this is the first logical page*/
+    if(get_entry(ssd,sub->lpn)->state==0)                                          /*this is the first logical page*/
     {
-        ssd->dram->map->map_entry[sub->lpn].pn=find_ppn(ssd,channel,chip,die,plane,block,page);
-        ssd->dram->map->map_entry[sub->lpn].state=sub->state;
+        get_entry(ssd,sub->lpn)->pn=find_ppn(ssd,channel,chip,die,plane,block,page);
+        get_entry(ssd,sub->lpn)->state=sub->state;
+        get_entry(ssd,sub->lpn)->trimmed=0;
     }
     else                                                                                      /*This new logical page has been updated, and the original page needs to be invalidated*/
     {
-        ppn=ssd->dram->map->map_entry[sub->lpn].pn;
+        ppn=get_entry(ssd,sub->lpn)->pn;
         location=find_location(ssd,ppn);
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].valid_state=0;        //表示某一页失效，同时标记valid和free状态都为0
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].free_state=0;         //Indicates that a page is invalid, and both the valid and free states are marked as 0
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].lpn=0;
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page=0;
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state=0;        //表示某一页失效，同时标记valid和free状态都为0
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->free_state=0;         //Indicates that a page is invalid, and both the valid and free states are marked as 0
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->lpn=0;
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page=0;
         ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].cached_pages_num--;  //changes_1
         ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].invalid_page_num++;
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page=0;        //表示某一页失效，同时标记valid和free状态都为0
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page=0;        //表示某一页失效，同时标记valid和free状态都为0
 
         if (ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].invalid_page_num == ssd->parameter->page_block)    //All invalid pages in this block can be deleted directly
         {
@@ -2917,11 +4977,11 @@ struct ssd_info *flash_page_state_modify(struct ssd_info *ssd,struct sub_request
         }
         free(location);
         location=NULL;
-        ssd->dram->map->map_entry[sub->lpn].pn=find_ppn(ssd,channel,chip,die,plane,block,page);
-        ssd->dram->map->map_entry[sub->lpn].state=(ssd->dram->map->map_entry[sub->lpn].state|sub->state);
+        get_entry(ssd,sub->lpn)->pn=find_ppn(ssd,channel,chip,die,plane,block,page);
+        get_entry(ssd,sub->lpn)->state=(get_entry(ssd,sub->lpn)->state|sub->state);
     }
 
-    sub->ppn=ssd->dram->map->map_entry[sub->lpn].pn;
+    sub->ppn=get_entry(ssd,sub->lpn)->pn;
     sub->location->channel=channel;
     sub->location->chip=chip;
     sub->location->die=die;
@@ -2934,10 +4994,10 @@ struct ssd_info *flash_page_state_modify(struct ssd_info *ssd,struct sub_request
     ssd->channel_head[channel].program_count++;
     ssd->channel_head[channel].chip_head[chip].program_count++;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page--;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page].lpn=sub->lpn;	
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page].valid_state=sub->state;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page].cached_page=sub->state;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page].free_state=((~(sub->state))&full_page);
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page)->lpn=sub->lpn;	
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page)->valid_state=sub->state;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page)->cached_page=sub->state;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page)->free_state=((~(sub->state))&full_page);
     ssd->write_flash_count++;
 
     return ssd;
@@ -2956,10 +5016,10 @@ struct ssd_info *make_same_level(struct ssd_info *ssd,unsigned int channel,unsig
     step=aim_page-page;
     while (i<step)
     {
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page+i].valid_state=0;     /*表示某一页失效，同时标记valid和free状态都为0*/
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page+i].free_state=0;      /*表示某一页失效，同时标记valid和free状态都为0*/
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page+i].lpn=0;
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[page+i].cached_page=0;
+        get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page+i)->valid_state=0;     /*表示某一页失效，同时标记valid和free状态都为0*/
+        get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page+i)->free_state=0;      /*表示某一页失效，同时标记valid和free状态都为0*/
+        get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page+i)->lpn=0;
+        get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],page+i)->cached_page=0;
         ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].invalid_page_num++;
         ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].free_page_num--;
         ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page--;
@@ -3020,8 +5080,9 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
                 subs[i]->current_state=SR_W_TRANSFER;
                 subs[i]->current_time=ssd->current_time;
                 subs[i]->next_state=SR_COMPLETE;
-                subs[i]->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(subs[i]->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                subs[i]->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,subs[i]->size*ssd->parameter->subpage_capacity);
                 subs[i]->complete_time=subs[i]->next_state_predict_time;
+                sub_request_complete(ssd,subs[i]);
 
                 delete_from_channel(ssd,channel,subs[i]);
             }
@@ -3031,10 +5092,7 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=last_sub->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;	
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
     }
     else if(command==TWO_PLANE)
     {
@@ -3054,8 +5112,9 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
                 }
 
                 subs[i]->next_state=SR_COMPLETE;
-                subs[i]->next_state_predict_time=subs[i]->current_time+7*ssd->parameter->time_characteristics.tWC+(subs[i]->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                subs[i]->next_state_predict_time=subs[i]->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,subs[i]->size*ssd->parameter->subpage_capacity);
                 subs[i]->complete_time=subs[i]->next_state_predict_time;
+                sub_request_complete(ssd,subs[i]);
                 last_sub=subs[i];
 
                 delete_from_channel(ssd,channel,subs[i]);
@@ -3066,10 +5125,7 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=last_sub->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
     }
     else if(command==INTERLEAVE)
     {
@@ -3088,8 +5144,9 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
                     subs[i]->current_time=last_sub->complete_time;
                 }
                 subs[i]->next_state=SR_COMPLETE;
-                subs[i]->next_state_predict_time=subs[i]->current_time+7*ssd->parameter->time_characteristics.tWC+(subs[i]->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                subs[i]->next_state_predict_time=subs[i]->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,subs[i]->size*ssd->parameter->subpage_capacity);
                 subs[i]->complete_time=subs[i]->next_state_predict_time;
+                sub_request_complete(ssd,subs[i]);
                 last_sub=subs[i];
 
                 delete_from_channel(ssd,channel,subs[i]);
@@ -3100,18 +5157,16 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=last_sub->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
     }
     else if(command==NORMAL)
     {
         subs[0]->current_state=SR_W_TRANSFER;
         subs[0]->current_time=ssd->current_time;
         subs[0]->next_state=SR_COMPLETE;
-        subs[0]->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(subs[0]->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        subs[0]->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,subs[0]->size*ssd->parameter->subpage_capacity);
         subs[0]->complete_time=subs[0]->next_state_predict_time;
+        sub_request_complete(ssd,subs[0]);
 
         delete_from_channel(ssd,channel,subs[0]);
 
@@ -3120,10 +5175,7 @@ struct ssd_info *compute_serve_time(struct ssd_info *ssd,unsigned int channel,un
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=subs[0]->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
     }
     else
     {
@@ -3244,13 +5296,14 @@ struct ssd_info *delete_from_channel(struct ssd_info *ssd,unsigned int channel,s
 
 struct ssd_info *un_greed_interleave_copyback(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,struct sub_request *sub1,struct sub_request *sub2)
 {
-    unsigned int old_ppn1,ppn1,old_ppn2,ppn2,greed_flag=0;
+    int64_t old_ppn1,ppn1,old_ppn2,ppn2;
+    unsigned int greed_flag=0;
 
-    old_ppn1=ssd->dram->map->map_entry[sub1->lpn].pn;
+    old_ppn1=get_entry(ssd,sub1->lpn)->pn;
     get_ppn(ssd,channel,chip,die,sub1->location->plane,sub1);                                  /*找出来的ppn一定是发生在与子请求相同的plane中,才能使用copyback操作*/
     ppn1=sub1->ppn;
 
-    old_ppn2=ssd->dram->map->map_entry[sub2->lpn].pn;
+    old_ppn2=get_entry(ssd,sub2->lpn)->pn;
     get_ppn(ssd,channel,chip,die,sub2->location->plane,sub2);                                  /*找出来的ppn一定是发生在与子请求相同的plane中,才能使用copyback操作*/
     ppn2=sub2->ppn;
 
@@ -3262,24 +5315,23 @@ struct ssd_info *un_greed_interleave_copyback(struct ssd_info *ssd,unsigned int
         sub1->current_state=SR_W_TRANSFER;
         sub1->current_time=ssd->current_time;
         sub1->next_state=SR_COMPLETE;
-        sub1->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub1->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub1->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub1->size*ssd->parameter->subpage_capacity);
         sub1->complete_time=sub1->next_state_predict_time;
+        sub_request_complete(ssd,sub1);
 
         sub2->current_state=SR_W_TRANSFER;
         sub2->current_time=sub1->complete_time;
         sub2->next_state=SR_COMPLETE;
-        sub2->next_state_predict_time=sub2->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub2->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub2->next_state_predict_time=sub2->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub2->size*ssd->parameter->subpage_capacity);
         sub2->complete_time=sub2->next_state_predict_time;
+        sub_request_complete(ssd,sub2);
 
         ssd->channel_head[channel].current_state=CHANNEL_TRANSFER;										
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=sub2->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
 
         delete_from_channel(ssd,channel,sub1);
         delete_from_channel(ssd,channel,sub2);
@@ -3292,18 +5344,16 @@ struct ssd_info *un_greed_interleave_copyback(struct ssd_info *ssd,unsigned int
         sub1->current_state=SR_W_TRANSFER;
         sub1->current_time=ssd->current_time;
         sub1->next_state=SR_COMPLETE;
-        sub1->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub1->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub1->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub1->size*ssd->parameter->subpage_capacity);
         sub1->complete_time=sub1->next_state_predict_time;
+        sub_request_complete(ssd,sub1);
 
         ssd->channel_head[channel].current_state=CHANNEL_TRANSFER;										
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=sub1->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
 
         delete_from_channel(ssd,channel,sub1);
     }//else if ((old_ppn1%2==ppn1%2)&&(old_ppn2%2!=ppn2%2))
@@ -3315,18 +5365,16 @@ struct ssd_info *un_greed_interleave_copyback(struct ssd_info *ssd,unsigned int
         sub2->current_state=SR_W_TRANSFER;
         sub2->current_time=ssd->current_time;
         sub2->next_state=SR_COMPLETE;
-        sub2->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub2->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub2->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub2->size*ssd->parameter->subpage_capacity);
         sub2->complete_time=sub2->next_state_predict_time;
+        sub_request_complete(ssd,sub2);
 
         ssd->channel_head[channel].current_state=CHANNEL_TRANSFER;										
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=sub2->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
 
         delete_from_channel(ssd,channel,sub2);
     }//else if ((old_ppn1%2!=ppn1%2)&&(old_ppn2%2==ppn2%2))
@@ -3337,18 +5385,16 @@ struct ssd_info *un_greed_interleave_copyback(struct ssd_info *ssd,unsigned int
         sub1->current_state=SR_W_TRANSFER;
         sub1->current_time=ssd->current_time;
         sub1->next_state=SR_COMPLETE;
-        sub1->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+2*(ssd->parameter->subpage_page*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub1->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+2*bus_data_in_time(ssd,ssd->parameter->subpage_page*ssd->parameter->subpage_capacity);
         sub1->complete_time=sub1->next_state_predict_time;
+        sub_request_complete(ssd,sub1);
 
         ssd->channel_head[channel].current_state=CHANNEL_TRANSFER;										
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=sub1->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
 
         delete_from_channel(ssd,channel,sub1);
     }//else
@@ -3359,9 +5405,9 @@ struct ssd_info *un_greed_interleave_copyback(struct ssd_info *ssd,unsigned int
 
 struct ssd_info *un_greed_copyback(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,struct sub_request *sub1)
 {
-    unsigned int old_ppn,ppn;
+    int64_t old_ppn,ppn;
 
-    old_ppn=ssd->dram->map->map_entry[sub1->lpn].pn;
+    old_ppn=get_entry(ssd,sub1->lpn)->pn;
     get_ppn(ssd,channel,chip,die,0,sub1);                                                     /*找出来的ppn一定是发生在与子请求相同的plane中,才能使用copyback操作*/
     ppn=sub1->ppn;
 
@@ -3371,36 +5417,32 @@ struct ssd_info *un_greed_copyback(struct ssd_info *ssd,unsigned int channel,uns
         sub1->current_state=SR_W_TRANSFER;
         sub1->current_time=ssd->current_time;
         sub1->next_state=SR_COMPLETE;
-        sub1->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(sub1->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub1->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+bus_data_in_time(ssd,sub1->size*ssd->parameter->subpage_capacity);
         sub1->complete_time=sub1->next_state_predict_time;
+        sub_request_complete(ssd,sub1);
 
         ssd->channel_head[channel].current_state=CHANNEL_TRANSFER;										
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=sub1->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
     }//if (old_ppn%2==ppn%2)
     else
     {
         sub1->current_state=SR_W_TRANSFER;
         sub1->current_time=ssd->current_time;
         sub1->next_state=SR_COMPLETE;
-        sub1->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+2*(ssd->parameter->subpage_page*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+        sub1->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14)+ssd->parameter->time_characteristics.tR+2*bus_data_in_time(ssd,ssd->parameter->subpage_page*ssd->parameter->subpage_capacity);
         sub1->complete_time=sub1->next_state_predict_time;
+        sub_request_complete(ssd,sub1);
 
         ssd->channel_head[channel].current_state=CHANNEL_TRANSFER;										
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;										
         ssd->channel_head[channel].next_state_predict_time=sub1->complete_time;
 
-        ssd->channel_head[channel].chip_head[chip].current_state=CHIP_WRITE_BUSY;										
-        ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;									
-        ssd->channel_head[channel].chip_head[chip].next_state=CHIP_IDLE;										
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
+        chip_program_state(ssd,channel,chip,ssd->channel_head[channel].next_state_predict_time);
     }//else
 
     delete_from_channel(ssd,channel,sub1);
@@ -3417,7 +5459,7 @@ struct sub_request *find_interleave_twoplane_page(struct ssd_info *ssd, struct s
 {
     struct sub_request *two_page;
 
-    if (one_page->current_state!=SR_WAIT)
+    if ((one_page->current_state!=SR_WAIT)||(sub_map_ready(ssd,one_page)==FALSE))
     {
         return NULL;                                                            
     }
@@ -3429,7 +5471,7 @@ struct sub_request *find_interleave_twoplane_page(struct ssd_info *ssd, struct s
         {
             while (two_page!=NULL)
             {
-                if (two_page->current_state!=SR_WAIT)
+                if ((two_page->current_state!=SR_WAIT)||(sub_map_ready(ssd,two_page)==FALSE))
                 {
                     two_page=two_page->next_node;
                 }
@@ -3458,7 +5500,7 @@ struct sub_request *find_interleave_twoplane_page(struct ssd_info *ssd, struct s
         {
             while (two_page!=NULL)
             {
-                if (two_page->current_state!=SR_WAIT)
+                if ((two_page->current_state!=SR_WAIT)||(sub_map_ready(ssd,two_page)==FALSE))
                 {
                     two_page=two_page->next_node;
                 }
@@ -3549,6 +5591,7 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
     struct sub_request * sub=NULL ; 
     struct sub_request * sub_twoplane_one=NULL, * sub_twoplane_two=NULL;
     struct sub_request * sub_interleave_one=NULL, * sub_interleave_two=NULL;
+    struct sub_request * sub_cache=NULL;
     struct local * location=NULL;
     if(sub1==NULL)
     {
@@ -3590,10 +5633,11 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                      *这个状态与channel，chip有关，所以要修改channel，chip的状态分别为CHANNEL_C_A_TRANSFER，CHIP_C_A_TRANSFER
                      *下一状态分别为CHANNEL_IDLE，CHIP_READ_BUSY
                      *******************************************************************************************************/
+                    subs_r_issue(ssd,sub);
                     sub->current_time=ssd->current_time;									
                     sub->current_state=SR_R_C_A_TRANSFER;									
                     sub->next_state=SR_R_READ;									
-                    sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC;
+                    sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7);
                     sub->begin_time=ssd->current_time;
 
                     ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].add_reg_ppn=sub->ppn;
@@ -3603,12 +5647,12 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     ssd->channel_head[location->channel].current_state=CHANNEL_C_A_TRANSFER;									
                     ssd->channel_head[location->channel].current_time=ssd->current_time;										
                     ssd->channel_head[location->channel].next_state=CHANNEL_IDLE;								
-                    ssd->channel_head[location->channel].next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC;
+                    ssd->channel_head[location->channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7);
 
                     ssd->channel_head[location->channel].chip_head[location->chip].current_state=CHIP_C_A_TRANSFER;								
                     ssd->channel_head[location->channel].chip_head[location->chip].current_time=ssd->current_time;						
                     ssd->channel_head[location->channel].chip_head[location->chip].next_state=CHIP_READ_BUSY;							
-                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC;
+                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7);
 
                     break;
 
@@ -3623,8 +5667,9 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     sub->current_time=ssd->current_time;					
                     sub->current_state=SR_R_DATA_TRANSFER;		
                     sub->next_state=SR_COMPLETE;				
-                    sub->next_state_predict_time=ssd->current_time+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tRC;			
+                    sub->next_state_predict_time=ssd->current_time+bus_data_out_time(ssd,sub->size*ssd->parameter->subpage_capacity);			
                     sub->complete_time=sub->next_state_predict_time;
+                    sub_request_complete(ssd,sub);
 
                     ssd->channel_head[location->channel].current_state=CHANNEL_DATA_TRANSFER;		
                     ssd->channel_head[location->channel].current_time=ssd->current_time;		
@@ -3638,6 +5683,16 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
 
                     ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].add_reg_ppn=-1;
 
+                    /*支持cache read时，数据传出的同时可以在同一个chip上开始下一页的阵列读*/
+                    if ((ssd->parameter->advanced_commands&AD_CACHE)==AD_CACHE)
+                    {
+                        sub_cache=find_cache_read_sub_request(ssd,location->channel,sub);
+                        if (sub_cache!=NULL)
+                        {
+                            go_one_step(ssd,sub,sub_cache,SR_R_READ,CACHE_READ);
+                        }
+                    }
+
                     break;
                 }
             case SR_W_TRANSFER:
@@ -3652,8 +5707,9 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     sub->current_time=ssd->current_time;
                     sub->current_state=SR_W_TRANSFER;
                     sub->next_state=SR_COMPLETE;
-                    sub->next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+(sub->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tWC;
+                    sub->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+bus_data_in_time(ssd,sub->size*ssd->parameter->subpage_capacity);
                     sub->complete_time=sub->next_state_predict_time;		
+                    sub_request_complete(ssd,sub);
                     time=sub->complete_time;
 
                     ssd->channel_head[location->channel].current_state=CHANNEL_TRANSFER;										
@@ -3661,10 +5717,7 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     ssd->channel_head[location->channel].next_state=CHANNEL_IDLE;										
                     ssd->channel_head[location->channel].next_state_predict_time=time;
 
-                    ssd->channel_head[location->channel].chip_head[location->chip].current_state=CHIP_WRITE_BUSY;										
-                    ssd->channel_head[location->channel].chip_head[location->chip].current_time=ssd->current_time;									
-                    ssd->channel_head[location->channel].chip_head[location->chip].next_state=CHIP_IDLE;										
-                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=time+ssd->parameter->time_characteristics.tPROG;
+                    chip_program_state(ssd,location->channel,location->chip,time);
 
                     break;
                 }
@@ -3692,9 +5745,10 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
             case SR_R_C_A_TRANSFER:
                 {
                     sub_twoplane_one->current_time=ssd->current_time;									
+                    subs_r_issue(ssd,sub_twoplane_one);
                     sub_twoplane_one->current_state=SR_R_C_A_TRANSFER;									
                     sub_twoplane_one->next_state=SR_R_READ;									
-                    sub_twoplane_one->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;									
+                    sub_twoplane_one->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);									
                     sub_twoplane_one->begin_time=ssd->current_time;
 
                     ssd->channel_head[sub_twoplane_one->location->channel].chip_head[sub_twoplane_one->location->chip].die_head[sub_twoplane_one->location->die].plane_head[sub_twoplane_one->location->plane].add_reg_ppn=sub_twoplane_one->ppn;
@@ -3702,6 +5756,7 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     ssd->in_read_size+=ssd->parameter->subpage_page;
 
                     sub_twoplane_two->current_time=ssd->current_time;									
+                    subs_r_issue(ssd,sub_twoplane_two);
                     sub_twoplane_two->current_state=SR_R_C_A_TRANSFER;									
                     sub_twoplane_two->next_state=SR_R_READ;									
                     sub_twoplane_two->next_state_predict_time=sub_twoplane_one->next_state_predict_time;									
@@ -3715,12 +5770,12 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     ssd->channel_head[location->channel].current_state=CHANNEL_C_A_TRANSFER;									
                     ssd->channel_head[location->channel].current_time=ssd->current_time;										
                     ssd->channel_head[location->channel].next_state=CHANNEL_IDLE;								
-                    ssd->channel_head[location->channel].next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;
+                    ssd->channel_head[location->channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);
 
                     ssd->channel_head[location->channel].chip_head[location->chip].current_state=CHIP_C_A_TRANSFER;								
                     ssd->channel_head[location->channel].chip_head[location->chip].current_time=ssd->current_time;						
                     ssd->channel_head[location->channel].chip_head[location->chip].next_state=CHIP_READ_BUSY;							
-                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;
+                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);
 
 
                     break;
@@ -3730,14 +5785,16 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     sub_twoplane_one->current_time=ssd->current_time;					
                     sub_twoplane_one->current_state=SR_R_DATA_TRANSFER;		
                     sub_twoplane_one->next_state=SR_COMPLETE;				
-                    sub_twoplane_one->next_state_predict_time=ssd->current_time+(sub_twoplane_one->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tRC;			
+                    sub_twoplane_one->next_state_predict_time=ssd->current_time+bus_data_out_time(ssd,sub_twoplane_one->size*ssd->parameter->subpage_capacity);			
                     sub_twoplane_one->complete_time=sub_twoplane_one->next_state_predict_time;
+                    sub_request_complete(ssd,sub_twoplane_one);
 
                     sub_twoplane_two->current_time=sub_twoplane_one->next_state_predict_time;					
                     sub_twoplane_two->current_state=SR_R_DATA_TRANSFER;		
                     sub_twoplane_two->next_state=SR_COMPLETE;				
-                    sub_twoplane_two->next_state_predict_time=sub_twoplane_two->current_time+(sub_twoplane_two->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tRC;			
+                    sub_twoplane_two->next_state_predict_time=sub_twoplane_two->current_time+bus_data_out_time(ssd,sub_twoplane_two->size*ssd->parameter->subpage_capacity);			
                     sub_twoplane_two->complete_time=sub_twoplane_two->next_state_predict_time;
+                    sub_request_complete(ssd,sub_twoplane_two);
 
                     ssd->channel_head[location->channel].current_state=CHANNEL_DATA_TRANSFER;		
                     ssd->channel_head[location->channel].current_time=ssd->current_time;		
@@ -3771,9 +5828,10 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
             case SR_R_C_A_TRANSFER:
                 {
                     sub_interleave_one->current_time=ssd->current_time;									
+                    subs_r_issue(ssd,sub_interleave_one);
                     sub_interleave_one->current_state=SR_R_C_A_TRANSFER;									
                     sub_interleave_one->next_state=SR_R_READ;									
-                    sub_interleave_one->next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;									
+                    sub_interleave_one->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);									
                     sub_interleave_one->begin_time=ssd->current_time;
 
                     ssd->channel_head[sub_interleave_one->location->channel].chip_head[sub_interleave_one->location->chip].die_head[sub_interleave_one->location->die].plane_head[sub_interleave_one->location->plane].add_reg_ppn=sub_interleave_one->ppn;
@@ -3781,6 +5839,7 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     ssd->in_read_size+=ssd->parameter->subpage_page;
 
                     sub_interleave_two->current_time=ssd->current_time;									
+                    subs_r_issue(ssd,sub_interleave_two);
                     sub_interleave_two->current_state=SR_R_C_A_TRANSFER;									
                     sub_interleave_two->next_state=SR_R_READ;									
                     sub_interleave_two->next_state_predict_time=sub_interleave_one->next_state_predict_time;									
@@ -3794,12 +5853,12 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     ssd->channel_head[location->channel].current_state=CHANNEL_C_A_TRANSFER;									
                     ssd->channel_head[location->channel].current_time=ssd->current_time;										
                     ssd->channel_head[location->channel].next_state=CHANNEL_IDLE;								
-                    ssd->channel_head[location->channel].next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;
+                    ssd->channel_head[location->channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);
 
                     ssd->channel_head[location->channel].chip_head[location->chip].current_state=CHIP_C_A_TRANSFER;								
                     ssd->channel_head[location->channel].chip_head[location->chip].current_time=ssd->current_time;						
                     ssd->channel_head[location->channel].chip_head[location->chip].next_state=CHIP_READ_BUSY;							
-                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;
+                    ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);
 
                     break;
 
@@ -3809,14 +5868,16 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
                     sub_interleave_one->current_time=ssd->current_time;					
                     sub_interleave_one->current_state=SR_R_DATA_TRANSFER;		
                     sub_interleave_one->next_state=SR_COMPLETE;				
-                    sub_interleave_one->next_state_predict_time=ssd->current_time+(sub_interleave_one->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tRC;			
+                    sub_interleave_one->next_state_predict_time=ssd->current_time+bus_data_out_time(ssd,sub_interleave_one->size*ssd->parameter->subpage_capacity);			
                     sub_interleave_one->complete_time=sub_interleave_one->next_state_predict_time;
+                    sub_request_complete(ssd,sub_interleave_one);
 
                     sub_interleave_two->current_time=sub_interleave_one->next_state_predict_time;					
                     sub_interleave_two->current_state=SR_R_DATA_TRANSFER;		
                     sub_interleave_two->next_state=SR_COMPLETE;				
-                    sub_interleave_two->next_state_predict_time=sub_interleave_two->current_time+(sub_interleave_two->size*ssd->parameter->subpage_capacity)*ssd->parameter->time_characteristics.tRC;			
+                    sub_interleave_two->next_state_predict_time=sub_interleave_two->current_time+bus_data_out_time(ssd,sub_interleave_two->size*ssd->parameter->subpage_capacity);			
                     sub_interleave_two->complete_time=sub_interleave_two->next_state_predict_time;
+                    sub_request_complete(ssd,sub_interleave_two);
 
                     ssd->channel_head[location->channel].current_state=CHANNEL_DATA_TRANSFER;		
                     ssd->channel_head[location->channel].current_time=ssd->current_time;		
@@ -3835,6 +5896,49 @@ Status go_one_step(struct ssd_info * ssd, struct sub_request * sub1,struct sub_r
             default :  return ERROR;	
         }//switch(aim_state)				
     }//else if(command==INTERLEAVE)
+    else if(command==CACHE_READ)
+    {
+        /***********************************************************************************************
+         *cache read的处理，sub1的数据正在从cache register传出(SR_R_DATA_TRANSFER)，sub2是同一个chip上的下一页
+         *先在channel上发送cache read命令和地址，然后sub1的数据传出与sub2的阵列读(tR)同时进行
+         *chip的下一个状态是CHIP_DATA_TRANSFER，时间取sub1传输完成和sub2读完成中较晚的一个
+         ************************************************************************************************/
+        if((sub1==NULL)||(sub2==NULL)||(aim_state!=SR_R_READ))
+        {
+            return ERROR;
+        }
+        location=sub1->location;
+
+        sub1->next_state_predict_time=sub1->next_state_predict_time+bus_ca_time(ssd,7);
+        sub1->complete_time=sub1->next_state_predict_time;
+        sub_request_complete(ssd,sub1);
+
+        subs_r_issue(ssd,sub2);
+        sub2->current_time=ssd->current_time;
+        sub2->current_state=SR_R_READ;
+        sub2->next_state=SR_R_DATA_TRANSFER;
+        sub2->next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+ssd->parameter->time_characteristics.tR;
+        sub2->begin_time=ssd->current_time;
+
+        ssd->channel_head[sub2->location->channel].chip_head[sub2->location->chip].die_head[sub2->location->die].plane_head[sub2->location->plane].add_reg_ppn=sub2->ppn;
+        ssd->read_count++;
+        ssd->in_read_size+=ssd->parameter->subpage_page;
+        ssd->cache_read_count++;
+
+        ssd->channel_head[location->channel].next_state_predict_time=sub1->complete_time;
+
+        ssd->channel_head[location->channel].chip_head[location->chip].current_state=CHIP_CACHE_READ_BUSY;
+        ssd->channel_head[location->channel].chip_head[location->chip].current_time=ssd->current_time;
+        ssd->channel_head[location->channel].chip_head[location->chip].next_state=CHIP_DATA_TRANSFER;
+        if(sub2->next_state_predict_time>sub1->complete_time)
+        {
+            ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=sub2->next_state_predict_time;
+        }
+        else
+        {
+            ssd->channel_head[location->channel].chip_head[location->chip].next_state_predict_time=sub1->complete_time;
+        }
+    }//else if(command==CACHE_READ)
     else
     {
         printf("\nERROR: Unexpected command !\n" );
@@ -23,7 +23,21 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 #include "pagemap.h"
 
 struct ssd_info *process(struct ssd_info *);
-struct ssd_info *insert2buffer(struct ssd_info *,unsigned int,int,struct sub_request *,struct request *);
+struct ssd_info *insert2buffer(struct ssd_info *,int64_t,subpage_mask,struct sub_request *,struct request *);
+extern const struct buffer_policy buffer_policies[];
+
+struct buffer_group *buffer_find(struct buffer_info *buffer,int64_t lpn);
+struct buffer_group *buffer_add(struct buffer_info *buffer,int64_t lpn);
+void buffer_remove(struct buffer_info *buffer,struct buffer_group *buffer_node);
+void buffer_touch(struct buffer_info *buffer,struct buffer_group *buffer_node);
+struct buffer_group *buffer_victim(struct buffer_info *buffer,struct buffer_group *exclude);
+void buffer_evict(struct ssd_info *ssd,struct buffer_info *buffer,unsigned int need,struct buffer_group *exclude,struct sub_request *sub,struct request *req);
+struct ssd_info *trim2buffer(struct ssd_info *ssd,int64_t lpn,subpage_mask state);
+subpage_mask read_cache_lookup(struct ssd_info *ssd,struct request *req,int64_t lpn,subpage_mask need);
+void read_cache_fill(struct ssd_info *ssd,int64_t lpn,subpage_mask state,int prefetched);
+void read_cache_invalidate(struct ssd_info *ssd,int64_t lpn,subpage_mask state);
+void read_cache_complete(struct ssd_info *ssd,struct request *req);
+void read_cache_prefetch(struct ssd_info *ssd,struct request *req);
 
 struct ssd_info *flash_page_state_modify(struct ssd_info *,struct sub_request *,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int);
 struct ssd_info *make_same_level(struct ssd_info *,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int,unsigned int);
@@ -40,7 +54,7 @@ int find_twoplane_write_sub_request(struct ssd_info * ssd, unsigned int channel,
 int find_interleave_sub_request(struct ssd_info * ssd, unsigned int channel, struct sub_request * sub_interleave_one,struct sub_request * sub_interleave_two);
 struct sub_request * find_read_sub_request(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die);
 struct sub_request * find_write_sub_request(struct ssd_info * ssd, unsigned int channel);
-struct sub_request * creat_sub_request(struct ssd_info * ssd,unsigned int lpn,int size,unsigned int state,struct request * req,unsigned int operation);
+struct sub_request * creat_sub_request(struct ssd_info * ssd,int64_t lpn,int size,subpage_mask state,struct request * req,unsigned int operation);
 
 struct sub_request *find_interleave_twoplane_page(struct ssd_info *ssd, struct sub_request *onepage,unsigned int command);
 int find_interleave_twoplane_sub_request(struct ssd_info * ssd, unsigned int channel,struct sub_request * sub_request_one,struct sub_request * sub_request_two,unsigned int command);
@@ -49,7 +63,7 @@ struct ssd_info *delete_from_channel(struct ssd_info *ssd,unsigned int channel,s
 struct ssd_info *un_greed_interleave_copyback(struct ssd_info *,unsigned int,unsigned int,unsigned int,struct sub_request *,struct sub_request *);
 struct ssd_info *un_greed_copyback(struct ssd_info *,unsigned int,unsigned int,unsigned int,struct sub_request *);
 int  find_active_block(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane);
-int write_page(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int active_block,unsigned int *ppn);
+int write_page(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int active_block,int64_t *ppn);
 int allocate_location(struct ssd_info * ssd ,struct sub_request *sub_req);
 
 
@@ -60,8 +74,30 @@ int services_2_r_wait(struct ssd_info * ssd,unsigned int channel,unsigned int *
 int services_2_r_data_trans(struct ssd_info * ssd,unsigned int channel,unsigned int * channel_busy_flag, unsigned int * change_current_time_flag);
 int services_2_write(struct ssd_info * ssd,unsigned int channel,unsigned int * channel_busy_flag, unsigned int * change_current_time_flag);
 int delete_w_sub_request(struct ssd_info * ssd, unsigned int channel, struct sub_request * sub );
+void cancel_write_sub_request(struct ssd_info *ssd,int64_t first_lpn,int64_t last_lpn,subpage_mask state);
 int copy_back(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die,struct sub_request * sub);
 int static_write(struct ssd_info * ssd, unsigned int channel,unsigned int chip, unsigned int die,struct sub_request * sub);
+int64_t bus_ca_time(struct ssd_info *ssd,unsigned int cycles);
+int64_t bus_transfer_time(struct ssd_info *ssd,unsigned long long bytes,int legacy_cycle);
+int64_t bus_data_in_time(struct ssd_info *ssd,unsigned long long bytes);
+int64_t bus_data_out_time(struct ssd_info *ssd,unsigned long long bytes);
+int chip_program_state(struct ssd_info *ssd,unsigned int channel,unsigned int chip,int64_t transfer_end);
+int power_budget_admit(struct ssd_info *ssd,int op_state,int urgent);
+void power_budget_start(struct ssd_info *ssd);
+int chip_write_ready(struct ssd_info *ssd,unsigned int channel,unsigned int chip);
+int dftl_flush(struct ssd_info *ssd);
+Status buffer_flush(struct ssd_info *ssd);
+unsigned int buffer_sync(struct ssd_info *ssd,struct request *req);
+void buffer_fua(struct ssd_info *ssd,int64_t lpn,struct request *req);
+int64_t buffer_holdup(struct ssd_info *ssd,unsigned long *pages,double *energy);
+struct buffer_info *buffer_of(struct ssd_info *ssd,int64_t lpn);
+void buffer_summary(struct ssd_info *ssd,struct buffer_info *total);
+void buffer_gc_account(struct ssd_info *ssd,struct buffer_group *node);
+void buffer_gc_release(struct ssd_info *ssd,struct buffer_group *node);
+struct sub_request * creat_map_sub_request(struct ssd_info * ssd,int64_t ppn,struct request * req);
+void sub_request_complete(struct ssd_info * ssd,struct sub_request * sub);
+int sub_map_ready(struct ssd_info * ssd,struct sub_request * sub);
+struct sub_request * find_cache_read_sub_request(struct ssd_info * ssd, unsigned int channel, struct sub_request * sub);
 
 #endif
 
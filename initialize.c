@@ -79,8 +79,8 @@ struct ssd_info *initiation(struct ssd_info *ssd)
     //导入ssd的配置文件 | Import SSD configuration file
     parameters=load_parameters(ssd->parameterfilename);
     ssd->parameter=parameters;
-    ssd->min_lsn=0x7fffffff;    // 0b1111111111111111111111111111111 (32 bit, all 1)
-    ssd->page=ssd->parameter->chip_num*ssd->parameter->die_chip*ssd->parameter->plane_die*ssd->parameter->block_plane*ssd->parameter->page_block;
+    ssd->min_lsn=INT64_MAX;
+    ssd->page=(int64_t)ssd->parameter->chip_num*ssd->parameter->die_chip*ssd->parameter->plane_die*ssd->parameter->block_plane*ssd->parameter->page_block;
 
     //初始化 dram | initialize dram
     ssd->dram = (struct dram_info *)malloc(sizeof(struct dram_info));
@@ -93,6 +93,44 @@ struct ssd_info *initiation(struct ssd_info *ssd)
     alloc_assert(ssd->channel_head,"ssd->channel_head");
     memset(ssd->channel_head,0,ssd->parameter->channel_number * sizeof(struct channel_info));
     initialize_channels(ssd );
+    if (ssd->parameter->lazy_allocation==0)
+    {
+        metadata_account(ssd,ssd->page*sizeof(struct page_info));
+    }
+
+    //初始化子页映射表 | initialize the sector-granularity mapping table
+    if (ssd->parameter->subpage_mapping!=0)
+    {
+        initialize_subpage_map(ssd);
+    }
+
+    //初始化DFTL的CMT和translation block | initialize the cached mapping table and translation blocks of DFTL
+    if (ssd->parameter->mapping_cache!=0)
+    {
+        if (initialize_dftl(ssd)==NULL)
+        {
+            return NULL;
+        }
+    }
+
+    //把数据块按地址顺序放入各个plane的空闲块池 | fill the free block pool of each plane
+    initialize_free_blocks(ssd);
+
+    //初始化块映射和FAST的映射表，ZNS的zone | initialize the block map and log blocks of block/FAST mapping, or the zones of ZNS
+    if (ssd->parameter->address_mapping==ZNS_MAPPING)
+    {
+        if (initialize_zns(ssd)==NULL)
+        {
+            return NULL;
+        }
+    }
+    else if (ssd->parameter->address_mapping!=PAGE_MAPPING)
+    {
+        if (initialize_blockmap(ssd)==NULL)
+        {
+            return NULL;
+        }
+    }
 
     ssd->outputfile=fopen(ssd->outputfilename,"w");
     if(ssd->outputfile==NULL)
@@ -188,26 +226,455 @@ struct ssd_info *initiation(struct ssd_info *ssd)
 
 struct dram_info * initialize_dram(struct ssd_info * ssd)
 {
-    unsigned int page_num;
+    int64_t page_num;
+    unsigned int i;
+    unsigned long long buffer_sector;
 
     struct dram_info *dram=ssd->dram;
     dram->dram_capacity = ssd->parameter->dram_capacity;		
-    dram->buffer = (tAVLTree *)avlTreeCreate((void*)keyCompareFunc , (void *)freeFunc);
-    dram->buffer->max_buffer_sector=ssd->parameter->dram_capacity/SECTOR; //512
+    /*写buffer分区时容量平均分给各个分区，每个分区是一个独立的buffer*/
+    dram->partition_num = 1;
+    if (ssd->parameter->buffer_partition==BUFFER_PARTITION_CHANNEL)
+    {
+        dram->partition_num = ssd->parameter->channel_number;
+    }
+    else if (ssd->parameter->buffer_partition==BUFFER_PARTITION_HASH)
+    {
+        dram->partition_num = ssd->parameter->buffer_shards;
+    }
+    dram->partition = (struct buffer_info **)malloc(sizeof(struct buffer_info *) * dram->partition_num);
+    alloc_assert(dram->partition,"dram->partition");
+    buffer_sector = (ssd->parameter->dram_capacity-ssd->parameter->read_cache_size)/SECTOR; //512
+    for (i=0;i<dram->partition_num;i++)
+    {
+        dram->partition[i] = initialize_buffer(ssd,buffer_sector/dram->partition_num,ssd->parameter->buffer_management);
+    }
+    dram->buffer = dram->partition[0];
+    if (ssd->parameter->read_cache_size!=0)
+    {
+        dram->read_cache = initialize_buffer(ssd,ssd->parameter->read_cache_size/SECTOR,BUFFER_LRU);
+    }
+    if (ssd->parameter->prefetch_depth!=0)
+    {
+        dram->prefetch = (struct prefetch_info *)malloc(sizeof(struct prefetch_info));
+        alloc_assert(dram->prefetch,"dram->prefetch");
+        memset(dram->prefetch,0,sizeof(struct prefetch_info));
+        dram->prefetch->stream_count=ssd->parameter->prefetch_streams;
+        dram->prefetch->stream = (struct prefetch_stream *)malloc(sizeof(struct prefetch_stream) * dram->prefetch->stream_count);
+        alloc_assert(dram->prefetch->stream,"dram->prefetch->stream");
+        memset(dram->prefetch->stream,0,sizeof(struct prefetch_stream) * dram->prefetch->stream_count);
+    }
 
     dram->map = (struct map_info *)malloc(sizeof(struct map_info));
     alloc_assert(dram->map,"dram->map");
     memset(dram->map,0, sizeof(struct map_info));
 
-    page_num = ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    page_num = ssd->page;
+
+    if (ssd->parameter->lazy_allocation!=0)
+    {
+        /*只分配目录，叶子在get_entry第一次访问时分配*/
+        dram->map->map_dir_size=(page_num+MAP_LEAF-1)>>MAP_LEAF_SHIFT;
+        dram->map->map_dir=(struct entry **)malloc(sizeof(struct entry *) * dram->map->map_dir_size);
+        alloc_assert(dram->map->map_dir,"dram->map->map_dir");
+        memset(dram->map->map_dir,0,sizeof(struct entry *) * dram->map->map_dir_size);
+        metadata_account(ssd,sizeof(struct entry *) * dram->map->map_dir_size);
+        return dram;
+    }
 
     dram->map->map_entry = (struct entry *)malloc(sizeof(struct entry) * page_num); //每个物理页和逻辑页都有对应关系 | Every physical page and logical page have a corresponding relationship
     alloc_assert(dram->map->map_entry,"dram->map->map_entry");
     memset(dram->map->map_entry,0,sizeof(struct entry) * page_num);
+    metadata_account(ssd,sizeof(struct entry) * page_num);
 
     return dram;
 }
 
+/*****************************************************************************************
+ *建立一个容量为max_sector个sector、替换策略为policy的buffer，buffer index为1时使用哈希索引。
+ *ARC的两个ghost队列和BPLRU/FAB的逻辑块队列也是LRU的buffer，节点中只有lpn或者逻辑块号
+ *****************************************************************************************/
+struct buffer_info * initialize_buffer(struct ssd_info * ssd,unsigned long long max_sector,int policy)
+{
+    struct buffer_info *buffer;
+
+    buffer = (tAVLTree *)avlTreeCreate((void*)keyCompareFunc , (void *)freeFunc);
+    buffer->max_buffer_sector=max_sector;
+    buffer->policy=policy;
+    if (ssd->parameter->buffer_index==BUFFER_INDEX_HASH)
+    {
+        initialize_buffer_hash(buffer,ssd->parameter->subpage_page);
+    }
+    if (policy==BUFFER_ARC)
+    {
+        buffer->arc_capacity=max_sector/ssd->parameter->subpage_page;
+        buffer->ghost[0]=initialize_buffer(ssd,max_sector,BUFFER_LRU);
+        buffer->ghost[1]=initialize_buffer(ssd,max_sector,BUFFER_LRU);
+    }
+    else if ((policy==BUFFER_BPLRU)||(policy==BUFFER_FAB))
+    {
+        buffer->block_pages=ssd->parameter->page_block;
+        buffer->blocks=initialize_buffer(ssd,max_sector,BUFFER_LRU);
+    }
+    return buffer;
+}
+
+/*释放buffer中的节点、哈希索引和buffer本身*/
+void free_buffer(struct buffer_info * buffer)
+{
+    unsigned int i;
+    struct buffer_hash *hash=buffer->hash;
+
+    for (i=0;i<2;i++)
+    {
+        if (buffer->ghost[i]!=NULL)
+        {
+            free_buffer(buffer->ghost[i]);
+        }
+    }
+    if (buffer->blocks!=NULL)
+    {
+        free_buffer(buffer->blocks);
+    }
+
+    avlTreeDestroy(buffer);
+    if (hash!=NULL)
+    {
+        for (i=0;i<hash->chunk_count;i++)
+        {
+            free(hash->chunk[i]);
+        }
+        free(hash->chunk);
+        free(hash->slot);
+        free(hash);
+    }
+}
+
+/*****************************************************************************************
+ *buffer的哈希索引：节点数组按buffer装满整页时的节点数预先分配，哈希表至少是它的两倍
+ *****************************************************************************************/
+struct buffer_hash * initialize_buffer_hash(struct buffer_info * buffer,unsigned int subpage_page)
+{
+    struct buffer_hash *hash;
+
+    hash=(struct buffer_hash *)malloc(sizeof(struct buffer_hash));
+    alloc_assert(hash,"buffer_hash");
+    memset(hash,0,sizeof(struct buffer_hash));
+
+    hash->chunk_size=buffer->max_buffer_sector/subpage_page+1;
+    if (hash->chunk_size<1024)
+    {
+        hash->chunk_size=1024;
+    }
+    hash->bits=6;
+    while ((1U<<hash->bits)<2*hash->chunk_size)
+    {
+        hash->bits++;
+    }
+    hash->slot=(struct buffer_group **)malloc(sizeof(struct buffer_group *)*(1U<<hash->bits));
+    alloc_assert(hash->slot,"buffer_hash->slot");
+    memset(hash->slot,0,sizeof(struct buffer_group *)*(1U<<hash->bits));
+
+    buffer->hash=hash;
+    buffer_hash_grow_pool(hash);
+    return hash;
+}
+
+/*****************************************************************************************
+ *再分配一个节点数组，把其中的节点都放入空闲节点链表
+ *****************************************************************************************/
+void buffer_hash_grow_pool(struct buffer_hash * hash)
+{
+    unsigned int i;
+    struct buffer_group *nodes;
+
+    nodes=(struct buffer_group *)malloc(sizeof(struct buffer_group)*hash->chunk_size);
+    alloc_assert(nodes,"buffer_hash nodes");
+    memset(nodes,0,sizeof(struct buffer_group)*hash->chunk_size);
+    hash->chunk=(struct buffer_group **)realloc(hash->chunk,sizeof(struct buffer_group *)*(hash->chunk_count+1));
+    alloc_assert(hash->chunk,"buffer_hash->chunk");
+    hash->chunk[hash->chunk_count]=nodes;
+    hash->chunk_count++;
+
+    for (i=0;i<hash->chunk_size;i++)
+    {
+        nodes[i].LRU_link_next=hash->free_node;
+        hash->free_node=&nodes[i];
+    }
+}
+
+/*****************************************************************************************
+ *DFTL的初始化：在每个plane的最后blocks个块中保留translation block，这些块不再计入plane的
+ *free_page，数据的分配和gc都不会使用它们。所有translation page轮流分配到各个plane，初始时
+ *直接写入(不计时间)，CMT为空
+ *****************************************************************************************/
+struct dftl_info * initialize_dftl(struct ssd_info * ssd)
+{
+    unsigned int i=0,plane_num=0,index=0,block=0,page=0;
+    int64_t page_num=0;
+    struct dftl_info *dftl=NULL;
+    struct local location;
+    struct plane_info *p_plane=NULL;
+
+    dftl=(struct dftl_info *)malloc(sizeof(struct dftl_info));
+    alloc_assert(dftl,"dftl");
+    memset(dftl,0,sizeof(struct dftl_info));
+
+    page_num=ssd->page;
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+
+    dftl->cache_size=ssd->parameter->mapping_cache;
+    dftl->entry_per_page=ssd->parameter->page_capacity/4;                              /*每个映射项4个字节*/
+    dftl->trans_pages=(page_num+dftl->entry_per_page-1)/dftl->entry_per_page;
+    dftl->blocks=ssd->parameter->translation_blocks;
+    if (dftl->blocks==0)                                                               /*translation page所占空间的两倍，再加一个gc用的空闲块*/
+    {
+        dftl->blocks=(2*dftl->trans_pages+plane_num*ssd->parameter->page_block-1)/(plane_num*ssd->parameter->page_block)+1;
+        if (dftl->blocks<2)
+            dftl->blocks=2;
+    }
+    if ((dftl->blocks>=ssd->parameter->block_plane)||(dftl->blocks*ssd->parameter->page_block*plane_num<=dftl->trans_pages))
+    {
+        printf("the translation blocks (%u) can't hold %u translation pages\n",dftl->blocks,dftl->trans_pages);
+        free(dftl);
+        return NULL;
+    }
+
+    dftl->slot_lpn=(int64_t *)malloc(dftl->cache_size*sizeof(int64_t));
+    dftl->slot_dirty=(unsigned char *)malloc(dftl->cache_size*sizeof(unsigned char));
+    dftl->slot_ref=(unsigned char *)malloc(dftl->cache_size*sizeof(unsigned char));
+    dftl->prev=(int *)malloc(dftl->cache_size*sizeof(int));
+    dftl->next=(int *)malloc(dftl->cache_size*sizeof(int));
+    dftl->gtd=(int64_t *)malloc(dftl->trans_pages*sizeof(int64_t));
+    alloc_assert(dftl->slot_lpn,"dftl->slot_lpn");
+    alloc_assert(dftl->slot_dirty,"dftl->slot_dirty");
+    alloc_assert(dftl->slot_ref,"dftl->slot_ref");
+    alloc_assert(dftl->prev,"dftl->prev");
+    alloc_assert(dftl->next,"dftl->next");
+    alloc_assert(dftl->gtd,"dftl->gtd");
+    memset(dftl->slot_dirty,0,dftl->cache_size*sizeof(unsigned char));
+    memset(dftl->slot_ref,0,dftl->cache_size*sizeof(unsigned char));
+    dftl->head=-1;
+    dftl->tail=-1;
+
+    for (index=0;index<plane_num;index++)
+    {
+        plane_location(ssd,index,&location);
+        ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].free_page-=dftl->blocks*ssd->parameter->page_block;
+    }
+
+    for (i=0;i<dftl->trans_pages;i++)
+    {
+        plane_location(ssd,i%plane_num,&location);
+        block=ssd->parameter->block_plane-dftl->blocks+(i/plane_num)/ssd->parameter->page_block;
+        page=(i/plane_num)%ssd->parameter->page_block;
+        p_plane=&ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane];
+        get_page(ssd,&p_plane->blk_head[block],page)->valid_state=SUBPAGE_BITS(ssd->parameter->subpage_page);
+        get_page(ssd,&p_plane->blk_head[block],page)->free_state=0;
+        get_page(ssd,&p_plane->blk_head[block],page)->lpn=i;
+        p_plane->blk_head[block].free_page_num--;
+        p_plane->blk_head[block].last_write_page++;
+        dftl->gtd[i]=find_ppn(ssd,location.channel,location.chip,location.die,location.plane,block,page);
+    }
+    dftl->plane_token=dftl->trans_pages%plane_num;
+
+    ssd->dram->map->dftl=dftl;
+    return dftl;
+}
+
+/*****************************************************************************************
+ *静态分配表：分配顺序中排在前面的层次变化最快，第i层的编号为(lpn/前面各层个数之积)%该层个数。
+ *static_allocation 0-5对应ICS2011中的六种方式，6使用参数文件中的static allocation order
+ *****************************************************************************************/
+Status initialize_allocation_table(struct parameter_value *p)
+{
+    static const char *orders[6]={"chip,die,plane,channel","channel,chip,die,plane","channel,plane,chip,die",
+                                  "channel,die,chip,plane","channel,plane,die,chip","channel,die,plane,chip"};
+    static const char *names[4]={"channel","chip","die","plane"};
+    char order[64],*token=NULL;
+    unsigned int i=0,n=0,stride=1,seen=0;
+
+    if ((p->static_allocation>=0)&&(p->static_allocation<6))
+    {
+        strcpy(order,orders[p->static_allocation]);
+    }
+    else if (p->static_allocation==6)
+    {
+        strcpy(order,p->static_allocation_order);
+    }
+    else
+    {
+        printf("Error! wrong static_allocation %d\n",p->static_allocation);
+        return FAILURE;
+    }
+
+    p->alloc_count[ALLOC_CHANNEL]=p->channel_number;
+    p->alloc_count[ALLOC_CHIP]=p->chip_channel[0];
+    p->alloc_count[ALLOC_DIE]=p->die_chip;
+    p->alloc_count[ALLOC_PLANE]=p->plane_die;
+
+    for (token=strtok(order,", \t");token!=NULL;token=strtok(NULL,", \t"))
+    {
+        for (i=0;i<4;i++)
+        {
+            if (strcmp(token,names[i])==0)
+                break;
+        }
+        if ((i==4)||((seen&(1<<i))!=0))
+        {
+            printf("Error! wrong static allocation order \"%s\"\n",p->static_allocation_order);
+            return FAILURE;
+        }
+        seen|=1<<i;
+        p->alloc_stride[i]=stride;
+        stride*=p->alloc_count[i];
+        n++;
+    }
+    if (n!=4)
+    {
+        printf("Error! static allocation order must list channel, chip, die and plane\n");
+        return FAILURE;
+    }
+
+    return SUCCESS;
+}
+
+/*****************************************************************************************
+ *空闲块池的初始化：每个plane的数据块(DFTL的translation block除外)按地址顺序放入空闲块池，
+ *之后块被擦除时由erase_operation放回池中
+ *****************************************************************************************/
+struct ssd_info * initialize_free_blocks(struct ssd_info * ssd)
+{
+    unsigned int channel=0,chip=0,die=0,plane=0,block=0;
+
+    for (channel=0;channel<ssd->parameter->channel_number;channel++)
+    {
+        for (chip=0;chip<ssd->channel_head[channel].chip;chip++)
+        {
+            for (die=0;die<ssd->parameter->die_chip;die++)
+            {
+                for (plane=0;plane<ssd->parameter->plane_die;plane++)
+                {
+                    for (block=0;block<data_block_plane(ssd);block++)
+                    {
+                        free_block_push(ssd,channel,chip,die,plane,block);
+                    }
+                }
+            }
+        }
+    }
+    return ssd;
+}
+
+/*****************************************************************************************
+ *块映射和FAST的初始化：逻辑块按lbn%plane数分到各个plane上，检查每个plane的块数是否能容纳分给它的
+ *逻辑块、日志块和merge时需要的一个空闲块
+ *****************************************************************************************/
+struct blockmap_info * initialize_blockmap(struct ssd_info * ssd)
+{
+    unsigned int i=0,plane_num=0,lbn_plane=0,need=0;
+    struct blockmap_info *blockmap=NULL;
+
+    blockmap=(struct blockmap_info *)malloc(sizeof(struct blockmap_info));
+    alloc_assert(blockmap,"blockmap");
+    memset(blockmap,0,sizeof(struct blockmap_info));
+
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    blockmap->lbn_num=(unsigned int)((user_capacity(ssd,ssd->page)+ssd->parameter->page_block-1)/ssd->parameter->page_block);
+    lbn_plane=(blockmap->lbn_num+plane_num-1)/plane_num;
+    need=lbn_plane+1;
+    if (ssd->parameter->address_mapping==FAST_MAPPING)
+    {
+        need+=ssd->parameter->log_blocks+1;
+    }
+    if (need>ssd->parameter->block_plane)
+    {
+        printf("each plane needs %u blocks for %u logical blocks, but only has %u, increase overprovide\n",need,lbn_plane,ssd->parameter->block_plane);
+        free(blockmap);
+        return NULL;
+    }
+
+    blockmap->data_block=(unsigned int *)malloc(blockmap->lbn_num*sizeof(unsigned int));
+    blockmap->used=(unsigned char *)malloc(plane_num*ssd->parameter->block_plane*sizeof(unsigned char));
+    blockmap->log=(struct log_plane *)malloc(plane_num*sizeof(struct log_plane));
+    alloc_assert(blockmap->data_block,"blockmap->data_block");
+    alloc_assert(blockmap->used,"blockmap->used");
+    alloc_assert(blockmap->log,"blockmap->log");
+    memset(blockmap->data_block,0xff,blockmap->lbn_num*sizeof(unsigned int));
+    memset(blockmap->used,0,plane_num*ssd->parameter->block_plane*sizeof(unsigned char));
+    memset(blockmap->log,0,plane_num*sizeof(struct log_plane));
+
+    for (i=0;i<plane_num;i++)
+    {
+        blockmap->log[i].sw_block=-1;
+        if (ssd->parameter->address_mapping==FAST_MAPPING)
+        {
+            blockmap->log[i].rw_block=(int *)malloc(ssd->parameter->log_blocks*sizeof(int));
+            alloc_assert(blockmap->log[i].rw_block,"blockmap->log->rw_block");
+        }
+    }
+
+    ssd->dram->map->blockmap=blockmap;
+    return blockmap;
+}
+
+/*****************************************************************************************
+ *ZNS的初始化：zone size为0时每个zone在每个plane上各占一个块。所有的块都可以分给zone，
+ *不需要为gc保留空间，不能组成完整zone的块不使用
+ *****************************************************************************************/
+struct zns_info * initialize_zns(struct ssd_info * ssd)
+{
+    unsigned int plane_num=0;
+    struct zns_info *zns=NULL;
+
+    zns=(struct zns_info *)malloc(sizeof(struct zns_info));
+    alloc_assert(zns,"zns");
+    memset(zns,0,sizeof(struct zns_info));
+
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    zns->zone_blocks=(ssd->parameter->zone_blocks==0)?plane_num:ssd->parameter->zone_blocks;
+    zns->zone_num=plane_num*ssd->parameter->block_plane/zns->zone_blocks;
+    if (zns->zone_num==0)
+    {
+        printf("zone size %u is larger than the %u blocks of the ssd\n",zns->zone_blocks,plane_num*ssd->parameter->block_plane);
+        free(zns);
+        return NULL;
+    }
+    zns->zone_pages=zns->zone_blocks*ssd->parameter->page_block;
+    zns->zone_sectors=zns->zone_pages*ssd->parameter->subpage_page;
+
+    zns->zone=(struct zone_info *)malloc(zns->zone_num*sizeof(struct zone_info));
+    alloc_assert(zns->zone,"zns->zone");
+    memset(zns->zone,0,zns->zone_num*sizeof(struct zone_info));
+
+    ssd->dram->map->zns=zns;
+    return zns;
+}
+
+/*****************************************************************************************
+ *子页映射的初始化：正向和反向映射表各有ssd->page*subpage_page项，全部置为-1
+ *****************************************************************************************/
+struct subpage_map_info * initialize_subpage_map(struct ssd_info * ssd)
+{
+    int64_t sector_num=0;
+    struct subpage_map_info *submap=NULL;
+
+    submap=(struct subpage_map_info *)malloc(sizeof(struct subpage_map_info));
+    alloc_assert(submap,"submap");
+    memset(submap,0,sizeof(struct subpage_map_info));
+
+    sector_num=ssd->page*ssd->parameter->subpage_page;
+    submap->psn=(int64_t *)malloc(sector_num*sizeof(int64_t));
+    submap->owner=(int64_t *)malloc(sector_num*sizeof(int64_t));
+    alloc_assert(submap->psn,"submap->psn");
+    alloc_assert(submap->owner,"submap->owner");
+    memset(submap->psn,0xff,sector_num*sizeof(int64_t));
+    memset(submap->owner,0xff,sector_num*sizeof(int64_t));
+
+    ssd->dram->map->submap=submap;
+    return submap;
+}
+
 struct page_info * initialize_page(struct page_info * p_page )
 {
     p_page->valid_state =0;
@@ -220,11 +687,26 @@ struct page_info * initialize_page(struct page_info * p_page )
 
 struct blk_info * initialize_block(struct blk_info * p_block,struct parameter_value *parameter)
 {
-    unsigned int i;
-    struct page_info * p_page;
-
     p_block->free_page_num = parameter->page_block;	// all pages are free
     p_block->last_write_page = -1;	// no page has been programmed
+    p_block->aged_pages = 0;
+
+    if (parameter->lazy_allocation==0)
+    {
+        initialize_page_head(p_block,parameter);
+    }
+    return p_block;
+
+}
+
+/*****************************************************************************************
+ *分配并初始化一个块的page_info数组。lazy allocation时由get_page在第一次访问时调用，
+ *make_aged留下的aged_pages个页按失效页初始化
+ *****************************************************************************************/
+struct page_info * initialize_page_head(struct blk_info * p_block,struct parameter_value *parameter)
+{
+    unsigned int i;
+    struct page_info * p_page;
 
     p_block->page_head = (struct page_info *)malloc(parameter->page_block * sizeof(struct page_info));
     alloc_assert(p_block->page_head,"p_block->page_head");
@@ -234,9 +716,54 @@ struct blk_info * initialize_block(struct blk_info * p_block,struct parameter_va
     {
         p_page = &(p_block->page_head[i]);
         initialize_page(p_page );
+        if (i<p_block->aged_pages)
+        {
+            p_page->valid_state=0;
+            p_page->free_state=0;
+            p_page->lpn=0;
+        }
     }
-    return p_block;
+    return p_block->page_head;
+}
 
+/*****************************************************************************************
+ *擦除时释放lazy allocation分配的page_info数组，下一次访问时重新分配
+ *****************************************************************************************/
+void release_page_head(struct ssd_info * ssd,struct blk_info * p_block)
+{
+    if (p_block->page_head!=NULL)
+    {
+        free(p_block->page_head);
+        p_block->page_head=NULL;
+        metadata_account(ssd,-(int64_t)ssd->parameter->page_block*sizeof(struct page_info));
+    }
+    p_block->aged_pages=0;
+}
+
+/*****************************************************************************************
+ *分配映射表目录中的第leaf个叶子，叶子中的映射项初始为0(未映射)
+ *****************************************************************************************/
+struct entry * initialize_map_leaf(struct ssd_info * ssd,int64_t leaf)
+{
+    struct map_info *map=ssd->dram->map;
+
+    map->map_dir[leaf]=(struct entry *)malloc(sizeof(struct entry)*MAP_LEAF);
+    alloc_assert(map->map_dir[leaf],"map->map_dir[leaf]");
+    memset(map->map_dir[leaf],0,sizeof(struct entry)*MAP_LEAF);
+    metadata_account(ssd,sizeof(struct entry)*MAP_LEAF);
+    return map->map_dir[leaf];
+}
+
+/*****************************************************************************************
+ *记录模拟器元数据(映射表和page_info)占用的内存及其峰值
+ *****************************************************************************************/
+void metadata_account(struct ssd_info * ssd,int64_t bytes)
+{
+    ssd->metadata_size+=bytes;
+    if (ssd->metadata_size>ssd->metadata_peak)
+    {
+        ssd->metadata_peak=ssd->metadata_size;
+    }
 }
 
 struct plane_info * initialize_plane(struct plane_info * p_plane,struct parameter_value *parameter )
@@ -250,6 +777,20 @@ struct plane_info * initialize_plane(struct plane_info * p_plane,struct paramete
     alloc_assert(p_plane->blk_head,"p_plane->blk_head");
     memset(p_plane->blk_head,0,parameter->block_plane * sizeof(struct blk_info));
 
+    p_plane->free_map = (unsigned long long *)malloc((parameter->block_plane/64+1) * sizeof(unsigned long long));
+    alloc_assert(p_plane->free_map,"p_plane->free_map");
+    memset(p_plane->free_map,0,(parameter->block_plane/64+1) * sizeof(unsigned long long));
+    p_plane->free_block = (unsigned int *)malloc(parameter->block_plane * sizeof(unsigned int));
+    alloc_assert(p_plane->free_block,"p_plane->free_block");
+    memset(p_plane->free_block,0,parameter->block_plane * sizeof(unsigned int));
+    if (parameter->stream_count>1)
+    {
+        p_plane->stream_block = (unsigned int *)malloc(parameter->stream_count * sizeof(unsigned int));
+        alloc_assert(p_plane->stream_block,"p_plane->stream_block");
+        memset(p_plane->stream_block,0xff,parameter->stream_count * sizeof(unsigned int));
+    }
+    p_plane->pack_ppn = -1;
+
     for(i = 0; i<parameter->block_plane; i++)
     {
         p_block = &(p_plane->blk_head[i]);
@@ -325,6 +866,9 @@ struct ssd_info * initialize_channels(struct ssd_info * ssd )
         p_channel->chip = ssd->parameter->chip_channel[i];
         p_channel->current_state = CHANNEL_IDLE;
         p_channel->next_state = CHANNEL_IDLE;
+        p_channel->subs_r_index = (struct sub_request **)malloc((1<<SUBS_R_INDEX_BITS)*sizeof(struct sub_request *));
+        alloc_assert(p_channel->subs_r_index,"p_channel->subs_r_index");
+        memset(p_channel->subs_r_index,0,(1<<SUBS_R_INDEX_BITS)*sizeof(struct sub_request *));
 
         p_channel->chip_head = (struct chip_info *)malloc(ssd->parameter->chip_channel[i]* sizeof(struct chip_info));
         alloc_assert(p_channel->chip_head,"p_channel->chip_head");
@@ -399,7 +943,7 @@ struct parameter_value *load_parameters(char parameter_file[30])
         if((res_eql=strcmp(buf,"chip number")) ==0){			
             sscanf(buf + next_eql,"%d",&p->chip_num);
         }else if((res_eql=strcmp(buf,"dram capacity")) ==0){
-            sscanf(buf + next_eql,"%d",&p->dram_capacity);
+            sscanf(buf + next_eql,"%llu",&p->dram_capacity);
         }else if((res_eql=strcmp(buf,"cpu sdram")) ==0){
             sscanf(buf + next_eql,"%d",&p->cpu_sdram);
         }else if((res_eql=strcmp(buf,"channel number")) ==0){
@@ -486,6 +1030,62 @@ struct parameter_value *load_parameters(char parameter_file[30])
             sscanf(buf + next_eql,"%d",&p->time_characteristics.tWHR); 
         }else if((res_eql=strcmp(buf,"t_RST")) ==0){
             sscanf(buf + next_eql,"%d",&p->time_characteristics.tRST); 
+        }else if((res_eql=strcmp(buf,"bus speed")) ==0){
+            sscanf(buf + next_eql,"%d",&p->bus_speed); 
+        }else if((res_eql=strcmp(buf,"bus width")) ==0){
+            sscanf(buf + next_eql,"%d",&p->bus_width); 
+        }else if((res_eql=strcmp(buf,"command cycle")) ==0){
+            sscanf(buf + next_eql,"%d",&p->command_cycle); 
+        }else if((res_eql=strcmp(buf,"read energy")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->read_energy); 
+        }else if((res_eql=strcmp(buf,"program energy")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->program_energy); 
+        }else if((res_eql=strcmp(buf,"erase energy")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->erase_energy); 
+        }else if((res_eql=strcmp(buf,"bus energy")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->bus_energy); 
+        }else if((res_eql=strcmp(buf,"dram access energy")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->dram_energy); 
+        }else if((res_eql=strcmp(buf,"chip idle power")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->chip_idle_power); 
+        }else if((res_eql=strcmp(buf,"chip active power")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->chip_active_power); 
+        }else if((res_eql=strcmp(buf,"channel idle power")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->channel_idle_power); 
+        }else if((res_eql=strcmp(buf,"channel active power")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->channel_active_power); 
+        }else if((res_eql=strcmp(buf,"power window")) ==0){
+            sscanf(buf + next_eql,"%u",&p->power_window); 
+        }else if((res_eql=strcmp(buf,"power cap ops")) ==0){
+            sscanf(buf + next_eql,"%u",&p->power_cap_ops); 
+        }else if((res_eql=strcmp(buf,"power cap")) ==0){
+            sscanf(buf + next_eql,"%lf",&p->power_cap); 
+        }else if((res_eql=strcmp(buf,"power cap gc reserve")) ==0){
+            sscanf(buf + next_eql,"%f",&p->power_cap_gc_reserve); 
+        }else if((res_eql=strcmp(buf,"mapping cache")) ==0){
+            sscanf(buf + next_eql,"%u",&p->mapping_cache); 
+        }else if((res_eql=strcmp(buf,"mapping cache policy")) ==0){
+            sscanf(buf + next_eql,"%d",&p->mapping_cache_policy); 
+        }else if((res_eql=strcmp(buf,"translation blocks")) ==0){
+            sscanf(buf + next_eql,"%u",&p->translation_blocks); 
+        }else if((res_eql=strcmp(buf,"log blocks")) ==0){
+            sscanf(buf + next_eql,"%u",&p->log_blocks); 
+        }else if((res_eql=strcmp(buf,"free block policy")) ==0){
+            sscanf(buf + next_eql,"%d",&p->free_block_policy); 
+        }else if((res_eql=strcmp(buf,"stream count")) ==0){
+            sscanf(buf + next_eql,"%u",&p->stream_count); 
+        }else if((res_eql=strcmp(buf,"stream fallback")) ==0){
+            sscanf(buf + next_eql,"%d",&p->stream_fallback); 
+        }else if((res_eql=strcmp(buf,"zone size")) ==0){
+            sscanf(buf + next_eql,"%u",&p->zone_blocks); 
+        }else if((res_eql=strcmp(buf,"max open zones")) ==0){
+            sscanf(buf + next_eql,"%u",&p->max_open_zones); 
+        }else if((res_eql=strcmp(buf,"max active zones")) ==0){
+            sscanf(buf + next_eql,"%u",&p->max_active_zones); 
+        }else if((res_eql=strcmp(buf,"subpage mapping")) ==0){
+            sscanf(buf + next_eql,"%d",&p->subpage_mapping); 
+        }else if((res_eql=strcmp(buf,"lazy allocation")) ==0){
+            sscanf(buf + next_eql,"%d",&p->lazy_allocation); 
         }else if((res_eql=strcmp(buf,"erase limit")) ==0){
             sscanf(buf + next_eql,"%d",&p->ers_limit); 
         }else if((res_eql=strcmp(buf,"flash operating current")) ==0){
@@ -514,6 +1114,22 @@ struct parameter_value *load_parameters(char parameter_file[30])
             sscanf(buf + next_eql,"%f",&p->gc_threshold); 
         }else if((res_eql=strcmp(buf,"buffer management")) ==0){
             sscanf(buf + next_eql,"%d",&p->buffer_management); 
+        }else if((res_eql=strcmp(buf,"buffer index")) ==0){
+            sscanf(buf + next_eql,"%d",&p->buffer_index); 
+        }else if((res_eql=strcmp(buf,"evict batch")) ==0){
+            sscanf(buf + next_eql,"%u",&p->evict_batch); 
+        }else if((res_eql=strcmp(buf,"read cache size")) ==0){
+            sscanf(buf + next_eql,"%llu",&p->read_cache_size); 
+        }else if((res_eql=strcmp(buf,"buffer partition")) ==0){
+            sscanf(buf + next_eql,"%d",&p->buffer_partition); 
+        }else if((res_eql=strcmp(buf,"buffer shards")) ==0){
+            sscanf(buf + next_eql,"%u",&p->buffer_shards); 
+        }else if((res_eql=strcmp(buf,"hold-up budget")) ==0){
+            sscanf(buf + next_eql,"%lld",&p->holdup_budget); 
+        }else if((res_eql=strcmp(buf,"prefetch depth")) ==0){
+            sscanf(buf + next_eql,"%u",&p->prefetch_depth); 
+        }else if((res_eql=strcmp(buf,"prefetch streams")) ==0){
+            sscanf(buf + next_eql,"%u",&p->prefetch_streams); 
         }else if((res_eql=strcmp(buf,"scheduling algorithm")) ==0){
             sscanf(buf + next_eql,"%d",&p->scheduling_algorithm); 
         }else if((res_eql=strcmp(buf,"quick table radio")) ==0){
@@ -536,12 +1152,22 @@ struct parameter_value *load_parameters(char parameter_file[30])
             sscanf(buf + next_eql,"%d",&p->threshold_value); 
         }else if((res_eql=strcmp(buf,"active write")) ==0){
             sscanf(buf + next_eql,"%d",&p->active_write); 
+        }else if((res_eql=strcmp(buf,"background flush")) ==0){
+            sscanf(buf + next_eql,"%d",&p->background_flush); 
+        }else if((res_eql=strcmp(buf,"flush high watermark")) ==0){
+            sscanf(buf + next_eql,"%f",&p->flush_high); 
+        }else if((res_eql=strcmp(buf,"flush low watermark")) ==0){
+            sscanf(buf + next_eql,"%f",&p->flush_low); 
         }else if((res_eql=strcmp(buf,"gc hard threshold")) ==0){
             sscanf(buf + next_eql,"%f",&p->gc_hard_threshold); 
+        }else if((res_eql=strcmp(buf,"gc buffer aware")) ==0){
+            sscanf(buf + next_eql,"%d",&p->gc_buffer_aware); 
         }else if((res_eql=strcmp(buf,"allocation")) ==0){
             sscanf(buf + next_eql,"%d",&p->allocation_scheme); 
         }else if((res_eql=strcmp(buf,"static_allocation")) ==0){
             sscanf(buf + next_eql,"%d",&p->static_allocation); 
+        }else if((res_eql=strcmp(buf,"static allocation order")) ==0){
+            sscanf(buf + next_eql,"%63[^;#\n]",p->static_allocation_order); 
         }else if((res_eql=strcmp(buf,"dynamic_allocation")) ==0){
             sscanf(buf + next_eql,"%d",&p->dynamic_allocation); 
         }else if((res_eql=strcmp(buf,"advanced command")) ==0){
@@ -575,6 +1201,131 @@ struct parameter_value *load_parameters(char parameter_file[30])
 //    fclose(fp1);
 //    fclose(fp2);
 
+    /*没有给出每次操作的能耗时，用flash的工作电流*电压*操作时间估算，uA*V*ns=fJ，除以10^6得到nJ*/
+    if (p->read_energy==0)
+        p->read_energy=p->operating_current*p->supply_voltage*p->time_characteristics.tR/1000000;
+    if (p->program_energy==0)
+        p->program_energy=p->operating_current*p->supply_voltage*p->time_characteristics.tPROG/1000000;
+    if (p->erase_energy==0)
+        p->erase_energy=p->operating_current*p->supply_voltage*p->time_characteristics.tBERS/1000000;
+    if (p->power_window==0)
+        p->power_window=1000000;
+    if ((p->subpage_page<1)||(p->subpage_page>MAX_SUBPAGE))
+    {
+        printf("Error! subpage page %d is out of range 1-%d\n",p->subpage_page,MAX_SUBPAGE);
+        exit(100);
+    }
+
+    /*块映射，FAST和ZNS中逻辑块的位置是固定的，只能静态分配；数据页必须写在固定的偏移上，不能使用
+     *copyback，two plane和interleave写；DFTL只用于页映射*/
+    if ((p->address_mapping==BLOCK_MAPPING)||(p->address_mapping==FAST_MAPPING)||(p->address_mapping==ZNS_MAPPING))
+    {
+        p->allocation_scheme=1;
+        p->advanced_commands&=~(AD_COPYBACK|AD_TWOPLANE|AD_INTERLEAVE);
+        p->mapping_cache=0;
+        if ((p->address_mapping==FAST_MAPPING)&&(p->log_blocks==0))
+            p->log_blocks=1;
+        if (p->address_mapping==ZNS_MAPPING)
+            p->stream_count=0;
+        if ((p->max_active_zones!=0)&&((p->max_open_zones==0)||(p->max_open_zones>p->max_active_zones)))
+            p->max_open_zones=p->max_active_zones;
+    }
+    else
+    {
+        p->address_mapping=PAGE_MAPPING;
+    }
+    /*子页映射只用于页映射，一页只有一个子页时没有意义；物理页中的子页可能属于不同的逻辑页，
+     *不能使用copyback，two plane和interleave写，映射表常驻dram*/
+    if ((p->subpage_mapping!=0)&&((p->address_mapping!=PAGE_MAPPING)||(p->subpage_page<2)))
+    {
+        p->subpage_mapping=0;
+    }
+    if (p->subpage_mapping!=0)
+    {
+        p->subpage_mapping=1;
+        p->advanced_commands&=~(AD_COPYBACK|AD_TWOPLANE|AD_INTERLEAVE);
+        p->mapping_cache=0;
+    }
+    if (p->lazy_allocation!=0)
+    {
+        p->lazy_allocation=1;
+    }
+    if ((p->buffer_management<BUFFER_LRU)||(p->buffer_management>BUFFER_ARC))
+    {
+        p->buffer_management=BUFFER_LRU;
+    }
+    if (p->buffer_index!=BUFFER_INDEX_HASH)
+    {
+        p->buffer_index=BUFFER_INDEX_AVL;
+    }
+    if ((p->flush_high<=0)||(p->flush_high>1))
+    {
+        p->flush_high=0.8;
+    }
+    if ((p->flush_low<=0)||(p->flush_low>=p->flush_high))
+    {
+        p->flush_low=p->flush_high*5/8;
+    }
+    /*read cache和预取都要有写buffer，read cache最多占dram的一半*/
+    if ((p->dram_capacity==0)||(p->read_cache_size<SECTOR))
+    {
+        p->read_cache_size=0;
+    }
+    if (p->read_cache_size>p->dram_capacity/2)
+    {
+        p->read_cache_size=p->dram_capacity/2;
+    }
+    if (p->read_cache_size==0)
+    {
+        p->prefetch_depth=0;
+    }
+    /*gc buffer aware只用于页映射(不包括子页映射和DFTL)，要有写buffer*/
+    if ((p->gc_buffer_aware!=0)&&((p->dram_capacity==0)||(p->address_mapping!=PAGE_MAPPING)||(p->subpage_mapping!=0)||(p->mapping_cache!=0)))
+    {
+        p->gc_buffer_aware=0;
+    }
+    if (p->gc_buffer_aware!=0)
+    {
+        p->gc_buffer_aware=1;
+    }
+    /*写buffer分区时每个分区至少要放得下一页*/
+    if ((p->buffer_partition!=BUFFER_PARTITION_CHANNEL)&&(p->buffer_partition!=BUFFER_PARTITION_HASH))
+    {
+        p->buffer_partition=BUFFER_PARTITION_NONE;
+    }
+    if ((p->buffer_partition==BUFFER_PARTITION_HASH)&&(p->buffer_shards<=1))
+    {
+        p->buffer_partition=BUFFER_PARTITION_NONE;
+    }
+    if ((p->buffer_partition==BUFFER_PARTITION_CHANNEL)&&((p->dram_capacity-p->read_cache_size)/SECTOR/p->channel_number<p->subpage_page))
+    {
+        p->buffer_partition=BUFFER_PARTITION_NONE;
+    }
+    if ((p->buffer_partition==BUFFER_PARTITION_HASH)&&((p->dram_capacity-p->read_cache_size)/SECTOR/p->buffer_shards<p->subpage_page))
+    {
+        p->buffer_partition=BUFFER_PARTITION_NONE;
+    }
+    if (p->prefetch_streams==0)
+    {
+        p->prefetch_streams=8;
+    }
+    if ((p->free_block_policy<0)||(p->free_block_policy>2))
+        p->free_block_policy=0;
+    if (p->stream_count>=p->block_plane/2)
+    {
+        printf("Error! stream count %u needs more blocks per plane\n",p->stream_count);
+        exit(100);
+    }
+    /*two plane和interleave写在plane的活跃块上成对分配，不区分stream，有多个stream时不使用*/
+    if (p->stream_count>1)
+    {
+        p->advanced_commands&=~(AD_TWOPLANE|AD_INTERLEAVE);
+    }
+    if ((p->allocation_scheme==1)&&(initialize_allocation_table(p)==FAILURE))
+    {
+        exit(100);
+    }
+
     return p;
 }
 
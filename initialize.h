@@ -24,11 +24,19 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 #include <time.h>
 #include <ctype.h>
 #include <sys/types.h>
+#include <stdint.h>
 #include "avlTree.h"
 
 #define SECTOR 512
 #define BUFSIZE 200
 
+/*子页位图：每一位表示页中的一个子页(sector)，页的状态，映射项，buffer节点和子请求都用它记录子页，
+ *一页最多MAX_SUBPAGE个子页，例如16KB的页按512B的sector分是32个子页，64KB的页按1KB分是64个子页*/
+typedef unsigned long long subpage_mask;
+#define MAX_SUBPAGE 64
+#define SUBPAGE_BITS(n) (((n)>=MAX_SUBPAGE)?~0ULL:~(~0ULL<<(n)))    //低n个子页全为1的位图
+#define SUBPAGE_BIT(i) (1ULL<<(i))
+
 #define DYNAMIC_ALLOCATION 0
 #define STATIC_ALLOCATION 1
 
@@ -38,15 +46,59 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 #define NORMAL    2
 #define INTERLEAVE_TWO_PLANE 3
 #define COPY_BACK	4
+#define CACHE_READ 5
 
 #define AD_RANDOM 1
 #define AD_COPYBACK 2
 #define AD_TWOPLANE 4
 #define AD_INTERLEAVE 8
 #define AD_TWOPLANE_READ 16
+#define AD_CACHE 32                  //cache program/cache read，数据传输与阵列操作重叠
+
+#define PAGE_MAPPING 1               //address mapping的取值
+#define BLOCK_MAPPING 2
+#define FAST_MAPPING 3
+#define ZNS_MAPPING 4                //zoned namespace，逻辑地址按zone固定在条带化的块上，只能顺序写
+
+#define BUFFER_LRU 0                 //buffer management的取值，即buffer的替换策略
+#define BUFFER_CLOCK 1
+#define BUFFER_CFLRU 2               //clean first LRU，LRU端窗口中先替换干净的页
+#define BUFFER_BPLRU 3               //按逻辑块LRU，整块写回，块映射时补齐块中不在buffer里的页
+#define BUFFER_FAB 4                 //flash aware buffer，整块写回buffer中页数最多的逻辑块
+#define BUFFER_ARC 5                 //adaptive replacement cache
+#define CFLRU_WINDOW 4               //CFLRU的clean first窗口为LRU端1/CFLRU_WINDOW的节点
+#define GC_HOLD_SCAN 8               //gc buffer aware时，替换对象要留下，往前最多再看的节点数
+
+#define BUFFER_INDEX_AVL 0           //buffer index的取值，即按lpn查找buffer node的方式
+#define BUFFER_INDEX_HASH 1
+
+#define BUFFER_PARTITION_NONE 0      //buffer partition的取值，0:整个写buffer是一个全局的buffer
+#define BUFFER_PARTITION_CHANNEL 1   //每个channel一个分区，lpn按写回的目标channel分到各分区
+#define BUFFER_PARTITION_HASH 2      //按lpn的哈希值分成buffer shards个分区
+#define SUBS_R_INDEX_BITS 12         //channel读队列按ppn的哈希索引有2^SUBS_R_INDEX_BITS个槽
 
 #define READ 1
 #define WRITE 0
+#define TRIM 2                       //discard，使一段逻辑地址上的数据失效
+#define ZONE_APPEND 3                //ZNS：追加写，写入位置由zone的写指针决定
+#define ZONE_RESET 4                 //ZNS：复位zone，直接擦除zone中的块
+#define ZONE_FINISH 5                //ZNS：把zone置为FULL，不再接受写
+#define FLUSH 6                      //flush命令：写buffer中的脏数据都写入flash之后才完成
+#define FUA 7                        //force unit access写：数据写入flash之后才完成
+#define POWER_LOSS 8                 //掉电事件：估算把写buffer中的脏数据写入flash需要的时间，不产生请求
+
+#define ZONE_EMPTY 0                 //zone的状态
+#define ZONE_OPEN 1
+#define ZONE_CLOSED 2
+#define ZONE_FULL 3
+
+#define ALLOC_CHANNEL 0              //静态分配表alloc_stride，alloc_count的下标
+#define ALLOC_CHIP 1
+#define ALLOC_DIE 2
+#define ALLOC_PLANE 3
+
+#define MAP_LEAF_SHIFT 10            //lazy allocation时映射表按目录分配，每个叶子有MAP_LEAF个映射项
+#define MAP_LEAF (1<<MAP_LEAF_SHIFT)
 
 /*********************************all states of each objects************************************************
  *一下定义了channel的空闲，命令地址传输，数据传输，传输，其他等状态
@@ -70,6 +122,8 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 #define CHIP_ERASE_BUSY 109
 #define CHIP_COPYBACK_BUSY 110
 #define UNKNOWN 111
+#define CHIP_CACHE_WRITE_BUSY 112   //阵列正在编程，cache register空闲后可以接收下一页的数据
+#define CHIP_CACHE_READ_BUSY 113    //cache register中的数据正在传出，阵列同时读取下一页
 
 #define SR_WAIT 200                 
 #define SR_R_C_A_TRANSFER 201
@@ -98,7 +152,7 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 #define PAGE(lsn) (lsn&0x0000)>>16 
 #define SUBPAGE(lsn) (lsn&0x0000)>>16  
 
-#define PG_SUB 0xffffffff			
+#define PG_SUB 0xffffffffffffffffULL			
 
 #define GCSSYNC_BUFFER_TIME 0 //62800000
 
@@ -167,6 +221,30 @@ struct ac_time_characteristics{
     int tRST;      //device resetting time
 }ac_timing;
 
+/*****************************************************************************************
+ *能耗统计，能量单位都是nJ。read/program/erase/bus/dram是按操作计的动态能耗，static是chip和
+ *channel的空闲/工作功率在时间轴上积分得到的能耗。按power_window划分时间窗，记录峰值功率
+ *****************************************************************************************/
+struct energy_info{
+    double read_energy;
+    double program_energy;
+    double erase_energy;
+    double bus_energy;
+    double dram_energy;
+    double static_energy;
+
+    unsigned long last_read_count;       //上次统计时的计数，两次统计之间的增量就是这段时间内的操作次数
+    unsigned long last_program_count;
+    unsigned long last_erase_count;
+    unsigned long last_dram_access;
+    unsigned int last_transfer_size;     //in_read_size+in_program_size，单位sector
+
+    int64_t window_start;                //当前时间窗的起始时间
+    double window_energy;                //当前时间窗内的能耗
+    double peak_power;                   //峰值功率，单位mW
+    int64_t peak_window_start;           //峰值功率所在时间窗的起始时间
+};
+
 
 struct ssd_info
 { 
@@ -181,13 +259,16 @@ struct ssd_info
     int64_t simulation_start_time;
     int64_t simulation_end_time;
 
-    double ssd_energy;                   //SSD的能耗，是时间和芯片数的函数,能耗因子
+    double ssd_energy;                   //SSD的能耗，是时间和芯片数的函数,能耗因子，单位nJ
+    struct energy_info energy;           //能耗的分类统计和峰值功率
     int64_t current_time;                //记录系统时间
     int64_t next_request_time;
     unsigned int real_time_subreq;       //记录实时的写请求个数，用在全动态分配时，channel优先的情况
     int flag;
     int active_flag;                     //记录主动写是否阻塞，如果发现柱塞，需要将时间向前推进,0表示没有阻塞，1表示被阻塞，需要向前推进时间
-    unsigned int page;
+    int64_t page;                        //ssd中物理页的总数
+    int64_t metadata_size;               //映射表和page_info当前占用的内存(字节)，lazy allocation时随访问增长
+    int64_t metadata_peak;               //metadata_size的最大值
 
     unsigned int token;                  //在动态分配中，为防止每次分配在第一个channel需要维持一个令牌，每次从令牌所指的位置开始分配
     unsigned int gc_request;             //记录在SSD中，当前时刻有多少gc操作的请求
@@ -198,6 +279,20 @@ struct ssd_info
     int64_t read_avg;                    //记录用于计算读请求平均响应时间的时间
 
     unsigned int write_request_size;    // total write size in bytes
+    unsigned int trim_request_count;     //记录trim操作的次数
+    int64_t trim_avg;                    //记录用于计算trim请求平均响应时间的时间
+    unsigned int trim_request_size;      // total trimmed size in sectors
+    unsigned int trim_page_count;        //trim后整页失效的物理页数
+    unsigned int write_cancel_count;     //trim和zone reset取消的还没有写入flash的写子请求数
+    unsigned int flush_request_count;    //记录flush命令的次数
+    int64_t flush_avg;                   //记录用于计算flush命令平均响应时间的时间
+    unsigned int fua_request_count;      //FUA写的次数，同时计入写请求
+    unsigned int power_loss_count;       //掉电事件的次数
+    int64_t holdup_time;                 //掉电时把脏数据写入flash需要的最长时间(hold-up时间)，单位ns
+    unsigned long holdup_pages;          //最长hold-up时间对应要写入的页数(脏页和写队列中等待的写子请求)
+    double holdup_energy;                //最长hold-up时间对应的能耗，单位nJ
+    unsigned int holdup_over_budget;     //hold-up时间超过hold-up budget的掉电事件数
+    unsigned int stream_fallback_count;  //stream没有可用的空闲块，写到stream 0活跃块中的次数
     unsigned int read_request_size;     // total read size in bytes
     unsigned int in_program_size;       // total internal write (program) size in bytes
     unsigned int in_read_size;          // total internal read size in bytes
@@ -205,8 +300,8 @@ struct ssd_info
     unsigned int read_subreq_count;
     unsigned int gc_move_page;
 
-    unsigned int min_lsn;
-    unsigned int max_lsn;
+    int64_t min_lsn;
+    int64_t max_lsn;
     unsigned long read_count;
     unsigned long program_count;
     unsigned long erase_count;
@@ -222,9 +317,18 @@ struct ssd_info
     unsigned long mplane_erase_conut;
     unsigned long interleave_mplane_erase_count;
     unsigned long gc_copy_back;
+    unsigned long gc_absorb_count;       //gc时写buffer中有新数据而不用迁移的页数
+    unsigned long gc_hold_count;         //buffer替换时为了等gc而留在buffer中的节点数
     unsigned long num_gc;
     unsigned long write_flash_count;     //实际产生的对flash的写操作 | The actual write to flash
     unsigned long waste_page_count;      //记录因为高级命令的限制导致的页浪费 | Recording page waste due to limitations of advanced commands
+    unsigned long cache_program_count;   //数据传输与上一页编程重叠的cache program次数
+    unsigned long cache_read_count;      //阵列读与上一页数据传出重叠的cache read次数
+    unsigned long gc_cache_pipeline_count;  //gc迁移中使用cache read/program流水的页数
+    int64_t bus_stat_time;               //channel/chip忙时间已经统计到的时刻
+    unsigned long power_cap_host_defer;  //因为超出功耗预算而推迟过的写子请求数
+    unsigned long power_cap_gc_defer;    //因为超出功耗预算而推迟过的gc请求数
+    unsigned int power_cap_peak_ops;     //有功耗预算时，同时进行的编程/擦除操作数目的最大值
     float ave_read_size;
     float ave_write_size;
     unsigned int request_queue_length;
@@ -253,6 +357,10 @@ struct ssd_info
     struct dram_info *dram;
     struct request *request_queue;       //dynamic request queue
     struct request *request_tail;	     // the tail of the request queue
+    struct request **complete_heap;      //子请求的完成时间都已确定的请求，按retire_time排成的最小堆，trace_output只处理堆顶已完成的请求
+    unsigned int complete_count;
+    unsigned int complete_max;
+    struct request *flush_wait;          //子请求已经完成，还在等它之前产生的写子请求确定完成时间的flush命令
     struct sub_request *subs_w_head;     //当采用全动态分配时，分配是不知道应该挂载哪个channel上，所以先挂在ssd上，等进入process函数时才挂到相应的channel的读请求队列上
     struct sub_request *subs_w_tail;
     struct event_node *event;            //事件队列，每产生一个新的事件，按照时间顺序加到这个队列，在simulate函数最后，根据这个队列队首的时间，确定时间
@@ -272,10 +380,15 @@ struct channel_info
     int next_state;
     int64_t current_time;                //记录该通道的当前时间
     int64_t next_state_predict_time;     //the predict time of next state, used to decide the sate at the moment
+    int64_t bus_busy_time;               //通道总线处于忙状态的累计时间，用于统计总线饱和度
+    int64_t chip_busy_time;              //该通道上所有chip处于忙状态的累计时间之和
 
     struct event_node *event;
     struct sub_request *subs_r_head;     //channel上的读请求队列头，先服务处于队列头的子请求
     struct sub_request *subs_r_tail;     //channel上的读请求队列尾，新加进来的子请求加到队尾
+    struct sub_request **subs_r_index;   //读请求队列按ppn的哈希索引，查找相同ppn的子请求不用遍历队列
+    unsigned int subs_r_prefetch;        //读请求队列中预取子请求的个数
+    struct sub_request *subs_r_issued;   //读请求队列中已经发出读命令的子请求，只有它们的状态会随时间改变
     struct sub_request *subs_w_head;     //channel上的写请求队列头，先服务处于队列头的子请求
     struct sub_request *subs_w_tail;     //channel上的写请求队列，新加进来的子请求加到队尾
     struct gc_operation *gc_command;     //记录需要产生gc的位置
@@ -297,6 +410,11 @@ struct chip_info
     int next_state;
     int64_t current_time;               //记录该通道的当前时间
     int64_t next_state_predict_time;    //the predict time of next state, used to decide the sate at the moment
+    int64_t cache_reg_free_time;        //cache program时，cache register中的数据转入page register的时间，此后可以接收下一页数据
+    unsigned int map_read_pending;      //DFTL中等待在该chip空闲时执行的translation page读、写和擦除操作数
+    unsigned int map_write_pending;
+    unsigned int map_erase_pending;
+    int64_t merge_time;                 //块映射和FAST中merge操作(拷贝有效页和擦除)占用阵列的时间，在下一次编程之前执行
 
     unsigned long read_count;           //how many read count in the process of workload
     unsigned long program_count;
@@ -316,13 +434,20 @@ struct die_info{
 
 
 struct plane_info{
-    int add_reg_ppn;                    //read，write时把地址传送到该变量，该变量代表地址寄存器。die由busy变为idle时，清除地址 //有可能因为一对多的映射，在一个读请求时，有多个相同的lpn，所以需要用ppn来区分  
+    int64_t add_reg_ppn;                //read，write时把地址传送到该变量，该变量代表地址寄存器。die由busy变为idle时，清除地址 //有可能因为一对多的映射，在一个读请求时，有多个相同的lpn，所以需要用ppn来区分  
     unsigned int free_page;             //该plane中有多少free page
     unsigned int ers_invalid;           //记录该plane中擦除失效的块数
     unsigned int active_block;          //if a die has a active block, 该项表示其物理块号
     int can_erase_block;                //记录在一个plane中准备在gc操作中被擦除操作的块,-1表示还没有找到合适的块
     struct direct_erase *erase_node;    //用来记录可以直接删除的块号,在获取新的ppn时，每当出现invalid_page_num==64时，将其添加到这个指针上，供GC操作时直接删除
     struct blk_info *blk_head;
+
+    unsigned long long *free_map;       //free block policy为0时，有空闲页的块的位图，按地址顺序查找下一个块
+    unsigned int *free_block;           //free block policy为1时是FIFO环形队列，为2时是按擦除次数排序的小顶堆
+    unsigned int free_block_head;       //FIFO的队首
+    unsigned int free_block_num;        //FIFO或堆中块的个数
+    unsigned int *stream_block;         //stream count大于1时每个stream的活跃块，stream 0使用active_block，0xffffffff表示还没有分配
+    int64_t pack_ppn;                   //子页映射中还有空闲子页、可以继续写入小数据的页，-1表示没有
 };
 
 
@@ -331,26 +456,60 @@ struct blk_info{
     unsigned int free_page_num;        //记录该块中的free页个数，同上
     unsigned int invalid_page_num;     //Record the number of failed pages in this block, same as above
     unsigned int cached_pages_num;     //Total number cached page in the Dram
+    int buffered_pages_num;            //gc buffer aware时，写buffer中有脏的新数据的有效页数，gc时这些页不用迁移
     int last_write_page;               //记录最近一次写操作执行的页数,-1表示该块没有一页被写过
-    struct page_info *page_head;       // Record the status of each subpage
+    int pooled;                        //该块是否在plane的空闲块FIFO或堆中
+    unsigned int aged_pages;           //lazy allocation时make_aged置为失效的页数(从第0页开始)，页数组分配时按此初始化
+    struct page_info *page_head;       // Record the status of each subpage，lazy allocation时第一次访问才分配，擦除后释放
 };
 
 
 struct page_info{                      //lpn records the logical page stored in the physical page. When the logical page is valid, valid_state is greater than 0, and free_state is greater than 0;
-    int valid_state;                   //indicate the page is valid or invalid
-    int free_state;                    //each bit indicates the subpage is free or occupted. 1 indicates that the bit is free and 0 indicates that the bit is used                  
-    unsigned int lpn;                  
+    subpage_mask valid_state;          //indicate the page is valid or invalid
+    subpage_mask free_state;           //each bit indicates the subpage is free or occupted. 1 indicates that the bit is free and 0 indicates that the bit is used                  
+    int64_t lpn;                  
     unsigned int written_count;        //Record the number of times the page was written
-    int cached_page;
+    subpage_mask cached_page;
 };
 
 
 struct dram_info{
-    unsigned int dram_capacity;     
+    unsigned long long dram_capacity;     
     int64_t current_time;
     struct dram_parameter *dram_paramters;      
     struct map_info *map;
-    struct buffer_info *buffer; 
+    struct buffer_info *buffer;         //写buffer，分区时为第0个分区
+    struct buffer_info **partition;     //写buffer的各个分区，每个分区有自己的替换队列和索引，各自替换和写回
+    unsigned int partition_num;         //分区数，不分区时为1
+    unsigned int flush_partition;       //后台写回下一次最先处理的分区
+    struct sub_request *write_head;     //有buffer时完成时间还没有确定的写子请求(包括替换和后台写回)，按产生的先后排列
+    struct sub_request *write_tail;
+    unsigned long long write_seq;       //已经产生的写子请求数
+    int64_t write_done_time;            //完成时间已经确定的写子请求中最晚的完成时间，flush命令要等之前的写子请求写入flash
+    struct buffer_info *read_cache;     //从flash读出的干净数据，read cache size为0时为NULL
+    struct prefetch_info *prefetch;     //顺序读流检测和预取，prefetch depth为0时为NULL
+};
+
+
+/*********************************************************************************************
+ *顺序读流的检测：每个流记录下一个期望的lsn，读请求的起始lsn与之相差不超过一页就认为是这个流
+ *的继续。预取深度从请求的页数开始，每次命中加倍，最大prefetch depth页；prefetched_lpn之前的
+ *页已经预取过了。流表满时替换last_time最早的流
+ **********************************************************************************************/
+struct prefetch_stream{
+    int64_t next_lsn;                   //这个流的下一个请求期望的起始lsn
+    int64_t prefetched_lpn;             //下一个要预取的lpn
+    int64_t last_time;                  //最近一次命中这个流的时间
+    unsigned int depth;                 //当前预取深度，单位为页
+    unsigned int run;                   //连续命中的次数，0表示空闲
+};
+
+struct prefetch_info{
+    struct prefetch_stream *stream;
+    unsigned int stream_count;
+    unsigned long prefetch_count;       //预取的页数
+    unsigned long hit_count;            //预取的页在被替换出read cache之前被读命中的页数
+    unsigned long wasted_count;         //预取的页没有被读过就被替换或者失效的页数
 };
 
 
@@ -368,12 +527,50 @@ typedef struct buffer_group{
     struct buffer_group *LRU_link_next;	// next node in LRU list
     struct buffer_group *LRU_link_pre;	// previous node in LRU list
 
-    unsigned int group;                 //the first data logic sector number of a group stored in buffer 
-    unsigned int stored;                //indicate the sector is stored in buffer or not. 1 indicates the sector is stored and 0 indicate the sector isn't stored.EX.  00110011 indicates the first, second, fifth, sixth sector is stored in buffer.
-    unsigned int dirty_clean;           //it is flag of the data has been modified, one bit indicates one subpage. EX. 0001 indicates the first subpage is dirty
+    int64_t group;                      //the first data logic sector number of a group stored in buffer 
+    subpage_mask stored;                //indicate the sector is stored in buffer or not. 1 indicates the sector is stored and 0 indicate the sector isn't stored.EX.  00110011 indicates the first, second, fifth, sixth sector is stored in buffer.
+    subpage_mask dirty_clean;           //it is flag of the data has been modified, one bit indicates one subpage. EX. 0001 indicates the first subpage is dirty
+    unsigned int stream;                //最近一次写这个节点的请求所属的stream，写回时使用
     int flag;			                //indicates if this node is the last 20% of the LRU list	
+    int referenced;                     //CLOCK替换时的访问位，命中时置1，淘汰扫描时清0并给一次机会
+    int prefetched;                     //read cache中预取进来、还没有被读命中过的节点
+    int frequent;                       //ARC中被访问过两次以上的节点(T2)，在buffer_info的frequent队列中
+    unsigned int page_count;            //BPLRU/FAB的逻辑块节点中，这个逻辑块在buffer中的页数
+    int64_t gc_ppn;                     //gc buffer aware时，节点计入了哪个物理页所在块的buffered_pages_num(ppn+1)，0表示没有计入
+    struct plane_info *gc_plane;        //gc_ppn所在的plane和块，替换时判断是否留下不用再计算物理地址
+    struct blk_info *gc_blk;
 }buf_node;
 
+/*********************************************************************************************
+ *buffer index为1时用开放定址(线性探测)的哈希表按lpn查找buffer node，代替平衡二叉树。
+ *buffer node从预先分配的节点数组中取，释放后放回free_node链表，不再每次malloc/free；
+ *节点数组不够时再分配一块同样大小的数组，哈希表装载率超过1/2时加倍
+ **********************************************************************************************/
+/*********************************************************************************************
+ *buffer替换策略的接口，buffer management的值是buffer_policies[]的下标。insert在新节点加到
+ *LRU队首以后调用，remove在节点从buffer中删除之前调用，evict只在节点被替换出buffer时调用；
+ *block_level的策略按逻辑块整体写回
+ **********************************************************************************************/
+struct buffer_policy{
+    const char *name;
+    int block_level;
+    void (*insert)(struct buffer_info *buffer,struct buffer_group *buffer_node);
+    void (*touch)(struct buffer_info *buffer,struct buffer_group *buffer_node);
+    struct buffer_group *(*victim)(struct buffer_info *buffer,struct buffer_group *exclude);
+    void (*evict)(struct buffer_info *buffer,struct buffer_group *buffer_node);
+    void (*remove)(struct buffer_info *buffer,struct buffer_group *buffer_node);
+};
+
+struct buffer_hash{
+    struct buffer_group **slot;         //哈希表，NULL表示空位
+    unsigned int bits;                  //哈希表大小为1<<bits
+    unsigned int count;                 //哈希表中的节点数
+    struct buffer_group *free_node;     //空闲节点链表，用LRU_link_next串起来
+    struct buffer_group **chunk;        //已分配的节点数组
+    unsigned int chunk_count;
+    unsigned int chunk_size;            //每个节点数组中的节点数
+};
+
 
 struct dram_parameter{
     float active_current;
@@ -385,9 +582,118 @@ struct dram_parameter{
 
 struct map_info{
     struct entry *map_entry;            //该项是映射表结构体指针,each entry indicate a mapping information
+    struct entry **map_dir;             //lazy allocation时的映射表目录，每项指向MAP_LEAF个映射项，第一次访问时才分配，此时map_entry为NULL
+    int64_t map_dir_size;               //目录的项数
+    struct dftl_info *dftl;             //DFTL模式下的CMT和GTD，mapping cache为0时为NULL
+    struct blockmap_info *blockmap;     //块映射和FAST模式下的块映射表和日志块，页映射时为NULL
+    struct zns_info *zns;               //ZNS模式下各个zone的状态和写指针，其他模式为NULL
+    struct subpage_map_info *submap;    //子页映射表，subpage mapping为0时为NULL
     struct buffer_info *attach_info;	// info about attach map
 };
 
+/*****************************************************************************************
+ *块映射和FAST：逻辑块lbn固定在第lbn%plane数个plane上，data_block记录它在这个plane中的数据块号。
+ *块映射中逻辑页只能写在数据块的固定偏移上，覆盖写需要把整个块拷贝到新块。FAST中每个plane还有一个
+ *顺序写日志块(sw)和log_blocks个随机写日志块(rw)，日志块满了以后通过switch/partial/full merge回收。
+ *map_entry仍然记录每个逻辑页当前所在的物理页，供读操作和统计使用
+ *****************************************************************************************/
+struct log_plane{
+    int sw_block;                       //顺序写日志块，-1表示没有
+    unsigned int sw_lbn;                //顺序写日志块对应的逻辑块
+    int *rw_block;                      //随机写日志块，按分配的先后排列，rw_block[0]最先被merge
+    unsigned int rw_num;
+};
+
+struct blockmap_info{
+    unsigned int lbn_num;               //逻辑块数目
+    unsigned int *data_block;           //0xffffffff表示该逻辑块还没有分配数据块
+    unsigned char *used;                //物理块是否已经作为数据块或日志块，下标为plane编号*block_plane+块号
+    struct log_plane *log;              //FAST中每个plane的日志块
+
+    unsigned long block_copy_count;     //块映射中因为覆盖写拷贝整个块的次数
+    unsigned long switch_merge_count;
+    unsigned long partial_merge_count;
+    unsigned long full_merge_count;
+    unsigned long merge_page_count;     //merge时拷贝的页数
+    unsigned long merge_erase_count;    //merge时擦除的块数
+};
+
+/*****************************************************************************************
+ *ZNS：第z个zone由编号z*zone_blocks到(z+1)*zone_blocks-1的块单元组成，块单元u位于第u%plane数个
+ *plane的第u/plane数个块上，zone内的逻辑页在这些块之间轮流放置，顺序写可以同时用到所有的channel
+ *和die。写指针wp以sector为单位；zone reset直接擦除zone中的块，不需要gc
+ *****************************************************************************************/
+struct zone_info{
+    unsigned int state;                 //ZONE_EMPTY，ZONE_OPEN，ZONE_CLOSED，ZONE_FULL
+    unsigned int wp;                    //写指针，zone中已经写过的sector数目
+    int64_t last_time;                  //最近一次写的时间，打开的zone超过上限时关闭最久没写的zone
+};
+
+struct zns_info{
+    unsigned int zone_num;
+    unsigned int zone_blocks;           //每个zone的块数
+    unsigned int zone_pages;            //每个zone的页数
+    unsigned int zone_sectors;          //每个zone的sector数
+    unsigned int open_num;              //处于ZONE_OPEN的zone数目
+    unsigned int active_num;            //处于ZONE_OPEN和ZONE_CLOSED的zone数目
+    struct zone_info *zone;
+
+    unsigned long append_count;
+    unsigned long reset_count;
+    unsigned long finish_count;
+    unsigned long reset_erase_count;    //zone reset和打开zone时擦除的块数
+    int64_t reset_avg;                  //记录用于计算zone reset平均响应时间的时间
+    unsigned long implicit_close_count; //打开的zone超过上限时被关闭的次数
+    unsigned long wp_error_count;       //没有从写指针开始或者越过zone边界的写
+    unsigned long resource_error_count; //超过active zone上限而被拒绝的写
+    unsigned long rejected_count;
+};
+
+/*****************************************************************************************
+ *子页映射：每个逻辑子页lsn单独映射到物理子页psn=ppn*subpage_page+slot，一个逻辑页的子页可以分散
+ *在不同的物理页中，一个物理页也可以存放多个逻辑页的子页。map_entry的state仍然是逻辑页中有效子页
+ *的位图，pn是最近一次写入的物理页；物理页的valid_state和free_state按slot计。owner是反向映射，
+ *gc搬移物理页时用来修改其中每个子页的映射(实际的ftl放在页的oob中，不计入dram)
+ *****************************************************************************************/
+struct subpage_map_info{
+    int64_t *psn;                       //逻辑子页所在的物理子页，-1表示没有
+    int64_t *owner;                     //物理子页中存放的逻辑子页，-1表示没有
+
+    unsigned long avoided_update_read_count;  //部分页的写在页映射中需要的读(update read)
+    unsigned long packed_write_count;   //写到已有数据的物理页的空闲子页中的写
+};
+
+/*****************************************************************************************
+ *DFTL(demand-based FTL)：dram中只缓存cache_size个映射项(CMT)，完整的映射表以translation page
+ *的形式存放在每个plane最后blocks个保留块中，gtd记录每个translation page的物理页号。
+ *CMT的各个slot用数组组成双向链表(LRU/FIFO)，CLOCK策略使用slot_ref和hand
+ *****************************************************************************************/
+struct dftl_info{
+    unsigned int cache_size;            //CMT能容纳的映射项数目
+    unsigned int count;                 //CMT中已使用的slot数目
+    unsigned int entry_per_page;        //一个translation page能存放的映射项数目
+    unsigned int blocks;                //每个plane中保留的translation block数目
+    unsigned int trans_pages;           //translation page的数目
+    int64_t *slot_lpn;
+    unsigned char *slot_dirty;          //该映射项在CMT中被修改过，替换出去时需要写回translation page
+    unsigned char *slot_ref;            //CLOCK策略的访问位
+    int *prev;
+    int *next;
+    int head;                           //最近插入或访问的slot
+    int tail;                           //LRU/FIFO的替换对象
+    unsigned int hand;                  //CLOCK指针
+    int64_t *gtd;                       //global translation directory，记录每个translation page当前的物理页号
+    unsigned int plane_token;           //新translation page在所有plane之间轮流分配
+
+    unsigned long hit_count;
+    unsigned long miss_count;
+    unsigned long trans_read_count;
+    unsigned long trans_write_count;
+    unsigned long writeback_count;      //替换dirty映射项引起的写回次数，同一translation page中的dirty项一起写回
+    unsigned long gc_count;             //translation block的gc次数
+    unsigned long gc_move_count;
+};
+
 
 struct controller_info{
     unsigned int frequency;             //表示该控制器的工作频率
@@ -398,11 +704,18 @@ struct controller_info{
 
 struct request{
     int64_t time;                      //请求到达的时间，单位为us,这里和通常的习惯不一样，通常的是ms为单位，这里需要有个单位变换过程
-    unsigned int lsn;                  //请求的起始地址，逻辑地址
+    int64_t lsn;                       //请求的起始地址，逻辑地址
     unsigned int size;                 //请求的大小，既多少个扇区
     unsigned int operation;            //请求的种类，1为读，0为写
-
-    unsigned int* need_distr_flag;
+    unsigned int stream;               //trace中可选的第6列，写请求所属的stream，没有时为0
+    int failed;                        //ZNS中违反写指针或zone资源限制而被拒绝的请求，不计入响应时间统计
+    int prefetch;                      //预取产生的内部读请求，完成后只把数据放入read cache，不输出也不计入统计
+    int flush;                         //buffer后台写回产生的内部写请求，不输出也不计入统计
+    int fua;                           //FUA写，写入buffer的数据还要立即写入flash
+    unsigned long long write_seq;      //flush命令到达时已经产生的写子请求数，flush要等这些写子请求写入flash
+    int synced;                        //flush命令之前的写子请求的完成时间都已确定，并计入了complete_time
+
+    subpage_mask *need_distr_flag;     //读请求中每个逻辑页还需要从flash读的子页，每个lpn一项
     unsigned int complete_lsn_count;   //record the count of lsn served by buffer
 
     int distri_flag;		           // indicate whether this request has been distributed already
@@ -414,32 +727,52 @@ struct request{
     double energy_consumption;         //记录该请求的能量消耗，单位为uJ
 
     struct sub_request *subs;          //链接到属于该请求的所有子请求
+    unsigned int outstanding;          //完成时间还没有确定的子请求数，为0时请求进入完成堆
+    int64_t complete_time;             //已经确定的子请求完成时间中最晚的一个
+    int64_t retire_time;               //在完成堆中排序用的时间，到达后trace_output才检查该请求
+    int retire_flag;                   //请求已经在完成堆中
     struct request *next_node;         //指向下一个请求结构体
+    struct request *prev_node;         //请求队列中的前一个请求，完成时直接从队列中删除
+    struct request *wait_node;         //flush_wait链表中的下一个flush命令
 
     struct raid_sub_request *subreq_on_raid;
 };
 
 
 struct sub_request{
-    unsigned int lpn;                  //这里表示该子请求的逻辑页号
-    unsigned int ppn;                  //分配那个物理子页给这个子请求。在multi_chip_page_mapping中，产生子页请求时可能就知道psn的值，其他时候psn的值由page_map_read,page_map_write等FTL最底层函数产生。 
+    int64_t lpn;                       //这里表示该子请求的逻辑页号
+    int64_t ppn;                       //分配那个物理子页给这个子请求。在multi_chip_page_mapping中，产生子页请求时可能就知道psn的值，其他时候psn的值由page_map_read,page_map_write等FTL最底层函数产生。 
     unsigned int operation;            //表示该子请求的类型，除了读1 写0，还有擦除，two plane等操作 
     int size;
+    unsigned int stream;               //写子请求所属的stream，决定写到plane中哪个活跃块
+    int prefetch;                      //预取的读子请求，在channel的读队列中排在普通读子请求后面
+    int power_deferred;                //写子请求因为功耗预算推迟过，推迟次数只计一次
 
     unsigned int current_state;        //表示该子请求所处的状态，见宏定义sub request
     int64_t current_time;
     unsigned int next_state;
     int64_t next_state_predict_time;
-    unsigned int state;              //Use the highest bit of the state to indicate whether the subrequest is one of the one-to-many mapping relationships. If yes, it needs to be read into the buffer. 1 means one-to-many, 0 means no need to write to buffer
+    subpage_mask state;              //Use the highest bit of the state to indicate whether the subrequest is one of the one-to-many mapping relationships. If yes, it needs to be read into the buffer. 1 means one-to-many, 0 means no need to write to buffer
     //Read request does not need this member, lsn plus size can distinguish the status of the page; but write request requires this member, most write sub-requests come from buffer write-back operations, there may be situations similar to discontinuous sub-pages, So the member needs to be maintained separately
 
     int64_t begin_time;               //子请求开始时间
     int64_t complete_time;            //记录该子请求的处理时间,既真正写入或者读出数据的时间
+    int done;                         //完成时间已经确定，已经从所属请求的outstanding中减去
+    unsigned long long write_seq;     //在dram->write_head链表中的写子请求的序号，不在链表中时为0
+    struct sub_request *write_prev;   //dram->write_head链表中的前一个写子请求
+    struct sub_request *write_next;
+
+    struct request *req;              //子请求所属的请求，gc和更新读等内部子请求为NULL
 
     struct local *location;           //在静态分配和混合分配方式中，已知lpn就知道该lpn该分配到那个channel，chip，die，plane，这个结构体用来保存计算得到的地址
     struct sub_request *next_subs;    //指向属于同一个request的子请求
     struct sub_request *next_node;    //指向同一个channel中下一个子请求结构体
+    struct sub_request *prev_node;    //channel读队列中的前一个子请求
+    struct sub_request *hash_next;    //channel读队列哈希索引中同一个槽的下一个子请求
+    struct sub_request *issued_next;  //channel读队列中已经发出读命令的下一个子请求
     struct sub_request *update;       //因为在写操作中存在更新操作，因为在动态分配方式中无法使用copyback操作，需要将原来的页读出后才能进行写操作，所以，将因更新产生的读操作挂在这个指针上
+    struct sub_request *map_sub;      //DFTL中映射项不在CMT里时，需要先完成的translation page读子请求
+    struct sub_request *map_wait;     //等待这个translation page读子请求的其他map子请求(不在读队列中)，用map_wait串起来，读完成时一起完成
 };
 
 
@@ -455,7 +788,7 @@ struct event_node{
 
 struct parameter_value{
     unsigned int chip_num;          //记录一个SSD中有多少个颗粒
-    unsigned int dram_capacity;     //记录SSD中DRAM capacity
+    unsigned long long dram_capacity;   //记录SSD中DRAM capacity，单位为B
     unsigned int cpu_sdram;         //记录片内有多少
 
     unsigned int channel_number;    //记录SSD中有多少个通道，每个通道是单独的bus
@@ -487,7 +820,15 @@ struct parameter_value{
     double dram_refresh_current;    //cpu sdram work current   uA
     double dram_voltage;            //cpu sdram work voltage  V
 
-    int buffer_management;          //indicates that there are buffer management or not
+    int buffer_management;          //buffer的替换策略，0:LRU，1:CLOCK
+    int buffer_index;               //buffer node的查找方式，0:平衡二叉树，1:哈希表
+    unsigned int evict_batch;       //buffer满时一次最多写回的节点数，按die/plane分组；0和1表示每次只写回需要的节点
+    unsigned long long read_cache_size; //从dram capacity中划给read cache的字节数，其余的给写buffer；0表示没有read cache
+    int buffer_partition;           //写buffer的分区方式，0:不分区，1:每个channel一个分区，2:按lpn哈希分区
+    unsigned int buffer_shards;     //buffer partition为2时的分区数
+    int64_t holdup_budget;          //电容能支持的掉电后写入时间(ns)，用来检查掉电事件的hold-up时间，0表示不检查
+    unsigned int prefetch_depth;    //顺序读流最多预取的页数，0表示不预取
+    unsigned int prefetch_streams;  //同时跟踪的顺序读流的个数
     int scheduling_algorithm;       //记录使用哪种调度算法，1:FCFS
     float quick_radio;
     int related_mapping;
@@ -501,9 +842,16 @@ struct parameter_value{
     int threshold_fixed_adjust;
     int threshold_value;
     int active_write;               //表示是否执行主动写操作1,yes;0,no
+    int background_flush;           //1表示buffer在空闲时后台写回脏数据，0表示不写回
+    float flush_high;               //后台写回时buffer中脏数据超过这个比例开始写回
+    float flush_low;                //后台写回到脏数据低于这个比例时停止
     float gc_hard_threshold;        //普通策略中用不到该参数，只有在主动写策略中，当满足这个阈值时，GC操作不可中断
+    int gc_buffer_aware;            //gc和写buffer配合：选块时加上buffer中有新数据的页，不迁移这些页，马上要gc的plane上的页先留在buffer中
     int allocation_scheme;          //记录分配方式的选择，0表示动态分配，1表示静态分配
-    int static_allocation;          //记录是那种静态分配方式，如ICS09那篇文章所述的所有静态分配方式
+    int static_allocation;          //记录是那种静态分配方式，如ICS09那篇文章所述的所有静态分配方式，6表示使用static allocation order
+    char static_allocation_order[64];   //static_allocation为6时自定义的分配顺序，如"plane,die,chip,channel"，排在前面的变化最快
+    unsigned int alloc_stride[4];   //静态分配表：channel，chip，die，plane的编号为(lpn/alloc_stride)%alloc_count，初始化时由分配顺序算出
+    unsigned int alloc_count[4];
     int dynamic_allocation;         //记录动态分配的方式
     int advanced_commands;  
     int ad_priority;                //record the priority between two plane operation and interleave operation
@@ -513,6 +861,35 @@ struct parameter_value{
     int aged;                       //1表示需要将这个SSD变成aged，0表示需要将这个SSD保持non-aged
     float aged_ratio; 
     int queue_length;               //请求队列的长度限制
+    int bus_speed;                  //通道总线的传输速率(MT/s)，0表示沿用tWC/tRC，每个字节一个周期
+    int bus_width;                  //通道总线的位宽(bit)
+    int command_cycle;              //命令/地址周期的时间(ns)，0表示使用tWC
+
+    double read_energy;             //读一个page的能耗(nJ)，0表示用flash operating current*supply voltage*tR计算
+    double program_energy;          //写一个page的能耗(nJ)，0表示用flash operating current*supply voltage*tPROG计算
+    double erase_energy;            //擦除一个block的能耗(nJ)，0表示用flash operating current*supply voltage*tBERS计算
+    double bus_energy;              //总线上传输一个字节的能耗(pJ)
+    double dram_energy;             //访问dram中一个sector的能耗(nJ)
+    double chip_idle_power;         //每个chip的空闲功率(mW)
+    double chip_active_power;       //chip忙时在空闲功率之外增加的功率(mW)
+    double channel_idle_power;      //每个channel的空闲功率(mW)
+    double channel_active_power;    //channel忙时在空闲功率之外增加的功率(mW)
+    unsigned int power_window;      //统计峰值功率的时间窗(ns)
+    unsigned int power_cap_ops;     //同时进行的编程/擦除操作数目的上限，0表示不限制
+    double power_cap;               //编程/擦除操作的总功率上限(mW)，0表示不限制
+    float power_cap_gc_reserve;     //为不可中断的gc保留的预算比例，主机写和可中断的gc只能用剩下的部分
+    unsigned int mapping_cache;     //DFTL中缓存在dram里的映射项数目(CMT)，0表示整个映射表常驻dram
+    int mapping_cache_policy;       //CMT的替换策略，0:LRU；1:FIFO；2:CLOCK
+    unsigned int translation_blocks;//每个plane中保留给translation page的块数，0表示根据映射表大小自动计算
+    unsigned int log_blocks;        //FAST中每个plane的随机写日志块数目
+    int free_block_policy;          //活跃块用完后选择下一个块的方式，0:地址顺序(位图)；1:FIFO(擦除的先后)；2:擦除次数最少
+    unsigned int stream_count;      //每个plane中同时打开的活跃块数(stream数)，0和1表示不区分stream
+    int stream_fallback;            //stream号不小于stream count时，0:映射到stream%stream count；1:和stream 0共用活跃块
+    unsigned int zone_blocks;       //ZNS中每个zone包含的块数，0表示每个plane各一个块
+    unsigned int max_open_zones;    //ZNS中同时打开的zone数目上限，0表示不限制
+    unsigned int max_active_zones;  //ZNS中打开和关闭的zone数目之和的上限，0表示不限制
+    int subpage_mapping;            //页映射中以子页(sector)为映射单位，1表示使用；部分页的写不再读出旧数据，小数据可以打包写到同一页中
+    int lazy_allocation;            //1表示映射表和每个块的page_info在第一次访问时才分配，适合大容量、工作集小的模拟
 
     struct ac_time_characteristics time_characteristics;
 };
@@ -521,8 +898,10 @@ struct parameter_value{
  *mapping information,state的最高位表示是否有附加映射关系
  *********************************************************/
 struct entry{                       
-    unsigned int pn;                //物理号，既可以表示物理页号，也可以表示物理子页号，也可以表示物理块号
-    int state;                      //The hexadecimal representation is 0000-FFFF, and each bit indicates whether the corresponding subpage is valid (page mapping). For example, in this page, subpages 0 and 1 are valid, and subpages 2 and 3 are invalid. This should be 0x0003.
+    int64_t pn;                     //物理号，既可以表示物理页号，也可以表示物理子页号，也可以表示物理块号
+    subpage_mask state;             //The hexadecimal representation is 0000-FFFF, and each bit indicates whether the corresponding subpage is valid (page mapping). For example, in this page, subpages 0 and 1 are valid, and subpages 2 and 3 are invalid. This should be 0x0003.
+    unsigned int cmt_slot;          //DFTL中该映射项在CMT中的位置加1，0表示不在CMT中
+    unsigned int trimmed;           //1表示整页被trim过、之后还没有再写，读时不需要读flash(ZNS中没有映射的页都不读)
 };
 
 
@@ -564,6 +943,7 @@ struct gc_operation{
     unsigned int page;            //该参数只在可中断的gc函数中使用（gc_interrupt），用来记录已经完成的数据迁移的页号 | This parameter is only used in the interruptible gc function (gc_interrupt), which is used to record the page number of the completed data migration.
     unsigned int state;           //记录当前gc请求的状态 | Record the status of the current gc request
     unsigned int priority;        //记录该gc操作的优先级，1表示不可中断，0表示可中断（软阈值产生的gc请求） | Record the priority of the gc operation, 1 means uninterruptible, 0 means interruptable (gc request generated by soft threshold)
+    unsigned int power_deferred;  //因为功耗预算推迟过，推迟次数只计一次
     struct gc_operation *next_node;
 
     int64_t x_init_time;           // time when gc initialized, when the threshold is reached.
@@ -588,11 +968,25 @@ struct ssd_info *initiation(struct ssd_info *);
 struct parameter_value *load_parameters(char parameter_file[30]);
 struct page_info * initialize_page(struct page_info * p_page);
 struct blk_info * initialize_block(struct blk_info * p_block,struct parameter_value *parameter);
+struct page_info * initialize_page_head(struct blk_info * p_block,struct parameter_value *parameter);
+struct entry * initialize_map_leaf(struct ssd_info * ssd,int64_t leaf);
+void release_page_head(struct ssd_info * ssd,struct blk_info * p_block);
+void metadata_account(struct ssd_info * ssd,int64_t bytes);
 struct plane_info * initialize_plane(struct plane_info * p_plane,struct parameter_value *parameter );
 struct die_info * initialize_die(struct die_info * p_die,struct parameter_value *parameter,long long current_time );
 struct chip_info * initialize_chip(struct chip_info * p_chip,struct parameter_value *parameter,long long current_time );
 struct ssd_info * initialize_channels(struct ssd_info * ssd );
 struct dram_info * initialize_dram(struct ssd_info * ssd);
+struct buffer_info * initialize_buffer(struct ssd_info * ssd,unsigned long long max_sector,int policy);
+struct buffer_hash * initialize_buffer_hash(struct buffer_info * buffer,unsigned int subpage_page);
+void buffer_hash_grow_pool(struct buffer_hash * hash);
+void free_buffer(struct buffer_info * buffer);
+struct dftl_info * initialize_dftl(struct ssd_info * ssd);
+struct blockmap_info * initialize_blockmap(struct ssd_info * ssd);
+struct zns_info * initialize_zns(struct ssd_info * ssd);
+struct subpage_map_info * initialize_subpage_map(struct ssd_info * ssd);
+struct ssd_info * initialize_free_blocks(struct ssd_info * ssd);
+Status initialize_allocation_table(struct parameter_value *p);
 
 #endif
 
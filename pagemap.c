@@ -54,11 +54,11 @@ void alloc_assert(void *p,char *s)//断言
  *A，读到的time_t，device，lsn，size，ope都<0时，输出“trace error:.....”
  *B，读到的time_t，device，lsn，size，ope都=0时，输出“probable read a blank line”
  **********************************************************************************/
-void trace_assert(int64_t time_t,int device,unsigned int lsn,int size,int ope)//断言
+void trace_assert(int64_t time_t,int device,int64_t lsn,int size,int ope)//断言
 {
     if(time_t <0 || device < 0 || lsn < 0 || size < 0 || ope < 0)
     {
-        printf("trace error:%lld %d %d %d %d\n",time_t,device,lsn,size,ope);
+        printf("trace error:%lld %d %lld %d %d\n",time_t,device,lsn,size,ope);
         getchar();
         exit(-1);
     }
@@ -69,17 +69,66 @@ void trace_assert(int64_t time_t,int device,unsigned int lsn,int size,int ope)//
     }
 }
 
+/************************************************************************************
+*get_page返回块中第page页的page_info，get_entry返回lpn的映射项。lazy allocation时
+*page_info数组和映射表叶子在第一次访问时分配；find_entry不分配，叶子不存在时返回NULL，
+*用于只需要判断是否已映射的遍历
+ *************************************************************************************/
+struct page_info *get_page(struct ssd_info *ssd,struct blk_info *p_block,unsigned int page)
+{
+    if (p_block->page_head==NULL)
+    {
+        initialize_page_head(p_block,ssd->parameter);
+        metadata_account(ssd,(int64_t)ssd->parameter->page_block*sizeof(struct page_info));
+    }
+    return &p_block->page_head[page];
+}
+
+struct entry *get_entry(struct ssd_info *ssd,int64_t lpn)
+{
+    struct map_info *map=ssd->dram->map;
+    struct entry *leaf;
+
+    if (map->map_dir==NULL)
+    {
+        return &map->map_entry[lpn];
+    }
+    leaf=map->map_dir[lpn>>MAP_LEAF_SHIFT];
+    if (leaf==NULL)
+    {
+        leaf=initialize_map_leaf(ssd,lpn>>MAP_LEAF_SHIFT);
+    }
+    return &leaf[lpn&(MAP_LEAF-1)];
+}
+
+struct entry *find_entry(struct ssd_info *ssd,int64_t lpn)
+{
+    struct map_info *map=ssd->dram->map;
+    struct entry *leaf;
+
+    if (map->map_dir==NULL)
+    {
+        return &map->map_entry[lpn];
+    }
+    leaf=map->map_dir[lpn>>MAP_LEAF_SHIFT];
+    if (leaf==NULL)
+    {
+        return NULL;
+    }
+    return &leaf[lpn&(MAP_LEAF-1)];
+}
+
 
 /************************************************************************************
 *The function of the function is to find the channel, chip, die, plane, block, page where the physical page is located according to the physical page number ppn
 *The obtained channel, chip, die, plane, block, and page are placed in the structure location and used as the return value
  *************************************************************************************/
-struct local *find_location(struct ssd_info *ssd, unsigned int ppn)
+struct local *find_location(struct ssd_info *ssd, int64_t ppn)
 {
     struct local *location=NULL;
     unsigned int i=0;
-    int pn,ppn_value=ppn;
-    int page_plane=0,page_die=0,page_chip=0,page_channel=0;
+    int64_t pn,ppn_value=ppn;
+    int64_t page_plane=0,page_die=0,page_chip=0,page_channel=0;
 
     pn = ppn;
 
@@ -91,7 +140,7 @@ struct local *find_location(struct ssd_info *ssd, unsigned int ppn)
     alloc_assert(location,"location");
     memset(location,0, sizeof(struct local));
 
-    page_plane=ssd->parameter->page_block*ssd->parameter->block_plane;
+    page_plane=(int64_t)ssd->parameter->page_block*ssd->parameter->block_plane;
     page_die=page_plane*ssd->parameter->plane_die;
     page_chip=page_die*ssd->parameter->die_chip;
     page_channel=page_chip*ssd->parameter->chip_channel[0];
@@ -117,12 +166,12 @@ struct local *find_location(struct ssd_info *ssd, unsigned int ppn)
  * The function of this function is to find the physical page number according to the parameters channel, chip, die, plane, block, page.
  * The return value of the function is the physical page number
  ******************************************************************************/
-unsigned int find_ppn(struct ssd_info * ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page)
+int64_t find_ppn(struct ssd_info * ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page)
 {
-    unsigned int ppn=0;
+    int64_t ppn=0;
     unsigned int i=0;
-    int page_plane=0,page_die=0,page_chip=0;
-    int page_channel[100];                  /*这个数组存放的是每个channel的page数目 | This array stores the number of pages per channel*/
+    int64_t page_plane=0,page_die=0,page_chip=0;
+    int64_t page_channel[100];                  /*这个数组存放的是每个channel的page数目 | This array stores the number of pages per channel*/
 
 #ifdef DEBUG
     printf("enter find_psn,channel:%d, chip:%d, die:%d, plane:%d, block:%d, page:%d\n",channel,chip,die,plane,block,page);
@@ -131,7 +180,7 @@ unsigned int find_ppn(struct ssd_info * ssd,unsigned int channel,unsigned int ch
     /*********************************************
      *计算出plane，die，chip，channel中的page的数目 | Calculate the number of pages in plane, die, chip, channel
      **********************************************/
-    page_plane=ssd->parameter->page_block*ssd->parameter->block_plane;
+    page_plane=(int64_t)ssd->parameter->page_block*ssd->parameter->block_plane;
     page_die=page_plane*ssd->parameter->plane_die;
     page_chip=page_die*ssd->parameter->die_chip;
     while(i<ssd->parameter->channel_number)
@@ -150,21 +199,36 @@ unsigned int find_ppn(struct ssd_info * ssd,unsigned int channel,unsigned int ch
         ppn=ppn+page_channel[i];
         i++;
     }
-    ppn=ppn+page_chip*chip+page_die*die+page_plane*plane+block*ssd->parameter->page_block+page;
+    ppn=ppn+page_chip*chip+page_die*die+page_plane*plane+(int64_t)block*ssd->parameter->page_block+page;
 
     return ppn;
 }
 
+/*****************************************************************************************
+ *静态分配：根据初始化时算好的静态分配表得到lpn所在的channel，chip，die，plane
+ *Static allocation: look up channel/chip/die/plane of lpn in the table built at start-up.
+ *****************************************************************************************/
+void static_location(struct ssd_info *ssd,int64_t lpn,struct local *location)
+{
+    struct parameter_value *p=ssd->parameter;
+
+    location->channel=(lpn/p->alloc_stride[ALLOC_CHANNEL])%p->alloc_count[ALLOC_CHANNEL];
+    location->chip=(lpn/p->alloc_stride[ALLOC_CHIP])%p->alloc_count[ALLOC_CHIP];
+    location->die=(lpn/p->alloc_stride[ALLOC_DIE])%p->alloc_count[ALLOC_DIE];
+    location->plane=(lpn/p->alloc_stride[ALLOC_PLANE])%p->alloc_count[ALLOC_PLANE];
+}
+
 /********************************
  *函数功能是获得一个读子请求的状态
  *==============================
  *The function function is to get the status of a read sub request
  *********************************/
-int set_entry_state(struct ssd_info *ssd,unsigned int lsn,unsigned int size)
+subpage_mask set_entry_state(struct ssd_info *ssd,int64_t lsn,unsigned int size)
 {
-    int temp,state,move;
+    subpage_mask temp,state;
+    int move;
 
-    temp=~(0xffffffff<<size);
+    temp=SUBPAGE_BITS(size);
     move=lsn%ssd->parameter->subpage_page;
     state=temp<<move;
 
@@ -178,10 +242,11 @@ int set_entry_state(struct ssd_info *ssd,unsigned int lsn,unsigned int size)
 struct ssd_info *pre_process_page(struct ssd_info *ssd)
 {
     int fl=0;
-    unsigned int device,lsn,size,ope,lpn,full_page;
-    unsigned int largest_lsn,sub_size,ppn,add_size=0;
+    unsigned int device,size,ope;
+    int64_t lsn,lpn,largest_lsn,ppn;
+    unsigned int sub_size,add_size=0;
     unsigned int i=0,j,k;
-    int map_entry_new,map_entry_old,modify;
+    subpage_mask full_page,map_entry_new,map_entry_old,modify;
     int flag=0;
     char buffer_request[200];
     struct local *location;
@@ -197,22 +262,22 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
         return NULL;
     }
 
-    full_page=~(0xffffffff<<(ssd->parameter->subpage_page));
-    printf("full page %d %d \n",full_page, ssd->parameter->subpage_page);
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    printf("full page %llu %d \n",full_page, ssd->parameter->subpage_page);
     /*计算出这个ssd的最大逻辑扇区号 | Calculate the maximum logical sector number of this ssd*/
-    largest_lsn=(unsigned int )((ssd->parameter->chip_num*ssd->parameter->die_chip*ssd->parameter->plane_die*ssd->parameter->block_plane*ssd->parameter->page_block*ssd->parameter->subpage_page)*(1-ssd->parameter->overprovide));
-    printf("largest lsn : %d\n", largest_lsn);
+    largest_lsn=user_capacity(ssd,(int64_t)ssd->parameter->chip_num*ssd->parameter->die_chip*ssd->parameter->plane_die*ssd->parameter->block_plane*ssd->parameter->page_block*ssd->parameter->subpage_page);
+    printf("largest lsn : %lld\n", largest_lsn);
 
     while(fgets(buffer_request,200,ssd->tracefile))
     {
-        sscanf(buffer_request,"%lld %d %d %d %d",&time,&device,&lsn,&size,&ope);
+        sscanf(buffer_request,"%lld %d %lld %d %d",&time,&device,&lsn,&size,&ope);
         fl++;
         trace_assert(time,device,lsn,size,ope);                         /*断言，当读到的time，device，lsn，size，ope不合法时就会处理*/
 
         add_size=0;                                                     /* add_size is the size that this request has been preprocessed*/
 
-        // Only pre process page that will be read
-        if(ope==1)                                                      /* This is just a preprocessing of the read request, and the information in the corresponding position needs to be modified in advance.*/
+        // Only pre process page that will be read, in ZNS reading behind the write pointer returns without flash access
+        if((ope==1)&&(ssd->parameter->address_mapping!=ZNS_MAPPING))                                                      /* This is just a preprocessing of the read request, and the information in the corresponding position needs to be modified in advance.*/
         {
             while(add_size<size)
             {				
@@ -242,7 +307,7 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
                  ********************************************************************************************************/
                 lpn=lsn/ssd->parameter->subpage_page;
 
-                if(ssd->dram->map->map_entry[lpn].state==0)
+                if(get_entry(ssd,lpn)->state==0)
                  
                 {
                     /**************************************************************
@@ -259,13 +324,13 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
 
                         ssd->channel_head[location->channel].program_count++;
                         ssd->channel_head[location->channel].chip_head[location->chip].program_count++;		
-                        ssd->dram->map->map_entry[lpn].pn=ppn;	
-                        ssd->dram->map->map_entry[lpn].state=set_entry_state(ssd,lsn,sub_size);   //0001
+                        get_entry(ssd,lpn)->pn=ppn;	
+                        get_entry(ssd,lpn)->state=set_entry_state(ssd,lsn,sub_size);   //0001
 
-                        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].lpn=lpn;
-                        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].valid_state=ssd->dram->map->map_entry[lpn].state;
-                        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].free_state=((~ssd->dram->map->map_entry[lpn].state)&full_page);
-                        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page=ssd->dram->map->map_entry[lpn].state;
+                        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->lpn=lpn;
+                        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state=get_entry(ssd,lpn)->state;
+                        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->free_state=((~get_entry(ssd,lpn)->state)&full_page);
+                        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page=get_entry(ssd,lpn)->state;
                         ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].cached_pages_num++;   // C1
 
                     free(location);
@@ -274,27 +339,27 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
                 }
 
                     
-                else if(ssd->dram->map->map_entry[lpn].state>0)           /* state is not 0 */  //change_1
+                else if(get_entry(ssd,lpn)->state>0)           /* state is not 0 */  //change_1
                 {
                     map_entry_new=set_entry_state(ssd,lsn,sub_size);      /*Get the new state, and get a state with the original state*/
 
-                    map_entry_old=ssd->dram->map->map_entry[lpn].state;
+                    map_entry_old=get_entry(ssd,lpn)->state;
                     modify=map_entry_new|map_entry_old;
-                    ppn=ssd->dram->map->map_entry[lpn].pn;
+                    ppn=get_entry(ssd,lpn)->pn;
                     location=find_location(ssd,ppn);
 
                     // ssd->program_count++;
                     // ssd->in_program_size+=ssd->parameter->subpage_page;
                     
                     //change_1
-                    //if(ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page==0)
+                    //if(get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page==0)
                     //{
                             ssd->channel_head[location->channel].program_count++;
                             ssd->channel_head[location->channel].chip_head[location->chip].program_count++;		
-                            ssd->dram->map->map_entry[lsn/ssd->parameter->subpage_page].state=modify; 
-                            ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].valid_state=modify;
-                            ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].free_state=((~modify)&full_page);
-                            ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page=modify;
+                            get_entry(ssd,lsn/ssd->parameter->subpage_page)->state=modify; 
+                            get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state=modify;
+                            get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->free_state=((~modify)&full_page);
+                            get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page=modify;
                             ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].cached_pages_num++;   //change_1
 
                             free(location);
@@ -302,7 +367,7 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
                    // }
                     
                     
-                }//else if(ssd->dram->map->map_entry[lpn].state>0)
+                }//else if(get_entry(ssd,lpn)->state>0)
                 
                 lsn=lsn+sub_size;                                         /*下个子请求的起始位置*/
                 add_size+=sub_size;                                       /*已经处理了的add_size大小变化*/
@@ -324,6 +389,11 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
                 fflush(ssd->outputfile);
             }
 
+    if (ssd->dram->map->submap!=NULL)
+    {
+        subpage_map_build(ssd);
+    }
+
     return ssd;
 }
 
@@ -331,23 +401,24 @@ struct ssd_info *pre_process_page(struct ssd_info *ssd)
 *  The function is to obtain the physical page number ppn for the preprocessing function
  * Obtaining the page number is divided into dynamic acquisition and static acquisition
  **************************************/
-unsigned int get_ppn_for_pre_process(struct ssd_info *ssd,unsigned int lsn)     
+int64_t get_ppn_for_pre_process(struct ssd_info *ssd,int64_t lsn)     
 {
     unsigned int channel=0,chip=0,die=0,plane=0; 
-    unsigned int ppn,lpn;
+    int64_t ppn,lpn;
     unsigned int active_block;
-    unsigned int channel_num=0,chip_num=0,die_num=0,plane_num=0;
+    struct local location;
 
 #ifdef DEBUG
     printf("enter get_psn_for_pre_process\n");
 #endif
 
-    channel_num=ssd->parameter->channel_number;
-    chip_num=ssd->parameter->chip_channel[0];
-    die_num=ssd->parameter->die_chip;
-    plane_num=ssd->parameter->plane_die;
     lpn=lsn/ssd->parameter->subpage_page;
 
+    if (ssd->parameter->address_mapping!=PAGE_MAPPING)
+    {
+        return blockmap_pre_process(ssd,lpn);
+    }
+
     if (ssd->parameter->allocation_scheme==0)                /*Get ppn in dynamic mode*/ 
     {
         if (ssd->parameter->dynamic_allocation==0)           /*Indicates that in the full dynamic mode, that is, channel, chip, die, plane, block, etc. are all dynamically allocated*/
@@ -372,64 +443,13 @@ unsigned int get_ppn_for_pre_process(struct ssd_info *ssd,unsigned int lsn)
             ssd->channel_head[channel].chip_head[chip].die_head[die].token=(plane+1)%ssd->parameter->plane_die;
         }
     } 
-    else if (ssd->parameter->allocation_scheme==1)             /* Indicates static allocation, and there are 6 different static allocation methods of 0, 1, 2, 3, 4, 5 */
+    else if (ssd->parameter->allocation_scheme==1)             /* Indicates static allocation, see initialize_allocation_table() */
     {
-        switch (ssd->parameter->static_allocation)
-        {
-
-            case 0:         
-                {
-                    channel=(lpn/(plane_num*die_num*chip_num))%channel_num;
-                    chip=lpn%chip_num;
-                    die=(lpn/chip_num)%die_num;
-                    plane=(lpn/(die_num*chip_num))%plane_num;
-                    break;
-                }
-            case 1:
-                {
-                    channel=lpn%channel_num;
-                    chip=(lpn/channel_num)%chip_num;
-                    die=(lpn/(chip_num*channel_num))%die_num;
-                    plane=(lpn/(die_num*chip_num*channel_num))%plane_num;
-
-                    break;
-                }
-            case 2:
-                {
-                    channel=lpn%channel_num;
-                    chip=(lpn/(plane_num*channel_num))%chip_num;
-                    die=(lpn/(plane_num*chip_num*channel_num))%die_num;
-                    plane=(lpn/channel_num)%plane_num;
-                    break;
-                }
-            case 3:
-                {
-                    channel=lpn%channel_num;
-                    chip=(lpn/(die_num*channel_num))%chip_num;
-                    die=(lpn/channel_num)%die_num;
-                    plane=(lpn/(die_num*chip_num*channel_num))%plane_num;
-                    break;
-                }
-            case 4:  
-                {
-                    channel=lpn%channel_num;
-                    chip=(lpn/(plane_num*die_num*channel_num))%chip_num;
-                    die=(lpn/(plane_num*channel_num))%die_num;
-                    plane=(lpn/channel_num)%plane_num;
-
-                    break;
-                }
-            case 5:   
-                {
-                    channel=lpn%channel_num;
-                    chip=(lpn/(plane_num*die_num*channel_num))%chip_num;
-                    die=(lpn/channel_num)%die_num;
-                    plane=(lpn/(die_num*channel_num))%plane_num;
-
-                    break;
-                }
-            default : return 0;
-        }
+        static_location(ssd,lpn,&location);
+        channel=location.channel;
+        chip=location.chip;
+        die=location.die;
+        plane=location.plane;
     }
 
     /******************************************************************************
@@ -454,6 +474,56 @@ unsigned int get_ppn_for_pre_process(struct ssd_info *ssd,unsigned int lsn)
 }
 
 
+/*****************************************************************************************
+ *没有主动写策略时，plane中的free page少于gc_hard_threshold就在channel上挂一个不可中断的gc请求，
+ *同一个plane已经有gc请求时不再重复挂
+ *****************************************************************************************/
+void init_plane_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane)
+{
+    unsigned int is_gc_inited=1;
+    struct gc_operation *gc_node;
+
+    if (ssd->parameter->active_write==0)                                            /* If there is no active policy, only gc_hard_threshold is used, and the GC process cannot be interrupted.*/
+    {                                                                               /* If the number of free_pages in the plane is less than the threshold set by gc_hard_threshold, a gc operation will be generated*/
+        if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page<(ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->gc_hard_threshold))
+        {
+            // check whether gc process already initialized for this plane
+            is_gc_inited=1;
+            gc_node=ssd->channel_head[channel].gc_command;
+            while(gc_node!=NULL) {
+                if (gc_node->chip==chip && gc_node->die==die && gc_node->plane==plane) {
+                    is_gc_inited = 0;
+                    break;
+                }
+                gc_node=gc_node->next_node;
+            }
+
+            // only initialized gc if it wasn't initialized previously
+            if (is_gc_inited) {
+                gc_node=(struct gc_operation *)malloc(sizeof(struct gc_operation));
+                alloc_assert(gc_node,"gc_node");
+                memset(gc_node,0, sizeof(struct gc_operation));
+
+                gc_node->next_node=NULL;
+                gc_node->chip=chip;
+                gc_node->die=die;
+                gc_node->plane=plane;
+                gc_node->block=0xffffffff;
+                gc_node->page=0;
+                gc_node->state=GC_WAIT;
+                gc_node->priority=GC_UNINTERRUPT;
+                gc_node->next_node=ssd->channel_head[channel].gc_command;
+                gc_node->x_init_time = ssd->channel_head[channel].current_time;
+                gc_node->x_free_percentage = (double) ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page / (double) (ssd->parameter->page_block*ssd->parameter->block_plane) * (double) 100;
+                gc_node->x_moved_pages=0;
+
+                ssd->channel_head[channel].gc_command=gc_node;
+                ssd->gc_request++;
+            }
+        }
+    }
+}
+
 /***************************************************************************************************
  *函数功能是在所给的channel，chip，die，plane里面找到一个active_block然后再在这个block里面找到一个页，
  *再利用find_ppn找到ppn。
@@ -463,16 +533,17 @@ unsigned int get_ppn_for_pre_process(struct ssd_info *ssd,unsigned int lsn)
 
 struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,struct sub_request *sub)
 {
-    int old_ppn=-1;
-    unsigned int ppn,lpn,full_page;
+    int64_t old_ppn=-1;
+    int64_t ppn,lpn;
+    subpage_mask full_page;
     unsigned int active_block;
     unsigned int block;
     unsigned int page,flag=0,flag1=0;
-    unsigned int old_state=0,state=0,copy_subpage=0;
-    unsigned int is_in_tw=0, is_gc_inited=1;
+    unsigned int copy_subpage=0;
+    subpage_mask old_state=0,state=0;
+    unsigned int is_in_tw=0;
     struct local *location;
     struct direct_erase *direct_erase_node,*new_direct_erase;
-    struct gc_operation *gc_node;
 
     unsigned int i=0,j=0,k=0,l=0,m=0,n=0;
 
@@ -480,7 +551,16 @@ struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int
     printf("enter get_ppn,channel:%d, chip:%d, die:%d, plane:%d\n",channel,chip,die,plane);
 #endif
 
-    full_page=~(0xffffffff<<(ssd->parameter->subpage_page));
+    if (ssd->parameter->address_mapping!=PAGE_MAPPING)                              /*块映射和FAST由映射方式决定物理页*/
+    {
+        return blockmap_get_ppn(ssd,sub);
+    }
+    if (ssd->dram->map->submap!=NULL)                                               /*子页映射以子页为单位分配*/
+    {
+        return subpage_get_ppn(ssd,channel,chip,die,plane,sub);
+    }
+
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
     lpn=sub->lpn;
 
     /*************************************************************************************
@@ -489,13 +569,12 @@ struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int
      * Use the find_active_block function to find active blocks on channel, chip, die, plane
      * and modify the last_write_page and free_page_num under this channel, chip, die, plane, active_block
      **************************************************************************************/
-    if(find_active_block(ssd,channel,chip,die,plane)==FAILURE)                      
+    if(find_stream_block(ssd,channel,chip,die,plane,sub->stream,&active_block)==FAILURE)                      
     {
         printf("ERROR :there is no free page in channel:%d, chip:%d, die:%d, plane:%d\n",channel,chip,die,plane);	
         return ssd;
     }
 
-    active_block=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].last_write_page++;	
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].free_page_num--;
 
@@ -508,29 +587,30 @@ struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int
     block=active_block;	
     page=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].last_write_page;	
 
-    if(ssd->dram->map->map_entry[lpn].state==0)                                       /*this is the first logical page*/
+    if(get_entry(ssd,lpn)->state==0)                                       /*this is the first logical page*/
     {
-        if(ssd->dram->map->map_entry[lpn].pn!=0)
+        if(get_entry(ssd,lpn)->pn!=0)
         {
             printf("Error in get_ppn()\n");
         }
-        ssd->dram->map->map_entry[lpn].pn=find_ppn(ssd,channel,chip,die,plane,block,page);
-        ssd->dram->map->map_entry[lpn].state=sub->state;
+        get_entry(ssd,lpn)->pn=find_ppn(ssd,channel,chip,die,plane,block,page);
+        get_entry(ssd,lpn)->state=sub->state;
+        get_entry(ssd,lpn)->trimmed=0;
     }
     else                                                                            /*这个逻辑页进行了更新，需要将原来的页置为失效*/
     {  
         /*This logical page has been updated, and the original page needs to be invalidated*/
-        ppn=ssd->dram->map->map_entry[lpn].pn;
+        ppn=get_entry(ssd,lpn)->pn;
         location=find_location(ssd,ppn);
-        if(	ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].lpn!=lpn)
+        if(	get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->lpn!=lpn)
         {
             printf("\nError in get_ppn()\n");
         }
 
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].valid_state=0;             /*Indicates that a certain page is invalid, and both the valid and free states are marked as 0*/
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].free_state=0;              /*Indicates that a certain page is invalid, and both the valid and free states are marked as 0*/
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].lpn=0;
-        ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page=0;    //changes Done Here
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state=0;             /*Indicates that a certain page is invalid, and both the valid and free states are marked as 0*/
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->free_state=0;              /*Indicates that a certain page is invalid, and both the valid and free states are marked as 0*/
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->lpn=0;
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page=0;    //changes Done Here
         ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].invalid_page_num++;
             
 
@@ -560,12 +640,12 @@ struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int
 
         free(location);
         location=NULL;
-        ssd->dram->map->map_entry[lpn].pn=find_ppn(ssd,channel,chip,die,plane,block,page);
-        ssd->dram->map->map_entry[lpn].state=(ssd->dram->map->map_entry[lpn].state|sub->state);
+        get_entry(ssd,lpn)->pn=find_ppn(ssd,channel,chip,die,plane,block,page);
+        get_entry(ssd,lpn)->state=(get_entry(ssd,lpn)->state|sub->state);
     }
 
 
-    sub->ppn=ssd->dram->map->map_entry[lpn].pn;                                      /*修改sub子请求的ppn，location等变量*/
+    sub->ppn=get_entry(ssd,lpn)->pn;                                      /*修改sub子请求的ppn，location等变量*/
     sub->location->channel=channel;
     sub->location->chip=chip;
     sub->location->die=die;
@@ -578,63 +658,256 @@ struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int
     ssd->channel_head[channel].program_count++;
     ssd->channel_head[channel].chip_head[chip].program_count++;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page--;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[page].lpn=lpn;	
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[page].valid_state=sub->state;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[page].free_state=((~(sub->state))&full_page);
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[page].cached_page=sub->state;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[page].written_count++;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],page)->lpn=lpn;	
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],page)->valid_state=sub->state;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],page)->free_state=((~(sub->state))&full_page);
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],page)->cached_page=sub->state;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],page)->written_count++;
     ssd->write_flash_count++;
 
-    if (ssd->parameter->active_write==0)                                            /* If there is no active policy, only gc_hard_threshold is used, and the GC process cannot be interrupted.*/
-    {                                                                               /* If the number of free_pages in the plane is less than the threshold set by gc_hard_threshold, a gc operation will be generated*/
-        if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page<(ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->gc_hard_threshold))
+    init_plane_gc(ssd,channel,chip,die,plane);
+
+    return ssd;
+}
+
+/*****************************************************************************************
+ *子页映射中使逻辑子页lsn原来所在的物理子页失效，物理页中的子页全部失效时这一页才算作invalid页，
+ *块中的页全部失效时挂到direct erase链上
+ *****************************************************************************************/
+void subpage_invalidate(struct ssd_info *ssd,int64_t lsn)
+{
+    int64_t psn=0,ppn=0;
+    struct local *location=NULL;
+    struct plane_info *p_plane=NULL;
+    struct blk_info *p_blk=NULL;
+    struct page_info *p_page=NULL;
+    struct direct_erase *new_direct_erase=NULL;
+    struct subpage_map_info *submap=ssd->dram->map->submap;
+
+    psn=submap->psn[lsn];
+    if (psn==-1)
+    {
+        return;
+    }
+    submap->psn[lsn]=-1;
+    submap->owner[psn]=-1;
+
+    ppn=psn/ssd->parameter->subpage_page;
+    location=find_location(ssd,ppn);
+    p_plane=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane];
+    p_blk=&p_plane->blk_head[location->block];
+    p_page=get_page(ssd,p_blk,location->page);
+
+    p_page->valid_state&=~SUBPAGE_BIT(psn%ssd->parameter->subpage_page);
+    p_page->cached_page&=p_page->valid_state;
+    if (p_page->valid_state==0)
+    {
+        p_page->free_state=0;
+        p_page->lpn=0;
+        p_page->cached_page=0;
+        p_blk->invalid_page_num++;
+        if (p_plane->pack_ppn==ppn)
         {
-            // check whether gc process already initialized for this plane
-            is_gc_inited=1;
-            gc_node=ssd->channel_head[channel].gc_command;
-            while(gc_node!=NULL) {
-                if (gc_node->chip==chip && gc_node->die==die && gc_node->plane==plane) {
-                    is_gc_inited = 0;
-                    break;
-                }
-                gc_node=gc_node->next_node;
-            }
+            p_plane->pack_ppn=-1;
+        }
 
-            // only initialized gc if it wasn't initialized previously
-            if (is_gc_inited) {
-                gc_node=(struct gc_operation *)malloc(sizeof(struct gc_operation));
-                alloc_assert(gc_node,"gc_node");
-                memset(gc_node,0, sizeof(struct gc_operation));
+        if (p_blk->invalid_page_num==ssd->parameter->page_block)
+        {
+            new_direct_erase=(struct direct_erase *)malloc(sizeof(struct direct_erase));
+            alloc_assert(new_direct_erase,"new_direct_erase");
+            memset(new_direct_erase,0, sizeof(struct direct_erase));
 
-                gc_node->next_node=NULL;
-                gc_node->chip=chip;
-                gc_node->die=die;
-                gc_node->plane=plane;
-                gc_node->block=0xffffffff;
-                gc_node->page=0;
-                gc_node->state=GC_WAIT;
-                gc_node->priority=GC_UNINTERRUPT;
-                gc_node->next_node=ssd->channel_head[channel].gc_command;
-                gc_node->x_init_time = ssd->channel_head[channel].current_time;
-                gc_node->x_free_percentage = (double) ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page / (double) (ssd->parameter->page_block*ssd->parameter->block_plane) * (double) 100;
-                gc_node->x_moved_pages=0;
+            new_direct_erase->block=location->block;
+            new_direct_erase->next_node=p_plane->erase_node;
+            p_plane->erase_node=new_direct_erase;
+        }
+    }
+    free(location);
+    location=NULL;
+}
 
-                ssd->channel_head[channel].gc_command=gc_node;
-                ssd->gc_request++;
-            }
+/*****************************************************************************************
+ *子页映射的写：sub中的子页依次放到物理页中最低的空闲子页里。plane的pack_ppn是活跃块中最后写的
+ *一页，它还有足够的空闲子页时，新数据以partial program的方式写到这一页中(可以来自不同的逻辑页)，
+ *否则像get_ppn一样在活跃块中分配新的一页。先占用新的子页，再使旧的子页失效，所以旧数据在同一页中
+ *时这一页不会被误判为invalid页
+ *****************************************************************************************/
+struct ssd_info *subpage_get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,struct sub_request *sub)
+{
+    int64_t ppn=0,lsn=0,psn=0;
+    unsigned int slot=0,i=0;
+    subpage_mask full_page=0;
+    unsigned int active_block=0,page=0,packed=0;
+    struct local *location=NULL;
+    struct plane_info *p_plane=NULL;
+    struct page_info *p_page=NULL;
+    struct subpage_map_info *submap=ssd->dram->map->submap;
+
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    p_plane=&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane];
+
+    if (p_plane->pack_ppn!=-1)
+    {
+        location=find_location(ssd,p_plane->pack_ppn);
+        p_page=get_page(ssd,&p_plane->blk_head[location->block],location->page);
+        if ((p_plane->blk_head[location->block].last_write_page==(int)location->page)&&(p_page->valid_state!=0)
+            &&(size(p_page->free_state&full_page)>=size(sub->state)))
+        {
+            active_block=location->block;
+            page=location->page;
+            packed=1;
         }
-    } 
+        free(location);
+        location=NULL;
+    }
+
+    if (packed==0)
+    {
+        if(find_stream_block(ssd,channel,chip,die,plane,sub->stream,&active_block)==FAILURE)
+        {
+            printf("ERROR :there is no free page in channel:%d, chip:%d, die:%d, plane:%d\n",channel,chip,die,plane);
+            return ssd;
+        }
+        p_plane->blk_head[active_block].last_write_page++;
+        p_plane->blk_head[active_block].free_page_num--;
+        if(p_plane->blk_head[active_block].last_write_page>=ssd->parameter->page_block)
+        {
+            printf("error! the last write page larger than %d!!\n", ssd->parameter->page_block);
+            while(1){}
+        }
+        page=p_plane->blk_head[active_block].last_write_page;
+        p_page=get_page(ssd,&p_plane->blk_head[active_block],page);
+        p_page->valid_state=0;
+        p_page->free_state=full_page;
+        p_plane->free_page--;
+    }
+    else
+    {
+        submap->packed_write_count++;
+    }
+
+    ppn=find_ppn(ssd,channel,chip,die,plane,active_block,page);
+    for (i=0;i<ssd->parameter->subpage_page;i++)
+    {
+        if ((sub->state&SUBPAGE_BIT(i))==0)
+        {
+            continue;
+        }
+        for (slot=0;(p_page->free_state&SUBPAGE_BIT(slot))==0;slot++);
+
+        lsn=sub->lpn*ssd->parameter->subpage_page+i;
+        psn=ppn*ssd->parameter->subpage_page+slot;
+        p_page->free_state&=~SUBPAGE_BIT(slot);
+        p_page->valid_state|=SUBPAGE_BIT(slot);
+        subpage_invalidate(ssd,lsn);
+        submap->psn[lsn]=psn;
+        submap->owner[psn]=lsn;
+    }
+    p_page->lpn=sub->lpn;
+    p_page->cached_page=p_page->valid_state;
+    p_page->written_count++;
+    p_plane->pack_ppn=((p_page->free_state&full_page)!=0)?ppn:-1;
+
+    get_entry(ssd,sub->lpn)->pn=ppn;
+    get_entry(ssd,sub->lpn)->state|=sub->state;
+    get_entry(ssd,sub->lpn)->trimmed=0;
+
+    sub->ppn=ppn;
+    sub->location->channel=channel;
+    sub->location->chip=chip;
+    sub->location->die=die;
+    sub->location->plane=plane;
+    sub->location->block=active_block;
+    sub->location->page=page;
+
+    ssd->program_count++;
+    ssd->in_program_size+=size(sub->state);
+    ssd->channel_head[channel].program_count++;
+    ssd->channel_head[channel].chip_head[chip].program_count++;
+    ssd->write_flash_count++;
+
+    init_plane_gc(ssd,channel,chip,die,plane);
 
     return ssd;
 }
+
+/*****************************************************************************************
+ *gc把物理页old_ppn搬到new_ppn时，按反向映射修改其中每个子页的映射
+ *****************************************************************************************/
+void subpage_move(struct ssd_info *ssd,int64_t old_ppn,int64_t new_ppn)
+{
+    unsigned int slot=0;
+    int64_t lsn=0,lpn=0;
+    struct subpage_map_info *submap=ssd->dram->map->submap;
+
+    for (slot=0;slot<ssd->parameter->subpage_page;slot++)
+    {
+        lsn=submap->owner[old_ppn*ssd->parameter->subpage_page+slot];
+        if (lsn==-1)
+        {
+            continue;
+        }
+        submap->owner[old_ppn*ssd->parameter->subpage_page+slot]=-1;
+        submap->owner[new_ppn*ssd->parameter->subpage_page+slot]=lsn;
+        submap->psn[lsn]=new_ppn*ssd->parameter->subpage_page+slot;
+        lpn=lsn/ssd->parameter->subpage_page;
+        if (get_entry(ssd,lpn)->pn==old_ppn)
+        {
+            get_entry(ssd,lpn)->pn=new_ppn;
+        }
+    }
+}
+
+/*****************************************************************************************
+ *预处理和老化之后，按页映射的结果建立子页映射：逻辑页的子页i在物理页的子页i中
+ *****************************************************************************************/
+void subpage_map_build(struct ssd_info *ssd)
+{
+    int64_t lpn=0,pn=0;
+    unsigned int i=0;
+    subpage_mask full_page=0,state=0;
+    struct local *location=NULL;
+    struct entry *p_entry=NULL;
+    struct subpage_map_info *submap=ssd->dram->map->submap;
+
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    for (lpn=0;lpn<ssd->page;lpn++)
+    {
+        p_entry=find_entry(ssd,lpn);
+        if (p_entry==NULL)
+        {
+            lpn|=MAP_LEAF-1;                //整个叶子都没有分配，跳过
+            continue;
+        }
+        state=p_entry->state&full_page;
+        if (state==0)
+        {
+            continue;
+        }
+        pn=p_entry->pn;
+        p_entry->state=state;
+        location=find_location(ssd,pn);
+        get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state=state;
+        free(location);
+        location=NULL;
+        for (i=0;i<ssd->parameter->subpage_page;i++)
+        {
+            if ((state&SUBPAGE_BIT(i))!=0)
+            {
+                submap->psn[lpn*ssd->parameter->subpage_page+i]=pn*ssd->parameter->subpage_page+i;
+                submap->owner[pn*ssd->parameter->subpage_page+i]=lpn*ssd->parameter->subpage_page+i;
+            }
+        }
+    }
+}
 /*****************************************************************************************
 *The function of this function is to find a new ppn for the gc operation, because in the gc operation, a new physical block needs to be found to store the data on the original physical block
  * The function of finding new physical blocks in GC, which will not cause cyclic GC operation
  ******************************************************************************************/
 
-unsigned int get_ppn_for_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane)     
+int64_t get_ppn_for_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane)     
 {
-    unsigned int ppn;
+    int64_t ppn;
     unsigned int active_block,block,page;
 
 #ifdef DEBUG
@@ -644,7 +917,7 @@ unsigned int get_ppn_for_gc(struct ssd_info *ssd,unsigned int channel,unsigned i
     if(find_active_block(ssd,channel,chip,die,plane)!=SUCCESS)
     {
         printf("\n\n Error int get_ppn_for_gc().\n");
-        return 0xffffffff;
+        return -1;
     }
 
     active_block=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block;
@@ -668,7 +941,7 @@ unsigned int get_ppn_for_gc(struct ssd_info *ssd,unsigned int channel,unsigned i
     ssd->channel_head[channel].program_count++;
     ssd->channel_head[channel].chip_head[chip].program_count++;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page--;
-    ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block].page_head[page].written_count++;
+    get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[active_block],page)->written_count++;
     ssd->write_flash_count++;
 
     return ppn;
@@ -690,42 +963,236 @@ Status erase_operation(struct ssd_info * ssd,unsigned int channel ,unsigned int
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].last_write_page=-1;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].erase_count++;
 
-    for (i=0;i<ssd->parameter->page_block;i++)
+    if (ssd->parameter->lazy_allocation!=0)
+    {
+        release_page_head(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block]);     //擦除后的块不再占用page_info
+    }
+    else
     {
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].free_state=PG_SUB;
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].valid_state=0;
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].cached_page=0;
-        ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].lpn=-1;
+        for (i=0;i<ssd->parameter->page_block;i++)
+        {
+            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].free_state=PG_SUB;
+            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].valid_state=0;
+            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].cached_page=0;
+            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].lpn=-1;
+        }
     }
     ssd->erase_count++;
     ssd->channel_head[channel].erase_count++;			
     ssd->channel_head[channel].chip_head[chip].erase_count++;
     ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page+=ssd->parameter->page_block;
+    free_block_push(ssd,channel,chip,die,plane,block);
 
     return SUCCESS;
 
 }
 
-
-/**************************************************************************************
- *这个函数的功能是处理INTERLEAVE_TWO_PLANE，INTERLEAVE，TWO_PLANE，NORMAL下的擦除的操作。
- ***************************************************************************************/
-Status erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die1, unsigned int plane1,unsigned int command)
+/*****************************************************************************************
+ *把块放回plane的空闲块池(DFTL的translation block不放入)：
+ *free block policy为0时在位图中置位；为1时放到FIFO队尾；为2时按擦除次数放入小顶堆
+ *****************************************************************************************/
+void free_block_push(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block)
 {
-    unsigned int die=0;
-    unsigned int plane=0;
-    unsigned int block=0;
-    struct direct_erase *direct_erase_node=NULL;
-    unsigned int block0=0xffffffff;
-    unsigned int block1=0;
+    unsigned int i=0,parent=0,tmp=0;
+    struct plane_info *p_plane=&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane];
 
-    if((ssd->channel_head[channel].chip_head[chip].die_head[die1].plane_head[plane1].erase_node==NULL)||               
-            ((command!=INTERLEAVE_TWO_PLANE)&&(command!=INTERLEAVE)&&(command!=TWO_PLANE)&&(command!=NORMAL)))     /*如果没有擦除操作，或者command不对，返回错误*/           
+    if (block>=data_block_plane(ssd))
     {
-        return ERROR;
+        return;
     }
-
-    /************************************************************************************************************
+    if (ssd->parameter->free_block_policy==0)
+    {
+        p_plane->free_map[block/64]|=(1ULL<<(block%64));
+        return;
+    }
+    if (p_plane->blk_head[block].pooled==1)
+    {
+        return;
+    }
+
+    p_plane->blk_head[block].pooled=1;
+    if (ssd->parameter->free_block_policy==1)
+    {
+        p_plane->free_block[(p_plane->free_block_head+p_plane->free_block_num)%ssd->parameter->block_plane]=block;
+        p_plane->free_block_num++;
+        return;
+    }
+
+    i=p_plane->free_block_num++;
+    p_plane->free_block[i]=block;
+    while (i>0)
+    {
+        parent=(i-1)/2;
+        if (p_plane->blk_head[p_plane->free_block[parent]].erase_count<=p_plane->blk_head[p_plane->free_block[i]].erase_count)
+        {
+            break;
+        }
+        tmp=p_plane->free_block[parent];
+        p_plane->free_block[parent]=p_plane->free_block[i];
+        p_plane->free_block[i]=tmp;
+        i=parent;
+    }
+}
+
+/*****************************************************************************************
+ *从plane的空闲块池中取出下一个有空闲页的块，没有时返回-1。池中的块可能已经被写满(例如
+ *make_aged之后)，取出时跳过这些块。位图按地址顺序从from之后查找，和原来逐块扫描的顺序相同
+ *****************************************************************************************/
+int free_block_pop(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int from)
+{
+    unsigned int i=0,block=0,child=0,tmp=0,words=0,word=0,n=0;
+    unsigned long long bits=0;
+    struct plane_info *p_plane=&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane];
+
+    if (ssd->parameter->free_block_policy==0)
+    {
+        words=(data_block_plane(ssd)+63)/64;
+        word=((from+1)%data_block_plane(ssd))/64;
+        bits=p_plane->free_map[word]&(~0ULL<<(((from+1)%data_block_plane(ssd))%64));
+        for (n=0;n<=words;n++)
+        {
+            while (bits!=0)
+            {
+                block=word*64+__builtin_ctzll(bits);
+                bits&=bits-1;
+                if (p_plane->blk_head[block].free_page_num==0)
+                {
+                    p_plane->free_map[word]&=~(1ULL<<(block%64));
+                }
+                else if (!is_open_block(ssd,p_plane,block))
+                {
+                    return block;
+                }
+            }
+            word=(word+1)%words;
+            bits=p_plane->free_map[word];
+        }
+        return -1;
+    }
+
+    while (p_plane->free_block_num>0)
+    {
+        if (ssd->parameter->free_block_policy==1)
+        {
+            block=p_plane->free_block[p_plane->free_block_head];
+            p_plane->free_block_head=(p_plane->free_block_head+1)%ssd->parameter->block_plane;
+            p_plane->free_block_num--;
+        }
+        else
+        {
+            block=p_plane->free_block[0];
+            p_plane->free_block[0]=p_plane->free_block[--p_plane->free_block_num];
+            i=0;
+            while ((child=2*i+1)<p_plane->free_block_num)
+            {
+                if ((child+1<p_plane->free_block_num)&&(p_plane->blk_head[p_plane->free_block[child+1]].erase_count<p_plane->blk_head[p_plane->free_block[child]].erase_count))
+                {
+                    child++;
+                }
+                if (p_plane->blk_head[p_plane->free_block[i]].erase_count<=p_plane->blk_head[p_plane->free_block[child]].erase_count)
+                {
+                    break;
+                }
+                tmp=p_plane->free_block[i];
+                p_plane->free_block[i]=p_plane->free_block[child];
+                p_plane->free_block[child]=tmp;
+                i=child;
+            }
+        }
+        p_plane->blk_head[block].pooled=0;
+        if ((p_plane->blk_head[block].free_page_num>0)&&(!is_open_block(ssd,p_plane,block)))
+        {
+            return block;
+        }
+    }
+    return -1;
+}
+
+/*****************************************************************************************
+ *判断块是不是plane中某个stream正在写的活跃块，活跃块不能被GC选中，也不能再分给别的stream
+ *****************************************************************************************/
+int is_open_block(struct ssd_info *ssd,struct plane_info *p_plane,unsigned int block)
+{
+    unsigned int i=0;
+
+    if (block==p_plane->active_block)
+    {
+        return 1;
+    }
+    for (i=1;i<ssd->parameter->stream_count;i++)
+    {
+        if (p_plane->stream_block[i]==block)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*****************************************************************************************
+ *找到写子请求所属stream的活跃块。stream 0使用plane的active_block；其他stream在自己的活跃块
+ *写满后从空闲块池中取一个新块，池中没有空闲块时和stream 0共用活跃块
+ *****************************************************************************************/
+Status find_stream_block(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int stream,unsigned int *block)
+{
+    unsigned int s=0;
+    int new_block=0;
+    struct plane_info *p_plane=&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane];
+
+    if (ssd->parameter->stream_count>1)
+    {
+        if (stream<ssd->parameter->stream_count)
+            s=stream;
+        else if (ssd->parameter->stream_fallback==0)
+            s=stream%ssd->parameter->stream_count;
+    }
+
+    if (s!=0)
+    {
+        if ((p_plane->stream_block[s]!=0xffffffff)&&(p_plane->blk_head[p_plane->stream_block[s]].free_page_num>0))
+        {
+            *block=p_plane->stream_block[s];
+            return SUCCESS;
+        }
+        new_block=free_block_pop(ssd,channel,chip,die,plane,(p_plane->stream_block[s]!=0xffffffff)?p_plane->stream_block[s]:p_plane->active_block);
+        if (new_block>=0)
+        {
+            p_plane->stream_block[s]=new_block;
+            *block=new_block;
+            return SUCCESS;
+        }
+        p_plane->stream_block[s]=0xffffffff;
+        ssd->stream_fallback_count++;
+    }
+
+    if (find_active_block(ssd,channel,chip,die,plane)==FAILURE)
+    {
+        return FAILURE;
+    }
+    *block=p_plane->active_block;
+    return SUCCESS;
+}
+
+
+/**************************************************************************************
+ *这个函数的功能是处理INTERLEAVE_TWO_PLANE，INTERLEAVE，TWO_PLANE，NORMAL下的擦除的操作。
+ ***************************************************************************************/
+Status erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die1, unsigned int plane1,unsigned int command)
+{
+    unsigned int die=0;
+    unsigned int plane=0;
+    unsigned int block=0;
+    struct direct_erase *direct_erase_node=NULL;
+    unsigned int block0=0xffffffff;
+    unsigned int block1=0;
+
+    if((ssd->channel_head[channel].chip_head[chip].die_head[die1].plane_head[plane1].erase_node==NULL)||               
+            ((command!=INTERLEAVE_TWO_PLANE)&&(command!=INTERLEAVE)&&(command!=TWO_PLANE)&&(command!=NORMAL)))     /*如果没有擦除操作，或者command不对，返回错误*/           
+    {
+        return ERROR;
+    }
+
+    /************************************************************************************************************
      *处理擦除操作时，首先要传送擦除命令，这是channel，chip处于传送命令的状态，即CHANNEL_TRANSFER，CHIP_ERASE_BUSY
      *下一状态是CHANNEL_IDLE，CHIP_IDLE。
      *************************************************************************************************************/
@@ -779,8 +1246,8 @@ Status erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int ch
         }
 
         ssd->interleave_mplane_erase_count++;                             /*发送了一个interleave two plane erase命令,并计算这个处理的时间，以及下一个状态的时间*/
-        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+18*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tWB;       
-        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time-9*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tBERS;
+        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,18)+ssd->parameter->time_characteristics.tWB;       
+        ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time-bus_ca_time(ssd,9)+ssd->parameter->time_characteristics.tBERS;
 
     }
     else if(command==INTERLEAVE)                                          /*高级命令INTERLEAVE的处理*/
@@ -807,7 +1274,7 @@ Status erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int ch
             }
         }
         ssd->interleave_erase_count++;
-        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;       
+        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);       
         ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tBERS;
     }
     else if(command==TWO_PLANE)                                          /*高级命令TWO_PLANE的处理*/
@@ -831,7 +1298,7 @@ Status erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int ch
         }
 
         ssd->mplane_erase_conut++;
-        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+14*ssd->parameter->time_characteristics.tWC;      
+        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,14);      
         ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tBERS;
     }
     else if(command==NORMAL)                                             /*普通命令NORMAL的处理*/
@@ -844,7 +1311,7 @@ Status erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int ch
         erase_operation(ssd,channel,chip,die1,plane1,block);
 
         ssd->direct_erase_count++;
-        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+5*ssd->parameter->time_characteristics.tWC;       								
+        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,5);       								
         ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tWB+ssd->parameter->time_characteristics.tBERS;	
     }
     else
@@ -987,13 +1454,14 @@ int gc_direct_erase(struct ssd_info *ssd,unsigned int channel,unsigned int chip,
 Status move_page(struct ssd_info * ssd, struct local *location, unsigned int * transfer_size)
 {
     struct local *new_location=NULL;
-    unsigned int free_state=0,valid_state=0,cached_page=0;
-    unsigned int lpn=0,old_ppn=0,ppn=0;
-
-    lpn=ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].lpn;
-    cached_page=ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page;
-    valid_state=ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].valid_state;
-    free_state=ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].free_state;
+    subpage_mask free_state=0,valid_state=0,cached_page=0;
+    int64_t lpn=0,old_ppn=0,ppn=0;
+    struct buffer_group *node=NULL;
+
+    lpn=get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->lpn;
+    cached_page=get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page;
+    valid_state=get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state;
+    free_state=get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->free_state;
     old_ppn=find_ppn(ssd,location->channel,location->chip,location->die,location->plane,location->block,location->page);     /*Record the ppn of this effective mobile page, compare the ppn in the map or the additional mapping relationship, and perform deletion and addition operations*/
 
     ppn=get_ppn_for_gc(ssd,location->channel,location->chip,location->die,location->plane);                /*The found ppn must be in the plane where the gc operation occurs, so that the copyback operation can be used to obtain the ppn for the gc operation*/
@@ -1010,12 +1478,12 @@ Status move_page(struct ssd_info * ssd, struct local *location, unsigned int * t
             ssd->gc_copy_back++;
             while (old_ppn%2!=ppn%2)
             {
-                //if(ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page==1)  //changes_1
+                //if(get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page==1)  //changes_1
                 //{
-                ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].free_state=0;
-                ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].lpn=0;
-                ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].valid_state=0;
-                ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].cached_page=0;
+                get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->free_state=0;
+                get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->lpn=0;
+                get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->valid_state=0;
+                get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->cached_page=0;
                 ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].invalid_page_num++;
                 ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].cached_pages_num--; //changes_1
 
@@ -1034,12 +1502,12 @@ Status move_page(struct ssd_info * ssd, struct local *location, unsigned int * t
                 new_location=find_location(ssd,ppn);
             }
 
-            //if(ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page==0)  //changes_1
+            //if(get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page==0)  //changes_1
             //{
-            ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].free_state=free_state;
-            ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].lpn=lpn;
-            ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].valid_state=valid_state;
-            ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].cached_page=cached_page;
+            get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->free_state=free_state;
+            get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->lpn=lpn;
+            get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->valid_state=valid_state;
+            get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->cached_page=cached_page;
             ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].cached_pages_num++;
            // }
         } 
@@ -1063,22 +1531,35 @@ Status move_page(struct ssd_info * ssd, struct local *location, unsigned int * t
         (* transfer_size)+=size(valid_state);
     }
     //new location 
-    ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].free_state=free_state;
-    ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].lpn=lpn;
-    ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].valid_state=valid_state;
-    ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].page_head[new_location->page].cached_page=cached_page;
+    get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->free_state=free_state;
+    get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->lpn=lpn;
+    get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->valid_state=valid_state;
+    get_page(ssd,&ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block],new_location->page)->cached_page=cached_page;
     ssd->channel_head[new_location->channel].chip_head[new_location->chip].die_head[new_location->die].plane_head[new_location->plane].blk_head[new_location->block].cached_pages_num++;
 
     //old location 
-    ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].free_state=0;
-    ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].lpn=0;
-    ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].valid_state=0;
-    ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].page_head[location->page].cached_page=0;
+    get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->free_state=0;
+    get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->lpn=0;
+    get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->valid_state=0;
+    get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block],location->page)->cached_page=0;
     ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block].invalid_page_num++;
     
-    if (old_ppn==ssd->dram->map->map_entry[lpn].pn)                                                     /*修改映射表*/
+    if (ssd->dram->map->submap!=NULL)                                                                   /*子页映射中页内的子页可能属于不同的逻辑页*/
+    {
+        subpage_move(ssd,old_ppn,ppn);
+    }
+    else if (old_ppn==get_entry(ssd,lpn)->pn)                                                /*修改映射表*/
+    {
+        get_entry(ssd,lpn)->pn=ppn;
+        dftl_update(ssd,lpn);
+    }
+    if (ssd->parameter->gc_buffer_aware!=0)                                                  /*buffer中的节点改为计入新的位置*/
     {
-        ssd->dram->map->map_entry[lpn].pn=ppn;
+        node=buffer_find(buffer_of(ssd,lpn),lpn);
+        if ((node!=NULL)&&(node->gc_ppn==old_ppn+1))
+        {
+            buffer_gc_account(ssd,node);
+        }
     }
 
     free(new_location);
@@ -1087,6 +1568,61 @@ Status move_page(struct ssd_info * ssd, struct local *location, unsigned int * t
     return SUCCESS;
 }
 
+/*****************************************************************************************
+ *gc buffer aware：写buffer中有这一页的脏的新数据，而且覆盖了页中所有有效的子页时，这一页不用迁移，
+ *直接置为失效并清空映射项，新数据写回时按第一次写处理。返回SUCCESS表示这一页不用迁移
+ *****************************************************************************************/
+Status gc_buffer_absorb(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page)
+{
+    struct blk_info *p_blk=&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block];
+    struct page_info *p_page=get_page(ssd,p_blk,page);
+    struct buffer_group *node=NULL;
+    struct entry *entry=NULL;
+    int64_t lpn=p_page->lpn;
+
+    if (ssd->parameter->gc_buffer_aware==0)
+    {
+        return FAILURE;
+    }
+    node=buffer_find(buffer_of(ssd,lpn),lpn);
+    entry=find_entry(ssd,lpn);
+    if ((node==NULL)||(entry==NULL)||(entry->pn!=find_ppn(ssd,channel,chip,die,plane,block,page))||((node->dirty_clean&p_page->valid_state)!=p_page->valid_state))
+    {
+        return FAILURE;
+    }
+
+    buffer_gc_release(ssd,node);
+    p_page->valid_state=0;
+    p_page->free_state=0;
+    p_page->lpn=0;
+    p_page->cached_page=0;
+    p_blk->cached_pages_num--;
+    p_blk->invalid_page_num++;
+    entry->pn=0;
+    entry->state=0;
+    ssd->gc_absorb_count++;
+    return SUCCESS;
+}
+
+/*gc buffer aware时在原来按cached_pages_num选块的基础上，再加上写buffer中有新数据、gc时不用迁移的页数；没有可以回收的块时返回-1*/
+int gc_buffer_victim(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane)
+{
+    struct plane_info *p_plane=&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane];
+    unsigned int i;
+    int block=-1,gain,best=0;
+
+    for (i=0;i<data_block_plane(ssd);i++)
+    {
+        gain=(int)p_plane->blk_head[i].cached_pages_num+p_plane->blk_head[i].buffered_pages_num;
+        if ((gain>best)&&(!is_open_block(ssd,p_plane,i)))
+        {
+            best=gain;
+            block=i;
+        }
+    }
+    return block;
+}
+
 /*******************************************************************************************************************************************
 *  The target plane does not have a block that can be deleted directly. It is necessary to find the target erase block before performing the erase operation. It is used in uninterruptible gc operations. If a block is successfully deleted, it returns 1, and if a block is not deleted, it returns -1
  * In this function, regardless of whether the target channel or die is free, erase the block with the most invalid_page_num.
@@ -1096,7 +1632,7 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
 {
     // printf("U_GC");
     unsigned int i=0,invalid_page=0;
-    unsigned int block,active_block,transfer_size,free_page,page_move_count=0;                           /*Record the block number with the most failed pages*/
+    unsigned int block,transfer_size,free_page,page_move_count=0;                                        /*Record the block number with the most failed pages*/
     struct local *  location=NULL;
     unsigned int total_invalid_page_num=0;
     unsigned int total_cached_page_num=0;
@@ -1107,7 +1643,6 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
         printf("\n\n Error in uninterrupt_gc().\n");
         return ERROR;
     }
-    active_block=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block;
 
     invalid_page=0;
     transfer_size=0;
@@ -1119,7 +1654,7 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
     fp = fopen(filename, "w");
 
 
-    for(i=0;i<ssd->parameter->block_plane;i++)               /*Find the block number with the most invalid_page, and the largest invalid_page_num*/
+    for(i=0;i<data_block_plane(ssd);i++)               /*Find the block number with the most invalid_page, and the largest invalid_page_num*/
     {	
 
 
@@ -1149,7 +1684,7 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
 
         total_cached_page_num+=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num;
 
-        if((active_block!=i)&&(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num > cached_page))						
+        if((!is_open_block(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane],i))&&(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num > cached_page))						
         {				
             cached_page=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num;
             block=i;
@@ -1158,6 +1693,11 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
         
     }
 
+    if (ssd->parameter->gc_buffer_aware!=0)
+    {
+        block=gc_buffer_victim(ssd,channel,chip,die,plane);
+    }
+
     if(fp)
     {
         fprintf(fp, "Block number= %d is Selected as Victim Block\n",block);
@@ -1179,7 +1719,7 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
     free_page=0;
     for(i=0;i<ssd->parameter->page_block;i++)		                                                     /*Check each page one by one, if the page with valid data needs to be moved to other places for storage*/	
     {		
-        if ((ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].free_state&PG_SUB)==0x0000000f)
+        if ((get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],i)->free_state&PG_SUB)==0x0000000f)
         {
             free_page++;
         }
@@ -1188,8 +1728,12 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
             printf("\ntoo much free page. \t %d\t .%d\t%d\t%d\t%d\t\n",free_page,channel,chip,die,plane);
         }
 
-        if(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].valid_state>0)  /*This page is a valid page and requires copyback operation*/		
+        if(get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],i)->valid_state>0)  /*This page is a valid page and requires copyback operation*/		
         {	
+            if (gc_buffer_absorb(ssd,channel,chip,die,plane,block,i)==SUCCESS)                             /*写buffer中有新数据，不用迁移*/
+            {
+                continue;
+            }
             location=(struct local * )malloc(sizeof(struct local ));
             alloc_assert(location,"location");
             memset(location,0, sizeof(struct local));
@@ -1225,14 +1769,14 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
     {
         if (ssd->parameter->greed_CB_ad==1)
         {
-            ssd->channel_head[channel].next_state_predict_time=ssd->current_time+page_move_count*(7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tPROG);			
+            ssd->channel_head[channel].next_state_predict_time=ssd->current_time+compute_gc_move_time(ssd,page_move_count,page_move_count*bus_ca_time(ssd,14));			
             ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tBERS;
         } 
     } 
     else
     {
 
-        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+page_move_count*(7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tPROG)+transfer_size*SECTOR*(ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tRC);
+        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+compute_gc_move_time(ssd,page_move_count,page_move_count*bus_ca_time(ssd,14)+bus_data_out_time(ssd,transfer_size*SECTOR)+bus_data_in_time(ssd,transfer_size*SECTOR));
         ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tBERS;
     }
 
@@ -1244,6 +1788,31 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
 }
 
 
+/**********************************************************************************************
+ *计算gc迁移page_move_count个有效页所需的时间，bus_time是这些页在channel上的命令和数据传输总时间
+ *每页在阵列上需要tR+tPROG，不支持cache时传输与阵列操作串行；
+ *支持cache read/cache program(AD_CACHE)时，后一页的传输与前一页的阵列操作重叠，只有第一页的传输不能隐藏
+ ***********************************************************************************************/
+int64_t compute_gc_move_time(struct ssd_info *ssd,unsigned int page_move_count,int64_t bus_time)
+{
+    int64_t array_time=0,bus_per_page=0;
+
+    array_time=ssd->parameter->time_characteristics.tR+ssd->parameter->time_characteristics.tPROG;
+    if (((ssd->parameter->advanced_commands&AD_CACHE)!=AD_CACHE)||(page_move_count<2))
+    {
+        return page_move_count*array_time+bus_time;
+    }
+
+    ssd->gc_cache_pipeline_count+=page_move_count-1;
+    bus_per_page=bus_time/page_move_count;
+    if (bus_per_page>array_time)                                                       /*channel是瓶颈*/
+    {
+        return page_move_count*bus_per_page+array_time;
+    }
+    return bus_per_page+page_move_count*array_time;                                    /*阵列是瓶颈*/
+}
+
+
 /*******************************************************************************************************************************************
 *  The target plane does not have a block that can be deleted directly. It needs to find the target erase block and then implement the erase operation. It is used in the gc operation that can be interrupted. If a block is successfully deleted, it returns 1, and if a block is not deleted, it returns -1
  * In this function, it is not necessary to consider whether the target channel, die is free or not
@@ -1252,10 +1821,10 @@ int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,u
 int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,struct gc_operation *gc_node)        
 {
     // printf("I_GC");
-    unsigned int i,block,active_block,transfer_size,invalid_page=0, cached_page=0;
+    unsigned int i,block,transfer_size,invalid_page=0, cached_page=0;
+    unsigned int absorbed=0;
     struct local *location;
 
-    active_block=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].active_block;
     transfer_size=0;
 
     FILE *fp;
@@ -1277,7 +1846,7 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
 
     if (gc_node->block>=ssd->parameter->block_plane)
     {
-        for(i=0;i<ssd->parameter->block_plane;i++)
+        for(i=0;i<data_block_plane(ssd);i++)
         {	
             int invalid_value=ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].invalid_page_num;
 
@@ -1297,7 +1866,7 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
          if(fp)
             fprintf(fp, "Block Number = %d ------------------------------------------Cached Pages = %d\n",i, cache_value); 
         
-            if((active_block!=i)&&(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num>cached_page))						
+            if((!is_open_block(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane],i))&&(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num>cached_page))						
             {				
                 cached_page = ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[i].cached_pages_num;
                 block=i;
@@ -1312,6 +1881,15 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
         // printf("chck 777777\n"),
         // fprintf(fp, "Block-> %d is Selected as Victim Block\n", block);
 
+        if (ssd->parameter->gc_buffer_aware!=0)
+        {
+            block=gc_buffer_victim(ssd,channel,chip,die,plane);
+            if (block==(unsigned int)-1)
+            {
+                fclose(fp);
+                return 1;
+            }
+        }
         gc_node->block=block;
     }
 
@@ -1319,8 +1897,14 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
     {
         for (i=gc_node->page;i<ssd->parameter->page_block;i++)
         {
-            if (ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[gc_node->block].page_head[i].valid_state>0) 
+            if (get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[gc_node->block],i)->valid_state>0) 
             {
+                if (gc_buffer_absorb(ssd,channel,chip,die,plane,gc_node->block,i)==SUCCESS)                  /*写buffer中有新数据，不用迁移*/
+                {
+                    gc_node->page=i+1;
+                    absorbed++;
+                    continue;
+                }
                 location=(struct local * )malloc(sizeof(struct local ));
                 alloc_assert(location,"location");
                 memset(location,0, sizeof(struct local));
@@ -1329,7 +1913,7 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
                 location->chip=chip;
                 location->die=die;
                 location->plane=plane;
-                location->block=block;
+                location->block=gc_node->block;                                     /*block只在第一次选块时有值*/
                 location->page=i;
                 transfer_size=0;
 
@@ -1338,8 +1922,7 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
                 free(location);
                 location=NULL;
 
-                gc_node->page=i+1;
-                ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[gc_node->block].invalid_page_num++;
+                gc_node->page=i+1;                                                  /*move_page已经把原来的页置为失效*/
                 ssd->channel_head[channel].current_state=CHANNEL_C_A_TRANSFER;									
                 ssd->channel_head[channel].current_time=ssd->current_time;										
                 ssd->channel_head[channel].next_state=CHANNEL_IDLE;	
@@ -1349,12 +1932,12 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
 
                 if ((ssd->parameter->advanced_commands&AD_COPYBACK)==AD_COPYBACK)
                 {					
-                    ssd->channel_head[channel].next_state_predict_time=ssd->current_time+7*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+7*ssd->parameter->time_characteristics.tWC;		
+                    ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+ssd->parameter->time_characteristics.tR+bus_ca_time(ssd,7);		
                     ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
                 } 
                 else
                 {	
-                    ssd->channel_head[channel].next_state_predict_time=ssd->current_time+(7+transfer_size*SECTOR)*ssd->parameter->time_characteristics.tWC+ssd->parameter->time_characteristics.tR+(7+transfer_size*SECTOR)*ssd->parameter->time_characteristics.tWC;					
+                    ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,7)+ssd->parameter->time_characteristics.tR+bus_data_out_time(ssd,transfer_size*SECTOR)+bus_ca_time(ssd,7)+bus_data_in_time(ssd,transfer_size*SECTOR);					
                     ssd->channel_head[channel].chip_head[chip].next_state_predict_time=ssd->channel_head[channel].next_state_predict_time+ssd->parameter->time_characteristics.tPROG;
                 }
                 
@@ -1364,14 +1947,14 @@ int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,uns
             }
         }
     }
-    else
+    if ((absorbed!=0)||(ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[gc_node->block].invalid_page_num==ssd->parameter->page_block))    /*剩下的有效页都不用迁移时直接擦除*/
     {
         erase_operation(ssd,channel ,chip, die,plane,gc_node->block);	
 
         ssd->channel_head[channel].current_state=CHANNEL_C_A_TRANSFER;									
         ssd->channel_head[channel].current_time=ssd->current_time;										
         ssd->channel_head[channel].next_state=CHANNEL_IDLE;								
-        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+5*ssd->parameter->time_characteristics.tWC;
+        ssd->channel_head[channel].next_state_predict_time=ssd->current_time+bus_ca_time(ssd,5);
 
         ssd->channel_head[channel].chip_head[chip].current_state=CHIP_ERASE_BUSY;								
         ssd->channel_head[channel].chip_head[chip].current_time=ssd->current_time;						
@@ -1514,6 +2097,20 @@ Status gc_for_channel(struct ssd_info *ssd, unsigned int channel)
     {
         return FAILURE;
     }
+    /*********************************************************************************************
+     *gc按一个擦除操作经过功耗预算。不可中断的gc在数据迁移和擦除期间chip一直是CHIP_ERASE_BUSY，
+     *迁移的编程都算在这一个擦除名额里；可中断的gc每一步都重新经过预算，迁移时chip是CHIP_COPYBACK_BUSY，
+     *在之后的预算中按编程计
+     **********************************************************************************************/
+    if(power_budget_admit(ssd,CHIP_ERASE_BUSY,(gc_node->priority==GC_UNINTERRUPT)?TRUE:FALSE)==FALSE)    /*超出功耗预算，gc请求留在队列中等待*/
+    {
+        if (gc_node->power_deferred==0)
+        {
+            gc_node->power_deferred=1;
+            ssd->power_cap_gc_defer++;
+        }
+        return FAILURE;
+    }
 
     // check whether gcsync active or not. If active check whether 
     // GC can be started or not
@@ -1563,6 +2160,7 @@ Status gc_for_channel(struct ssd_info *ssd, unsigned int channel)
             gc_node->x_end_time = ssd->channel_head[channel].next_state_predict_time;
             delete_gc_node(ssd,channel,gc_node);
         }
+        power_budget_start(ssd);
         return SUCCESS;
     }
     /*******************************************************************************
@@ -1589,6 +2187,7 @@ Status gc_for_channel(struct ssd_info *ssd, unsigned int channel)
                 gc_node->x_end_time = ssd->channel_head[channel].chip_head[chip].next_state_predict_time;
                 delete_gc_node(ssd,channel,gc_node);
             }
+            power_budget_start(ssd);
             return SUCCESS;
         } 
         else
@@ -1724,3 +2323,1126 @@ int decide_gc_invoke(struct ssd_info *ssd, unsigned int channel)
     }
 }
 
+
+
+/*****************************************************************************************
+ *DFTL中数据可以使用的块数，每个plane最后的translation block不参与数据的分配和gc
+ *****************************************************************************************/
+unsigned int data_block_plane(struct ssd_info *ssd)
+{
+    if (ssd->dram->map->dftl==NULL)
+    {
+        return ssd->parameter->block_plane;
+    }
+    return ssd->parameter->block_plane-ssd->dram->map->dftl->blocks;
+}
+
+/*****************************************************************************************
+ *total个页(或扇区)中去掉overprovide后用户可以使用的数目，overprovide是float，用double计算避免大容量时丢精度
+ *****************************************************************************************/
+int64_t user_capacity(struct ssd_info *ssd,int64_t total)
+{
+    return (int64_t)((double)total*(1.0-ssd->parameter->overprovide));
+}
+
+/*****************************************************************************************
+ *把所有plane按channel，chip，die，plane的顺序编号，求出第index个plane的位置
+ *****************************************************************************************/
+void plane_location(struct ssd_info *ssd,unsigned int index,struct local *location)
+{
+    unsigned int channel=0,plane_chip=0;
+
+    plane_chip=ssd->parameter->die_chip*ssd->parameter->plane_die;
+    for (channel=0;channel<ssd->parameter->channel_number;channel++)
+    {
+        if (index<ssd->parameter->chip_channel[channel]*plane_chip)
+        {
+            break;
+        }
+        index-=ssd->parameter->chip_channel[channel]*plane_chip;
+    }
+    memset(location,0,sizeof(struct local));
+    location->channel=channel;
+    location->chip=index/plane_chip;
+    location->die=(index%plane_chip)/ssd->parameter->plane_die;
+    location->plane=index%ssd->parameter->plane_die;
+}
+
+/*****************************************************************************************
+ *CMT的slot链表操作，head是最近插入(LRU时也是最近访问)的slot，tail是LRU/FIFO的替换对象
+ *****************************************************************************************/
+void cmt_unlink(struct dftl_info *dftl,int slot)
+{
+    if (dftl->prev[slot]!=-1)
+        dftl->next[dftl->prev[slot]]=dftl->next[slot];
+    else
+        dftl->head=dftl->next[slot];
+    if (dftl->next[slot]!=-1)
+        dftl->prev[dftl->next[slot]]=dftl->prev[slot];
+    else
+        dftl->tail=dftl->prev[slot];
+    dftl->prev[slot]=-1;
+    dftl->next[slot]=-1;
+}
+
+void cmt_push(struct dftl_info *dftl,int slot)
+{
+    dftl->prev[slot]=-1;
+    dftl->next[slot]=dftl->head;
+    if (dftl->head!=-1)
+        dftl->prev[dftl->head]=slot;
+    dftl->head=slot;
+    if (dftl->tail==-1)
+        dftl->tail=slot;
+}
+
+void cmt_touch(struct ssd_info *ssd,int slot)
+{
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+
+    switch (ssd->parameter->mapping_cache_policy)
+    {
+        case 1:                                                                         /*FIFO，命中不改变顺序*/
+            break;
+        case 2:                                                                         /*CLOCK，只置访问位*/
+            dftl->slot_ref[slot]=1;
+            break;
+        default:                                                                        /*LRU*/
+            cmt_unlink(dftl,slot);
+            cmt_push(dftl,slot);
+            break;
+    }
+}
+
+int cmt_victim(struct ssd_info *ssd)
+{
+    int slot=0;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+
+    if (ssd->parameter->mapping_cache_policy!=2)
+    {
+        return dftl->tail;
+    }
+    while (dftl->slot_ref[dftl->hand]!=0)
+    {
+        dftl->slot_ref[dftl->hand]=0;
+        dftl->hand=(dftl->hand+1)%dftl->count;
+    }
+    slot=dftl->hand;
+    dftl->hand=(dftl->hand+1)%dftl->count;
+    return slot;
+}
+
+/*****************************************************************************************
+ *在所有plane的translation block中轮流分配一个空闲页。每个plane只有一个正在写的块，没有时取一个
+ *空闲块；空闲块只剩一个时先对translation block做gc，保证gc总有一个空闲块可以写
+ *****************************************************************************************/
+int dftl_active_block(struct ssd_info *ssd,struct local *location)
+{
+    unsigned int i=0,empty=0;
+    int block=-1;
+    struct plane_info *p_plane=NULL;
+
+    p_plane=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane];
+    for (i=data_block_plane(ssd);i<ssd->parameter->block_plane;i++)
+    {
+        if ((p_plane->blk_head[i].free_page_num>0)&&(p_plane->blk_head[i].last_write_page>=0))
+        {
+            return i;
+        }
+        if (p_plane->blk_head[i].free_page_num==ssd->parameter->page_block)
+        {
+            empty++;
+            if (block==-1)
+                block=i;
+        }
+    }
+    if ((empty<=1)&&(dftl_gc(ssd,location)==SUCCESS))
+    {
+        return dftl_active_block(ssd,location);
+    }
+    return block;
+}
+
+int64_t dftl_alloc_page(struct ssd_info *ssd,unsigned int tvpn)
+{
+    unsigned int n=0,plane_num=0,page=0;
+    int block=-1;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+    struct local location;
+    struct blk_info *p_blk=NULL;
+
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    for (n=0;n<plane_num;n++)
+    {
+        plane_location(ssd,dftl->plane_token,&location);
+        dftl->plane_token=(dftl->plane_token+1)%plane_num;
+        block=dftl_active_block(ssd,&location);
+        if (block!=-1)
+        {
+            break;
+        }
+    }
+    if (block==-1)
+    {
+        printf("\nERROR ! No free translation page.\n");
+        exit(100);
+    }
+
+    p_blk=&ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].blk_head[block];
+    page=p_blk->last_write_page+1;
+    p_blk->last_write_page++;
+    p_blk->free_page_num--;
+    get_page(ssd,p_blk,page)->valid_state=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    get_page(ssd,p_blk,page)->free_state=0;
+    get_page(ssd,p_blk,page)->lpn=tvpn;
+    get_page(ssd,p_blk,page)->written_count++;
+    ssd->channel_head[location.channel].chip_head[location.chip].map_write_pending++;
+
+    return find_ppn(ssd,location.channel,location.chip,location.die,location.plane,block,page);
+}
+
+void dftl_invalidate_page(struct ssd_info *ssd,int64_t ppn)
+{
+    struct local *location=NULL;
+    struct blk_info *p_blk=NULL;
+
+    location=find_location(ssd,ppn);
+    p_blk=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[location->block];
+    get_page(ssd,p_blk,location->page)->valid_state=0;
+    get_page(ssd,p_blk,location->page)->lpn=0;
+    p_blk->invalid_page_num++;
+    free(location);
+    location=NULL;
+}
+
+/*****************************************************************************************
+ *translation block的gc：选择无效页最多的已写满的块，把其中的有效translation page搬到空闲块里，
+ *更新gtd后擦除。搬移和擦除的时间记在chip上，等chip空闲时由dftl_flush执行
+ *****************************************************************************************/
+Status dftl_gc(struct ssd_info *ssd,struct local *location)
+{
+    unsigned int i=0,page=0,tvpn=0;
+    int block=-1,target=-1;
+    unsigned int invalid_page=0;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+    struct chip_info *p_chip=NULL;
+    struct plane_info *p_plane=NULL;
+
+    p_chip=&ssd->channel_head[location->channel].chip_head[location->chip];
+    p_plane=&p_chip->die_head[location->die].plane_head[location->plane];
+    for (i=data_block_plane(ssd);i<ssd->parameter->block_plane;i++)
+    {
+        if ((p_plane->blk_head[i].free_page_num==0)&&(p_plane->blk_head[i].invalid_page_num>invalid_page))
+        {
+            invalid_page=p_plane->blk_head[i].invalid_page_num;
+            block=i;
+        }
+        if ((target==-1)&&(p_plane->blk_head[i].free_page_num==ssd->parameter->page_block))
+        {
+            target=i;
+        }
+    }
+    if ((block==-1)||(target==-1))
+    {
+        return FAILURE;
+    }
+
+    for (i=0;i<ssd->parameter->page_block;i++)
+    {
+        if (get_page(ssd,&p_plane->blk_head[block],i)->valid_state>0)
+        {
+            tvpn=get_page(ssd,&p_plane->blk_head[block],i)->lpn;
+            page=p_plane->blk_head[target].last_write_page+1;
+            p_plane->blk_head[target].last_write_page++;
+            p_plane->blk_head[target].free_page_num--;
+            get_page(ssd,&p_plane->blk_head[target],page)->valid_state=get_page(ssd,&p_plane->blk_head[block],i)->valid_state;
+            get_page(ssd,&p_plane->blk_head[target],page)->free_state=0;
+            get_page(ssd,&p_plane->blk_head[target],page)->lpn=tvpn;
+            get_page(ssd,&p_plane->blk_head[target],page)->written_count++;
+            dftl->gtd[tvpn]=find_ppn(ssd,location->channel,location->chip,location->die,location->plane,target,page);
+            p_chip->map_read_pending++;
+            p_chip->map_write_pending++;
+            dftl->gc_move_count++;
+        }
+    }
+
+    erase_operation(ssd,location->channel,location->chip,location->die,location->plane,block);
+    p_plane->free_page-=ssd->parameter->page_block;                                 /*translation block不计入plane的free_page*/
+    p_chip->map_erase_pending++;
+    dftl->gc_count++;
+
+    return SUCCESS;
+}
+
+/*****************************************************************************************
+ *把tvpn这个translation page中在CMT里被修改过的映射项一起写回：先读出旧的translation page，
+ *再写到新的位置，旧页置为无效
+ *****************************************************************************************/
+void dftl_writeback(struct ssd_info *ssd,unsigned int tvpn)
+{
+    int64_t lpn=0,end=0;
+    unsigned int slot=0;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+    struct local *location=NULL;
+    struct entry *p_entry=NULL;
+
+    end=((int64_t)tvpn+1)*dftl->entry_per_page;
+    if (end>ssd->page)
+        end=ssd->page;
+    for (lpn=(int64_t)tvpn*dftl->entry_per_page;lpn<end;lpn++)
+    {
+        p_entry=find_entry(ssd,lpn);
+        if (p_entry==NULL)
+        {
+            lpn|=MAP_LEAF-1;
+            continue;
+        }
+        slot=p_entry->cmt_slot;
+        if (slot!=0)
+        {
+            dftl->slot_dirty[slot-1]=0;
+        }
+    }
+
+    location=find_location(ssd,dftl->gtd[tvpn]);
+    ssd->channel_head[location->channel].chip_head[location->chip].map_read_pending++;
+    free(location);
+    location=NULL;
+    dftl_invalidate_page(ssd,dftl->gtd[tvpn]);
+    dftl->gtd[tvpn]=dftl_alloc_page(ssd,tvpn);
+
+    dftl->trans_read_count++;
+    dftl->trans_write_count++;
+    dftl->writeback_count++;
+}
+
+/*****************************************************************************************
+ *把lpn的映射项放入CMT，CMT满时按替换策略选择一个映射项替换出去，dirty的映射项需要写回
+ *****************************************************************************************/
+void cmt_insert(struct ssd_info *ssd,int64_t lpn,int dirty)
+{
+    int slot=0;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+
+    if (dftl->count<dftl->cache_size)
+    {
+        slot=dftl->count;
+        dftl->count++;
+    }
+    else
+    {
+        slot=cmt_victim(ssd);
+        if (dftl->slot_dirty[slot]!=0)
+        {
+            dftl_writeback(ssd,dftl->slot_lpn[slot]/dftl->entry_per_page);
+        }
+        get_entry(ssd,dftl->slot_lpn[slot])->cmt_slot=0;
+        cmt_unlink(dftl,slot);
+    }
+
+    dftl->slot_lpn[slot]=lpn;
+    dftl->slot_dirty[slot]=(dirty!=0);
+    dftl->slot_ref[slot]=1;
+    cmt_push(dftl,slot);
+    get_entry(ssd,lpn)->cmt_slot=slot+1;
+}
+
+/*****************************************************************************************
+ *DFTL中处理读写子请求前查找lpn的映射项。命中时按替换策略更新CMT；读请求不命中时，需要先读出
+ *translation page，返回的读子请求挂在req上，数据读子请求要等它完成后才能发出。写请求不命中时
+ *直接在CMT中插入dirty的映射项，不需要读translation page
+ *****************************************************************************************/
+struct sub_request *dftl_lookup(struct ssd_info *ssd,int64_t lpn,struct request *req,unsigned int operation)
+{
+    unsigned int slot=0;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+    struct sub_request *map_sub=NULL;
+    struct local *location=NULL;
+
+    if (dftl==NULL)
+    {
+        return NULL;
+    }
+
+    slot=get_entry(ssd,lpn)->cmt_slot;
+    if (slot!=0)
+    {
+        dftl->hit_count++;
+        cmt_touch(ssd,slot-1);
+        if (operation==WRITE)
+        {
+            dftl->slot_dirty[slot-1]=1;
+        }
+        return NULL;
+    }
+
+    dftl->miss_count++;
+    cmt_insert(ssd,lpn,operation==WRITE);
+    if (operation==READ)
+    {
+        if (req!=NULL)
+        {
+            map_sub=creat_map_sub_request(ssd,dftl->gtd[lpn/dftl->entry_per_page],req);
+        }
+        else
+        {
+            dftl->trans_read_count++;
+            location=find_location(ssd,dftl->gtd[lpn/dftl->entry_per_page]);
+            ssd->channel_head[location->channel].chip_head[location->chip].map_read_pending++;
+            free(location);
+            location=NULL;
+        }
+    }
+    return map_sub;
+}
+
+/*****************************************************************************************
+ *gc搬移有效页后修改映射项：映射项在CMT中时置为dirty，否则作为dirty的映射项插入CMT
+ *****************************************************************************************/
+void dftl_update(struct ssd_info *ssd,int64_t lpn)
+{
+    unsigned int slot=0;
+    struct dftl_info *dftl=ssd->dram->map->dftl;
+
+    if (dftl==NULL)
+    {
+        return;
+    }
+
+    slot=get_entry(ssd,lpn)->cmt_slot;
+    if (slot!=0)
+    {
+        dftl->slot_dirty[slot-1]=1;
+    }
+    else
+    {
+        cmt_insert(ssd,lpn,1);
+    }
+}
+
+
+/*****************************************************************************************
+ *块映射和FAST：lbn所在的plane，返回plane的编号
+ *****************************************************************************************/
+unsigned int blockmap_plane(struct ssd_info *ssd,unsigned int lbn,struct local *location)
+{
+    unsigned int index=0;
+
+    index=lbn%(ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num);
+    plane_location(ssd,index,location);
+    return index;
+}
+
+/*****************************************************************************************
+ *在plane中分配一个空闲块作为数据块或日志块。优先使用擦除过的块，没有时擦除一个没有有效页的块
+ *(例如make_aged产生的块)
+ *****************************************************************************************/
+int blockmap_alloc_block(struct ssd_info *ssd,unsigned int index,struct local *location)
+{
+    unsigned int i=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct plane_info *p_plane=NULL;
+
+    p_plane=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane];
+    for (i=0;i<ssd->parameter->block_plane;i++)
+    {
+        if ((blockmap->used[index*ssd->parameter->block_plane+i]==0)&&(p_plane->blk_head[i].free_page_num==ssd->parameter->page_block))
+        {
+            blockmap->used[index*ssd->parameter->block_plane+i]=1;
+            return i;
+        }
+    }
+    for (i=0;i<ssd->parameter->block_plane;i++)
+    {
+        if ((blockmap->used[index*ssd->parameter->block_plane+i]==0)&&(ssd->parameter->page_block-p_plane->blk_head[i].free_page_num==p_plane->blk_head[i].invalid_page_num))
+        {
+            blockmap_erase(ssd,index,location,i);
+            blockmap->used[index*ssd->parameter->block_plane+i]=1;
+            return i;
+        }
+    }
+
+    printf("\nERROR ! No free block in channel:%d, chip:%d, die:%d, plane:%d\n",location->channel,location->chip,location->die,location->plane);
+    exit(100);
+    return -1;
+}
+
+/*****************************************************************************************
+ *merge中擦除一个不再使用的块，擦除时间记在chip的merge_time上
+ *****************************************************************************************/
+void blockmap_erase(struct ssd_info *ssd,unsigned int index,struct local *location,unsigned int block)
+{
+    erase_operation(ssd,location->channel,location->chip,location->die,location->plane,block);
+    ssd->channel_head[location->channel].chip_head[location->chip].merge_time+=ssd->parameter->time_characteristics.tBERS;
+    ssd->dram->map->blockmap->used[index*ssd->parameter->block_plane+block]=0;
+    ssd->dram->map->blockmap->merge_erase_count++;
+}
+
+/*****************************************************************************************
+ *把lpn写到block的第page页，原来的物理页置为无效，修改map_entry
+ *****************************************************************************************/
+int64_t blockmap_program(struct ssd_info *ssd,struct local *location,unsigned int block,unsigned int page,int64_t lpn,subpage_mask state)
+{
+    subpage_mask full_page=0;
+    struct local *old=NULL;
+    struct blk_info *p_blk=NULL;
+
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    if (get_entry(ssd,lpn)->state!=0)
+    {
+        old=find_location(ssd,get_entry(ssd,lpn)->pn);
+        p_blk=&ssd->channel_head[old->channel].chip_head[old->chip].die_head[old->die].plane_head[old->plane].blk_head[old->block];
+        get_page(ssd,p_blk,old->page)->valid_state=0;
+        get_page(ssd,p_blk,old->page)->free_state=0;
+        get_page(ssd,p_blk,old->page)->lpn=0;
+        get_page(ssd,p_blk,old->page)->cached_page=0;
+        p_blk->invalid_page_num++;
+        free(old);
+        old=NULL;
+    }
+
+    p_blk=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[block];
+    get_page(ssd,p_blk,page)->lpn=lpn;
+    get_page(ssd,p_blk,page)->valid_state=state;
+    get_page(ssd,p_blk,page)->free_state=((~state)&full_page);
+    get_page(ssd,p_blk,page)->cached_page=state;
+    get_page(ssd,p_blk,page)->written_count++;
+    p_blk->free_page_num--;
+    if ((int)page>p_blk->last_write_page)
+    {
+        p_blk->last_write_page=page;
+    }
+    ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].free_page--;
+
+    get_entry(ssd,lpn)->pn=find_ppn(ssd,location->channel,location->chip,location->die,location->plane,block,page);
+    get_entry(ssd,lpn)->state=state;
+    get_entry(ssd,lpn)->trimmed=0;
+    return get_entry(ssd,lpn)->pn;
+}
+
+/*****************************************************************************************
+ *merge中把lpn的有效数据拷贝到block的第page页，在plane内部完成(读出再编程)，不占用channel
+ *****************************************************************************************/
+void blockmap_copy(struct ssd_info *ssd,struct local *location,unsigned int block,unsigned int page,int64_t lpn)
+{
+    blockmap_program(ssd,location,block,page,lpn,get_entry(ssd,lpn)->state);
+
+    ssd->channel_head[location->channel].chip_head[location->chip].merge_time+=ssd->parameter->time_characteristics.tR+ssd->parameter->time_characteristics.tPROG;
+    ssd->read_count++;
+    ssd->program_count++;
+    ssd->in_read_size+=ssd->parameter->subpage_page;
+    ssd->in_program_size+=ssd->parameter->subpage_page;
+    ssd->channel_head[location->channel].read_count++;
+    ssd->channel_head[location->channel].program_count++;
+    ssd->channel_head[location->channel].chip_head[location->chip].read_count++;
+    ssd->channel_head[location->channel].chip_head[location->chip].program_count++;
+    ssd->dram->map->blockmap->merge_page_count++;
+}
+
+int blockmap_page_free(struct ssd_info *ssd,struct local *location,unsigned int block,unsigned int page)
+{
+    struct page_info *p_page=NULL;
+
+    p_page=get_page(ssd,&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[block],page);
+    return (p_page->valid_state==0)&&(p_page->free_state==PG_SUB);
+}
+
+/*****************************************************************************************
+ *块映射的写：lpn只能写在数据块的第lpn%page_block页上，这一页已经写过时，把数据块中其他有效页
+ *拷贝到一个新块中，再擦除原来的块
+ *****************************************************************************************/
+int64_t block_map_write(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    unsigned int i=0,lbn=0,offset=0,index=0,block=0,new_block=0;
+    int64_t l=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct local location;
+
+    lbn=lpn/ssd->parameter->page_block;
+    offset=lpn%ssd->parameter->page_block;
+    index=blockmap_plane(ssd,lbn,&location);
+
+    if (blockmap->data_block[lbn]==0xffffffff)
+    {
+        blockmap->data_block[lbn]=blockmap_alloc_block(ssd,index,&location);
+    }
+    block=blockmap->data_block[lbn];
+    if (blockmap_page_free(ssd,&location,block,offset))
+    {
+        return blockmap_program(ssd,&location,block,offset,lpn,state);
+    }
+
+    new_block=blockmap_alloc_block(ssd,index,&location);
+    for (i=0;i<ssd->parameter->page_block;i++)
+    {
+        l=(int64_t)lbn*ssd->parameter->page_block+i;
+        if ((i!=offset)&&(l<ssd->page)&&(find_entry(ssd,l)!=NULL)&&(find_entry(ssd,l)->state!=0))
+        {
+            blockmap_copy(ssd,&location,new_block,i,l);
+        }
+    }
+    blockmap_program(ssd,&location,new_block,offset,lpn,state);
+    blockmap_erase(ssd,index,&location,block);
+    blockmap->data_block[lbn]=new_block;
+    blockmap->block_copy_count++;
+
+    return get_entry(ssd,lpn)->pn;
+}
+
+/*****************************************************************************************
+ *FAST中把逻辑块lbn的所有有效页合并到一个新的数据块中(full merge)，原数据块和只含lbn的顺序写
+ *日志块都被擦除
+ *****************************************************************************************/
+void fast_merge_lbn(struct ssd_info *ssd,unsigned int index,struct local *location,unsigned int lbn)
+{
+    unsigned int i=0,block=0;
+    int64_t l=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct log_plane *log=&blockmap->log[index];
+
+    block=blockmap_alloc_block(ssd,index,location);
+    for (i=0;i<ssd->parameter->page_block;i++)
+    {
+        l=(int64_t)lbn*ssd->parameter->page_block+i;
+        if ((l<ssd->page)&&(find_entry(ssd,l)!=NULL)&&(find_entry(ssd,l)->state!=0))
+        {
+            blockmap_copy(ssd,location,block,i,l);
+        }
+    }
+    if (blockmap->data_block[lbn]!=0xffffffff)
+    {
+        blockmap_erase(ssd,index,location,blockmap->data_block[lbn]);
+    }
+    blockmap->data_block[lbn]=block;
+    if ((log->sw_block!=-1)&&(log->sw_lbn==lbn))
+    {
+        blockmap_erase(ssd,index,location,log->sw_block);
+        log->sw_block=-1;
+    }
+    blockmap->full_merge_count++;
+}
+
+/*****************************************************************************************
+ *顺序写日志块的回收：日志块写满并且全部有效时直接替换数据块(switch merge)，否则把剩下偏移上的
+ *有效页拷贝进来后再替换(partial merge)
+ *****************************************************************************************/
+void fast_sw_merge(struct ssd_info *ssd,unsigned int index,struct local *location)
+{
+    unsigned int i=0,lbn=0,copied=0,valid=0;
+    int64_t l=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct log_plane *log=&blockmap->log[index];
+    struct blk_info *p_blk=NULL;
+
+    lbn=log->sw_lbn;
+    p_blk=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[log->sw_block];
+    for (i=p_blk->last_write_page+1;i<ssd->parameter->page_block;i++)
+    {
+        l=(int64_t)lbn*ssd->parameter->page_block+i;
+        if ((l<ssd->page)&&(find_entry(ssd,l)!=NULL)&&(find_entry(ssd,l)->state!=0))
+        {
+            blockmap_copy(ssd,location,log->sw_block,i,l);
+            copied++;
+        }
+    }
+    valid=ssd->parameter->page_block-p_blk->free_page_num-p_blk->invalid_page_num;
+
+    if (blockmap->data_block[lbn]!=0xffffffff)
+    {
+        blockmap_erase(ssd,index,location,blockmap->data_block[lbn]);
+    }
+    blockmap->data_block[lbn]=log->sw_block;
+    log->sw_block=-1;
+    if ((copied==0)&&(valid==ssd->parameter->page_block))
+        blockmap->switch_merge_count++;
+    else
+        blockmap->partial_merge_count++;
+}
+
+/*****************************************************************************************
+ *随机写日志块用完时回收最早的一个：对其中每个有效页所属的逻辑块做full merge，再擦除这个日志块
+ *****************************************************************************************/
+void fast_rw_merge(struct ssd_info *ssd,unsigned int index,struct local *location)
+{
+    unsigned int i=0,victim=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct log_plane *log=&blockmap->log[index];
+    struct blk_info *p_blk=NULL;
+
+    victim=log->rw_block[0];
+    p_blk=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane].blk_head[victim];
+    for (i=0;i<ssd->parameter->page_block;i++)
+    {
+        if (get_page(ssd,p_blk,i)->valid_state>0)
+        {
+            fast_merge_lbn(ssd,index,location,get_page(ssd,p_blk,i)->lpn/ssd->parameter->page_block);
+        }
+    }
+    blockmap_erase(ssd,index,location,victim);
+    for (i=1;i<log->rw_num;i++)
+    {
+        log->rw_block[i-1]=log->rw_block[i];
+    }
+    log->rw_num--;
+}
+
+/*****************************************************************************************
+ *FAST的写：数据块中对应偏移空闲时直接写入；偏移为0的写开始一个新的顺序写日志块，紧接着顺序写
+ *日志块的写继续写在其中；其余的写追加到随机写日志块中
+ *****************************************************************************************/
+int64_t fast_write(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    unsigned int lbn=0,offset=0,index=0,block=0,page=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct log_plane *log=NULL;
+    struct local location;
+    struct blk_info *p_blk=NULL;
+
+    lbn=lpn/ssd->parameter->page_block;
+    offset=lpn%ssd->parameter->page_block;
+    index=blockmap_plane(ssd,lbn,&location);
+    log=&blockmap->log[index];
+
+    if (blockmap->data_block[lbn]==0xffffffff)
+    {
+        blockmap->data_block[lbn]=blockmap_alloc_block(ssd,index,&location);
+    }
+    if (blockmap_page_free(ssd,&location,blockmap->data_block[lbn],offset))
+    {
+        return blockmap_program(ssd,&location,blockmap->data_block[lbn],offset,lpn,state);
+    }
+
+    if (offset==0)
+    {
+        if (log->sw_block!=-1)
+        {
+            fast_sw_merge(ssd,index,&location);
+        }
+        log->sw_block=blockmap_alloc_block(ssd,index,&location);
+        log->sw_lbn=lbn;
+        return blockmap_program(ssd,&location,log->sw_block,0,lpn,state);
+    }
+
+    if ((log->sw_block!=-1)&&(log->sw_lbn==lbn))
+    {
+        p_blk=&ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].blk_head[log->sw_block];
+        if (p_blk->last_write_page+1==(int)offset)
+        {
+            blockmap_program(ssd,&location,log->sw_block,offset,lpn,state);
+            if (offset==ssd->parameter->page_block-1)
+            {
+                fast_sw_merge(ssd,index,&location);
+            }
+            return get_entry(ssd,lpn)->pn;
+        }
+    }
+
+    if ((log->rw_num==0)||(ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].blk_head[log->rw_block[log->rw_num-1]].free_page_num==0))
+    {
+        if (log->rw_num==ssd->parameter->log_blocks)
+        {
+            fast_rw_merge(ssd,index,&location);
+        }
+        log->rw_block[log->rw_num]=blockmap_alloc_block(ssd,index,&location);
+        log->rw_num++;
+    }
+    block=log->rw_block[log->rw_num-1];
+    page=ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].blk_head[block].last_write_page+1;
+    return blockmap_program(ssd,&location,block,page,lpn,state);
+}
+
+/*****************************************************************************************
+ *块映射，FAST和ZNS中的get_ppn：由映射方式决定写入的物理页，merge(ZNS中是擦除zone)需要的时间
+ *在chip_program_state中加在这次编程之前
+ *****************************************************************************************/
+struct ssd_info *blockmap_get_ppn(struct ssd_info *ssd,struct sub_request *sub)
+{
+    int64_t ppn=0;
+    subpage_mask state=0;
+    struct local *location=NULL;
+
+    if (ssd->parameter->address_mapping==ZNS_MAPPING)
+    {
+        ppn=zns_write(ssd,sub->lpn,sub->state);
+    }
+    else
+    {
+        if (sub->lpn/ssd->parameter->page_block>=ssd->dram->map->blockmap->lbn_num)
+        {
+            printf("\nERROR ! lpn %lld is out of the logical space.\n",sub->lpn);
+            exit(100);
+        }
+
+        state=sub->state|get_entry(ssd,sub->lpn)->state;
+        if (ssd->parameter->address_mapping==BLOCK_MAPPING)
+        {
+            ppn=block_map_write(ssd,sub->lpn,state);
+        }
+        else
+        {
+            ppn=fast_write(ssd,sub->lpn,state);
+        }
+    }
+
+    location=find_location(ssd,ppn);
+    sub->ppn=ppn;
+    sub->location->channel=location->channel;
+    sub->location->chip=location->chip;
+    sub->location->die=location->die;
+    sub->location->plane=location->plane;
+    sub->location->block=location->block;
+    sub->location->page=location->page;
+
+    ssd->program_count++;
+    ssd->in_program_size+=ssd->parameter->subpage_page;
+    ssd->channel_head[location->channel].program_count++;
+    ssd->channel_head[location->channel].chip_head[location->chip].program_count++;
+    ssd->write_flash_count++;
+    free(location);
+    location=NULL;
+
+    return ssd;
+}
+
+/*****************************************************************************************
+ *预处理(读之前没有写过的数据)时把lpn放在数据块的固定偏移上，不计时间和统计
+ *****************************************************************************************/
+int64_t blockmap_pre_process(struct ssd_info *ssd,int64_t lpn)
+{
+    unsigned int lbn=0,index=0,erase_count=0;
+    int64_t ppn=0;
+    struct blockmap_info *blockmap=ssd->dram->map->blockmap;
+    struct local location;
+    struct blk_info *p_blk=NULL;
+
+    lbn=lpn/ssd->parameter->page_block;
+    if (lbn>=blockmap->lbn_num)
+    {
+        return 0;
+    }
+    index=blockmap_plane(ssd,lbn,&location);
+    if (blockmap->data_block[lbn]==0xffffffff)
+    {
+        erase_count=ssd->erase_count;
+        blockmap->data_block[lbn]=blockmap_alloc_block(ssd,index,&location);
+        if (ssd->erase_count!=erase_count)                                             /*擦除了make_aged产生的块*/
+        {
+            ssd->erase_count=erase_count;
+            ssd->channel_head[location.channel].erase_count--;
+            ssd->channel_head[location.channel].chip_head[location.chip].erase_count--;
+            blockmap->merge_erase_count--;
+            ssd->channel_head[location.channel].chip_head[location.chip].merge_time=0;
+        }
+    }
+
+    p_blk=&ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].blk_head[blockmap->data_block[lbn]];
+    p_blk->free_page_num--;
+    if ((int)(lpn%ssd->parameter->page_block)>p_blk->last_write_page)
+    {
+        p_blk->last_write_page=lpn%ssd->parameter->page_block;
+    }
+    ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].free_page--;
+    ppn=find_ppn(ssd,location.channel,location.chip,location.die,location.plane,blockmap->data_block[lbn],lpn%ssd->parameter->page_block);
+
+    return ppn;
+}
+
+/*****************************************************************************************
+ *各种映射方式下映射表占用的dram(字节)，每个映射项4个字节：页映射每个逻辑页一项(DFTL只计CMT和GTD)，
+ *块映射每个逻辑块一项，FAST再加上日志块的页映射，ZNS只有每个zone的状态和写指针
+ *****************************************************************************************/
+int64_t mapping_table_size(struct ssd_info *ssd)
+{
+    int64_t plane_num=0;
+
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    if (ssd->parameter->address_mapping==ZNS_MAPPING)
+    {
+        return (int64_t)ssd->dram->map->zns->zone_num*8;
+    }
+    if (ssd->parameter->address_mapping==BLOCK_MAPPING)
+    {
+        return (int64_t)ssd->dram->map->blockmap->lbn_num*4;
+    }
+    if (ssd->parameter->address_mapping==FAST_MAPPING)
+    {
+        return (int64_t)ssd->dram->map->blockmap->lbn_num*4+plane_num*(ssd->parameter->log_blocks+1)*(4+(int64_t)ssd->parameter->page_block*4);
+    }
+    if (ssd->dram->map->dftl!=NULL)
+    {
+        return (int64_t)ssd->dram->map->dftl->cache_size*8+(int64_t)ssd->dram->map->dftl->trans_pages*4;
+    }
+    if (ssd->dram->map->submap!=NULL)
+    {
+        return user_capacity(ssd,ssd->page)*ssd->parameter->subpage_page*4;
+    }
+    return user_capacity(ssd,ssd->page)*4;
+}
+
+/*****************************************************************************************
+ *trim：使lpn中state所表示的子页失效。整页都失效时物理页置为无效，映射项清零；
+ *页映射中一个块的页全部失效时挂到direct erase链上，和写操作使旧页失效的处理一样
+ *****************************************************************************************/
+Status trim_page(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    unsigned int i=0;
+    subpage_mask new_state=0;
+    struct local *location=NULL;
+    struct blk_info *p_blk=NULL;
+    struct plane_info *p_plane=NULL;
+    struct direct_erase *new_direct_erase=NULL;
+
+    if ((lpn>=ssd->page)||(get_entry(ssd,lpn)->state==0))
+    {
+        return FAILURE;
+    }
+    if (ssd->dram->map->submap!=NULL)                                                  /*子页映射中逐个子页失效*/
+    {
+        for (i=0;i<ssd->parameter->subpage_page;i++)
+        {
+            if ((state&get_entry(ssd,lpn)->state&SUBPAGE_BIT(i))!=0)
+            {
+                subpage_invalidate(ssd,lpn*ssd->parameter->subpage_page+i);
+            }
+        }
+        get_entry(ssd,lpn)->state&=~state;
+        if (get_entry(ssd,lpn)->state==0)
+        {
+            get_entry(ssd,lpn)->pn=0;
+            get_entry(ssd,lpn)->trimmed=1;
+            ssd->trim_page_count++;
+        }
+        return SUCCESS;
+    }
+
+    new_state=get_entry(ssd,lpn)->state&(~state);
+    location=find_location(ssd,get_entry(ssd,lpn)->pn);
+    p_plane=&ssd->channel_head[location->channel].chip_head[location->chip].die_head[location->die].plane_head[location->plane];
+    p_blk=&p_plane->blk_head[location->block];
+    dftl_update(ssd,lpn);
+
+    if (new_state!=0)
+    {
+        get_page(ssd,p_blk,location->page)->valid_state=new_state;
+        get_page(ssd,p_blk,location->page)->cached_page&=new_state;
+        get_entry(ssd,lpn)->state=new_state;
+        free(location);
+        location=NULL;
+        return SUCCESS;
+    }
+
+    get_page(ssd,p_blk,location->page)->valid_state=0;
+    get_page(ssd,p_blk,location->page)->free_state=0;
+    get_page(ssd,p_blk,location->page)->lpn=0;
+    get_page(ssd,p_blk,location->page)->cached_page=0;
+    p_blk->cached_pages_num--;
+    p_blk->invalid_page_num++;
+    get_entry(ssd,lpn)->pn=0;
+    get_entry(ssd,lpn)->state=0;
+    get_entry(ssd,lpn)->trimmed=1;
+    ssd->trim_page_count++;
+
+    if ((ssd->parameter->address_mapping==PAGE_MAPPING)&&(p_blk->invalid_page_num==ssd->parameter->page_block))
+    {
+        new_direct_erase=(struct direct_erase *)malloc(sizeof(struct direct_erase));
+        alloc_assert(new_direct_erase,"new_direct_erase");
+        memset(new_direct_erase,0, sizeof(struct direct_erase));
+
+        new_direct_erase->block=location->block;
+        new_direct_erase->next_node=p_plane->erase_node;
+        p_plane->erase_node=new_direct_erase;
+    }
+    free(location);
+    location=NULL;
+
+    return SUCCESS;
+}
+
+/*****************************************************************************************
+ *ZNS：逻辑页lpn所在的位置。zone内的第offset页在zone的各个块之间轮流放置，位置是固定的，
+ *不需要映射表
+ *****************************************************************************************/
+void zns_location(struct ssd_info *ssd,int64_t lpn,struct local *location)
+{
+    unsigned int zone=0,offset=0,unit=0,plane_num=0;
+    struct zns_info *zns=ssd->dram->map->zns;
+
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    zone=lpn/zns->zone_pages;
+    offset=lpn%zns->zone_pages;
+    unit=zone*zns->zone_blocks+offset%zns->zone_blocks;
+    plane_location(ssd,unit%plane_num,location);
+    location->block=unit/plane_num;
+    location->page=offset/zns->zone_blocks;
+}
+
+/*****************************************************************************************
+ *ZNS的写：把lpn写到它在zone中的固定位置上。写指针保证了每一页只写一次，只有在写指针停在页的
+ *中间时，同一页剩下的子页会再写一次，这时和已经写入的子页合并，不需要读出旧数据
+ *****************************************************************************************/
+int64_t zns_write(struct ssd_info *ssd,int64_t lpn,subpage_mask state)
+{
+    unsigned int new_page=0;
+    subpage_mask full_page=0;
+    struct local location;
+    struct blk_info *p_blk=NULL;
+
+    if (lpn/ssd->dram->map->zns->zone_pages>=ssd->dram->map->zns->zone_num)
+    {
+        printf("\nERROR ! lpn %lld is out of the zoned space.\n",lpn);
+        exit(100);
+    }
+
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    zns_location(ssd,lpn,&location);
+    new_page=blockmap_page_free(ssd,&location,location.block,location.page);
+    p_blk=&ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].blk_head[location.block];
+
+    state=(state|get_page(ssd,p_blk,location.page)->valid_state)&full_page;
+    get_page(ssd,p_blk,location.page)->lpn=lpn;
+    get_page(ssd,p_blk,location.page)->valid_state=state;
+    get_page(ssd,p_blk,location.page)->free_state=((~state)&full_page);
+    get_page(ssd,p_blk,location.page)->cached_page=state;
+    get_page(ssd,p_blk,location.page)->written_count++;
+    if (new_page)
+    {
+        p_blk->free_page_num--;
+        if ((int)location.page>p_blk->last_write_page)
+        {
+            p_blk->last_write_page=location.page;
+        }
+        ssd->channel_head[location.channel].chip_head[location.chip].die_head[location.die].plane_head[location.plane].free_page--;
+    }
+
+    get_entry(ssd,lpn)->pn=find_ppn(ssd,location.channel,location.chip,location.die,location.plane,location.block,location.page);
+    get_entry(ssd,lpn)->state=state;
+    get_entry(ssd,lpn)->trimmed=0;
+    return get_entry(ssd,lpn)->pn;
+}
+
+/*****************************************************************************************
+ *ZNS：擦除zone中所有写过的块(包括make_aged产生的块)，擦除时间记在chip的merge_time上，在这个
+ *chip下一次编程之前执行。返回擦除最多的chip上需要的时间
+ *****************************************************************************************/
+int64_t zns_erase_zone(struct ssd_info *ssd,unsigned int zone)
+{
+    unsigned int i=0,unit=0,plane_num=0;
+    int64_t erase_time=0;
+    struct zns_info *zns=ssd->dram->map->zns;
+    struct local location;
+    struct chip_info *p_chip=NULL;
+
+    plane_num=ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num;
+    for (i=0;i<zns->zone_blocks;i++)
+    {
+        unit=zone*zns->zone_blocks+i;
+        plane_location(ssd,unit%plane_num,&location);
+        location.block=unit/plane_num;
+        p_chip=&ssd->channel_head[location.channel].chip_head[location.chip];
+        if (p_chip->die_head[location.die].plane_head[location.plane].blk_head[location.block].free_page_num==ssd->parameter->page_block)
+        {
+            continue;
+        }
+
+        erase_operation(ssd,location.channel,location.chip,location.die,location.plane,location.block);
+        p_chip->merge_time+=ssd->parameter->time_characteristics.tBERS;
+        zns->reset_erase_count++;
+        if (p_chip->merge_time>erase_time)
+        {
+            erase_time=p_chip->merge_time;
+        }
+    }
+    return erase_time;
+}
+
+/*****************************************************************************************
+ *ZNS：写之前打开zone。EMPTY的zone需要一个active zone的名额，没有名额时返回FAILURE；
+ *打开的zone达到上限时，关闭最久没有写过的一个(implicit close)
+ *****************************************************************************************/
+Status zns_open_zone(struct ssd_info *ssd,unsigned int zone)
+{
+    unsigned int i=0;
+    int victim=-1;
+    struct zns_info *zns=ssd->dram->map->zns;
+
+    if (zns->zone[zone].state==ZONE_OPEN)
+    {
+        zns->zone[zone].last_time=ssd->current_time;
+        return SUCCESS;
+    }
+    if ((zns->zone[zone].state==ZONE_EMPTY)&&(ssd->parameter->max_active_zones!=0)&&(zns->active_num>=ssd->parameter->max_active_zones))
+    {
+        return FAILURE;
+    }
+
+    if ((ssd->parameter->max_open_zones!=0)&&(zns->open_num>=ssd->parameter->max_open_zones))
+    {
+        for (i=0;i<zns->zone_num;i++)
+        {
+            if ((zns->zone[i].state==ZONE_OPEN)&&((victim==-1)||(zns->zone[i].last_time<zns->zone[victim].last_time)))
+            {
+                victim=i;
+            }
+        }
+        zns->zone[victim].state=ZONE_CLOSED;
+        zns->open_num--;
+        zns->implicit_close_count++;
+    }
+
+    if (zns->zone[zone].state==ZONE_EMPTY)
+    {
+        zns_erase_zone(ssd,zone);
+        zns->active_num++;
+    }
+    zns->zone[zone].state=ZONE_OPEN;
+    zns->zone[zone].last_time=ssd->current_time;
+    zns->open_num++;
+    return SUCCESS;
+}
+
+/*****************************************************************************************
+ *ZNS：zone离开OPEN/CLOSED状态时释放占用的open和active名额
+ *****************************************************************************************/
+void zns_release_zone(struct ssd_info *ssd,unsigned int zone)
+{
+    struct zns_info *zns=ssd->dram->map->zns;
+
+    if (zns->zone[zone].state==ZONE_OPEN)
+    {
+        zns->open_num--;
+    }
+    if ((zns->zone[zone].state==ZONE_OPEN)||(zns->zone[zone].state==ZONE_CLOSED))
+    {
+        zns->active_num--;
+    }
+}
+
+/*****************************************************************************************
+ *ZNS的zone reset：丢弃buffer中、写队列中和映射表中这个zone的数据，直接擦除zone中的块，不经过gc。
+ *返回擦除需要的时间
+ *****************************************************************************************/
+int64_t zns_reset_zone(struct ssd_info *ssd,unsigned int zone)
+{
+    int64_t lpn=0;
+    subpage_mask full_page=0;
+    struct zns_info *zns=ssd->dram->map->zns;
+
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
+    for (lpn=(int64_t)zone*zns->zone_pages;lpn<((int64_t)zone+1)*zns->zone_pages;lpn++)
+    {
+        if (ssd->parameter->dram_capacity!=0)
+        {
+            trim2buffer(ssd,lpn,full_page);
+        }
+        get_entry(ssd,lpn)->pn=0;
+        get_entry(ssd,lpn)->state=0;
+    }
+    cancel_write_sub_request(ssd,(int64_t)zone*zns->zone_pages,((int64_t)zone+1)*zns->zone_pages-1,full_page);   /*写队列中这个zone还没有写入的子请求不再写，否则擦除之后还会写到zone里*/
+
+    zns_release_zone(ssd,zone);
+    zns->zone[zone].state=ZONE_EMPTY;
+    zns->zone[zone].wp=0;
+    zns->reset_count++;
+    return zns_erase_zone(ssd,zone);
+}
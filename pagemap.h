@@ -25,27 +25,81 @@ Hao Luo         2011/01/01        2.0           Change               luohao13568
 
 void file_assert(int error,char *s);
 void alloc_assert(void *p,char *s);
-void trace_assert(int64_t time_t,int device,unsigned int lsn,int size,int ope);
+void trace_assert(int64_t time_t,int device,int64_t lsn,int size,int ope);
 
-struct local *find_location(struct ssd_info *ssd,unsigned int ppn);
-unsigned int find_ppn(struct ssd_info * ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page);
+struct local *find_location(struct ssd_info *ssd,int64_t ppn);
+struct page_info *get_page(struct ssd_info *ssd,struct blk_info *p_block,unsigned int page);
+struct entry *get_entry(struct ssd_info *ssd,int64_t lpn);
+struct entry *find_entry(struct ssd_info *ssd,int64_t lpn);
+void static_location(struct ssd_info *ssd,int64_t lpn,struct local *location);
+int64_t find_ppn(struct ssd_info * ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page);
 struct ssd_info *pre_process_page(struct ssd_info *ssd);
-unsigned int get_ppn_for_pre_process(struct ssd_info *ssd,unsigned int lsn);
+int64_t get_ppn_for_pre_process(struct ssd_info *ssd,int64_t lsn);
 struct ssd_info *get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,struct sub_request *sub);
+void init_plane_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane);
+struct ssd_info *subpage_get_ppn(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,struct sub_request *sub);
+void subpage_invalidate(struct ssd_info *ssd,int64_t lsn);
+void subpage_move(struct ssd_info *ssd,int64_t old_ppn,int64_t new_ppn);
+void subpage_map_build(struct ssd_info *ssd);
 unsigned int gc(struct ssd_info *ssd,unsigned int channel, unsigned int flag);
 int gc_direct_erase(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane);
 int uninterrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane, struct gc_operation *gc_node);
+int64_t compute_gc_move_time(struct ssd_info *ssd,unsigned int page_move_count,int64_t bus_time);
 int interrupt_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,struct gc_operation *gc_node);
 int decide_gc_invoke(struct ssd_info *ssd, unsigned int channel);
-int set_entry_state(struct ssd_info *ssd,unsigned int lsn,unsigned int size);
-unsigned int get_ppn_for_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane);
+subpage_mask set_entry_state(struct ssd_info *ssd,int64_t lsn,unsigned int size);
+int64_t get_ppn_for_gc(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane);
 
 int erase_operation(struct ssd_info * ssd,unsigned int channel ,unsigned int chip ,unsigned int die,unsigned int plane ,unsigned int block);
 int erase_planes(struct ssd_info * ssd, unsigned int channel, unsigned int chip, unsigned int die1, unsigned int plane1,unsigned int command);
 int move_page(struct ssd_info * ssd, struct local *location,unsigned int * transfer_size);
+Status gc_buffer_absorb(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block,unsigned int page);
+int gc_buffer_victim(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane);
 int gc_for_channel(struct ssd_info *ssd, unsigned int channel);
 int delete_gc_node(struct ssd_info *ssd, unsigned int channel,struct gc_operation *gc_node);
 
+unsigned int data_block_plane(struct ssd_info *ssd);
+int64_t user_capacity(struct ssd_info *ssd,int64_t total);
+void plane_location(struct ssd_info *ssd,unsigned int index,struct local *location);
+void cmt_unlink(struct dftl_info *dftl,int slot);
+void cmt_push(struct dftl_info *dftl,int slot);
+void cmt_touch(struct ssd_info *ssd,int slot);
+int cmt_victim(struct ssd_info *ssd);
+void cmt_insert(struct ssd_info *ssd,int64_t lpn,int dirty);
+int dftl_active_block(struct ssd_info *ssd,struct local *location);
+int64_t dftl_alloc_page(struct ssd_info *ssd,unsigned int tvpn);
+void dftl_invalidate_page(struct ssd_info *ssd,int64_t ppn);
+int dftl_gc(struct ssd_info *ssd,struct local *location);
+void dftl_writeback(struct ssd_info *ssd,unsigned int tvpn);
+struct sub_request *dftl_lookup(struct ssd_info *ssd,int64_t lpn,struct request *req,unsigned int operation);
+void dftl_update(struct ssd_info *ssd,int64_t lpn);
+
+unsigned int blockmap_plane(struct ssd_info *ssd,unsigned int lbn,struct local *location);
+int blockmap_alloc_block(struct ssd_info *ssd,unsigned int index,struct local *location);
+void blockmap_erase(struct ssd_info *ssd,unsigned int index,struct local *location,unsigned int block);
+int64_t blockmap_program(struct ssd_info *ssd,struct local *location,unsigned int block,unsigned int page,int64_t lpn,subpage_mask state);
+void blockmap_copy(struct ssd_info *ssd,struct local *location,unsigned int block,unsigned int page,int64_t lpn);
+int blockmap_page_free(struct ssd_info *ssd,struct local *location,unsigned int block,unsigned int page);
+int64_t block_map_write(struct ssd_info *ssd,int64_t lpn,subpage_mask state);
+void fast_merge_lbn(struct ssd_info *ssd,unsigned int index,struct local *location,unsigned int lbn);
+void fast_sw_merge(struct ssd_info *ssd,unsigned int index,struct local *location);
+void fast_rw_merge(struct ssd_info *ssd,unsigned int index,struct local *location);
+int64_t fast_write(struct ssd_info *ssd,int64_t lpn,subpage_mask state);
+struct ssd_info *blockmap_get_ppn(struct ssd_info *ssd,struct sub_request *sub);
+int64_t blockmap_pre_process(struct ssd_info *ssd,int64_t lpn);
+int64_t mapping_table_size(struct ssd_info *ssd);
+Status trim_page(struct ssd_info *ssd,int64_t lpn,subpage_mask state);
+void zns_location(struct ssd_info *ssd,int64_t lpn,struct local *location);
+int64_t zns_write(struct ssd_info *ssd,int64_t lpn,subpage_mask state);
+int64_t zns_erase_zone(struct ssd_info *ssd,unsigned int zone);
+Status zns_open_zone(struct ssd_info *ssd,unsigned int zone);
+void zns_release_zone(struct ssd_info *ssd,unsigned int zone);
+int64_t zns_reset_zone(struct ssd_info *ssd,unsigned int zone);
+void free_block_push(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int block);
+int is_open_block(struct ssd_info *ssd,struct plane_info *p_plane,unsigned int block);
+Status find_stream_block(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int stream,unsigned int *block);
+int free_block_pop(struct ssd_info *ssd,unsigned int channel,unsigned int chip,unsigned int die,unsigned int plane,unsigned int from);
+
 #endif
 
 
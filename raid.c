@@ -7,7 +7,7 @@
 // initialize_raid function initializes raid struct and all ssd connected to the struct
 struct raid_info* initialize_raid(struct raid_info* raid, struct user_args* uargs) {
     struct ssd_info *ssd_pointer;
-    unsigned int max_lsn_per_disk;
+    int64_t max_lsn_per_disk;
     char *current_time;
     char logfilename[80];
 
@@ -87,7 +87,7 @@ struct raid_info* initialize_raid(struct raid_info* raid, struct user_args* uarg
     }
 
     // calculating the maximum lsn for the raid
-    max_lsn_per_disk = (unsigned int) ssd_pointer->parameter->subpage_page * ssd_pointer->parameter->page_block * ssd_pointer->parameter->block_plane * ssd_pointer->parameter->plane_die * ssd_pointer->parameter->die_chip * ssd_pointer->parameter->chip_num * (1 - ssd_pointer->parameter->overprovide );
+    max_lsn_per_disk = user_capacity(ssd_pointer, (int64_t)ssd_pointer->parameter->subpage_page * ssd_pointer->parameter->page_block * ssd_pointer->parameter->block_plane * ssd_pointer->parameter->plane_die * ssd_pointer->parameter->die_chip * ssd_pointer->parameter->chip_num);
     raid->max_lsn = max_lsn_per_disk * raid->num_disk;
     if (raid->raid_type == RAID_5)
         raid->max_lsn -= max_lsn_per_disk;
@@ -99,7 +99,7 @@ struct raid_info* initialize_raid(struct raid_info* raid, struct user_args* uarg
     return raid;
 }
 
-struct raid_request* initialize_raid_request(struct raid_request* raid_req, int64_t req_incoming_time, unsigned int req_lsn, unsigned int req_size, unsigned int req_operation) {
+struct raid_request* initialize_raid_request(struct raid_request* raid_req, int64_t req_incoming_time, int64_t req_lsn, unsigned int req_size, unsigned int req_operation) {
     raid_req->begin_time = req_incoming_time;
     raid_req->lsn = req_lsn;
     raid_req->size = req_size;
@@ -109,7 +109,7 @@ struct raid_request* initialize_raid_request(struct raid_request* raid_req, int6
     return raid_req;
 }
 
-struct raid_sub_request* initialize_raid_sub_request(struct raid_sub_request* raid_subreq, struct raid_request* raid_req, unsigned int disk_id, unsigned int stripe_id, unsigned int strip_id, unsigned int strip_offset, unsigned int lsn, unsigned int size, unsigned int operation) {
+struct raid_sub_request* initialize_raid_sub_request(struct raid_sub_request* raid_subreq, struct raid_request* raid_req, unsigned int disk_id, unsigned int stripe_id, unsigned int strip_id, unsigned int strip_offset, int64_t lsn, unsigned int size, unsigned int operation) {
     struct raid_sub_request *ptr = NULL;
     unsigned int state = R_SR_PENDING;
 
@@ -127,6 +127,7 @@ struct raid_sub_request* initialize_raid_sub_request(struct raid_sub_request* ra
     raid_subreq->current_state = state;
     raid_subreq->lsn = lsn;
     raid_subreq->size = size;
+    raid_subreq->stream = raid_req->stream;
     raid_subreq->next_node = NULL;
     if (raid_req->subs == NULL) {
         raid_req->subs = raid_subreq;
@@ -192,8 +193,9 @@ int64_t raid_find_nearest_event(struct raid_info* raid) {
 // raid_distribute_request will distribute single IO request in raid level
 // to IO request in disk level. A single IO request can be splitted into multiple IO request
 // in disk level. This function return R_DIST_SUCCESS (0) if success and R_DIST_ERR (1) if not.
-int raid_distribute_request(struct raid_info* raid, int64_t req_incoming_time, unsigned int req_lsn, unsigned int req_size, unsigned int req_operation) {
-    unsigned int disk_id, strip_id, stripe_id, stripe_offset, strip_offset, disk_req_lsn, disk_req_size;
+int raid_distribute_request(struct raid_info* raid, int64_t req_incoming_time, int64_t req_lsn, unsigned int req_size, unsigned int req_operation, unsigned int req_stream) {
+    unsigned int disk_id, strip_id, stripe_id, stripe_offset, strip_offset, disk_req_size;
+    int64_t disk_req_lsn;
     int req_size_block = req_size, parity_strip_id;
     struct raid_request* raid_req;
     struct raid_sub_request* raid_subreq;
@@ -208,19 +210,20 @@ int raid_distribute_request(struct raid_info* raid, int64_t req_incoming_time, u
         alloc_assert(raid_req, "raid_request");
         memset(raid_req,0,sizeof(struct raid_request));
         initialize_raid_request(raid_req, req_incoming_time, req_lsn, req_size, req_operation);
+        raid_req->stream = (req_operation == WRITE) ? req_stream : 0;
 
         while(req_size_block > 0) {
             stripe_id = req_lsn / raid->stripe_size_block;
-            stripe_offset = req_lsn - (stripe_id * raid->stripe_size_block);
+            stripe_offset = req_lsn - ((int64_t)stripe_id * raid->stripe_size_block);
             strip_id = stripe_offset / raid->strip_size_block;
             strip_offset = stripe_offset % raid->strip_size_block;
             disk_id = strip_id;
-            disk_req_lsn = (stripe_id * raid->strip_size_block) + strip_offset;
+            disk_req_lsn = ((int64_t)stripe_id * raid->strip_size_block) + strip_offset;
             disk_req_size = (raid->strip_size_block - strip_offset >= req_size) ? req_size : raid->strip_size_block - strip_offset;
 
             // add sub_request to request
             #ifdef DEBUG
-            printf("--> req distributed to ssd: %u %u %u %u %u\n", disk_id, stripe_id, strip_id, strip_offset, disk_req_lsn);
+            printf("--> req distributed to ssd: %u %u %u %u %lld\n", disk_id, stripe_id, strip_id, strip_offset, disk_req_lsn);
             #endif
             raid_subreq = (struct raid_sub_request*)malloc(sizeof(struct raid_sub_request));
             alloc_assert(raid_subreq, "raid_sub_request");
@@ -255,18 +258,19 @@ int raid_distribute_request(struct raid_info* raid, int64_t req_incoming_time, u
         alloc_assert(raid_req, "raid_request");
         memset(raid_req,0,sizeof(struct raid_request));
         initialize_raid_request(raid_req, req_incoming_time, req_lsn, req_size, req_operation);
+        raid_req->stream = (req_operation == WRITE) ? req_stream : 0;
 
-        // handle read request
-        if (raid_req->operation == READ) {
+        // handle read and trim request, a trim only touches the data strips and leaves the parity as is
+        if (raid_req->operation == READ || raid_req->operation == TRIM) {
             while (req_size_block > 0) {
                 stripe_id = req_lsn / (raid->strip_size_block*(raid->num_disk-1)); // not include parity strip
-                stripe_offset = req_lsn - (raid->strip_size_block * (raid->num_disk-1) * stripe_id);
+                stripe_offset = req_lsn - ((int64_t)raid->strip_size_block * (raid->num_disk-1) * stripe_id);
                 strip_id = stripe_offset / raid->strip_size_block;
                 parity_strip_id = stripe_id % raid->num_disk;
                 if (parity_strip_id <= strip_id) strip_id++;
                 strip_offset = stripe_offset % raid->strip_size_block;
                 disk_id = strip_id;
-                disk_req_lsn = (stripe_id * raid->strip_size_block) + strip_offset;
+                disk_req_lsn = ((int64_t)stripe_id * raid->strip_size_block) + strip_offset;
                 disk_req_size = (raid->strip_size_block - strip_offset >= req_size_block) ? req_size_block : raid->strip_size_block - strip_offset;
 
                 // add sub_request to request
@@ -290,13 +294,13 @@ int raid_distribute_request(struct raid_info* raid, int64_t req_incoming_time, u
                 #endif
                 // reading old data
                 stripe_id = req_lsn / (raid->strip_size_block*(raid->num_disk-1)); // not include parity strip
-                stripe_offset = req_lsn - (raid->strip_size_block * (raid->num_disk-1) * stripe_id);
+                stripe_offset = req_lsn - ((int64_t)raid->strip_size_block * (raid->num_disk-1) * stripe_id);
                 strip_id = stripe_offset / raid->strip_size_block;
                 parity_strip_id = stripe_id % raid->num_disk;
                 if (parity_strip_id <= strip_id) strip_id++;
                 strip_offset = stripe_offset % raid->strip_size_block;
                 disk_id = strip_id;
-                disk_req_lsn = (stripe_id * raid->strip_size_block) + strip_offset;
+                disk_req_lsn = ((int64_t)stripe_id * raid->strip_size_block) + strip_offset;
                 disk_req_size = (raid->strip_size_block - strip_offset >= req_size_block) ? req_size_block : raid->strip_size_block - strip_offset;
 
                 raid_subreq = (struct raid_sub_request*)malloc(sizeof(struct raid_sub_request));
@@ -323,13 +327,13 @@ int raid_distribute_request(struct raid_info* raid, int64_t req_incoming_time, u
             while (req_size_block > 0) {
                 // writing new data
                 stripe_id = req_lsn / (raid->strip_size_block*(raid->num_disk-1)); // not include parity strip
-                stripe_offset = req_lsn - (raid->strip_size_block * (raid->num_disk-1) * stripe_id);
+                stripe_offset = req_lsn - ((int64_t)raid->strip_size_block * (raid->num_disk-1) * stripe_id);
                 strip_id = stripe_offset / raid->strip_size_block;
                 parity_strip_id = stripe_id % raid->num_disk;
                 if (parity_strip_id <= strip_id) strip_id++;
                 strip_offset = stripe_offset % raid->strip_size_block;
                 disk_id = strip_id;
-                disk_req_lsn = (stripe_id * raid->strip_size_block) + strip_offset;
+                disk_req_lsn = ((int64_t)stripe_id * raid->strip_size_block) + strip_offset;
                 disk_req_size = (raid->strip_size_block - strip_offset >= req_size_block) ? req_size_block : raid->strip_size_block - strip_offset;
 
                 raid_subreq = (struct raid_sub_request*)malloc(sizeof(struct raid_sub_request));
@@ -466,8 +470,8 @@ int raid_ssd_get_requests(int disk_id, struct ssd_info *ssd, struct raid_info *r
     struct request *ssd_request;
     int is_found = 0;
 
-    unsigned int req_lsn=0;
-    int req_device, req_size, req_ope, large_lsn;
+    int64_t req_lsn=0, large_lsn;
+    int req_device, req_size, req_ope;
     int64_t req_time = 0;
     int64_t nearest_event_time;
 
@@ -507,7 +511,7 @@ int raid_ssd_get_requests(int disk_id, struct ssd_info *ssd, struct raid_info *r
         exit(100);
     }
 
-    large_lsn=(int)((ssd->parameter->subpage_page*ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num)*(1-ssd->parameter->overprovide));
+    large_lsn=user_capacity(ssd,(int64_t)ssd->parameter->subpage_page*ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num);
     req_lsn = req_lsn%large_lsn;
 
     if (nearest_event_time==MAX_INT64) {
@@ -542,6 +546,7 @@ int raid_ssd_get_requests(int disk_id, struct ssd_info *ssd, struct raid_info *r
     ssd_request->lsn = req_lsn;
     ssd_request->size = req_size;
     ssd_request->operation = req_ope;
+    ssd_request->stream = rsreq->stream;
     ssd_request->begin_time = req_time;
     ssd_request->response_time = 0;	
     ssd_request->energy_consumption = 0;	
@@ -566,12 +571,13 @@ int raid_ssd_get_requests(int disk_id, struct ssd_info *ssd, struct raid_info *r
     if (ssd_request->lsn < ssd->min_lsn) ssd->min_lsn = ssd_request->lsn;
     if (ssd_request->operation == WRITE) ssd->ave_write_size=(ssd->ave_write_size*ssd->write_request_count+ssd_request->size)/(ssd->write_request_count+1);
     if (ssd_request->operation == READ) ssd->ave_read_size=(ssd->ave_read_size*ssd->read_request_count+ssd_request->size)/(ssd->read_request_count+1);
+    if (ssd_request->operation == TRIM) ssd->trim_request_size+=ssd_request->size;
 
     return 1;
 }
 
 int raid_ssd_interface(struct ssd_info* ssd, struct raid_sub_request *subreq) {
-    int large_lsn;
+    int64_t large_lsn;
     int64_t nearest_event_time;
     struct request *ssd_request;
     
@@ -585,7 +591,7 @@ int raid_ssd_interface(struct ssd_info* ssd, struct raid_sub_request *subreq) {
         return SUCCESS;
     }
 
-    large_lsn = (int)((ssd->parameter->subpage_page*ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num)*(1-ssd->parameter->overprovide));
+    large_lsn = user_capacity(ssd,(int64_t)ssd->parameter->subpage_page*ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num);
     subreq->lsn = subreq->lsn % large_lsn;
 
     if (nearest_event_time == MAX_INT64) {
@@ -611,6 +617,7 @@ int raid_ssd_interface(struct ssd_info* ssd, struct raid_sub_request *subreq) {
     ssd_request->lsn = subreq->lsn;
     ssd_request->size = subreq->size;
     ssd_request->operation = subreq->operation;
+    ssd_request->stream = subreq->stream;
     ssd_request->begin_time = subreq->begin_time;
     ssd_request->response_time = 0;	
     ssd_request->energy_consumption = 0;	
@@ -635,6 +642,7 @@ int raid_ssd_interface(struct ssd_info* ssd, struct raid_sub_request *subreq) {
     if (ssd_request->lsn < ssd->min_lsn) ssd->min_lsn = ssd_request->lsn;
     if (ssd_request->operation == WRITE) ssd->ave_write_size=(ssd->ave_write_size*ssd->write_request_count+ssd_request->size)/(ssd->write_request_count+1);
     if (ssd_request->operation == READ) ssd->ave_read_size=(ssd->ave_read_size*ssd->read_request_count+ssd_request->size)/(ssd->read_request_count+1);
+    if (ssd_request->operation == TRIM) ssd->trim_request_size+=ssd_request->size;
 
     return SUCCESS;
 }
@@ -655,17 +663,20 @@ void raid_ssd_trace_output(struct ssd_info* ssd) {
         if (req->response_time != 0) {
             latency = req->response_time-req->time;
             #ifdef DEBUG
-            printf("%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+            printf("%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
             #endif
-            fprintf(ssd->outputfile,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time); fflush(ssd->outputfile);
-            fprintf(ssd->outfile_io,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time); fflush(ssd->outfile_io);
+            fprintf(ssd->outputfile,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time); fflush(ssd->outputfile);
+            fprintf(ssd->outfile_io,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time); fflush(ssd->outfile_io);
             if (req->operation == WRITE) {
-                fprintf(ssd->outfile_io_write,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                fprintf(ssd->outfile_io_write,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                 fflush(ssd->outfile_io_write);
                 ssd->write_request_count++;
                 ssd->write_avg=ssd->write_avg+(req->response_time-req->time);
+            } else if (req->operation == TRIM) {
+                ssd->trim_request_count++;
+                ssd->trim_avg=ssd->trim_avg+(req->response_time-req->time);
             } else if (req->operation == READ){
-                fprintf(ssd->outfile_io_read,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                fprintf(ssd->outfile_io_read,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                 fflush(ssd->outfile_io_read);
                 ssd->read_request_count++;
                 ssd->read_avg=ssd->read_avg+(req->response_time-req->time);
@@ -703,20 +714,20 @@ void raid_ssd_trace_output(struct ssd_info* ssd) {
                 latency = end_time-req->time;
                 
                 #ifdef DEBUG
-                printf("%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                printf("%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                 #endif
-                fprintf(ssd->outputfile,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                fprintf(ssd->outputfile,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                 fflush(ssd->outputfile);
-                fprintf(ssd->outfile_io,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                fprintf(ssd->outfile_io,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                 fflush(ssd->outfile_io);
 
                 if (req->operation == WRITE) {
-                    fprintf(ssd->outfile_io_write,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                    fprintf(ssd->outfile_io_write,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                     fflush(ssd->outfile_io_write);
                     ssd->write_request_count++;
                     ssd->write_avg=ssd->write_avg+(end_time-req->time);
                 } else if (req->operation == READ){
-                    fprintf(ssd->outfile_io_read,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+                    fprintf(ssd->outfile_io_read,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
                     fflush(ssd->outfile_io_read);
                     ssd->read_request_count++;
                     ssd->read_avg=ssd->read_avg+(end_time-req->time);
@@ -859,7 +870,7 @@ void raid_print_req_queue(struct raid_info* raid) {
     printf(" ============ RAID REQUEST QUEUE ============ \n");
     rreq = raid->request_queue;
     while (rreq != NULL) {
-        printf(" [%d] %lld %lld %u %u %u\n", rreq_id, rreq->begin_time, rreq->response_time, rreq->lsn, rreq->size, rreq->operation);
+        printf(" [%d] %lld %lld %lld %u %u\n", rreq_id, rreq->begin_time, rreq->response_time, rreq->lsn, rreq->size, rreq->operation);
         srreq = rreq->subs;
         while (srreq != NULL) {
             printf("    %u %u %lld %lld\n", srreq->disk_id, srreq->current_state, srreq->begin_time, srreq->complete_time);
@@ -874,6 +885,7 @@ void raid_print_req_queue(struct raid_info* raid) {
 
 struct raid_info* simulate_raid0(struct raid_info* raid) {
     int req_device_id, req_size, req_operation, flag, err, is_accept_req, interface_flag;
+    unsigned int req_stream;
     int64_t req_incoming_time, nearest_event_time, req_lsn;
     struct ssd_info *ssd;
     char buffer[200];
@@ -893,11 +905,13 @@ struct raid_info* simulate_raid0(struct raid_info* raid) {
             // Read a request from tracefile
             filepoint = ftell(raid->tracefile);
             fgets (buffer, 200, raid->tracefile);
-            sscanf (buffer,"%lld %d %lld %d %d", &req_incoming_time, &req_device_id, &req_lsn, &req_size, &req_operation);
+            if (sscanf (buffer,"%lld %d %lld %d %d %u", &req_incoming_time, &req_device_id, &req_lsn, &req_size, &req_operation, &req_stream) < 6) {
+                req_stream = 0;     // the stream id column is optional
+            }
             is_accept_req = 1;
 
             // Validating incoming request
-            if (req_device_id < 0 || req_lsn < 0 || req_size < 0 || !(req_operation == 0 || req_operation == 1)) {
+            if (req_device_id < 0 || req_lsn < 0 || req_size < 0 || !(req_operation == WRITE || req_operation == READ || req_operation == TRIM)) {
                 printf("Error! wrong io request from tracefile (%lld %d %lld %d %d)\n", req_incoming_time, req_device_id, req_lsn, req_size, req_operation);
                 exit(1);
             }
@@ -920,12 +934,12 @@ struct raid_info* simulate_raid0(struct raid_info* raid) {
 
             if (is_accept_req) {
                 #ifdef DEBUG
-                printf("req inserted: %lld %d %d %d %d [%d]\n", req_incoming_time, req_device_id, req_lsn, req_size, req_operation, raid->request_queue_length);
+                printf("req inserted: %lld %d %lld %d %d [%d]\n", req_incoming_time, req_device_id, req_lsn, req_size, req_operation, raid->request_queue_length);
                 #endif
             
                 // insert request to raid rquest queue
                 // a single request can be forwarder to multiple disk
-                err = raid_distribute_request(raid, req_incoming_time, req_lsn, req_size, req_operation);
+                err = raid_distribute_request(raid, req_incoming_time, req_lsn, req_size, req_operation, req_stream);
                 if (err == R_DIST_ERR) {
                     fseek(raid->tracefile,filepoint,0);
                     printf("Error! Distributing raid request failed!\n");
@@ -951,6 +965,7 @@ struct raid_info* simulate_raid0(struct raid_info* raid) {
 
 struct raid_info* simulate_raid5(struct raid_info* raid) {
     int req_device_id, req_size, req_operation, flag, err, is_accept_req, interface_flag;
+    unsigned int req_stream;
     int64_t req_incoming_time, nearest_event_time, req_lsn;
     struct ssd_info *ssd;
     char buffer[200];
@@ -970,11 +985,13 @@ struct raid_info* simulate_raid5(struct raid_info* raid) {
             // Read a request from tracefile
             filepoint = ftell(raid->tracefile);
             fgets (buffer, 200, raid->tracefile);
-            sscanf (buffer,"%lld %d %lld %d %d", &req_incoming_time, &req_device_id, &req_lsn, &req_size, &req_operation);
+            if (sscanf (buffer,"%lld %d %lld %d %d %u", &req_incoming_time, &req_device_id, &req_lsn, &req_size, &req_operation, &req_stream) < 6) {
+                req_stream = 0;     // the stream id column is optional
+            }
             is_accept_req = 1;
 
             // Validating incoming request
-            if (req_device_id < 0 || req_lsn < 0 || req_size < 0 || !(req_operation == 0 || req_operation == 1)) {
+            if (req_device_id < 0 || req_lsn < 0 || req_size < 0 || !(req_operation == WRITE || req_operation == READ || req_operation == TRIM)) {
                 printf("Error! wrong io request from tracefile (%lld %d %lld %d %d)\n", req_incoming_time, req_device_id, req_lsn, req_size, req_operation);
                 exit(1);
             }
@@ -997,12 +1014,12 @@ struct raid_info* simulate_raid5(struct raid_info* raid) {
 
             if (is_accept_req) {
                 #ifdef DEBUGRAID
-                printf("req inserted: %lld %d %d %d %d [%d]\n", req_incoming_time, req_device_id, req_lsn, req_size, req_operation, raid->request_queue_length);
+                printf("req inserted: %lld %d %lld %d %d [%d]\n", req_incoming_time, req_device_id, req_lsn, req_size, req_operation, raid->request_queue_length);
                 #endif
             
                 // insert request to raid rquest queue
                 // a single request can be forwarder to multiple disk
-                err = raid_distribute_request(raid, req_incoming_time, req_lsn, req_size, req_operation);
+                err = raid_distribute_request(raid, req_incoming_time, req_lsn, req_size, req_operation, req_stream);
                 if (err == R_DIST_ERR) {
                     fseek(raid->tracefile,filepoint,0);
                     printf("Error! Distributing raid request failed!\n");
@@ -23,8 +23,8 @@
 #define WRITE_RAID 3
 
 struct raid_info* initialize_raid(struct raid_info*, struct user_args*);
-struct raid_request* initialize_raid_request(struct raid_request* raid_req, int64_t req_incoming_time, unsigned int req_lsn, unsigned int req_size, unsigned int req_operation);
-struct raid_sub_request* initialize_raid_sub_request(struct raid_sub_request* raid_subreq, struct raid_request* raid_req, unsigned int disk_id, unsigned int stripe_id, unsigned int strip_id, unsigned int strip_offset, unsigned int lsn, unsigned int size, unsigned int operation);
+struct raid_request* initialize_raid_request(struct raid_request* raid_req, int64_t req_incoming_time, int64_t req_lsn, unsigned int req_size, unsigned int req_operation);
+struct raid_sub_request* initialize_raid_sub_request(struct raid_sub_request* raid_subreq, struct raid_request* raid_req, unsigned int disk_id, unsigned int stripe_id, unsigned int strip_id, unsigned int strip_offset, int64_t lsn, unsigned int size, unsigned int operation);
 void free_raid_ssd_and_tracefile(struct raid_info*);
 int64_t raid_find_nearest_event(struct raid_info*);
 
@@ -36,7 +36,7 @@ int raid_ssd_interface(struct ssd_info*, struct raid_sub_request*);
 int raid_ssd_get_requests(int disk_id, struct ssd_info *ssd, struct raid_info *raid);
 void raid_ssd_trace_output(struct ssd_info*);
 
-int raid_distribute_request(struct raid_info*, int64_t, unsigned int, unsigned int, unsigned int);
+int raid_distribute_request(struct raid_info*, int64_t, int64_t, unsigned int, unsigned int, unsigned int);
 int raid_clear_completed_request(struct raid_info*);
 
 void raid5_finish_parity_calculation(struct raid_info*);
@@ -59,7 +59,7 @@ struct raid_info {
     FILE * logfile;
 
     int64_t current_time;
-    unsigned int max_lsn;
+    int64_t max_lsn;
     struct raid_request *request_queue;
     struct raid_request *request_tail;
     unsigned int request_queue_length;
@@ -80,9 +80,10 @@ struct gclock_raid_info {
 
 // Request in RAID level
 struct raid_request {
-    unsigned int lsn;
+    int64_t lsn;
     unsigned int size;
     unsigned int operation;
+    unsigned int stream;            // write stream id from the tracefile, 0 if not given
 
     int64_t begin_time;
     int64_t response_time;
@@ -103,9 +104,10 @@ struct raid_sub_request {
     int64_t complete_time;
     unsigned int current_state;
 
-    unsigned int lsn;
+    int64_t lsn;
     unsigned int size;
     unsigned int operation;
+    unsigned int stream;
 
     struct raid_sub_request *next_node;
 };
\ No newline at end of file
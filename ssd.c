@@ -290,6 +290,10 @@ struct ssd_info *simulate(struct ssd_info *ssd)
         return NULL;
     }
 
+    ssd->complete_max=1024;
+    ssd->complete_heap=(struct request **)malloc(ssd->complete_max*sizeof(struct request *));
+    alloc_assert(ssd->complete_heap,"complete_heap");
+
     fprintf(ssd->outputfile,"      arrive           lsn     size ope     begin time    response time    process time\n");	
     fflush(ssd->outputfile);
 
@@ -301,6 +305,7 @@ struct ssd_info *simulate(struct ssd_info *ssd)
 
         // Interface layer
         flag=get_requests(ssd);
+        update_bus_statistic(ssd);
 
         // Buffer layer
         if(flag == 1)
@@ -314,10 +319,16 @@ struct ssd_info *simulate(struct ssd_info *ssd)
             {
                 no_buffer_distribute(ssd);
             }		
+            request_complete(ssd,ssd->request_tail);
         }
 
         // FTL+FCL+Flash layer
         process(ssd);
+        dftl_flush(ssd);
+        if (ssd->parameter->dram_capacity!=0)
+        {
+            buffer_flush(ssd);
+        }
         trace_output(ssd);
         init_gc(ssd);
 
@@ -346,13 +357,15 @@ struct ssd_info *simulate(struct ssd_info *ssd)
 int get_requests(struct ssd_info *ssd)  
 {  
     char buffer[200];
-    unsigned int lsn=0;
-    int device,  size, ope,large_lsn, i = 0,j=0;
+    int64_t lsn=0,large_lsn;
+    int device,  size, ope, i = 0,j=0;
+    unsigned int stream=0;
     struct request *request1;
     int flag = 1;
     long filepoint; 
     int64_t time_t = 0;
     int64_t nearest_event_time;    
+    int64_t last_time=ssd->current_time;
 
 #ifdef DEBUG
     printf("enter get_requests,  current time:%lld\n",ssd->current_time);
@@ -362,7 +375,9 @@ int get_requests(struct ssd_info *ssd)
     if(!feof(ssd->tracefile)) {
         filepoint = ftell(ssd->tracefile);
         fgets(buffer, 200, ssd->tracefile);
-        sscanf(buffer,"%lld %d %d %d %d",&time_t,&device,&lsn,&size,&ope);
+        if (sscanf(buffer,"%lld %d %lld %d %d %u",&time_t,&device,&lsn,&size,&ope,&stream) < 6) {
+            stream = 0;                     // the stream id column is optional
+        }
 
         if (filepoint == 0) {
             ssd->simulation_start_time = time_t;
@@ -391,7 +406,7 @@ int get_requests(struct ssd_info *ssd)
      *large_lsn: channel下面有多少个subpage，即多少个sector。overprovide系数：SSD中并不是所有的空间都可以给用户使用，
      *比如32G的SSD可能有10%的空间保留下来留作他用，所以乘以1-provide
      ***********************************************************************************************************/
-    large_lsn=(int)((ssd->parameter->subpage_page*ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num)*(1-ssd->parameter->overprovide));
+    large_lsn=user_capacity(ssd,(int64_t)ssd->parameter->subpage_page*ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num);
     lsn = lsn%large_lsn;
 
     nearest_event_time=find_nearest_event(ssd);
@@ -419,7 +434,7 @@ int get_requests(struct ssd_info *ssd)
         }
         else // nearest_event_time >= time_t
         {
-            if (ssd->request_queue_length>=ssd->parameter->queue_length)
+            if ((ssd->request_queue_length>=ssd->parameter->queue_length)&&(ope!=POWER_LOSS))
             {
                 fseek(ssd->tracefile,filepoint,0);
                 ssd->current_time=nearest_event_time;
@@ -441,17 +456,33 @@ int get_requests(struct ssd_info *ssd)
     if(feof(ssd->tracefile))
     {
         request1=NULL;
+        if (ssd->current_time<last_time)                     /*读到EOF时time_t不可信，不能让时间倒退*/
+            ssd->current_time=last_time;
+        ssd->simulation_end_time = ssd->current_time;        /*所有请求都已经完成(比如都由buffer服务)时不会再进入上面EOF的分支*/
         return 0;
     }
 
+    if (ope==POWER_LOSS)                                     /*掉电事件只做估算，不产生请求*/
+    {
+        power_loss(ssd);
+        return -1;
+    }
+
     request1 = (struct request*)malloc(sizeof(struct request));
     alloc_assert(request1,"request");
     memset(request1,0, sizeof(struct request));
 
+    if (ope==FUA)                                            /*FUA写按写请求处理，数据还要立即写入flash*/
+    {
+        request1->fua = 1;
+        ope = WRITE;
+        ssd->fua_request_count++;
+    }
     request1->time = time_t;
     request1->lsn = lsn;
     request1->size = size;
     request1->operation = ope;	
+    request1->stream = (ope==WRITE)?stream:0;
     request1->begin_time = time_t;
     request1->response_time = 0;	
     request1->energy_consumption = 0;	
@@ -471,16 +502,21 @@ int get_requests(struct ssd_info *ssd)
     else
     {			
         (ssd->request_tail)->next_node = request1;	
+        request1->prev_node = ssd->request_tail;
         ssd->request_tail = request1;			
         ssd->request_queue_length++;
     }
 
-    if (request1->operation==READ)             //计算平均请求大小 1为读 0为写
+    if (request1->operation==READ)             //计算平均请求大小 1为读 0为写 2为trim
     {
         ssd->ave_read_size=(ssd->ave_read_size*ssd->read_request_count+request1->size)/(ssd->read_request_count+1);
         ssd->read_request_size+=request1->size;
     } 
-    else
+    else if (request1->operation==TRIM)
+    {
+        ssd->trim_request_size+=request1->size;
+    }
+    else if ((request1->operation==WRITE)||(request1->operation==ZONE_APPEND))
     {
         ssd->ave_write_size=(ssd->ave_write_size*ssd->write_request_count+request1->size)/(ssd->write_request_count+1);
         ssd->write_request_size+=request1->size;
@@ -489,7 +525,7 @@ int get_requests(struct ssd_info *ssd)
 
     filepoint = ftell(ssd->tracefile);	
     fgets(buffer, 200, ssd->tracefile);    //寻找下一条请求的到达时间
-    sscanf(buffer,"%lld %d %d %d %d",&time_t,&device,&lsn,&size,&ope);
+    sscanf(buffer,"%lld %d %lld %d %d",&time_t,&device,&lsn,&size,&ope);
     ssd->next_request_time=time_t;
     fseek(ssd->tracefile,filepoint,0);
 
@@ -510,27 +546,44 @@ int get_requests(struct ssd_info *ssd)
  ***********************************************************************************************************************************************/
 struct ssd_info *buffer_management(struct ssd_info *ssd)
 {   
-    unsigned int j,lsn,lpn,last_lpn,first_lpn,index,complete_flag=0, state,full_page;
-    unsigned int flag=0,need_distb_flag,lsn_flag,flag1=1,active_region_flag=0;           
+    unsigned int j,complete_flag=0;
+    int64_t lsn,lpn,last_lpn,first_lpn;
+    unsigned int flag=0,flag1=1,active_region_flag=0;           
+    subpage_mask state,full_page,need_distb_flag,lsn_flag;
     struct request *new_request;
-    struct buffer_group *buffer_node,key;
-    unsigned int mask=0,offset1=0,offset2=0;
+    struct buffer_group *buffer_node;
+    struct buffer_info *buffer;
+    subpage_mask mask=0;
+    unsigned int offset1=0,offset2=0;
 
 #ifdef DEBUG
     printf("enter buffer_management,  current time:%lld\n",ssd->current_time);
 #endif
     ssd->dram->current_time=ssd->current_time;
-    full_page=~(0xffffffff<<ssd->parameter->subpage_page);
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
 
     new_request=ssd->request_tail;
+    if ((ssd->parameter->address_mapping==ZNS_MAPPING)&&(zns_request(ssd,new_request)==FAILURE))
+    {
+        return ssd;
+    }
     lsn=new_request->lsn;
     lpn=new_request->lsn/ssd->parameter->subpage_page;
     last_lpn=(new_request->lsn+new_request->size-1)/ssd->parameter->subpage_page;
     first_lpn=new_request->lsn/ssd->parameter->subpage_page;
 
-    new_request->need_distr_flag=(unsigned int*)malloc(sizeof(unsigned int)*((last_lpn-first_lpn+1)*ssd->parameter->subpage_page/32+1));
+    new_request->need_distr_flag=(subpage_mask*)malloc(sizeof(subpage_mask)*(last_lpn-first_lpn+1));
     alloc_assert(new_request->need_distr_flag,"new_request->need_distr_flag");
-    memset(new_request->need_distr_flag, 0, sizeof(unsigned int)*((last_lpn-first_lpn+1)*ssd->parameter->subpage_page/32+1));
+    memset(new_request->need_distr_flag, 0, sizeof(subpage_mask)*(last_lpn-first_lpn+1));
+
+    if(new_request->operation==TRIM)
+    {
+        return trim_request(ssd,new_request);
+    }
+    if(new_request->operation==FLUSH)
+    {
+        return flush_request(ssd,new_request);
+    }
 
     if(new_request->operation==READ) 
     {	
@@ -541,49 +594,33 @@ struct ssd_info *buffer_management(struct ssd_info *ssd)
              *即1表示需要分发，0表示不需要分发，对应点初始全部赋为1
              *************************************************************************************************/
             need_distb_flag=full_page;   
-            key.group=lpn;
-            buffer_node= (struct buffer_group*)avlTreeFind(ssd->dram->buffer, (TREE_NODE *)&key);		// buffer node 
+            buffer=buffer_of(ssd,lpn);                                       /*lpn所在的写buffer分区*/
+            buffer_node=buffer_find(buffer,lpn);		// buffer node 
+            if (buffer_node==NULL)                                              /*没有这个lpn的节点时，请求在这一页中的sector都没有命中*/
+            {
+                buffer->read_node_miss+=((new_request->lsn+new_request->size<(lpn+1)*ssd->parameter->subpage_page)?new_request->lsn+new_request->size:(lpn+1)*ssd->parameter->subpage_page)
+                                                 -((new_request->lsn>lpn*ssd->parameter->subpage_page)?new_request->lsn:lpn*ssd->parameter->subpage_page);
+            }
 
             while((buffer_node!=NULL)&&(lsn<(lpn+1)*ssd->parameter->subpage_page)&&(lsn<=(new_request->lsn+new_request->size-1)))
             {
                 lsn_flag=full_page;
-                mask=1 << (lsn%ssd->parameter->subpage_page);
-                if(mask>255) // 4KB page
-                {
-                    printf("the subpage number is larger than 8!add some cases");
-                    getchar(); 		   
-                }
-                else if((buffer_node->stored & mask)==mask)
+                mask=SUBPAGE_BIT(lsn%ssd->parameter->subpage_page);
+                if((buffer_node->stored & mask)==mask)
                 {
                     flag=1;
                     lsn_flag=lsn_flag&(~mask);
                 }
 
                 if(flag==1)				
-                {	//如果该buffer节点不在buffer的队首，需要将这个节点提到队首，实现了LRU算法，这个是一个双向队列。		       		
-                    if(ssd->dram->buffer->buffer_head!=buffer_node)     
-                    {		
-                        if(ssd->dram->buffer->buffer_tail==buffer_node)								
-                        {			
-                            buffer_node->LRU_link_pre->LRU_link_next=NULL;					
-                            ssd->dram->buffer->buffer_tail=buffer_node->LRU_link_pre;							
-                        }				
-                        else								
-                        {				
-                            buffer_node->LRU_link_pre->LRU_link_next=buffer_node->LRU_link_next;				
-                            buffer_node->LRU_link_next->LRU_link_pre=buffer_node->LRU_link_pre;								
-                        }								
-                        buffer_node->LRU_link_next=ssd->dram->buffer->buffer_head;
-                        ssd->dram->buffer->buffer_head->LRU_link_pre=buffer_node;
-                        buffer_node->LRU_link_pre=NULL;			
-                        ssd->dram->buffer->buffer_head=buffer_node;													
-                    }						
-                    ssd->dram->buffer->read_hit++;					
+                {	//如果该buffer节点不在buffer的队首，需要将这个节点提到队首，实现了LRU算法，这个是一个双向队列；CLOCK时只置访问位
+                    buffer_touch(buffer,buffer_node);
+                    buffer->read_hit++;					
                     new_request->complete_lsn_count++;											
                 }		
                 else if(flag==0)
                 {
-                    ssd->dram->buffer->read_miss_hit++;
+                    buffer->read_miss_hit++;
                 }
 
                 need_distb_flag=need_distb_flag&lsn_flag;
@@ -592,37 +629,48 @@ struct ssd_info *buffer_management(struct ssd_info *ssd)
                 lsn++;						
             }	
 
-            index=(lpn-first_lpn)/(32/ssd->parameter->subpage_page); 			
-            new_request->need_distr_flag[index]=new_request->need_distr_flag[index]|(need_distb_flag<<(((lpn-first_lpn)%(32/ssd->parameter->subpage_page))*ssd->parameter->subpage_page));            
+            if (ssd->dram->read_cache!=NULL)                                  /*写buffer中没有的子页再查read cache*/
+            {
+                need_distb_flag=read_cache_lookup(ssd,new_request,lpn,need_distb_flag);
+            }
+            new_request->need_distr_flag[lpn-first_lpn]=need_distb_flag;
             lpn++;
 
         }
+        if (ssd->dram->prefetch!=NULL)
+        {
+            read_cache_prefetch(ssd,new_request);
+        }
     }  
     else if(new_request->operation==WRITE)
     {
         while(lpn<=last_lpn)           	
         {	
             need_distb_flag=full_page;
-            mask=~(0xffffffff<<(ssd->parameter->subpage_page));
+            mask=SUBPAGE_BITS(ssd->parameter->subpage_page);
             state=mask;
 
             if(lpn==first_lpn)
             {
                 offset1=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-new_request->lsn);
-                state=state&(0xffffffff<<offset1);
+                state=state&(~0ULL<<offset1);
             }
             if(lpn==last_lpn)
             {
                 offset2=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-(new_request->lsn+new_request->size));
-                state=state&(~(0xffffffff<<offset2));
+                state=state&SUBPAGE_BITS(offset2);
             }
 
             ssd=insert2buffer(ssd, lpn, state,NULL,new_request);
+            if (new_request->fua!=0)
+            {
+                buffer_fua(ssd,lpn,new_request);
+            }
             lpn++;
         }
     }
     complete_flag = 1;
-    for(j=0;j<=(last_lpn-first_lpn+1)*ssd->parameter->subpage_page/32;j++)
+    for(j=0;j<=last_lpn-first_lpn;j++)
     {
         if(new_request->need_distr_flag[j] != 0)
         {
@@ -648,15 +696,14 @@ struct ssd_info *buffer_management(struct ssd_info *ssd)
 /*****************************
  *lpn向ppn的转换
  ******************************/
-unsigned int lpn2ppn(struct ssd_info *ssd,unsigned int lsn)
+int64_t lpn2ppn(struct ssd_info *ssd,int64_t lsn)
 {
-    int lpn, ppn;	
-    struct entry *p_map = ssd->dram->map->map_entry;
+    int64_t lpn, ppn;	
 #ifdef DEBUG
     printf("enter lpn2ppn,  current time:%lld\n",ssd->current_time);
 #endif
     lpn = lsn/ssd->parameter->subpage_page;			//lpn
-    ppn = (p_map[lpn]).pn;
+    ppn = get_entry(ssd,lpn)->pn;
     return ppn;
 }
 
@@ -670,23 +717,24 @@ unsigned int lpn2ppn(struct ssd_info *ssd,unsigned int lsn)
  **********************************************************************************/
 struct ssd_info *distribute(struct ssd_info *ssd) 
 {
-    unsigned int start, end, first_lsn,last_lsn,lpn,flag=0,flag_attached=0,full_page;
-    unsigned int j, k, sub_size;
-    int i=0;
+    int64_t first_lpn,last_lpn,lpn;
+    unsigned int flag=0,flag_attached=0;
+    unsigned int sub_size;
+    subpage_mask k,full_page;
     struct request *req;
     struct sub_request *sub;
-    unsigned int* complt;
+    subpage_mask *complt;
 
 #ifdef DEBUG
     printf("enter distribute,  current time:%lld\n",ssd->current_time);
 #endif
-    full_page=~(0xffffffff<<ssd->parameter->subpage_page);
+    full_page=SUBPAGE_BITS(ssd->parameter->subpage_page);
 
     req = ssd->request_tail;
     if(req->response_time != 0){
         return ssd;
     }
-    if (req->operation==WRITE)
+    if ((req->operation==WRITE)||(req->operation==FLUSH))
     {
         return ssd;
     }
@@ -698,45 +746,31 @@ struct ssd_info *distribute(struct ssd_info *ssd)
             //如果还有一些读请求需要处理 | If there are still some read requests that need to be processed
             if(req->complete_lsn_count != ssd->request_tail->size)
             {
-                first_lsn = req->lsn;				
-                last_lsn = first_lsn + req->size;
+                first_lpn = req->lsn/ssd->parameter->subpage_page;
+                last_lpn = (req->lsn+req->size-1)/ssd->parameter->subpage_page;
                 complt = req->need_distr_flag;
-                start = first_lsn - first_lsn % ssd->parameter->subpage_page;
-                end = (last_lsn/ssd->parameter->subpage_page + 1) * ssd->parameter->subpage_page;
-                i = (end - start)/32;	
 
-                while(i >= 0)
-                {
-                    /*************************************************************************************
-                     *一个32位的整型数据的每一位代表一个子页，32/ssd->parameter->subpage_page就表示有多少页，
-                     *这里的每一页的状态都存放在了 req->need_distr_flag中，也就是complt中，通过比较complt的
-                     *每一项与full_page，就可以知道，这一页是否处理完成。如果没处理完成则通过creat_sub_request
-                     函数创建子请求。
-
-                     Each bit of a 32-bit integer data represents a subpage, and 32/ssd->parameter->subpage_page indicates 
-                     how many pages there are. The state of each page here is stored in req->need_distr_flag, 
-                     that is, In complt, by comparing each item of complt with full_page, you can know whether 
-                     this page is processed or not. A subrequest is created by the creat_sub_request function 
-                     if it is not processed.
-                     *************************************************************************************/
-                    for(j=0; j<32/ssd->parameter->subpage_page; j++)
-                    {	
-                        k = (complt[((end-start)/32-i)] >>(ssd->parameter->subpage_page*j)) & full_page;
-                        if (k !=0)
+                /*************************************************************************************
+                 *req->need_distr_flag中每个逻辑页一项，是这一页中buffer没有命中、还需要从flash读的子页，
+                 *不为0时通过creat_sub_request函数创建子请求。
+                 *req->need_distr_flag holds one subpage bitmap per logical page of the request: the
+                 *subpages the buffer did not serve. A sub request is created for each non-zero entry.
+                 *************************************************************************************/
+                for(lpn=first_lpn; lpn<=last_lpn; lpn++)
+                {	
+                    k = complt[lpn-first_lpn] & full_page;
+                    if (k !=0)
+                    {
+                        sub_size=transfer_size(ssd,k,lpn,req);    
+                        if (sub_size==0) 
                         {
-                            lpn = start/ssd->parameter->subpage_page+ ((end-start)/32-i)*32/ssd->parameter->subpage_page + j;
-                            sub_size=transfer_size(ssd,k,lpn,req);    
-                            if (sub_size==0) 
-                            {
-                                continue;
-                            }
-                            else
-                            {
-                                sub=creat_sub_request(ssd,lpn,sub_size,0,req,req->operation);
-                            }	
+                            continue;
                         }
+                        else
+                        {
+                            sub=creat_sub_request(ssd,lpn,sub_size,k,req,req->operation);
+                        }	
                     }
-                    i = i-1;
                 }
 
             }
@@ -752,244 +786,282 @@ struct ssd_info *distribute(struct ssd_info *ssd)
 }
 
 
+/*完成堆中a是否排在b前面：retire_time早的在前，相同时先到达的在前*/
+static int request_earlier(struct request *a,struct request *b)
+{
+    if (a->retire_time!=b->retire_time)
+    {
+        return a->retire_time<b->retire_time;
+    }
+    return a->time<=b->time;
+}
+
+/*********************************************************************************************
+ *request_complete()在请求所有子请求的完成时间都已确定(outstanding为0)时，把请求放入完成堆。
+ *有子请求的请求按最晚的子请求完成时间排序，buffer命中等已经有响应时间的请求按放入的时刻排序，
+ *下一次trace_output就输出。raid模拟不使用完成堆(complete_heap为NULL)
+ *********************************************************************************************/
+void request_complete(struct ssd_info *ssd,struct request *req)
+{
+    unsigned int i,parent;
+
+    if ((ssd->complete_heap==NULL)||(req->retire_flag!=0)||(req->outstanding!=0))
+    {
+        return;
+    }
+    if (ssd->complete_count==ssd->complete_max)
+    {
+        ssd->complete_max=ssd->complete_max*2;
+        ssd->complete_heap=(struct request **)realloc(ssd->complete_heap,ssd->complete_max*sizeof(struct request *));
+        alloc_assert(ssd->complete_heap,"complete_heap");
+    }
+    req->retire_flag=1;
+    req->retire_time=(req->response_time!=0)?ssd->current_time:req->complete_time;
+
+    i=ssd->complete_count++;
+    while (i>0)
+    {
+        parent=(i-1)/2;
+        if (request_earlier(ssd->complete_heap[parent],req))
+        {
+            break;
+        }
+        ssd->complete_heap[i]=ssd->complete_heap[parent];
+        i=parent;
+    }
+    ssd->complete_heap[i]=req;
+}
+
+/*取出完成堆的堆顶*/
+static struct request *request_retire_pop(struct ssd_info *ssd)
+{
+    struct request *top=ssd->complete_heap[0];
+    struct request *last=ssd->complete_heap[--ssd->complete_count];
+    unsigned int i=0,child;
+
+    while ((child=2*i+1)<ssd->complete_count)
+    {
+        if ((child+1<ssd->complete_count)&&request_earlier(ssd->complete_heap[child+1],ssd->complete_heap[child]))
+        {
+            child++;
+        }
+        if (request_earlier(last,ssd->complete_heap[child]))
+        {
+            break;
+        }
+        ssd->complete_heap[i]=ssd->complete_heap[child];
+        i=child;
+    }
+    ssd->complete_heap[i]=last;
+    top->retire_flag=0;
+    return top;
+}
+
+/*把完成的请求从请求队列中删除并释放*/
+static void request_free(struct ssd_info *ssd,struct request *req)
+{
+    if (req->prev_node==NULL)
+    {
+        ssd->request_queue=req->next_node;
+    }
+    else
+    {
+        req->prev_node->next_node=req->next_node;
+    }
+    if (req->next_node==NULL)
+    {
+        ssd->request_tail=req->prev_node;
+    }
+    else
+    {
+        req->next_node->prev_node=req->prev_node;
+    }
+    ssd->request_queue_length--;
+
+    free(req->need_distr_flag);
+    req->need_distr_flag=NULL;
+    free(req);
+}
+
+/*把完成的请求输出到outputfile和io输出文件*/
+static void request_print(struct ssd_info *ssd,struct request *req,int64_t start_time,int64_t end_time)
+{
+    int64_t latency=end_time-req->time;
+
+    req->energy_consumption = request_energy(ssd,req);
+    fprintf(ssd->outputfile,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld %10.3f\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time, req->energy_consumption);
+    fflush(ssd->outputfile);
+    fprintf(ssd->outfile_io,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+    fflush(ssd->outfile_io);
+    if (req->operation == WRITE) {
+        fprintf(ssd->outfile_io_write,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+        fflush(ssd->outfile_io_write);
+    } else if (req->operation == READ) {
+        fprintf(ssd->outfile_io_read,"%16lld %10lld %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
+        fflush(ssd->outfile_io_read);
+    }
+
+    if(end_time-start_time==0)
+    {
+        printf("the response time is 0?? \n");
+        getchar();
+    }
+}
+
 /**********************************************************************
  *trace_output()函数是在每一条请求的所有子请求经过process()函数处理完后，
- *打印输出相关的运行结果到outputfile文件中，这里的结果主要是运行的时间
+ *打印输出相关的运行结果到outputfile文件中，这里的结果主要是运行的时间。
+ *只处理完成堆中retire_time已经到达的请求，按完成时间先后输出，不扫描整个请求队列
  *====================================================================
  *The trace_output() function is executed after all sub-requests of each request have been processed by the process() function.
- *Print out the relevant running results to the outputfile, the result here is mainly the running time
+ *Print out the relevant running results to the outputfile, the result here is mainly the running time.
+ *Only the requests at the top of the completion heap whose retire_time has passed are retired, in completion order.
  **********************************************************************/
 void trace_output(struct ssd_info* ssd){
-    int flag = 1; 
-    int64_t start_time, end_time, latency = -1;
-    struct request *req, *pre_node;
+    int64_t start_time, end_time;
+    struct request *req;
     struct sub_request *sub, *tmp;
 
 #ifdef DEBUG
     printf("enter trace_output,  current time:%lld\n",ssd->current_time);
 #endif
 
-    pre_node=NULL;
-    req = ssd->request_queue;
-    start_time = 0;
-    end_time = 0;
-
-    if(req == NULL)
-        return;
-
-    while(req != NULL)	
+    while((ssd->complete_count>0)&&(ssd->complete_heap[0]->retire_time<=ssd->current_time))
     {
-        sub = req->subs;
-        flag = 1;
-        start_time = 0;
-        end_time = 0;
+        req=request_retire_pop(ssd);
+        if (req->outstanding!=0)                                        /*放入完成堆后又有新的子请求，等它们的完成时间确定后再放入*/
+        {
+            continue;
+        }
+
         if(req->response_time != 0)
         {
-            latency = req->response_time-req->time;
-            fprintf(ssd->outputfile,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-            fflush(ssd->outputfile);
-            fprintf(ssd->outfile_io,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-            fflush(ssd->outfile_io);
-            if (req->operation == WRITE) {
-                fprintf(ssd->outfile_io_write,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-                fflush(ssd->outfile_io_write);
-            } else {
-                fprintf(ssd->outfile_io_read,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, req->begin_time, req->response_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-                fflush(ssd->outfile_io_read);
-            }
+            request_print(ssd,req,req->begin_time,req->response_time);
 
-            if(req->response_time-req->begin_time==0)
+            if (req->failed!=0)
             {
-                printf("the response time is 0?? \n");
-                getchar();
+                ssd->dram->map->zns->rejected_count++;
             }
-
-            if (req->operation==READ)
+            else if (req->operation==READ)
             {
                 ssd->read_request_count++;
                 ssd->read_avg=ssd->read_avg+(req->response_time-req->time);
             } 
-            else
+            else if (req->operation==TRIM)
             {
-                ssd->write_request_count++;
-                ssd->write_avg=ssd->write_avg+(req->response_time-req->time);
+                ssd->trim_request_count++;
+                ssd->trim_avg=ssd->trim_avg+(req->response_time-req->time);
             }
-
-            if(pre_node == NULL)
+            else if (req->operation==FLUSH)
             {
-                if(req->next_node == NULL)
-                {
-                    free(req->need_distr_flag);
-                    req->need_distr_flag=NULL;
-                    free(req);
-                    req = NULL;
-                    ssd->request_queue = NULL;
-                    ssd->request_tail = NULL;
-                    ssd->request_queue_length--;
-                }
-                else
-                {
-                    ssd->request_queue = req->next_node;
-                    pre_node = req;
-                    req = req->next_node;
-                    free(pre_node->need_distr_flag);
-                    pre_node->need_distr_flag=NULL;
-                    free((void *)pre_node);
-                    pre_node = NULL;
-                    ssd->request_queue_length--;
-                }
+                ssd->flush_request_count++;
+                ssd->flush_avg=ssd->flush_avg+(req->response_time-req->time);
             }
-            else
+            else if (req->operation==WRITE)
             {
-                if(req->next_node == NULL)
-                {
-                    pre_node->next_node = NULL;
-                    free(req->need_distr_flag);
-                    req->need_distr_flag=NULL;
-                    free(req);
-                    req = NULL;
-                    ssd->request_tail = pre_node;
-                    ssd->request_queue_length--;
-                }
-                else
-                {
-                    pre_node->next_node = req->next_node;
-                    free(req->need_distr_flag);
-                    req->need_distr_flag=NULL;
-                    free((void *)req);
-                    req = pre_node->next_node;
-                    ssd->request_queue_length--;
-                }
+                ssd->write_request_count++;
+                ssd->write_avg=ssd->write_avg+(req->response_time-req->time);
             }
-        }
-        else
-        {
-            flag=1;
-            while(sub != NULL)
-            {
-                if(start_time == 0)
-                    start_time = sub->begin_time;
-                if(start_time > sub->begin_time)
-                    start_time = sub->begin_time;
-                if(end_time < sub->complete_time)
-                    end_time = sub->complete_time;
-                if((sub->current_state == SR_COMPLETE)||((sub->next_state==SR_COMPLETE)&&(sub->next_state_predict_time<=ssd->current_time)))	// if any sub-request is not completed, the request is not completed
-                {
-                    sub = sub->next_subs;
-                }
-                else
-                {
-                    flag=0;
-                    break;
-                }
 
+            for (sub=req->subs;sub!=NULL;sub=sub->next_subs)            /*剩下的子请求由channel继续处理，不再属于这个请求*/
+            {
+                sub->req=NULL;
             }
+            request_free(ssd,req);
+            continue;
+        }
 
-            if (flag == 1)
-            {		
-                req->response_time = end_time;
-                latency = end_time-req->time;
-                fprintf(ssd->outputfile,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-                fflush(ssd->outputfile);
-                fprintf(ssd->outfile_io,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-                fflush(ssd->outfile_io);
-                if (req->operation == WRITE) {
-                    fprintf(ssd->outfile_io_write,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-                    fflush(ssd->outfile_io_write);
-                } else {
-                    fprintf(ssd->outfile_io_read,"%16lld %10d %6d %2d %16lld %16lld %10lld %2d %10lld\n",req->time,req->lsn, req->size, req->operation, start_time, end_time, latency, req->meet_gc_flag, req->meet_gc_remaining_time);
-                    fflush(ssd->outfile_io_read);
-                }
-
-                if(end_time-start_time==0)
-                {
-                    printf("the response time is 0?? \n");
-                    getchar();
-                }
+        if (req->complete_time>ssd->current_time)                      /*放入完成堆之后有子请求的完成时间推迟了*/
+        {
+            request_complete(ssd,req);
+            continue;
+        }
 
-                if (req->operation==READ)
-                {
-                    ssd->read_request_count++;
-                    ssd->read_avg=ssd->read_avg+(end_time-req->time);
-                } 
-                else
-                {
-                    ssd->write_request_count++;
-                    ssd->write_avg=ssd->write_avg+(end_time-req->time);
-                }
+        start_time = 0;
+        end_time = 0;
+        for (sub=req->subs;sub!=NULL;sub=sub->next_subs)
+        {
+            if(start_time == 0)
+                start_time = sub->begin_time;
+            if(start_time > sub->begin_time)
+                start_time = sub->begin_time;
+            if(end_time < sub->complete_time)
+                end_time = sub->complete_time;
+        }
 
-                while(req->subs!=NULL)
+        if (req->operation==FLUSH)
+        {
+            if (flush_pending(ssd,req)!=0)                              /*flush命令还要等之前产生的写子请求*/
+            {
+                req->wait_node=ssd->flush_wait;
+                ssd->flush_wait=req;
+                continue;
+            }
+            if (req->synced==0)                                         /*之前的写子请求中最晚的完成时间只取一次*/
+            {
+                req->synced=1;
+                if (req->complete_time<ssd->dram->write_done_time)
                 {
-                    tmp = req->subs;
-                    req->subs = tmp->next_subs;
-                    if (tmp->update!=NULL)
+                    req->complete_time=ssd->dram->write_done_time;
+                    if (req->complete_time>ssd->current_time)
                     {
-                        free(tmp->update->location);
-                        tmp->update->location=NULL;
-                        free(tmp->update);
-                        tmp->update=NULL;
+                        request_complete(ssd,req);
+                        continue;
                     }
-                    free(tmp->location);
-                    tmp->location=NULL;
-                    free(tmp);
-                    tmp=NULL;
-
                 }
+            }
+            if (start_time==0)
+                start_time=req->begin_time;
+            if (end_time<req->complete_time)
+                end_time=req->complete_time;
+            if (end_time<req->begin_time+1000)
+                end_time=req->begin_time+1000;
+        }
 
-                if(pre_node == NULL)
-                {
-                    if(req->next_node == NULL)
-                    {
-                        free(req->need_distr_flag);
-                        req->need_distr_flag=NULL;
-                        free(req);
-                        req = NULL;
-                        ssd->request_queue = NULL;
-                        ssd->request_tail = NULL;
-                        ssd->request_queue_length--;
-                    }
-                    else
-                    {
-                        ssd->request_queue = req->next_node;
-                        pre_node = req;
-                        req = req->next_node;
-                        free(pre_node->need_distr_flag);
-                        pre_node->need_distr_flag=NULL;
-                        free(pre_node);
-                        pre_node = NULL;
-                        ssd->request_queue_length--;
-                    }
-                }
-                else
-                {
-                    if(req->next_node == NULL)
-                    {
-                        pre_node->next_node = NULL;
-                        free(req->need_distr_flag);
-                        req->need_distr_flag=NULL;
-                        free(req);
-                        req = NULL;
-                        ssd->request_tail = pre_node;	
-                        ssd->request_queue_length--;
-                    }
-                    else
-                    {
-                        pre_node->next_node = req->next_node;
-                        free(req->need_distr_flag);
-                        req->need_distr_flag=NULL;
-                        free(req);
-                        req = pre_node->next_node;
-                        ssd->request_queue_length--;
-                    }
+        req->response_time = end_time;
+        if ((ssd->dram->read_cache!=NULL)||(ssd->dram->buffer->policy==BUFFER_CFLRU))
+        {
+            read_cache_complete(ssd,req);
+        }
+        if ((req->prefetch==0)&&(req->flush==0))                      /*预取和后台写回的内部请求不输出，也不计入统计*/
+        {
+            request_print(ssd,req,start_time,end_time);
 
-                }
+            if (req->operation==READ)
+            {
+                ssd->read_request_count++;
+                ssd->read_avg=ssd->read_avg+(end_time-req->time);
+            } 
+            else if (req->operation==FLUSH)
+            {
+                ssd->flush_request_count++;
+                ssd->flush_avg=ssd->flush_avg+(end_time-req->time);
             }
             else
-            {	
-                pre_node = req;
-                req = req->next_node;
+            {
+                ssd->write_request_count++;
+                ssd->write_avg=ssd->write_avg+(end_time-req->time);
             }
-        }		
+        }
+
+        while(req->subs!=NULL)
+        {
+            tmp = req->subs;
+            req->subs = tmp->next_subs;
+            if (tmp->update!=NULL)
+            {
+                free(tmp->update->location);
+                tmp->update->location=NULL;
+                free(tmp->update);
+                tmp->update=NULL;
+            }
+            free(tmp->location);
+            tmp->location=NULL;
+            free(tmp);
+            tmp=NULL;
+        }
+
+        request_free(ssd,req);
     }
 }
 
@@ -1078,10 +1150,14 @@ void statistic_output(struct ssd_info *ssd)
 {
     unsigned int lpn_count=0,i,j,k,m,erase=0,plane_erase=0;
     double gc_energy=0.0;
+    struct buffer_info total;
 #ifdef DEBUG
     printf("enter statistic_output,  current time:%lld\n",ssd->current_time);
 #endif
 
+    update_energy(ssd,ssd->current_time,0,0);                    /*最后一次时间推进之后发生的操作*/
+    buffer_summary(ssd,&total);                                  /*写buffer分区时把各分区的计数加起来*/
+
     for(i=0;i<ssd->parameter->channel_number;i++)
     {
         for(j=0;j<ssd->parameter->die_chip;j++)
@@ -1106,8 +1182,8 @@ void statistic_output(struct ssd_info *ssd)
     fprintf(ssd->outputfile,"\n");
     fprintf(ssd->outputfile,"\n");
     fprintf(ssd->outputfile,"---------------------------statistic data---------------------------\n");	 
-    fprintf(ssd->outputfile,"min lsn: %13d\n",ssd->min_lsn);	
-    fprintf(ssd->outputfile,"max lsn: %13d\n",ssd->max_lsn);
+    fprintf(ssd->outputfile,"min lsn: %13lld\n",ssd->min_lsn);	
+    fprintf(ssd->outputfile,"max lsn: %13lld\n",ssd->max_lsn);
     fprintf(ssd->outputfile,"read count: %13lu\n",ssd->read_count);	  
     fprintf(ssd->outputfile,"program count: %13lu",ssd->program_count);	
     fprintf(ssd->outputfile,"                        include the flash write count leaded by read requests\n");
@@ -1122,10 +1198,62 @@ void statistic_output(struct ssd_info *ssd)
     fprintf(ssd->outputfile,"interleave two plane and one program count: %13lu\n",ssd->inter_mplane_prog_count);
     fprintf(ssd->outputfile,"interleave two plane count: %13lu\n",ssd->inter_mplane_count);
     fprintf(ssd->outputfile,"gc copy back count: %13lu\n",ssd->gc_copy_back);
+    if (ssd->parameter->gc_buffer_aware != 0)
+    {
+        fprintf(ssd->outputfile,"gc migrations saved by buffer: %13lu\n",ssd->gc_absorb_count);
+        fprintf(ssd->outputfile,"buffer evictions held for gc: %13lu\n",ssd->gc_hold_count);
+    }
     fprintf(ssd->outputfile,"write flash count: %13lu\n",ssd->write_flash_count);
     fprintf(ssd->outputfile,"interleave erase count: %13lu\n",ssd->interleave_erase_count);
     fprintf(ssd->outputfile,"multiple plane erase count: %13lu\n",ssd->mplane_erase_conut);
     fprintf(ssd->outputfile,"interleave multiple plane erase count: %13lu\n",ssd->interleave_mplane_erase_count);
+    fprintf(ssd->outputfile,"cache program count: %13lu\n",ssd->cache_program_count);
+    fprintf(ssd->outputfile,"cache read count: %13lu\n",ssd->cache_read_count);
+    fprintf(ssd->outputfile,"gc cache pipelined page count: %13lu\n",ssd->gc_cache_pipeline_count);
+    fprintf(ssd->outputfile,"power cap deferred write count: %13lu\n",ssd->power_cap_host_defer);
+    fprintf(ssd->outputfile,"power cap deferred gc count: %13lu\n",ssd->power_cap_gc_defer);
+    fprintf(ssd->outputfile,"peak concurrent program/erase count: %13u\n",ssd->power_cap_peak_ops);
+    fprintf(ssd->outputfile,"mapping table dram size: %13lld bytes\n",mapping_table_size(ssd));
+    fprintf(ssd->outputfile,"simulator metadata memory: %13lld bytes, peak %13lld bytes\n",ssd->metadata_size,ssd->metadata_peak);
+    if (ssd->dram->map->submap!=NULL)
+    {
+        fprintf(ssd->outputfile,"subpage mapping extra dram size: %13lld bytes\n",user_capacity(ssd,ssd->page)*(ssd->parameter->subpage_page-1)*4);
+        fprintf(ssd->outputfile,"update read avoided count: %13lu\n",ssd->dram->map->submap->avoided_update_read_count);
+        fprintf(ssd->outputfile,"packed subpage write count: %13lu\n",ssd->dram->map->submap->packed_write_count);
+    }
+    if (ssd->dram->map->blockmap!=NULL)
+    {
+        fprintf(ssd->outputfile,"block copy count: %13lu\n",ssd->dram->map->blockmap->block_copy_count);
+        fprintf(ssd->outputfile,"switch merge count: %13lu\n",ssd->dram->map->blockmap->switch_merge_count);
+        fprintf(ssd->outputfile,"partial merge count: %13lu\n",ssd->dram->map->blockmap->partial_merge_count);
+        fprintf(ssd->outputfile,"full merge count: %13lu\n",ssd->dram->map->blockmap->full_merge_count);
+        fprintf(ssd->outputfile,"merge page copy count: %13lu\n",ssd->dram->map->blockmap->merge_page_count);
+        fprintf(ssd->outputfile,"merge erase count: %13lu\n",ssd->dram->map->blockmap->merge_erase_count);
+    }
+    if (ssd->dram->map->zns!=NULL)
+    {
+        fprintf(ssd->outputfile,"zone count: %13u\n",ssd->dram->map->zns->zone_num);
+        fprintf(ssd->outputfile,"zone append count: %13lu\n",ssd->dram->map->zns->append_count);
+        fprintf(ssd->outputfile,"zone reset count: %13lu\n",ssd->dram->map->zns->reset_count);
+        if (ssd->dram->map->zns->reset_count!=0)
+            fprintf(ssd->outputfile,"zone reset average response time: %lld\n",ssd->dram->map->zns->reset_avg/ssd->dram->map->zns->reset_count);
+        fprintf(ssd->outputfile,"zone finish count: %13lu\n",ssd->dram->map->zns->finish_count);
+        fprintf(ssd->outputfile,"zone erase count: %13lu\n",ssd->dram->map->zns->reset_erase_count);
+        fprintf(ssd->outputfile,"zone implicit close count: %13lu\n",ssd->dram->map->zns->implicit_close_count);
+        fprintf(ssd->outputfile,"zone write pointer error count: %13lu\n",ssd->dram->map->zns->wp_error_count);
+        fprintf(ssd->outputfile,"zone resource error count: %13lu\n",ssd->dram->map->zns->resource_error_count);
+        fprintf(ssd->outputfile,"rejected request count: %13lu\n",ssd->dram->map->zns->rejected_count);
+    }
+    if (ssd->dram->map->dftl!=NULL)
+    {
+        fprintf(ssd->outputfile,"mapping cache hit count: %13lu\n",ssd->dram->map->dftl->hit_count);
+        fprintf(ssd->outputfile,"mapping cache miss count: %13lu\n",ssd->dram->map->dftl->miss_count);
+        fprintf(ssd->outputfile,"translation page read count: %13lu\n",ssd->dram->map->dftl->trans_read_count);
+        fprintf(ssd->outputfile,"translation page write count: %13lu\n",ssd->dram->map->dftl->trans_write_count);
+        fprintf(ssd->outputfile,"mapping write back count: %13lu\n",ssd->dram->map->dftl->writeback_count);
+        fprintf(ssd->outputfile,"translation block gc count: %13lu\n",ssd->dram->map->dftl->gc_count);
+        fprintf(ssd->outputfile,"translation page move count: %13lu\n",ssd->dram->map->dftl->gc_move_count);
+    }
     fprintf(ssd->outputfile,"read request count: %13u\n",ssd->read_request_count);
     fprintf(ssd->outputfile,"write request count: %13u\n",ssd->write_request_count);
     fprintf(ssd->outputfile,"read request average size: %13f\n",ssd->ave_read_size);
@@ -1134,10 +1262,72 @@ void statistic_output(struct ssd_info *ssd)
         fprintf(ssd->outputfile,"read request average response time: %lld\n",ssd->read_avg/ssd->read_request_count);
     if (ssd->write_request_count != 0)
         fprintf(ssd->outputfile,"write request average response time: %lld\n",ssd->write_avg/ssd->write_request_count);
-    fprintf(ssd->outputfile,"buffer read hits: %13lu\n",ssd->dram->buffer->read_hit);
-    fprintf(ssd->outputfile,"buffer read miss: %13lu\n",ssd->dram->buffer->read_miss_hit);
-    fprintf(ssd->outputfile,"buffer write hits: %13lu\n",ssd->dram->buffer->write_hit);
-    fprintf(ssd->outputfile,"buffer write miss: %13lu\n",ssd->dram->buffer->write_miss_hit);
+    if (ssd->trim_request_count != 0)
+    {
+        fprintf(ssd->outputfile,"trim request count: %13u\n",ssd->trim_request_count);
+        fprintf(ssd->outputfile,"trim request size: %13u\n",ssd->trim_request_size);
+        fprintf(ssd->outputfile,"trim request average response time: %lld\n",ssd->trim_avg/ssd->trim_request_count);
+        fprintf(ssd->outputfile,"trimmed page count: %13u\n",ssd->trim_page_count);
+    }
+    if (ssd->write_cancel_count != 0)
+    {
+        fprintf(ssd->outputfile,"cancelled write sub-request count: %13u\n",ssd->write_cancel_count);
+    }
+    if (ssd->flush_request_count != 0)
+    {
+        fprintf(ssd->outputfile,"flush request count: %13u\n",ssd->flush_request_count);
+        fprintf(ssd->outputfile,"flush request average response time: %lld\n",ssd->flush_avg/ssd->flush_request_count);
+    }
+    if (ssd->fua_request_count != 0)
+        fprintf(ssd->outputfile,"fua write request count: %13u\n",ssd->fua_request_count);
+    if (ssd->power_loss_count != 0)
+    {
+        fprintf(ssd->outputfile,"power loss count: %13u\n",ssd->power_loss_count);
+        fprintf(ssd->outputfile,"max hold-up time: %lld ns\n",ssd->holdup_time);
+        fprintf(ssd->outputfile,"max hold-up write pages: %13lu\n",ssd->holdup_pages);
+        fprintf(ssd->outputfile,"max hold-up energy: %.3f uJ\n",ssd->holdup_energy/1000);
+        if (ssd->parameter->holdup_budget > 0)
+            fprintf(ssd->outputfile,"power loss over hold-up budget: %13u\n",ssd->holdup_over_budget);
+    }
+    if (ssd->parameter->stream_count > 1)
+        fprintf(ssd->outputfile,"stream fallback count: %13u\n",ssd->stream_fallback_count);
+    fprintf(ssd->outputfile,"buffer policy: %s\n",buffer_policies[total.policy].name);
+    if (ssd->dram->partition_num > 1)
+        fprintf(ssd->outputfile,"buffer partitions: %13u\n",ssd->dram->partition_num);
+    fprintf(ssd->outputfile,"buffer read hits: %13lu\n",total.read_hit);
+    fprintf(ssd->outputfile,"buffer read miss: %13lu\n",total.read_miss_hit);
+    if (total.read_node_miss!=0)
+        fprintf(ssd->outputfile,"buffer read node miss: %13lu\n",total.read_node_miss);
+    fprintf(ssd->outputfile,"buffer write hits: %13lu\n",total.write_hit);
+    fprintf(ssd->outputfile,"buffer write miss: %13lu\n",total.write_miss_hit);
+    if (total.read_hit+total.read_miss_hit+total.read_node_miss!=0)
+        fprintf(ssd->outputfile,"buffer read hit ratio: %.4f\n",(double)total.read_hit/(total.read_hit+total.read_miss_hit+total.read_node_miss));
+    if (total.write_hit+total.write_miss_hit!=0)
+        fprintf(ssd->outputfile,"buffer write hit ratio: %.4f\n",(double)total.write_hit/(total.write_hit+total.write_miss_hit));
+    fprintf(ssd->outputfile,"buffer write back: %13lu\n",total.write_back_count);
+    if (total.clean_evict_count!=0)
+        fprintf(ssd->outputfile,"buffer clean evictions: %13lu\n",total.clean_evict_count);
+    if (total.padding_count!=0)
+        fprintf(ssd->outputfile,"buffer padded pages: %13lu\n",total.padding_count);
+    if (ssd->parameter->background_flush!=0)
+        fprintf(ssd->outputfile,"buffer background flushes: %13lu\n",total.flush_count);
+    if (total.sync_count!=0)
+        fprintf(ssd->outputfile,"buffer forced writes: %13lu\n",total.sync_count);
+    if (ssd->parameter->evict_batch > 1)
+        fprintf(ssd->outputfile,"buffer eviction batches: %13lu\n",total.evict_batch_count);
+    if (ssd->dram->read_cache!=NULL)
+    {
+        fprintf(ssd->outputfile,"read cache hits: %13lu\n",ssd->dram->read_cache->read_hit);
+        fprintf(ssd->outputfile,"read cache miss: %13lu\n",ssd->dram->read_cache->read_miss_hit);
+    }
+    if (ssd->dram->prefetch!=NULL)
+    {
+        fprintf(ssd->outputfile,"prefetched pages: %13lu\n",ssd->dram->prefetch->prefetch_count);
+        fprintf(ssd->outputfile,"prefetch hits: %13lu\n",ssd->dram->prefetch->hit_count);
+        fprintf(ssd->outputfile,"prefetch wasted pages: %13lu\n",ssd->dram->prefetch->wasted_count);
+        if (ssd->dram->prefetch->prefetch_count!=0)
+            fprintf(ssd->outputfile,"prefetch accuracy: %.4f\n",(double)ssd->dram->prefetch->hit_count/ssd->dram->prefetch->prefetch_count);
+    }
     fprintf(ssd->outputfile,"erase: %13u\n",erase);
     fprintf(ssd->outputfile,"write amplification: %.2f\n",(double)ssd->program_count/(double)ssd->write_request_count);
     fprintf(ssd->outputfile,"read amplification: %.2f\n",(double)ssd->read_count/(double)ssd->read_request_count);
@@ -1147,8 +1337,8 @@ void statistic_output(struct ssd_info *ssd)
     fprintf(ssd->statisticfile,"\n");
     fprintf(ssd->statisticfile,"\n");
     fprintf(ssd->statisticfile,"---------------------------statistic data---------------------------\n");	
-    fprintf(ssd->statisticfile,"min lsn: %13u\n",ssd->min_lsn);	
-    fprintf(ssd->statisticfile,"max lsn: %13u\n",ssd->max_lsn);
+    fprintf(ssd->statisticfile,"min lsn: %13lld\n",ssd->min_lsn);	
+    fprintf(ssd->statisticfile,"max lsn: %13lld\n",ssd->max_lsn);
     fprintf(ssd->statisticfile,"read count: %13lu\n",ssd->read_count);	  
     fprintf(ssd->statisticfile,"program count: %13lu",ssd->program_count);	  
     fprintf(ssd->statisticfile,"                        include the flash write count leaded by read requests\n");
@@ -1163,12 +1353,64 @@ void statistic_output(struct ssd_info *ssd)
     fprintf(ssd->statisticfile,"interleave two plane and one program count: %13lu\n",ssd->inter_mplane_prog_count);
     fprintf(ssd->statisticfile,"interleave two plane count: %13lu\n",ssd->inter_mplane_count);
     fprintf(ssd->statisticfile,"gc copy back count: %13lu\n",ssd->gc_copy_back);
+    if (ssd->parameter->gc_buffer_aware != 0)
+    {
+        fprintf(ssd->statisticfile,"gc migrations saved by buffer: %13lu\n",ssd->gc_absorb_count);
+        fprintf(ssd->statisticfile,"buffer evictions held for gc: %13lu\n",ssd->gc_hold_count);
+    }
     fprintf(ssd->statisticfile,"gc count: %13lu\n",ssd->num_gc);
     fprintf(ssd->statisticfile,"write flash count: %13lu\n",ssd->write_flash_count);
     fprintf(ssd->statisticfile,"waste page count: %13lu\n",ssd->waste_page_count);
     fprintf(ssd->statisticfile,"interleave erase count: %13lu\n",ssd->interleave_erase_count);
     fprintf(ssd->statisticfile,"multiple plane erase count: %13lu\n",ssd->mplane_erase_conut);
     fprintf(ssd->statisticfile,"interleave multiple plane erase count: %13lu\n",ssd->interleave_mplane_erase_count);
+    fprintf(ssd->statisticfile,"cache program count: %13lu\n",ssd->cache_program_count);
+    fprintf(ssd->statisticfile,"cache read count: %13lu\n",ssd->cache_read_count);
+    fprintf(ssd->statisticfile,"gc cache pipelined page count: %13lu\n",ssd->gc_cache_pipeline_count);
+    fprintf(ssd->statisticfile,"power cap deferred write count: %13lu\n",ssd->power_cap_host_defer);
+    fprintf(ssd->statisticfile,"power cap deferred gc count: %13lu\n",ssd->power_cap_gc_defer);
+    fprintf(ssd->statisticfile,"peak concurrent program/erase count: %13u\n",ssd->power_cap_peak_ops);
+    fprintf(ssd->statisticfile,"mapping table dram size: %13lld bytes\n",mapping_table_size(ssd));
+    fprintf(ssd->statisticfile,"simulator metadata memory: %13lld bytes, peak %13lld bytes\n",ssd->metadata_size,ssd->metadata_peak);
+    if (ssd->dram->map->submap!=NULL)
+    {
+        fprintf(ssd->statisticfile,"subpage mapping extra dram size: %13lld bytes\n",user_capacity(ssd,ssd->page)*(ssd->parameter->subpage_page-1)*4);
+        fprintf(ssd->statisticfile,"update read avoided count: %13lu\n",ssd->dram->map->submap->avoided_update_read_count);
+        fprintf(ssd->statisticfile,"packed subpage write count: %13lu\n",ssd->dram->map->submap->packed_write_count);
+    }
+    if (ssd->dram->map->blockmap!=NULL)
+    {
+        fprintf(ssd->statisticfile,"block copy count: %13lu\n",ssd->dram->map->blockmap->block_copy_count);
+        fprintf(ssd->statisticfile,"switch merge count: %13lu\n",ssd->dram->map->blockmap->switch_merge_count);
+        fprintf(ssd->statisticfile,"partial merge count: %13lu\n",ssd->dram->map->blockmap->partial_merge_count);
+        fprintf(ssd->statisticfile,"full merge count: %13lu\n",ssd->dram->map->blockmap->full_merge_count);
+        fprintf(ssd->statisticfile,"merge page copy count: %13lu\n",ssd->dram->map->blockmap->merge_page_count);
+        fprintf(ssd->statisticfile,"merge erase count: %13lu\n",ssd->dram->map->blockmap->merge_erase_count);
+    }
+    if (ssd->dram->map->zns!=NULL)
+    {
+        fprintf(ssd->statisticfile,"zone count: %13u\n",ssd->dram->map->zns->zone_num);
+        fprintf(ssd->statisticfile,"zone append count: %13lu\n",ssd->dram->map->zns->append_count);
+        fprintf(ssd->statisticfile,"zone reset count: %13lu\n",ssd->dram->map->zns->reset_count);
+        if (ssd->dram->map->zns->reset_count!=0)
+            fprintf(ssd->statisticfile,"zone reset average response time: %lld\n",ssd->dram->map->zns->reset_avg/ssd->dram->map->zns->reset_count);
+        fprintf(ssd->statisticfile,"zone finish count: %13lu\n",ssd->dram->map->zns->finish_count);
+        fprintf(ssd->statisticfile,"zone erase count: %13lu\n",ssd->dram->map->zns->reset_erase_count);
+        fprintf(ssd->statisticfile,"zone implicit close count: %13lu\n",ssd->dram->map->zns->implicit_close_count);
+        fprintf(ssd->statisticfile,"zone write pointer error count: %13lu\n",ssd->dram->map->zns->wp_error_count);
+        fprintf(ssd->statisticfile,"zone resource error count: %13lu\n",ssd->dram->map->zns->resource_error_count);
+        fprintf(ssd->statisticfile,"rejected request count: %13lu\n",ssd->dram->map->zns->rejected_count);
+    }
+    if (ssd->dram->map->dftl!=NULL)
+    {
+        fprintf(ssd->statisticfile,"mapping cache hit count: %13lu\n",ssd->dram->map->dftl->hit_count);
+        fprintf(ssd->statisticfile,"mapping cache miss count: %13lu\n",ssd->dram->map->dftl->miss_count);
+        fprintf(ssd->statisticfile,"translation page read count: %13lu\n",ssd->dram->map->dftl->trans_read_count);
+        fprintf(ssd->statisticfile,"translation page write count: %13lu\n",ssd->dram->map->dftl->trans_write_count);
+        fprintf(ssd->statisticfile,"mapping write back count: %13lu\n",ssd->dram->map->dftl->writeback_count);
+        fprintf(ssd->statisticfile,"translation block gc count: %13lu\n",ssd->dram->map->dftl->gc_count);
+        fprintf(ssd->statisticfile,"translation page move count: %13lu\n",ssd->dram->map->dftl->gc_move_count);
+    }
     fprintf(ssd->statisticfile,"read request count: %13u\n",ssd->read_request_count);
     fprintf(ssd->statisticfile,"write request count: %13u\n",ssd->write_request_count);
     fprintf(ssd->statisticfile,"read request average size: %13f\n",ssd->ave_read_size);
@@ -1177,10 +1419,72 @@ void statistic_output(struct ssd_info *ssd)
         fprintf(ssd->statisticfile,"read request average response time: %lld\n",ssd->read_avg/ssd->read_request_count);
     if(ssd->write_request_count != 0)
         fprintf(ssd->statisticfile,"write request average response time: %lld\n",ssd->write_avg/ssd->write_request_count);
-    fprintf(ssd->statisticfile,"buffer read hits: %13lu\n",ssd->dram->buffer->read_hit);
-    fprintf(ssd->statisticfile,"buffer read miss: %13lu\n",ssd->dram->buffer->read_miss_hit);
-    fprintf(ssd->statisticfile,"buffer write hits: %13lu\n",ssd->dram->buffer->write_hit);
-    fprintf(ssd->statisticfile,"buffer write miss: %13lu\n",ssd->dram->buffer->write_miss_hit);
+    if (ssd->trim_request_count != 0)
+    {
+        fprintf(ssd->statisticfile,"trim request count: %13u\n",ssd->trim_request_count);
+        fprintf(ssd->statisticfile,"trim request size: %13u\n",ssd->trim_request_size);
+        fprintf(ssd->statisticfile,"trim request average response time: %lld\n",ssd->trim_avg/ssd->trim_request_count);
+        fprintf(ssd->statisticfile,"trimmed page count: %13u\n",ssd->trim_page_count);
+    }
+    if (ssd->write_cancel_count != 0)
+    {
+        fprintf(ssd->statisticfile,"cancelled write sub-request count: %13u\n",ssd->write_cancel_count);
+    }
+    if (ssd->flush_request_count != 0)
+    {
+        fprintf(ssd->statisticfile,"flush request count: %13u\n",ssd->flush_request_count);
+        fprintf(ssd->statisticfile,"flush request average response time: %lld\n",ssd->flush_avg/ssd->flush_request_count);
+    }
+    if (ssd->fua_request_count != 0)
+        fprintf(ssd->statisticfile,"fua write request count: %13u\n",ssd->fua_request_count);
+    if (ssd->power_loss_count != 0)
+    {
+        fprintf(ssd->statisticfile,"power loss count: %13u\n",ssd->power_loss_count);
+        fprintf(ssd->statisticfile,"max hold-up time: %lld ns\n",ssd->holdup_time);
+        fprintf(ssd->statisticfile,"max hold-up write pages: %13lu\n",ssd->holdup_pages);
+        fprintf(ssd->statisticfile,"max hold-up energy: %.3f uJ\n",ssd->holdup_energy/1000);
+        if (ssd->parameter->holdup_budget > 0)
+            fprintf(ssd->statisticfile,"power loss over hold-up budget: %13u\n",ssd->holdup_over_budget);
+    }
+    if (ssd->parameter->stream_count > 1)
+        fprintf(ssd->statisticfile,"stream fallback count: %13u\n",ssd->stream_fallback_count);
+    fprintf(ssd->statisticfile,"buffer policy: %s\n",buffer_policies[total.policy].name);
+    if (ssd->dram->partition_num > 1)
+        fprintf(ssd->statisticfile,"buffer partitions: %13u\n",ssd->dram->partition_num);
+    fprintf(ssd->statisticfile,"buffer read hits: %13lu\n",total.read_hit);
+    fprintf(ssd->statisticfile,"buffer read miss: %13lu\n",total.read_miss_hit);
+    if (total.read_node_miss!=0)
+        fprintf(ssd->statisticfile,"buffer read node miss: %13lu\n",total.read_node_miss);
+    fprintf(ssd->statisticfile,"buffer write hits: %13lu\n",total.write_hit);
+    fprintf(ssd->statisticfile,"buffer write miss: %13lu\n",total.write_miss_hit);
+    if (total.read_hit+total.read_miss_hit+total.read_node_miss!=0)
+        fprintf(ssd->statisticfile,"buffer read hit ratio: %.4f\n",(double)total.read_hit/(total.read_hit+total.read_miss_hit+total.read_node_miss));
+    if (total.write_hit+total.write_miss_hit!=0)
+        fprintf(ssd->statisticfile,"buffer write hit ratio: %.4f\n",(double)total.write_hit/(total.write_hit+total.write_miss_hit));
+    fprintf(ssd->statisticfile,"buffer write back: %13lu\n",total.write_back_count);
+    if (total.clean_evict_count!=0)
+        fprintf(ssd->statisticfile,"buffer clean evictions: %13lu\n",total.clean_evict_count);
+    if (total.padding_count!=0)
+        fprintf(ssd->statisticfile,"buffer padded pages: %13lu\n",total.padding_count);
+    if (ssd->parameter->background_flush!=0)
+        fprintf(ssd->statisticfile,"buffer background flushes: %13lu\n",total.flush_count);
+    if (total.sync_count!=0)
+        fprintf(ssd->statisticfile,"buffer forced writes: %13lu\n",total.sync_count);
+    if (ssd->parameter->evict_batch > 1)
+        fprintf(ssd->statisticfile,"buffer eviction batches: %13lu\n",total.evict_batch_count);
+    if (ssd->dram->read_cache!=NULL)
+    {
+        fprintf(ssd->statisticfile,"read cache hits: %13lu\n",ssd->dram->read_cache->read_hit);
+        fprintf(ssd->statisticfile,"read cache miss: %13lu\n",ssd->dram->read_cache->read_miss_hit);
+    }
+    if (ssd->dram->prefetch!=NULL)
+    {
+        fprintf(ssd->statisticfile,"prefetched pages: %13lu\n",ssd->dram->prefetch->prefetch_count);
+        fprintf(ssd->statisticfile,"prefetch hits: %13lu\n",ssd->dram->prefetch->hit_count);
+        fprintf(ssd->statisticfile,"prefetch wasted pages: %13lu\n",ssd->dram->prefetch->wasted_count);
+        if (ssd->dram->prefetch->prefetch_count!=0)
+            fprintf(ssd->statisticfile,"prefetch accuracy: %.4f\n",(double)ssd->dram->prefetch->hit_count/ssd->dram->prefetch->prefetch_count);
+    }
     fprintf(ssd->statisticfile,"erase: %13u\n",erase);
     fprintf(ssd->statisticfile,"write sub request count: %13u\n",ssd->write_subreq_count);
     fprintf(ssd->statisticfile,"read subr request count: %13u\n",ssd->read_subreq_count);
@@ -1196,35 +1500,37 @@ void statistic_output(struct ssd_info *ssd)
     fprintf(ssd->statisticfile, " IOPS: %.3f\n", (double)(ssd->read_count+ssd->program_count)/((double)(ssd->simulation_end_time - ssd->simulation_start_time)/1000000000));
     fprintf(ssd->statisticfile, " read BW: %.3f MB/s\n", ((double)ssd->read_request_size/2000.0)/ ((double)(ssd->simulation_end_time - ssd->simulation_start_time)/1000000000));
     fprintf(ssd->statisticfile, " write BW: %.3f MB/s\n", ((double)ssd->write_request_size/2000.0)/ ((double)(ssd->simulation_end_time - ssd->simulation_start_time)/1000000000));
+    for(i=0;i<ssd->parameter->channel_number;i++)
+    {
+        if (ssd->parameter->chip_channel[i]==0)
+            continue;
+        fprintf(ssd->statisticfile, " channel %u bus busy: %lld ns (%.2f%%), chip busy: %.2f%%\n", i, ssd->channel_head[i].bus_busy_time,
+                100*(double)ssd->channel_head[i].bus_busy_time/(double)(ssd->simulation_end_time - ssd->simulation_start_time),
+                100*(double)ssd->channel_head[i].chip_busy_time/((double)(ssd->simulation_end_time - ssd->simulation_start_time)*ssd->parameter->chip_channel[i]));
+    }
+    add_window_energy(ssd,ssd->energy.window_start+ssd->parameter->power_window,0);      /*结束最后一个还没结束的时间窗，让它也参与峰值功率的比较*/
+    fprintf(ssd->statisticfile, " energy: %.6f J (read %.6f, program %.6f, erase %.6f, bus %.6f, dram %.6f, static %.6f)\n", ssd->ssd_energy/1e9,
+            ssd->energy.read_energy/1e9, ssd->energy.program_energy/1e9, ssd->energy.erase_energy/1e9, ssd->energy.bus_energy/1e9, ssd->energy.dram_energy/1e9, ssd->energy.static_energy/1e9);
+    fprintf(ssd->statisticfile, " average power: %.3f mW\n", ssd->ssd_energy*1000/(double)(ssd->simulation_end_time - ssd->simulation_start_time));
+    fprintf(ssd->statisticfile, " peak power: %.3f mW (%u ns window starting at %lld ns)\n", ssd->energy.peak_power, ssd->parameter->power_window, ssd->energy.peak_window_start);
+    fprintf(ssd->statisticfile, " energy per GB: %.3f J/GB\n", (ssd->ssd_energy/1e9)/((double)(ssd->read_request_size+ssd->write_request_size)*ssd->parameter->subpage_capacity/1e9));
     fflush(ssd->statisticfile);
 
     printf(" simulation duration: %lld ns\n", ssd->simulation_end_time - ssd->simulation_start_time);
     printf(" IOPS: %.3f\n", (double)(ssd->read_count+ssd->program_count)/((double)(ssd->simulation_end_time - ssd->simulation_start_time)/1000000000));
     printf(" read BW: %.3f MB/s\n", ((double)ssd->read_request_size/2000.0)/ ((double)(ssd->simulation_end_time - ssd->simulation_start_time)/1000000000));
     printf(" write BW: %.3f MB/s\n", ((double)ssd->write_request_size/2000.0)/ ((double)(ssd->simulation_end_time - ssd->simulation_start_time)/1000000000));
+    printf(" energy: %.6f J, average power: %.3f mW, peak power: %.3f mW\n", ssd->ssd_energy/1e9, ssd->ssd_energy*1000/(double)(ssd->simulation_end_time - ssd->simulation_start_time), ssd->energy.peak_power);
 }
 
 
 /***********************************************************************************
- *根据每一页的状态计算出每一需要处理的子页的数目，也就是一个子请求需要处理的子页的页数
+ *根据每一页的状态计算出每一需要处理的子页的数目，也就是一个子请求需要处理的子页的页数(位图中1的个数)
  *Calculate the number of subpages that need to be processed according to the state of each page, that is, the number of pages of subpages that a subrequest needs to process.
  ************************************************************************************/
-unsigned int size(unsigned int stored)
+unsigned int size(subpage_mask stored)
 {
-    unsigned int i,total=0,mask=0x80000000;
-
-#ifdef DEBUG
-    printf("enter size\n");
-#endif
-    for(i=1;i<=32;i++)
-    {
-        if(stored & mask) total++;
-        stored<<=1;
-    }
-#ifdef DEBUG
-    printf("leave size\n");
-#endif
-    return total;
+    return (unsigned int)__builtin_popcountll(stored);
 }
 
 
@@ -1234,25 +1540,27 @@ unsigned int size(unsigned int stored)
  *两种情况下很有可能不是处理一整页而是处理一页的一部分，因
  *为lsn有可能不是一页的第一个子页。
  *********************************************************/
-unsigned int transfer_size(struct ssd_info *ssd,int need_distribute,unsigned int lpn,struct request *req)
+unsigned int transfer_size(struct ssd_info *ssd,subpage_mask need_distribute,int64_t lpn,struct request *req)
 {
-    unsigned int first_lpn,last_lpn,state,trans_size;
-    unsigned int mask=0,offset1=0,offset2=0;
+    int64_t first_lpn,last_lpn;
+    unsigned int trans_size;
+    unsigned int offset1=0,offset2=0;
+    subpage_mask state,mask=0;
 
     first_lpn=req->lsn/ssd->parameter->subpage_page;
     last_lpn=(req->lsn+req->size-1)/ssd->parameter->subpage_page;
 
-    mask=~(0xffffffff<<(ssd->parameter->subpage_page));
+    mask=SUBPAGE_BITS(ssd->parameter->subpage_page);
     state=mask;
     if(lpn==first_lpn)
     {
         offset1=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-req->lsn);
-        state=state&(0xffffffff<<offset1);
+        state=state&(~0ULL<<offset1);
     }
     if(lpn==last_lpn)
     {
         offset2=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-(req->lsn+req->size));
-        state=state&(~(0xffffffff<<offset2));
+        state=state&SUBPAGE_BITS(offset2);
     }
 
     trans_size=size(state&need_distribute);
@@ -1293,6 +1601,10 @@ int64_t find_nearest_event(struct ssd_info *ssd)
                 if(time2>ssd->channel_head[i].chip_head[j].next_state_predict_time)
                     if (ssd->channel_head[i].chip_head[j].next_state_predict_time>ssd->current_time)    
                         time2=ssd->channel_head[i].chip_head[j].next_state_predict_time;	
+            if (ssd->channel_head[i].chip_head[j].current_state==CHIP_CACHE_WRITE_BUSY)    /*cache register空闲时chip可以接收下一页的数据*/
+                if(time2>ssd->channel_head[i].chip_head[j].cache_reg_free_time)
+                    if (ssd->channel_head[i].chip_head[j].cache_reg_free_time>ssd->current_time)
+                        time2=ssd->channel_head[i].chip_head[j].cache_reg_free_time;
         }   
     } 
 
@@ -1307,12 +1619,168 @@ int64_t find_nearest_event(struct ssd_info *ssd)
     return time;
 }
 
+/**********************************************************************************************************
+ *update_bus_statistic()在ssd的当前时间推进之后，统计从上次统计到的时间(bus_stat_time)到current_time之间
+ *每个channel的总线以及channel上各chip处于忙状态的时间，channel/chip从current_time(操作开始)到next_state_predict_time是忙的。
+ *current_time有可能因为请求到达时间回退，所以只统计bus_stat_time之后的部分。
+ *用总线忙的比例(饱和度)和chip忙的比例来判断瓶颈在通道带宽还是闪存阵列
+ ***********************************************************************************************************/
+void update_bus_statistic(struct ssd_info *ssd)
+{
+    unsigned int i,j;
+    int64_t start,end,last_time=ssd->bus_stat_time;
+    int64_t bus_busy=0,chip_busy=0;
+    struct chip_info *p_chip=NULL;
+
+    if (last_time<ssd->simulation_start_time)
+        last_time=ssd->simulation_start_time;
+    if (ssd->current_time<=last_time)
+        return;
+    ssd->bus_stat_time=ssd->current_time;
+
+    for (i=0;i<ssd->parameter->channel_number;i++)
+    {
+        start=(ssd->channel_head[i].current_time>last_time)?ssd->channel_head[i].current_time:last_time;    /*忙的区间从操作开始的时间算起*/
+        end=(ssd->channel_head[i].next_state_predict_time<ssd->current_time)?ssd->channel_head[i].next_state_predict_time:ssd->current_time;
+        if (end>start)
+        {
+            ssd->channel_head[i].bus_busy_time+=end-start;
+            bus_busy+=end-start;
+        }
+        for (j=0;j<ssd->parameter->chip_channel[i];j++)
+        {
+            p_chip=&ssd->channel_head[i].chip_head[j];
+            start=(p_chip->current_time>last_time)?p_chip->current_time:last_time;
+            end=(p_chip->next_state_predict_time<ssd->current_time)?p_chip->next_state_predict_time:ssd->current_time;
+            if (end>start)
+            {
+                ssd->channel_head[i].chip_busy_time+=end-start;
+                chip_busy+=end-start;
+            }
+        }
+    }
+
+    update_energy(ssd,last_time,bus_busy,chip_busy);
+}
+
+/**********************************************************************************************************
+ *update_energy()统计last_time到current_time之间的能耗
+ *1，按操作计的动态能耗：读、写、擦除、总线传输和dram访问，用计数器在这段时间内的增量乘以每次操作的能耗，
+ *   记在last_time所在的时间窗里
+ *2，chip和channel的空闲功率以及忙时增加的功率(bus_busy,chip_busy为这段时间内忙的时间之和)在时间轴上积分，
+ *   平均分到这段时间覆盖的各个时间窗里
+ *功率单位mW，时间单位ns，mW*ns=pJ
+ ***********************************************************************************************************/
+void update_energy(struct ssd_info *ssd,int64_t last_time,int64_t bus_busy,int64_t chip_busy)
+{
+    struct energy_info *e=&ssd->energy;
+    struct parameter_value *p=ssd->parameter;
+    unsigned long dram_access;
+    struct buffer_info total;
+    unsigned int transfer_size;
+    double read_e,program_e,erase_e,bus_e,dram_e,static_e;
+    int64_t t,end;
+
+    buffer_summary(ssd,&total);
+    dram_access=total.read_hit+total.read_miss_hit+total.write_hit+total.write_miss_hit;
+    transfer_size=ssd->in_read_size+ssd->in_program_size;
+
+    if (e->window_start<ssd->simulation_start_time)        /*第一次统计，从仿真开始的时间计起*/
+    {
+        e->window_start=ssd->simulation_start_time;
+        e->last_read_count=ssd->read_count;
+        e->last_program_count=ssd->program_count;
+        e->last_erase_count=ssd->erase_count;
+        e->last_dram_access=dram_access;
+        e->last_transfer_size=transfer_size;
+    }
+
+    read_e=(double)(ssd->read_count-e->last_read_count)*p->read_energy;
+    program_e=(double)(ssd->program_count-e->last_program_count)*p->program_energy;
+    erase_e=(double)(ssd->erase_count-e->last_erase_count)*p->erase_energy;
+    bus_e=(double)(int)(transfer_size-e->last_transfer_size)*p->subpage_capacity*p->bus_energy/1000;
+    dram_e=(double)(dram_access-e->last_dram_access)*p->dram_energy;
+    static_e=((p->chip_num*p->chip_idle_power+p->channel_number*p->channel_idle_power)*(double)(ssd->current_time-last_time)
+            +p->chip_active_power*(double)chip_busy+p->channel_active_power*(double)bus_busy)/1000;
+
+    e->last_read_count=ssd->read_count;
+    e->last_program_count=ssd->program_count;
+    e->last_erase_count=ssd->erase_count;
+    e->last_dram_access=dram_access;
+    e->last_transfer_size=transfer_size;
+
+    e->read_energy+=read_e;
+    e->program_energy+=program_e;
+    e->erase_energy+=erase_e;
+    e->bus_energy+=bus_e;
+    e->dram_energy+=dram_e;
+    e->static_energy+=static_e;
+    ssd->ssd_energy+=read_e+program_e+erase_e+bus_e+dram_e+static_e;
+
+    add_window_energy(ssd,last_time,read_e+program_e+erase_e+bus_e+dram_e);
+    for (t=last_time;t<ssd->current_time;t=end)
+    {
+        end=e->window_start+p->power_window;
+        if (end<=t)
+            end=t+1;
+        if (end>ssd->current_time)
+            end=ssd->current_time;
+        add_window_energy(ssd,t,static_e*(double)(end-t)/(double)(ssd->current_time-last_time));
+    }
+}
+
+/**********************************************************************************************************
+ *add_window_energy()把time时刻消耗的能量energy记到对应的时间窗里，time超出当前时间窗时先结束当前时间窗，
+ *用窗内能耗除以窗长得到这个窗的平均功率，更新峰值功率
+ ***********************************************************************************************************/
+void add_window_energy(struct ssd_info *ssd,int64_t time,double energy)
+{
+    struct energy_info *e=&ssd->energy;
+    double power;
+
+    if (time>=e->window_start+ssd->parameter->power_window)
+    {
+        power=e->window_energy*1000/ssd->parameter->power_window;     /*nJ/ns=W，换算成mW*/
+        if (power>e->peak_power)
+        {
+            e->peak_power=power;
+            e->peak_window_start=e->window_start;
+        }
+        e->window_energy=0;
+        e->window_start=time-(time-e->window_start)%ssd->parameter->power_window;
+    }
+    e->window_energy+=energy;
+}
+
+/**********************************************************************************************************
+ *request_energy()估算一个请求的能耗(uJ)：每个子请求一次读或写操作加上总线传输的能耗，以及请求在dram中的访问能耗，
+ *不包括gc和空闲功率
+ ***********************************************************************************************************/
+double request_energy(struct ssd_info *ssd,struct request *req)
+{
+    double energy=0;
+    struct sub_request *sub;
+
+    if (ssd->parameter->dram_capacity!=0)
+        energy+=req->size*ssd->parameter->dram_energy;
+    for (sub=req->subs;sub!=NULL;sub=sub->next_subs)
+    {
+        if (sub->operation==READ)
+            energy+=ssd->parameter->read_energy;
+        else
+            energy+=ssd->parameter->program_energy;
+        energy+=(double)sub->size*ssd->parameter->subpage_capacity*ssd->parameter->bus_energy/1000;
+    }
+    return energy/1000;
+}
+
 /***********************************************
  *free_all_node()函数的作用就是释放所有申请的节点
  ************************************************/
 void free_all_node(struct ssd_info *ssd)
 {
     unsigned int i,j,k,l,n;
+    int64_t leaf;
     struct buffer_group *pt=NULL;
     struct direct_erase * erase_node=NULL;
     for (i=0;i<ssd->parameter->channel_number;i++)
@@ -1347,15 +1815,42 @@ void free_all_node(struct ssd_info *ssd)
         }
         free(ssd->channel_head[i].chip_head);
         ssd->channel_head[i].chip_head=NULL;
+        free(ssd->channel_head[i].subs_r_index);
+        ssd->channel_head[i].subs_r_index=NULL;
     }
     free(ssd->channel_head);
     ssd->channel_head=NULL;
+    free(ssd->complete_heap);
+    ssd->complete_heap=NULL;
 
-    avlTreeDestroy( ssd->dram->buffer);
+    for (i=0;i<ssd->dram->partition_num;i++)
+    {
+        free_buffer(ssd->dram->partition[i]);
+    }
+    free(ssd->dram->partition);
+    ssd->dram->partition=NULL;
+    if (ssd->dram->read_cache!=NULL)
+    {
+        free_buffer(ssd->dram->read_cache);
+    }
+    if (ssd->dram->prefetch!=NULL)
+    {
+        free(ssd->dram->prefetch->stream);
+        free(ssd->dram->prefetch);
+    }
     ssd->dram->buffer=NULL;
 
     free(ssd->dram->map->map_entry);
     ssd->dram->map->map_entry=NULL;
+    if (ssd->dram->map->map_dir!=NULL)
+    {
+        for (leaf=0;leaf<ssd->dram->map->map_dir_size;leaf++)
+        {
+            free(ssd->dram->map->map_dir[leaf]);
+        }
+        free(ssd->dram->map->map_dir);
+        ssd->dram->map->map_dir=NULL;
+    }
     free(ssd->dram->map);
     ssd->dram->map=NULL;
     free(ssd->dram);
@@ -1374,7 +1869,8 @@ void free_all_node(struct ssd_info *ssd)
  ******************************************************************************/
 struct ssd_info *make_aged(struct ssd_info *ssd)
 {
-    unsigned int i,j,k,l,m,n,ppn;
+    unsigned int i,j,k,l,m,n;
+    int64_t ppn;
     int threshould,flag=0;
 
     if (ssd->parameter->aged==1)
@@ -1387,7 +1883,7 @@ struct ssd_info *make_aged(struct ssd_info *ssd)
                     for (l=0;l<ssd->parameter->plane_die;l++)
                     {  
                         flag=0;
-                        for (m=0;m<ssd->parameter->block_plane;m++)
+                        for (m=0;m<data_block_plane(ssd);m++)
                         {  
                             if (flag>=threshould)
                             {
@@ -1395,9 +1891,17 @@ struct ssd_info *make_aged(struct ssd_info *ssd)
                             }
                             for (n=0;n<(ssd->parameter->page_block*ssd->parameter->aged_ratio+1);n++)
                             {  
-                                ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head[n].valid_state=0;        //表示某一页失效，同时标记valid和free状态都为0
-                                ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head[n].free_state=0;         //表示某一页失效，同时标记valid和free状态都为0
-                                ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head[n].lpn=0;  //把valid_state free_state lpn都置为0表示页失效，检测的时候三项都检测，单独lpn=0可以是有效页
+                                if (ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head==NULL)
+                                {
+                                    //lazy allocation时只记录失效页数，页数组分配时再置为失效
+                                    ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].aged_pages=n+1;
+                                }
+                                else
+                                {
+                                    ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head[n].valid_state=0;        //表示某一页失效，同时标记valid和free状态都为0
+                                    ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head[n].free_state=0;         //表示某一页失效，同时标记valid和free状态都为0
+                                    ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].page_head[n].lpn=0;  //把valid_state free_state lpn都置为0表示页失效，检测的时候三项都检测，单独lpn=0可以是有效页
+                                }
                                 ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].free_page_num--;
                                 ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].invalid_page_num++;
                                 ssd->channel_head[i].chip_head[j].die_head[k].plane_head[l].blk_head[m].last_write_page++;
@@ -1422,13 +1926,13 @@ struct ssd_info *warmup(struct ssd_info *ssd) {
     int channel, chip, die, plane, block, i, valid_state;
     float threshold = ssd->parameter->aged_ratio;
     int64_t lpn=0, crt_lpn=0, pg_count=0;
-    int64_t pg_threshold=ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num * (1-ssd->parameter->overprovide);
+    int64_t pg_threshold=user_capacity(ssd,ssd->page);
 
     for (channel=0; channel<ssd->parameter->channel_number; channel++)
         for (chip=0; chip<ssd->channel_head[channel].chip; chip++)
             for (die=0; die<ssd->parameter->die_chip; die++)
                 for (plane=0; plane<ssd->parameter->plane_die; plane++)
-                    for (block=0; block<ssd->parameter->block_plane; block++)
+                    for (block=0; block<data_block_plane(ssd); block++)
                         for (i=0; i<ssd->parameter->page_block && pg_count < pg_threshold; i++) {
                             pg_count++;
 
@@ -1436,8 +1940,8 @@ struct ssd_info *warmup(struct ssd_info *ssd) {
                             if (i < ssd->parameter->page_block*threshold) {
                                 valid_state = 0xffffffff;
                                 lpn = crt_lpn++;
-                                ssd->dram->map->map_entry[lpn].pn=find_ppn(ssd, channel, chip, die, plane, block, i);
-                                ssd->dram->map->map_entry[lpn].state=valid_state;
+                                get_entry(ssd,lpn)->pn=find_ppn(ssd, channel, chip, die, plane, block, i);
+                                get_entry(ssd,lpn)->state=valid_state;
 
                             } else { // fill with invalid page
                                 valid_state = 0x0;
@@ -1445,9 +1949,9 @@ struct ssd_info *warmup(struct ssd_info *ssd) {
                                 ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].invalid_page_num++;
                             }
 
-                            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].valid_state=valid_state;
-                            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].free_state=0x0;
-                            ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].page_head[i].lpn=lpn;
+                            get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],i)->valid_state=valid_state;
+                            get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],i)->free_state=0x0;
+                            get_page(ssd,&ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block],i)->lpn=lpn;
                             ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].free_page_num--;
                             ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].blk_head[block].last_write_page++;
                             ssd->channel_head[channel].chip_head[chip].die_head[die].plane_head[plane].free_page--;
@@ -1465,7 +1969,8 @@ struct ssd_info *warmup(struct ssd_info *ssd) {
  *********************************************************************************************/
 struct ssd_info *no_buffer_distribute(struct ssd_info *ssd)
 {
-    unsigned int lsn,lpn,last_lpn,first_lpn,complete_flag=0, state;
+    int64_t lsn,lpn,last_lpn,first_lpn;
+    unsigned int complete_flag=0;
     unsigned int flag=0,flag1=1,active_region_flag=0;           //to indicate the lsn is hitted or not
     struct request *req=NULL;
     struct sub_request *sub=NULL,*sub_r=NULL,*update=NULL;
@@ -1473,23 +1978,36 @@ struct ssd_info *no_buffer_distribute(struct ssd_info *ssd)
     struct channel_info *p_ch=NULL;
 
 
-    unsigned int mask=0; 
+    subpage_mask mask=0,state=0; 
     unsigned int offset1=0, offset2=0;
     unsigned int sub_size=0;
-    unsigned int sub_state=0;
+    subpage_mask sub_state=0;
 
     ssd->dram->current_time=ssd->current_time;
     req=ssd->request_tail;       
+    if ((ssd->parameter->address_mapping==ZNS_MAPPING)&&(zns_request(ssd,req)==FAILURE))
+    {
+        return ssd;
+    }
     lsn=req->lsn;
     lpn=req->lsn/ssd->parameter->subpage_page;
     last_lpn=(req->lsn+req->size-1)/ssd->parameter->subpage_page;
     first_lpn=req->lsn/ssd->parameter->subpage_page;
 
+    if(req->operation==TRIM)
+    {
+        return trim_request(ssd,req);
+    }
+    if(req->operation==FLUSH)
+    {
+        return flush_request(ssd,req);
+    }
+
     if(req->operation==READ)        
     {		
         while(lpn<=last_lpn) 		
         {
-            sub_state=(ssd->dram->map->map_entry[lpn].state&0x7fffffff);
+            sub_state=(get_entry(ssd,lpn)->state&SUBPAGE_BITS(ssd->parameter->subpage_page));
             sub_size=size(sub_state);
             sub=creat_sub_request(ssd,lpn,sub_size,sub_state,req,req->operation);
             lpn++;
@@ -1499,17 +2017,17 @@ struct ssd_info *no_buffer_distribute(struct ssd_info *ssd)
     {
         while(lpn<=last_lpn)     	
         {	
-            mask=~(0xffffffff<<(ssd->parameter->subpage_page));
+            mask=SUBPAGE_BITS(ssd->parameter->subpage_page);
             state=mask;
             if(lpn==first_lpn)
             {
                 offset1=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-req->lsn);
-                state=state&(0xffffffff<<offset1);
+                state=state&(~0ULL<<offset1);
             }
             if(lpn==last_lpn)
             {
                 offset2=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-(req->lsn+req->size));
-                state=state&(~(0xffffffff<<offset2));
+                state=state&SUBPAGE_BITS(offset2);
             }
             sub_size=size(state);
 
@@ -1521,6 +2039,220 @@ struct ssd_info *no_buffer_distribute(struct ssd_info *ssd)
     return ssd;
 }
 
+/*********************************************************************************************
+ *trim_request()处理trim请求：请求覆盖的每个lpn，先从buffer和写队列中删除对应的sector，再使映射表和
+ *物理页中的数据失效。trim只修改dram中的数据结构，和buffer命中一样假设服务时间为1000ns
+ *A trim drops the covered sectors from the buffer and invalidates them in the FTL. It only
+ *touches DRAM state, so it is answered like a buffer hit after 1000ns.
+ *********************************************************************************************/
+struct ssd_info *trim_request(struct ssd_info *ssd,struct request *req)
+{
+    int64_t lpn,first_lpn,last_lpn;
+    unsigned int offset1=0,offset2=0;
+    subpage_mask state;
+
+    lpn=req->lsn/ssd->parameter->subpage_page;
+    first_lpn=lpn;
+    last_lpn=(req->lsn+req->size-1)/ssd->parameter->subpage_page;
+    while(lpn<=last_lpn)
+    {
+        state=SUBPAGE_BITS(ssd->parameter->subpage_page);
+        if(lpn==first_lpn)
+        {
+            offset1=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-req->lsn);
+            state=state&(~0ULL<<offset1);
+        }
+        if(lpn==last_lpn)
+        {
+            offset2=ssd->parameter->subpage_page-((lpn+1)*ssd->parameter->subpage_page-(req->lsn+req->size));
+            state=state&SUBPAGE_BITS(offset2);
+        }
+
+        if (ssd->parameter->dram_capacity!=0)
+        {
+            trim2buffer(ssd,lpn,state);
+        }
+        cancel_write_sub_request(ssd,lpn,lpn,state);                  /*已经从buffer写回、还在写队列中的数据也不再写入*/
+        trim_page(ssd,lpn,state);
+        lpn++;
+    }
+
+    req->begin_time=ssd->current_time;
+    req->response_time=ssd->current_time+1000;
+
+    return ssd;
+}
+
+/*********************************************************************************************
+ *flush_request()处理flush命令：写buffer中所有的脏数据写入flash，写子请求挂在命令上，之前产生
+ *的写子请求(buffer替换和后台写回)也要等它们写入flash。没有buffer时写请求写入flash才完成，flush命令和没有要等的写入时一样，
+ *按buffer命中1000ns完成
+ *********************************************************************************************/
+struct ssd_info *flush_request(struct ssd_info *ssd,struct request *req)
+{
+    req->write_seq=ssd->dram->write_seq;
+    if (ssd->parameter->dram_capacity!=0)
+    {
+        buffer_sync(ssd,req);
+    }
+    if ((req->subs==NULL)&&(flush_pending(ssd,req)==0)&&(ssd->dram->write_done_time<=ssd->current_time))
+    {
+        req->begin_time=ssd->current_time;
+        req->response_time=ssd->current_time+1000;
+    }
+
+    return ssd;
+}
+
+/*flush命令之前产生的写子请求(buffer替换、后台写回)是否还有完成时间没有确定的*/
+int flush_pending(struct ssd_info *ssd,struct request *req)
+{
+    struct sub_request *head=ssd->dram->write_head;
+
+    return ((head!=NULL)&&(head->write_seq<=req->write_seq))?1:0;
+}
+
+/*********************************************************************************************
+ *flush_wakeup()在最早的写子请求完成时间确定后调用：不再等待的flush命令把之前写子请求中最晚的
+ *完成时间计入complete_time，放回完成堆
+ *********************************************************************************************/
+void flush_wakeup(struct ssd_info *ssd)
+{
+    struct request *req=NULL,**pt=&ssd->flush_wait;
+
+    while (*pt!=NULL)
+    {
+        req=*pt;
+        if (flush_pending(ssd,req)!=0)
+        {
+            pt=&req->wait_node;
+            continue;
+        }
+        *pt=req->wait_node;
+        req->wait_node=NULL;
+        req->synced=1;
+        if (req->complete_time<ssd->dram->write_done_time)
+        {
+            req->complete_time=ssd->dram->write_done_time;
+        }
+        request_complete(ssd,req);
+    }
+}
+
+/*********************************************************************************************
+ *power_loss()处理trace中的掉电事件：估算在当前channel和chip的状态下把写buffer中的脏数据全部写入
+ *flash需要的时间(hold-up时间)和能耗，记录最大值，超过hold-up budget时计数。只做估算，不改变
+ *模拟的状态，之后的请求照常处理
+ *********************************************************************************************/
+void power_loss(struct ssd_info *ssd)
+{
+    int64_t holdup=0;
+    unsigned long pages=0;
+    double energy=0;
+
+    if (ssd->parameter->dram_capacity!=0)
+    {
+        holdup=buffer_holdup(ssd,&pages,&energy);
+    }
+    printf("power loss at %lld: %lu dirty pages, hold-up time %lld ns, energy %.3f uJ\n",ssd->current_time,pages,holdup,energy/1000);
+
+    ssd->power_loss_count++;
+    if (holdup>=ssd->holdup_time)
+    {
+        ssd->holdup_time=holdup;
+        ssd->holdup_pages=pages;
+        ssd->holdup_energy=energy;
+    }
+    if ((ssd->parameter->holdup_budget>0)&&(holdup>ssd->parameter->holdup_budget))
+    {
+        ssd->holdup_over_budget++;
+    }
+}
+
+/*********************************************************************************************
+ *ZNS中拒绝一个请求：报告错误，请求立即完成，不计入响应时间的统计
+ *********************************************************************************************/
+void zns_reject(struct ssd_info *ssd,struct request *req,char *reason)
+{
+    printf("ZNS error: %s, request %lld %lld %u %u is rejected\n",reason,req->time,req->lsn,req->size,req->operation);
+    req->failed=1;
+    req->begin_time=ssd->current_time;
+    req->response_time=ssd->current_time+1000;
+}
+
+/*********************************************************************************************
+ *zns_request()在ZNS模式下请求到达时检查zone的状态：写请求必须从zone的写指针开始，并且不能越过
+ *zone的边界，否则报告错误，不做重映射；zone append的写入位置就是写指针，请求的lsn改为写指针；
+ *zone reset和zone finish在这里直接完成。请求需要继续由buffer或flash处理时返回SUCCESS，
+ *已经完成(包括被拒绝)时返回FAILURE
+ *********************************************************************************************/
+Status zns_request(struct ssd_info *ssd,struct request *req)
+{
+    int64_t zone_id=0;
+    int64_t erase_time=0;
+    struct zns_info *zns=ssd->dram->map->zns;
+    struct zone_info *zone=NULL;
+
+    zone_id=req->lsn/zns->zone_sectors;
+    if ((req->operation==READ)||(req->operation==TRIM)||(req->operation==FLUSH))
+    {
+        return SUCCESS;
+    }
+    if (zone_id>=zns->zone_num)
+    {
+        zns->wp_error_count++;
+        zns_reject(ssd,req,"address out of the zoned space");
+        return FAILURE;
+    }
+    zone=&zns->zone[zone_id];
+
+    if (req->operation==ZONE_RESET)
+    {
+        erase_time=zns_reset_zone(ssd,zone_id);
+        req->begin_time=ssd->current_time;
+        req->response_time=ssd->current_time+((erase_time>1000)?erase_time:1000);
+        zns->reset_avg+=req->response_time-req->time;
+        return FAILURE;
+    }
+    if (req->operation==ZONE_FINISH)
+    {
+        zns_release_zone(ssd,zone_id);
+        zone->state=ZONE_FULL;
+        zone->wp=zns->zone_sectors;
+        zns->finish_count++;
+        req->begin_time=ssd->current_time;
+        req->response_time=ssd->current_time+1000;
+        return FAILURE;
+    }
+    if (req->operation==ZONE_APPEND)
+    {
+        req->lsn=zone_id*zns->zone_sectors+zone->wp;
+        req->operation=WRITE;
+        zns->append_count++;
+    }
+
+    if ((zone->state==ZONE_FULL)||(req->lsn!=zone_id*zns->zone_sectors+zone->wp)||(zone->wp+req->size>zns->zone_sectors))
+    {
+        zns->wp_error_count++;
+        zns_reject(ssd,req,"write is not at the write pointer of the zone");
+        return FAILURE;
+    }
+    if (zns_open_zone(ssd,zone_id)==FAILURE)
+    {
+        zns->resource_error_count++;
+        zns_reject(ssd,req,"too many active zones");
+        return FAILURE;
+    }
+
+    zone->wp+=req->size;
+    if (zone->wp==zns->zone_sectors)
+    {
+        zns_release_zone(ssd,zone_id);
+        zone->state=ZONE_FULL;
+    }
+    return SUCCESS;
+}
+
 void display_title() 
 {
     printf("\n");
@@ -1628,12 +2360,15 @@ void display_state(struct ssd_info *ssd) {
 
 struct ssd_info *init_gc(struct ssd_info *ssd) {
     struct gc_operation* gc_node = NULL;
-    unsigned int channel=0, chip=0, die=0, plane=0, is_gc_inited, free_page;
-    unsigned int threshold;
+    unsigned int channel=0, chip=0, die=0, plane=0, is_gc_inited;
+    int64_t threshold, free_page;
     int64_t gc_start_time = 0;
 
+    if (ssd->parameter->address_mapping!=PAGE_MAPPING)                                 /*块映射和FAST通过merge回收块*/
+        return ssd;
+
     // Don't check when #free-page > threshold
-    threshold = ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num * (1-ssd->parameter->overprovide) * ssd->parameter->gc_hard_threshold;
+    threshold = (int64_t)((double)user_capacity(ssd, (int64_t)ssd->parameter->page_block*ssd->parameter->block_plane*ssd->parameter->plane_die*ssd->parameter->die_chip*ssd->parameter->chip_num) * ssd->parameter->gc_hard_threshold);
     free_page = 0;
     for(channel=0; channel<ssd->parameter->channel_number; channel++) {
         for(chip=0; chip<ssd->channel_head[channel].chip; chip++) {
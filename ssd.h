@@ -30,16 +30,28 @@ void simulate_ssd(struct user_args *);
 struct ssd_info *simulate(struct ssd_info *);
 int get_requests(struct ssd_info *);
 struct ssd_info *buffer_management(struct ssd_info *);
-unsigned int lpn2ppn(struct ssd_info * ,unsigned int lsn);
+int64_t lpn2ppn(struct ssd_info * ,int64_t lsn);
 struct ssd_info *distribute(struct ssd_info *);
 void trace_output(struct ssd_info* );
 void statistic_output(struct ssd_info *);
-unsigned int size(unsigned int);
-unsigned int transfer_size(struct ssd_info *,int,unsigned int,struct request *);
+unsigned int size(subpage_mask);
+unsigned int transfer_size(struct ssd_info *,subpage_mask,int64_t,struct request *);
 int64_t find_nearest_event(struct ssd_info *);
+void update_bus_statistic(struct ssd_info *);
+void update_energy(struct ssd_info *,int64_t,int64_t,int64_t);
+void add_window_energy(struct ssd_info *,int64_t,double);
+double request_energy(struct ssd_info *,struct request *);
 void free_all_node(struct ssd_info *);
 struct ssd_info *make_aged(struct ssd_info *);
 struct ssd_info *no_buffer_distribute(struct ssd_info *);
+struct ssd_info *trim_request(struct ssd_info *ssd,struct request *req);
+struct ssd_info *flush_request(struct ssd_info *ssd,struct request *req);
+int flush_pending(struct ssd_info *ssd,struct request *req);
+void request_complete(struct ssd_info *ssd,struct request *req);
+void flush_wakeup(struct ssd_info *ssd);
+void power_loss(struct ssd_info *ssd);
+void zns_reject(struct ssd_info *ssd,struct request *req,char *reason);
+Status zns_request(struct ssd_info *ssd,struct request *req);
 struct ssd_info *warmup(struct ssd_info *);
 struct ssd_info *init_gc(struct ssd_info *);
 void print_gc_node(struct ssd_info* ssd);